@@ -4,25 +4,28 @@
  * http://www.tobias-franke.eu
  */
 
+#include <cstring>
+#include <vector>
+
 #include "image.h"
 
 namespace deimos {
 namespace image {
 
 Image::Image() :
-	raw_data_(0), width_(0), height_(0)
+	raw_data_(0), width_(0), height_(0), bytes_per_pixel_(0), layout_(LAYOUT_LINEAR)
 {
 
 }
 
 Image::Image(const char* filename) :
-	raw_data_(0), width_(0), height_(0)
+	raw_data_(0), width_(0), height_(0), bytes_per_pixel_(0), layout_(LAYOUT_LINEAR)
 {
 	load(filename);
 }
 
 Image::Image(const Image& image) :
-	raw_data_(0), width_(0), height_(0)
+	raw_data_(0), width_(0), height_(0), bytes_per_pixel_(0), layout_(LAYOUT_LINEAR)
 {
 	this->operator=(image);
 }
@@ -40,8 +43,9 @@ Image& Image::operator =(const Image& image)
 	width_ = image.width_;
 	height_ = image.height_;
 	bytes_per_pixel_ = image.bytes_per_pixel_;
+	layout_ = image.layout_;
 
-	const size_t data_size = width_ * height_ * bytes_per_pixel_;
+	const size_t data_size = get_data_size();
 
 	raw_data_ = new unsigned char[data_size];
 
@@ -51,6 +55,20 @@ Image& Image::operator =(const Image& image)
 	return *this;
 }
 
+void Image::create(unsigned int width, unsigned int height, unsigned int bytes_per_pixel)
+{
+	delete [] raw_data_;
+
+	width_ = width;
+	height_ = height;
+	bytes_per_pixel_ = bytes_per_pixel;
+
+	const size_t data_size = get_data_size();
+
+	raw_data_ = new unsigned char[data_size];
+	std::memset(raw_data_, 0, data_size);
+}
+
 bool Image::load(const char* filename)
 {
 	endian_ifstream stream(filename, std::ios_base::binary);
@@ -63,6 +81,7 @@ bool Image::load(const char* filename)
 
 	// Discard possible old image
 	delete [] raw_data_;
+	raw_data_ = 0;
 
 #ifdef BOOST_BIG_ENDIAN
 	stream.toggle_convert();
@@ -72,6 +91,13 @@ bool Image::load(const char* filename)
 
 	stream.close();
 
+	// Codecs deliver row-major data
+	if (ret && layout_ == LAYOUT_TILED)
+	{
+		layout_ = LAYOUT_LINEAR;
+		set_layout(LAYOUT_TILED);
+	}
+
 	return ret;
 }
 
@@ -89,27 +115,80 @@ bool Image::save(const char* filename) const
 	stream.toggle_convert();
 #endif
 
-	bool ret = do_save(stream);
+	// Codecs write row-major data and swap channels on the way, so they get a
+	// copy and the texels of this image stay as they are
+	std::vector<unsigned char> data(size_t(width_) * height_ * bytes_per_pixel_);
+
+	if (!data.empty())
+	{
+		if (layout_ == LAYOUT_TILED)
+			untile_data(raw_data_, &data[0], width_, height_, bytes_per_pixel_);
+		else
+			std::memcpy(&data[0], raw_data_, data.size());
+	}
+
+	const bool ret = do_save(stream, data.empty() ? 0 : &data[0]);
 
 	stream.close();
 
 	return ret;
 }
 
+size_t Image::get_data_size() const
+{
+	if (layout_ == LAYOUT_TILED)
+		return tiled_data_size(width_, height_, bytes_per_pixel_);
+
+	return size_t(width_) * height_ * bytes_per_pixel_;
+}
+
+void Image::set_layout(Layout layout)
+{
+	if (layout == layout_)
+		return;
+
+	if (!raw_data_)
+	{
+		layout_ = layout;
+		return;
+	}
+
+	unsigned char* data;
+
+	if (layout == LAYOUT_TILED)
+	{
+		data = new unsigned char[tiled_data_size(width_, height_, bytes_per_pixel_)];
+		tile_data(raw_data_, data, width_, height_, bytes_per_pixel_);
+	}
+	else
+	{
+		data = new unsigned char[size_t(width_) * height_ * bytes_per_pixel_];
+		untile_data(raw_data_, data, width_, height_, bytes_per_pixel_);
+	}
+
+	delete [] raw_data_;
+	raw_data_ = data;
+	layout_ = layout;
+}
+
 void Image::get_color(unsigned int x, unsigned int y, unsigned char* p_color) const
 {
 	assert(p_color);
 
+	const unsigned char* texel = raw_data_ + texel_offset(x, y);
+
 	for (unsigned int b = 0; b < bytes_per_pixel_; ++b)
-		p_color[b] = raw_data_[(width_ * bytes_per_pixel_ * y) + (x * bytes_per_pixel_) + b];
+		p_color[b] = texel[b];
 }
 
 void Image::set_color(unsigned int x, unsigned int y, const unsigned char* p_color)
 {
 	assert(p_color);
 
+	unsigned char* texel = raw_data_ + texel_offset(x, y);
+
 	for (unsigned int b = 0; b < bytes_per_pixel_; ++b)
-		raw_data_[(width_ * bytes_per_pixel_ * y) + (x * bytes_per_pixel_) + b] = p_color[b];
+		texel[b] = p_color[b];
 }
 
 } // namespace image
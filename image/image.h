@@ -12,18 +12,30 @@
 #include <cassert>
 
 #include "../stream/endian_stream.h"
+#include "image_tiling.h"
 
 namespace deimos {
 namespace image {
 
 class Image
 {
+public:
+	// texel order of raw_data_, codecs always read and write LAYOUT_LINEAR
+	enum Layout
+	{
+		LAYOUT_LINEAR,	// row-major
+		LAYOUT_TILED	// 8x8 tiles, Z-order inside a tile (see image_tiling.h)
+	};
+
 protected:
 	unsigned char* raw_data_;
 	unsigned int width_, height_, bytes_per_pixel_;
+	Layout layout_;
 
 	virtual bool do_load(endian_ifstream& stream) = 0;
-	virtual bool do_save(endian_ofstream& stream) const { return false; };
+
+	// gets a row-major copy of the texels, which the codec may change while writing
+	virtual bool do_save(endian_ofstream&, unsigned char*) const { return false; };
 
 public:
 	Image();
@@ -35,11 +47,34 @@ public:
 	inline unsigned int get_height() const { return height_; };
 	inline unsigned int get_bytes_per_pixel() const { return bytes_per_pixel_; };
 
+	inline Layout get_layout() const { return layout_; };
+
+	// data is ordered according to get_layout()
 	inline const unsigned char* const get_data() const { return raw_data_; };
 
+	// byte size of the data, including the padding of a tiled layout
+	size_t get_data_size() const;
+
+	// byte offset of texel (x, y) in get_data()
+	inline size_t texel_offset(unsigned int x, unsigned int y) const
+	{
+		assert(x < width_ && y < height_);
+
+		if (layout_ == LAYOUT_TILED)
+			return tiled_offset(x, y, tile_count(width_), bytes_per_pixel_);
+
+		return (size_t(width_) * y + x) * bytes_per_pixel_;
+	};
+
+	// reorders the texel data, also applies to images loaded later on
+	void set_layout(Layout layout);
+
 	void get_color(unsigned int x, unsigned int y, unsigned char* p_color) const;
 	void set_color(unsigned int x, unsigned int y, const unsigned char* p_color);
 
+	// replaces the texel data by width x height black texels in the current layout
+	void create(unsigned int width, unsigned int height, unsigned int bytes_per_pixel);
+
 	bool load(const char* filename);
 	bool save(const char* filename) const;
 
@@ -111,7 +111,7 @@ bool ImageBmp::do_load(endian_ifstream& stream)
 	return true;
 }
 
-bool ImageBmp::do_save(endian_ofstream& stream) const
+bool ImageBmp::do_save(endian_ofstream& stream, unsigned char* data) const
 {
 	tBmpFileHeader bmp_file_header;
 	tBmpInfoHeader bmp_info_header;
@@ -186,10 +186,10 @@ bool ImageBmp::do_save(endian_ofstream& stream) const
 	switch(bytes_per_pixel_)
 	{
 		case 3:
-			do_save_24(stream);
+			do_save_24(stream, data);
 			break;
 		case 1:
-			do_save_8(stream);
+			do_save_8(stream, data);
 			break;
 		default:
 			// Format not supported
@@ -217,16 +217,16 @@ void ImageBmp::do_load_24(std::ifstream& stream)
 	}
 }
 
-void ImageBmp::do_save_24(std::ofstream& stream) const
+void ImageBmp::do_save_24(std::ofstream& stream, unsigned char* data) const
 {
 	const size_t row_size = width_ * bytes_per_pixel_;
 
 	for(unsigned int y = 0; y < height_; ++y)
 	{
 		for(unsigned int x = 0; x < row_size; x+=3)
-			std::swap(raw_data_[(y * row_size) + x + 0], raw_data_[(y * row_size) + x + 2]);
+			std::swap(data[(y * row_size) + x + 0], data[(y * row_size) + x + 2]);
 
-		stream.write((char*)raw_data_ + (y * row_size), std::streamsize(row_size));
+		stream.write((char*)data + (y * row_size), std::streamsize(row_size));
 
 		// Align to 4 bytes
 		stream.write("\0", width_%4);
@@ -245,7 +245,7 @@ void ImageBmp::do_load_8(std::ifstream& stream)
 	}
 }
 
-void ImageBmp::do_save_8(std::ofstream& stream) const
+void ImageBmp::do_save_8(std::ofstream& stream, unsigned char* data) const
 {
 	char rgbt[4];
 	rgbt[3] = 0;
@@ -262,7 +262,7 @@ void ImageBmp::do_save_8(std::ofstream& stream) const
 	// Write data
 	for(unsigned int y = 0; y < height_; ++y)
 	{
-		stream.write((char*)(raw_data_ + (y * width_)), width_);
+		stream.write((char*)(data + (y * width_)), width_);
 		stream.write("\0", width_%4);
 	}
 }
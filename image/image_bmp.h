@@ -47,11 +47,11 @@ protected:
 	inline void do_load_24(std::ifstream& stream);
 	inline void do_load_8 (std::ifstream& stream);
 
-	inline void do_save_24(std::ofstream& stream) const;
-	inline void do_save_8 (std::ofstream& stream) const;
+	inline void do_save_24(std::ofstream& stream, unsigned char* data) const;
+	inline void do_save_8 (std::ofstream& stream, unsigned char* data) const;
 
 	bool do_load(endian_ifstream& stream);
-	bool do_save(endian_ofstream& stream) const;
+	bool do_save(endian_ofstream& stream, unsigned char* data) const;
 
 public:
 	ImageBmp();
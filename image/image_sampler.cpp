@@ -0,0 +1,638 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2001
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "image_sampler.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DEIMOS_SAMPLER_AVX2__
+#endif
+
+namespace deimos {
+namespace image {
+
+namespace {
+
+	const float INV_255 = 1.f / 255.f;
+
+	inline size_t level_size(unsigned int width, unsigned int height, unsigned int bytes_per_pixel, Image::Layout layout)
+	{
+		if (layout == Image::LAYOUT_TILED)
+			return tiled_data_size(width, height, bytes_per_pixel);
+
+		return size_t(width) * height * bytes_per_pixel;
+	}
+
+	// 2x2 box filter of a row-major level, odd sizes repeat the last row/column
+	void downsample(const unsigned char* src, unsigned int width, unsigned int height,
+					unsigned char* dst, unsigned int dst_width, unsigned int dst_height, unsigned int bytes_per_pixel)
+	{
+		for (unsigned int y = 0; y < dst_height; ++y)
+		{
+			const unsigned int y0 = std::min(2 * y, height - 1);
+			const unsigned int y1 = std::min(2 * y + 1, height - 1);
+
+			for (unsigned int x = 0; x < dst_width; ++x)
+			{
+				const unsigned int x0 = std::min(2 * x, width - 1);
+				const unsigned int x1 = std::min(2 * x + 1, width - 1);
+
+				for (unsigned int b = 0; b < bytes_per_pixel; ++b)
+				{
+					const unsigned int sum =
+						src[(size_t(y0) * width + x0) * bytes_per_pixel + b] +
+						src[(size_t(y0) * width + x1) * bytes_per_pixel + b] +
+						src[(size_t(y1) * width + x0) * bytes_per_pixel + b] +
+						src[(size_t(y1) * width + x1) * bytes_per_pixel + b];
+
+					dst[(size_t(y) * dst_width + x) * bytes_per_pixel + b] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	inline int wrap(int x, int size)
+	{
+		if (x < 0)
+			return x + size;
+		if (x >= size)
+			return x - size;
+		return x;
+	}
+
+	inline int clamp(int x, int size)
+	{
+		return std::max(0, std::min(x, size - 1));
+	}
+
+} // anonymous namespace
+
+//-------------------------------------//
+
+MipChain::MipChain(const Image& image) :
+	data_(0), levels_(0), bytes_per_pixel_(image.get_bytes_per_pixel()), layout_(image.get_layout())
+{
+	unsigned int width = image.get_width();
+	unsigned int height = image.get_height();
+
+	assert(width && height && image.get_data());
+
+	// level sizes and offsets
+	size_t data_size = 0;
+
+	for (;;)
+	{
+		width_[levels_] = width;
+		height_[levels_] = height;
+		offset_[levels_] = data_size;
+		data_size += level_size(width, height, bytes_per_pixel_, layout_);
+		++levels_;
+
+		if ((width == 1 && height == 1) || levels_ == MAX_LEVELS)
+			break;
+
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+
+	data_ = new unsigned char[data_size];
+
+	// filter on row-major copies, then bring each level into the image layout
+	unsigned char* linear = new unsigned char[size_t(width_[0]) * height_[0] * bytes_per_pixel_];
+	unsigned char* next = new unsigned char[size_t(width_[0]) * height_[0] * bytes_per_pixel_];
+
+	if (layout_ == Image::LAYOUT_TILED)
+		untile_data(image.get_data(), linear, width_[0], height_[0], bytes_per_pixel_);
+	else
+		std::memcpy(linear, image.get_data(), size_t(width_[0]) * height_[0] * bytes_per_pixel_);
+
+	for (unsigned int l = 0; l < levels_; ++l)
+	{
+		if (l > 0)
+		{
+			downsample(linear, width_[l-1], height_[l-1], next, width_[l], height_[l], bytes_per_pixel_);
+			std::swap(linear, next);
+		}
+
+		if (layout_ == Image::LAYOUT_TILED)
+			tile_data(linear, data_ + offset_[l], width_[l], height_[l], bytes_per_pixel_);
+		else
+			std::memcpy(data_ + offset_[l], linear, size_t(width_[l]) * height_[l] * bytes_per_pixel_);
+	}
+
+	delete [] linear;
+	delete [] next;
+}
+
+MipChain::~MipChain()
+{
+	delete [] data_;
+}
+
+//-------------------------------------//
+
+Sampler::Sampler(const Image& image, Filter filter, Address address) :
+	data_(image.get_data()), filter_(filter), address_(address), layout_(image.get_layout()),
+	levels_(1), bytes_per_pixel_(image.get_bytes_per_pixel())
+{
+	assert(data_ && bytes_per_pixel_ >= 1 && bytes_per_pixel_ <= 4);
+
+	width_[0] = image.get_width();
+	height_[0] = image.get_height();
+	widthf_[0] = static_cast<float>(width_[0]);
+	heightf_[0] = static_cast<float>(height_[0]);
+	tiles_x_[0] = tile_count(width_[0]);
+	offset_[0] = 0;
+
+	// a single level can't be filtered between levels
+	if (filter_ == FILTER_TRILINEAR)
+		filter_ = FILTER_BILINEAR;
+}
+
+Sampler::Sampler(const MipChain& chain, Filter filter, Address address) :
+	data_(chain.get_data()), filter_(filter), address_(address), layout_(chain.get_layout()),
+	levels_(chain.get_levels()), bytes_per_pixel_(chain.get_bytes_per_pixel())
+{
+	assert(data_ && bytes_per_pixel_ >= 1 && bytes_per_pixel_ <= 4);
+
+	for (unsigned int l = 0; l < levels_; ++l)
+	{
+		width_[l] = chain.get_width(l);
+		height_[l] = chain.get_height(l);
+		widthf_[l] = static_cast<float>(width_[l]);
+		heightf_[l] = static_cast<float>(height_[l]);
+		tiles_x_[l] = tile_count(width_[l]);
+
+		// offsets are kept 32bit so they can be used as gather indices
+		assert(chain.get_data(l) - data_ < 0x7fffffff);
+		offset_[l] = static_cast<int>(chain.get_data(l) - data_);
+	}
+}
+
+inline void Sampler::address(int level, float u, float v, int& x0, int& y0, int& x1, int& y1, float& fx, float& fy) const
+{
+	if (address_ == ADDRESS_WRAP)
+	{
+		u -= std::floor(u);
+		v -= std::floor(v);
+	}
+	else
+	{
+		// keep integer conversion in range, anything outside is clamped anyway
+		u = std::max(-1.f, std::min(u, 2.f));
+		v = std::max(-1.f, std::min(v, 2.f));
+	}
+
+	const float x = u * widthf_[level] - .5f;
+	const float y = v * heightf_[level] - .5f;
+	const float xf = std::floor(x);
+	const float yf = std::floor(y);
+
+	fx = x - xf;
+	fy = y - yf;
+	x0 = static_cast<int>(xf);
+	y0 = static_cast<int>(yf);
+
+	if (address_ == ADDRESS_WRAP)
+	{
+		x1 = wrap(x0 + 1, width_[level]);
+		y1 = wrap(y0 + 1, height_[level]);
+		x0 = wrap(x0, width_[level]);
+		y0 = wrap(y0, height_[level]);
+	}
+	else
+	{
+		x1 = clamp(x0 + 1, width_[level]);
+		y1 = clamp(y0 + 1, height_[level]);
+		x0 = clamp(x0, width_[level]);
+		y0 = clamp(y0, height_[level]);
+	}
+}
+
+inline void Sampler::fetch(int level, int x, int y, float* rgba) const
+{
+	const size_t offset = (layout_ == Image::LAYOUT_TILED) ?
+		tiled_offset(x, y, tiles_x_[level], bytes_per_pixel_) :
+		(size_t(width_[level]) * y + x) * bytes_per_pixel_;
+
+	const unsigned char* texel = data_ + offset_[level] + offset;
+
+	switch (bytes_per_pixel_)
+	{
+		case 4:
+			rgba[0] = texel[0] * INV_255;
+			rgba[1] = texel[1] * INV_255;
+			rgba[2] = texel[2] * INV_255;
+			rgba[3] = texel[3] * INV_255;
+			break;
+		case 3:
+			rgba[0] = texel[0] * INV_255;
+			rgba[1] = texel[1] * INV_255;
+			rgba[2] = texel[2] * INV_255;
+			rgba[3] = 1.f;
+			break;
+		case 2:
+			rgba[0] = rgba[1] = rgba[2] = texel[0] * INV_255;
+			rgba[3] = texel[1] * INV_255;
+			break;
+		default:
+			rgba[0] = rgba[1] = rgba[2] = texel[0] * INV_255;
+			rgba[3] = 1.f;
+			break;
+	}
+}
+
+void Sampler::sample_nearest(int level, float u, float v, float* rgba) const
+{
+	if (address_ == ADDRESS_WRAP)
+	{
+		u -= std::floor(u);
+		v -= std::floor(v);
+	}
+	else
+	{
+		u = std::max(0.f, std::min(u, 1.f));
+		v = std::max(0.f, std::min(v, 1.f));
+	}
+
+	// u == 1 lands on width, which wraps to 0 or clamps to width-1
+	int x = static_cast<int>(u * widthf_[level]);
+	int y = static_cast<int>(v * heightf_[level]);
+
+	if (address_ == ADDRESS_WRAP)
+	{
+		x = wrap(x, width_[level]);
+		y = wrap(y, height_[level]);
+	}
+	else
+	{
+		x = clamp(x, width_[level]);
+		y = clamp(y, height_[level]);
+	}
+
+	fetch(level, x, y, rgba);
+}
+
+void Sampler::sample_bilinear(int level, float u, float v, float* rgba) const
+{
+	int x0, y0, x1, y1;
+	float fx, fy;
+
+	address(level, u, v, x0, y0, x1, y1, fx, fy);
+
+	float t00[4], t10[4], t01[4], t11[4];
+
+	fetch(level, x0, y0, t00);
+	fetch(level, x1, y0, t10);
+	fetch(level, x0, y1, t01);
+	fetch(level, x1, y1, t11);
+
+	for (int c = 0; c < 4; ++c)
+	{
+		const float top = t00[c] + (t10[c] - t00[c]) * fx;
+		const float bottom = t01[c] + (t11[c] - t01[c]) * fx;
+		rgba[c] = top + (bottom - top) * fy;
+	}
+}
+
+void Sampler::sample(float u, float v, float* rgba) const
+{
+	if (filter_ == FILTER_NEAREST)
+		sample_nearest(0, u, v, rgba);
+	else
+		sample_bilinear(0, u, v, rgba);
+}
+
+void Sampler::sample(float u, float v, float lod, float* rgba) const
+{
+	const float max_level = static_cast<float>(levels_ - 1);
+	lod = std::max(0.f, std::min(lod, max_level));
+
+	if (filter_ != FILTER_TRILINEAR)
+	{
+		// closest level
+		const int level = static_cast<int>(lod + .5f);
+
+		if (filter_ == FILTER_NEAREST)
+			sample_nearest(level, u, v, rgba);
+		else
+			sample_bilinear(level, u, v, rgba);
+
+		return;
+	}
+
+	const int l0 = static_cast<int>(lod);
+	const int l1 = std::min(l0 + 1, static_cast<int>(levels_) - 1);
+	const float f = lod - l0;
+
+	float c0[4], c1[4];
+	sample_bilinear(l0, u, v, c0);
+	sample_bilinear(l1, u, v, c1);
+
+	for (int c = 0; c < 4; ++c)
+		rgba[c] = c0[c] + (c1[c] - c0[c]) * f;
+}
+
+void Sampler::sample(const float* u, const float* v, unsigned int count, float* rgba) const
+{
+	sample(u, v, 0, count, rgba);
+}
+
+void Sampler::sample(const float* u, const float* v, const float* lod, unsigned int count, float* rgba) const
+{
+	if (sample_batch_simd(u, v, lod, count, rgba))
+		return;
+
+	if (lod)
+		for (unsigned int i = 0; i < count; ++i)
+			sample(u[i], v[i], lod[i], rgba + 4 * i);
+	else
+		for (unsigned int i = 0; i < count; ++i)
+			sample(u[i], v[i], rgba + 4 * i);
+}
+
+//-------------------------------------//
+
+#if defined(DEIMOS_SAMPLER_AVX2__)
+
+namespace {
+
+	// per lane level constants
+	struct level_lanes
+	{
+		__m256 widthf, heightf;
+		__m256i width, height, tiles_x, offset;
+	};
+
+	inline __m256i wrap8(__m256i x, __m256i size)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		x = _mm256_add_epi32(x, _mm256_and_si256(_mm256_cmpgt_epi32(zero, x), size));
+		x = _mm256_sub_epi32(x, _mm256_andnot_si256(_mm256_cmpgt_epi32(size, x), size));
+		return x;
+	}
+
+	inline __m256i clamp8(__m256i x, __m256i size)
+	{
+		const __m256i one = _mm256_set1_epi32(1);
+		return _mm256_max_epi32(_mm256_setzero_si256(), _mm256_min_epi32(x, _mm256_sub_epi32(size, one)));
+	}
+
+	inline __m256i morton_part8(__m256i op)
+	{
+		op = _mm256_and_si256(_mm256_or_si256(op, _mm256_slli_epi32(op, 2)), _mm256_set1_epi32(0x33));
+		op = _mm256_and_si256(_mm256_or_si256(op, _mm256_slli_epi32(op, 1)), _mm256_set1_epi32(0x55));
+		return op;
+	}
+
+	// byte offset of 32bit texels relative to the sampler data
+	inline __m256i offset8(__m256i x, __m256i y, const level_lanes& level, bool tiled)
+	{
+		__m256i index;
+
+		if (tiled)
+		{
+			const __m256i mask = _mm256_set1_epi32(TILE_MASK);
+			const __m256i tile = _mm256_add_epi32(
+				_mm256_mullo_epi32(_mm256_srli_epi32(y, TILE_SHIFT), level.tiles_x),
+				_mm256_srli_epi32(x, TILE_SHIFT));
+
+			index = _mm256_or_si256(
+				_mm256_slli_epi32(tile, 6),
+				_mm256_or_si256(morton_part8(_mm256_and_si256(x, mask)), _mm256_slli_epi32(morton_part8(_mm256_and_si256(y, mask)), 1)));
+		}
+		else
+			index = _mm256_add_epi32(_mm256_mullo_epi32(y, level.width), x);
+
+		return _mm256_add_epi32(_mm256_slli_epi32(index, 2), level.offset);
+	}
+
+	inline void unpack8(__m256i texel, __m256* rgba)
+	{
+		const __m256i mask = _mm256_set1_epi32(0xff);
+		rgba[0] = _mm256_cvtepi32_ps(_mm256_and_si256(texel, mask));
+		rgba[1] = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texel, 8), mask));
+		rgba[2] = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texel, 16), mask));
+		rgba[3] = _mm256_cvtepi32_ps(_mm256_srli_epi32(texel, 24));
+	}
+
+	inline __m256 lerp8(__m256 a, __m256 b, __m256 f)
+	{
+		return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), f));
+	}
+
+	inline __m256 floor_frac8(__m256 op)
+	{
+		return _mm256_sub_ps(op, _mm256_floor_ps(op));
+	}
+
+	void nearest8(const int* data, __m256 u, __m256 v, const level_lanes& level, bool wrap, bool tiled, __m256* rgba)
+	{
+		if (wrap)
+		{
+			u = floor_frac8(u);
+			v = floor_frac8(v);
+		}
+		else
+		{
+			u = _mm256_max_ps(_mm256_setzero_ps(), _mm256_min_ps(u, _mm256_set1_ps(1.f)));
+			v = _mm256_max_ps(_mm256_setzero_ps(), _mm256_min_ps(v, _mm256_set1_ps(1.f)));
+		}
+
+		__m256i x = _mm256_cvttps_epi32(_mm256_mul_ps(u, level.widthf));
+		__m256i y = _mm256_cvttps_epi32(_mm256_mul_ps(v, level.heightf));
+
+		x = wrap ? wrap8(x, level.width) : clamp8(x, level.width);
+		y = wrap ? wrap8(y, level.height) : clamp8(y, level.height);
+
+		unpack8(_mm256_i32gather_epi32(data, offset8(x, y, level, tiled), 1), rgba);
+	}
+
+	void bilinear8(const int* data, __m256 u, __m256 v, const level_lanes& level, bool wrap, bool tiled, __m256* rgba)
+	{
+		const __m256 half = _mm256_set1_ps(.5f);
+
+		if (wrap)
+		{
+			u = floor_frac8(u);
+			v = floor_frac8(v);
+		}
+		else
+		{
+			u = _mm256_max_ps(_mm256_set1_ps(-1.f), _mm256_min_ps(u, _mm256_set1_ps(2.f)));
+			v = _mm256_max_ps(_mm256_set1_ps(-1.f), _mm256_min_ps(v, _mm256_set1_ps(2.f)));
+		}
+
+		const __m256 x = _mm256_sub_ps(_mm256_mul_ps(u, level.widthf), half);
+		const __m256 y = _mm256_sub_ps(_mm256_mul_ps(v, level.heightf), half);
+		const __m256 xf = _mm256_floor_ps(x);
+		const __m256 yf = _mm256_floor_ps(y);
+		const __m256 fx = _mm256_sub_ps(x, xf);
+		const __m256 fy = _mm256_sub_ps(y, yf);
+
+		const __m256i one = _mm256_set1_epi32(1);
+		__m256i x0 = _mm256_cvttps_epi32(xf);
+		__m256i y0 = _mm256_cvttps_epi32(yf);
+		__m256i x1 = _mm256_add_epi32(x0, one);
+		__m256i y1 = _mm256_add_epi32(y0, one);
+
+		if (wrap)
+		{
+			x0 = wrap8(x0, level.width);	x1 = wrap8(x1, level.width);
+			y0 = wrap8(y0, level.height);	y1 = wrap8(y1, level.height);
+		}
+		else
+		{
+			x0 = clamp8(x0, level.width);	x1 = clamp8(x1, level.width);
+			y0 = clamp8(y0, level.height);	y1 = clamp8(y1, level.height);
+		}
+
+		__m256 t00[4], t10[4], t01[4], t11[4];
+		unpack8(_mm256_i32gather_epi32(data, offset8(x0, y0, level, tiled), 1), t00);
+		unpack8(_mm256_i32gather_epi32(data, offset8(x1, y0, level, tiled), 1), t10);
+		unpack8(_mm256_i32gather_epi32(data, offset8(x0, y1, level, tiled), 1), t01);
+		unpack8(_mm256_i32gather_epi32(data, offset8(x1, y1, level, tiled), 1), t11);
+
+		for (int c = 0; c < 4; ++c)
+			rgba[c] = lerp8(lerp8(t00[c], t10[c], fx), lerp8(t01[c], t11[c], fx), fy);
+	}
+
+	// normalize and interleave 8 rgba samples
+	inline void store8(__m256* rgba, float* out)
+	{
+		const __m256 scale = _mm256_set1_ps(INV_255);
+
+		__m128 lo[4], hi[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			const __m256 s = _mm256_mul_ps(rgba[c], scale);
+			lo[c] = _mm256_castps256_ps128(s);
+			hi[c] = _mm256_extractf128_ps(s, 1);
+		}
+
+		_MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+		_MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			_mm_storeu_ps(out + 4 * i, lo[i]);
+			_mm_storeu_ps(out + 16 + 4 * i, hi[i]);
+		}
+	}
+
+} // anonymous namespace
+
+bool Sampler::sample_batch_simd(const float* u, const float* v, const float* lod, unsigned int count, float* rgba) const
+{
+	// gathers read whole 32bit texels
+	if (bytes_per_pixel_ != 4)
+		return false;
+
+	const int* data = reinterpret_cast<const int*>(data_);
+	const bool wrap = (address_ == ADDRESS_WRAP);
+	const bool tiled = (layout_ == Image::LAYOUT_TILED);
+	const __m256 max_level = _mm256_set1_ps(static_cast<float>(levels_ - 1));
+
+	level_lanes base;
+	base.widthf = _mm256_set1_ps(widthf_[0]);
+	base.heightf = _mm256_set1_ps(heightf_[0]);
+	base.width = _mm256_set1_epi32(width_[0]);
+	base.height = _mm256_set1_epi32(height_[0]);
+	base.tiles_x = _mm256_set1_epi32(tiles_x_[0]);
+	base.offset = _mm256_set1_epi32(offset_[0]);
+
+	unsigned int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256 u8 = _mm256_loadu_ps(u + i);
+		const __m256 v8 = _mm256_loadu_ps(v + i);
+
+		__m256 result[4];
+
+		if (!lod)
+		{
+			if (filter_ == FILTER_NEAREST)
+				nearest8(data, u8, v8, base, wrap, tiled, result);
+			else
+				bilinear8(data, u8, v8, base, wrap, tiled, result);
+		}
+		else
+		{
+			const __m256 l = _mm256_max_ps(_mm256_setzero_ps(), _mm256_min_ps(_mm256_loadu_ps(lod + i), max_level));
+
+			// trilinear blends floor(lod) and the next level, otherwise the closest level is used
+			__m256i l0, l1;
+			__m256 f = _mm256_setzero_ps();
+
+			if (filter_ == FILTER_TRILINEAR)
+			{
+				const __m256 lf = _mm256_floor_ps(l);
+				f = _mm256_sub_ps(l, lf);
+				l0 = _mm256_cvttps_epi32(lf);
+				l1 = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_add_ps(lf, _mm256_set1_ps(1.f)), max_level));
+			}
+			else
+				l0 = l1 = _mm256_cvttps_epi32(_mm256_add_ps(l, _mm256_set1_ps(.5f)));
+
+			level_lanes level0, level1;
+			level0.widthf = _mm256_i32gather_ps(widthf_, l0, 4);
+			level0.heightf = _mm256_i32gather_ps(heightf_, l0, 4);
+			level0.width = _mm256_i32gather_epi32(width_, l0, 4);
+			level0.height = _mm256_i32gather_epi32(height_, l0, 4);
+			level0.tiles_x = _mm256_i32gather_epi32(tiles_x_, l0, 4);
+			level0.offset = _mm256_i32gather_epi32(offset_, l0, 4);
+
+			if (filter_ == FILTER_NEAREST)
+				nearest8(data, u8, v8, level0, wrap, tiled, result);
+			else
+				bilinear8(data, u8, v8, level0, wrap, tiled, result);
+
+			if (filter_ == FILTER_TRILINEAR)
+			{
+				level1.widthf = _mm256_i32gather_ps(widthf_, l1, 4);
+				level1.heightf = _mm256_i32gather_ps(heightf_, l1, 4);
+				level1.width = _mm256_i32gather_epi32(width_, l1, 4);
+				level1.height = _mm256_i32gather_epi32(height_, l1, 4);
+				level1.tiles_x = _mm256_i32gather_epi32(tiles_x_, l1, 4);
+				level1.offset = _mm256_i32gather_epi32(offset_, l1, 4);
+
+				__m256 next[4];
+				bilinear8(data, u8, v8, level1, wrap, tiled, next);
+
+				for (int c = 0; c < 4; ++c)
+					result[c] = lerp8(result[c], next[c], f);
+			}
+		}
+
+		store8(result, rgba + 4 * i);
+	}
+
+	// remainder
+	for (; i < count; ++i)
+		if (lod)
+			sample(u[i], v[i], lod[i], rgba + 4 * i);
+		else
+			sample(u[i], v[i], rgba + 4 * i);
+
+	return true;
+}
+
+#else
+
+bool Sampler::sample_batch_simd(const float*, const float*, const float*, unsigned int, float*) const
+{
+	return false;
+}
+
+#endif // DEIMOS_SAMPLER_AVX2__
+
+} // namespace image
+} // namespace deimos
@@ -0,0 +1,117 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2001
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Texture sampling by UV coordinates. Texel centers are at (i + 0.5)/size,
+ * results are always written as 4 normalized floats per sample:
+ *   1 byte  per pixel -> (l, l, l, 1)
+ *   2 bytes per pixel -> (l, l, l, a)
+ *   3 bytes per pixel -> (r, g, b, 1)
+ *   4 bytes per pixel -> (r, g, b, a)
+ */
+
+#if !defined(DEIMOS_IMAGE_SAMPLER__)
+#define DEIMOS_IMAGE_SAMPLER__
+
+#include <cassert>
+
+#include "image.h"
+
+namespace deimos {
+namespace image {
+
+/*
+ * A chain of box filtered mip levels of an image down to 1x1. All levels live
+ * in one buffer and use the texel layout of the source image.
+ */
+class MipChain
+{
+public:
+	enum { MAX_LEVELS = 32 };
+
+protected:
+	unsigned char* data_;
+	unsigned int width_[MAX_LEVELS], height_[MAX_LEVELS];
+	size_t offset_[MAX_LEVELS];
+	unsigned int levels_, bytes_per_pixel_;
+	Image::Layout layout_;
+
+	MipChain(const MipChain&);
+	MipChain& operator=(const MipChain&);
+
+public:
+	MipChain(const Image& image);
+	~MipChain();
+
+	inline unsigned int get_levels() const { return levels_; };
+	inline unsigned int get_width(unsigned int level) const { assert(level < levels_); return width_[level]; };
+	inline unsigned int get_height(unsigned int level) const { assert(level < levels_); return height_[level]; };
+	inline unsigned int get_bytes_per_pixel() const { return bytes_per_pixel_; };
+	inline Image::Layout get_layout() const { return layout_; };
+
+	inline const unsigned char* get_data() const { return data_; };
+	inline const unsigned char* get_data(unsigned int level) const { assert(level < levels_); return data_ + offset_[level]; };
+};
+
+/*
+ * Samples an Image or a MipChain. All per level constants are computed once
+ * in the constructor; the sampled data must outlive the sampler.
+ */
+class Sampler
+{
+public:
+	enum Filter
+	{
+		FILTER_NEAREST,
+		FILTER_BILINEAR,
+		FILTER_TRILINEAR	// bilinear on the two closest levels, needs a MipChain
+	};
+
+	enum Address
+	{
+		ADDRESS_WRAP,
+		ADDRESS_CLAMP
+	};
+
+protected:
+	const unsigned char* data_;
+	Filter filter_;
+	Address address_;
+	Image::Layout layout_;
+	unsigned int levels_, bytes_per_pixel_;
+
+	// per level constants
+	int width_[MipChain::MAX_LEVELS], height_[MipChain::MAX_LEVELS];
+	int tiles_x_[MipChain::MAX_LEVELS], offset_[MipChain::MAX_LEVELS];
+	float widthf_[MipChain::MAX_LEVELS], heightf_[MipChain::MAX_LEVELS];
+
+	inline void address(int level, float u, float v, int& x0, int& y0, int& x1, int& y1, float& fx, float& fy) const;
+	inline void fetch(int level, int x, int y, float* rgba) const;
+
+	void sample_nearest(int level, float u, float v, float* rgba) const;
+	void sample_bilinear(int level, float u, float v, float* rgba) const;
+
+	bool sample_batch_simd(const float* u, const float* v, const float* lod, unsigned int count, float* rgba) const;
+
+public:
+	Sampler(const Image& image, Filter filter = FILTER_BILINEAR, Address address = ADDRESS_WRAP);
+	Sampler(const MipChain& chain, Filter filter = FILTER_TRILINEAR, Address address = ADDRESS_WRAP);
+
+	inline Filter get_filter() const { return filter_; };
+	inline Address get_address() const { return address_; };
+	inline unsigned int get_levels() const { return levels_; };
+
+	// sample level 0 (or the given level of detail with trilinear filtering)
+	void sample(float u, float v, float* rgba) const;
+	void sample(float u, float v, float lod, float* rgba) const;
+
+	// sample count coordinates at once, rgba receives 4*count floats; lod may be 0
+	void sample(const float* u, const float* v, unsigned int count, float* rgba) const;
+	void sample(const float* u, const float* v, const float* lod, unsigned int count, float* rgba) const;
+};
+
+} // namespace image
+} // namespace deimos
+
+#endif // DEIMOS_IMAGE_SAMPLER__
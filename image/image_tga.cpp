@@ -99,7 +99,7 @@ bool ImageTga::do_load(endian_ifstream& stream)
 	return true;
 }
 
-bool ImageTga::do_save(endian_ofstream& stream) const
+bool ImageTga::do_save(endian_ofstream& stream, unsigned char* data) const
 {
 	tTgaFileHeader tgaFileHeader;
 
@@ -135,10 +135,10 @@ bool ImageTga::do_save(endian_ofstream& stream) const
 	switch(bytes_per_pixel_)
 	{
 		case 3:
-			do_save_24(stream);
+			do_save_24(stream, data);
 			break;
 		case 4:
-			do_save_32(stream);
+			do_save_32(stream, data);
 			break;
 		default:
 			assert(0);
@@ -159,15 +159,15 @@ void ImageTga::do_load_24(std::ifstream& stream)
 	}
 }
 
-void ImageTga::do_save_24(std::ofstream& stream) const
+void ImageTga::do_save_24(std::ofstream& stream, unsigned char* data) const
 {
 	for (unsigned int i=0; i<width_ * height_ * bytes_per_pixel_; i+=3)
 	{
 		// Swap RGB to BGR
-		std::swap(raw_data_[i + 0], raw_data_[i + 2]);
+		std::swap(data[i + 0], data[i + 2]);
 	}
 
-	stream.write((char*)raw_data_, width_ * height_ * bytes_per_pixel_);
+	stream.write((char*)data, width_ * height_ * bytes_per_pixel_);
 }
 
 void ImageTga::do_load_32(std::ifstream& stream)
@@ -181,15 +181,15 @@ void ImageTga::do_load_32(std::ifstream& stream)
 	}
 }
 
-void ImageTga::do_save_32(std::ofstream& stream) const
+void ImageTga::do_save_32(std::ofstream& stream, unsigned char* data) const
 {
 	for (unsigned int i=0; i<width_ * height_ * bytes_per_pixel_; i+=4)
 	{
 		// Swap RGBA to BGRA
-		std::swap(raw_data_[i + 0], raw_data_[i + 2]);
+		std::swap(data[i + 0], data[i + 2]);
 	}
 
-	stream.write((char*)raw_data_, width_ * height_ * bytes_per_pixel_);
+	stream.write((char*)data, width_ * height_ * bytes_per_pixel_);
 }
 
 } // namespace image
@@ -0,0 +1,155 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2001
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include "image_tiling.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DEIMOS_TILING_SSE2__
+#endif
+
+namespace deimos {
+namespace image {
+
+namespace {
+
+	const unsigned int QUAD_COUNT = TILE_SIZE / 2;
+
+	// Copy a complete tile of 32bit texels. Two source rows are read at once: the
+	// 4-texel segments a0..a3 and b0..b3 form the Morton quads (a0 a1 b0 b1) and
+	// (a2 a3 b2 b3), which are exactly the low and high halves of both registers.
+	inline void tile_block_32(const unsigned char* src, size_t row_size, unsigned char* dst)
+	{
+		for (unsigned int qy = 0; qy < QUAD_COUNT; ++qy)
+		{
+			const unsigned char* row0 = src + (2 * qy) * row_size;
+			const unsigned char* row1 = row0 + row_size;
+
+			for (unsigned int qx = 0; qx < QUAD_COUNT; qx += 2)
+			{
+#if defined(DEIMOS_TILING_SSE2__)
+				const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + qx * 8));
+				const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + qx * 8));
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + morton_index(qx,     qy) * 16), _mm_unpacklo_epi64(r0, r1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + morton_index(qx + 1, qy) * 16), _mm_unpackhi_epi64(r0, r1));
+#else
+				unsigned char* q0 = dst + morton_index(qx,     qy) * 16;
+				unsigned char* q1 = dst + morton_index(qx + 1, qy) * 16;
+
+				std::memcpy(q0,     row0 + qx * 8,      8);
+				std::memcpy(q0 + 8, row1 + qx * 8,      8);
+				std::memcpy(q1,     row0 + qx * 8 + 8,  8);
+				std::memcpy(q1 + 8, row1 + qx * 8 + 8,  8);
+#endif
+			}
+		}
+	}
+
+	inline void untile_block_32(const unsigned char* src, unsigned char* dst, size_t row_size)
+	{
+		for (unsigned int qy = 0; qy < QUAD_COUNT; ++qy)
+		{
+			unsigned char* row0 = dst + (2 * qy) * row_size;
+			unsigned char* row1 = row0 + row_size;
+
+			for (unsigned int qx = 0; qx < QUAD_COUNT; qx += 2)
+			{
+#if defined(DEIMOS_TILING_SSE2__)
+				const __m128i q0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + morton_index(qx,     qy) * 16));
+				const __m128i q1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + morton_index(qx + 1, qy) * 16));
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(row0 + qx * 8), _mm_unpacklo_epi64(q0, q1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(row1 + qx * 8), _mm_unpackhi_epi64(q0, q1));
+#else
+				const unsigned char* q0 = src + morton_index(qx,     qy) * 16;
+				const unsigned char* q1 = src + morton_index(qx + 1, qy) * 16;
+
+				std::memcpy(row0 + qx * 8,     q0,     8);
+				std::memcpy(row1 + qx * 8,     q0 + 8, 8);
+				std::memcpy(row0 + qx * 8 + 8, q1,     8);
+				std::memcpy(row1 + qx * 8 + 8, q1 + 8, 8);
+#endif
+			}
+		}
+	}
+
+	// generic per texel copy for border tiles and other pixel sizes
+	inline void tile_block(const unsigned char* src, size_t row_size, unsigned char* dst,
+						   unsigned int w, unsigned int h, unsigned int bytes_per_pixel)
+	{
+		for (unsigned int y = 0; y < h; ++y)
+			for (unsigned int x = 0; x < w; ++x)
+				std::memcpy(dst + morton_index(x, y) * bytes_per_pixel, src + y * row_size + x * bytes_per_pixel, bytes_per_pixel);
+	}
+
+	inline void untile_block(const unsigned char* src, unsigned char* dst, size_t row_size,
+							 unsigned int w, unsigned int h, unsigned int bytes_per_pixel)
+	{
+		for (unsigned int y = 0; y < h; ++y)
+			for (unsigned int x = 0; x < w; ++x)
+				std::memcpy(dst + y * row_size + x * bytes_per_pixel, src + morton_index(x, y) * bytes_per_pixel, bytes_per_pixel);
+	}
+
+} // anonymous namespace
+
+void tile_data(const unsigned char* src, unsigned char* dst, unsigned int width, unsigned int height, unsigned int bytes_per_pixel)
+{
+	const unsigned int tiles_x = tile_count(width);
+	const unsigned int tiles_y = tile_count(height);
+	const size_t row_size = size_t(width) * bytes_per_pixel;
+	const size_t tile_size = TILE_TEXELS * bytes_per_pixel;
+
+	for (unsigned int ty = 0; ty < tiles_y; ++ty)
+	for (unsigned int tx = 0; tx < tiles_x; ++tx)
+	{
+		const unsigned char* s = src + size_t(ty * TILE_SIZE) * row_size + size_t(tx * TILE_SIZE) * bytes_per_pixel;
+		unsigned char* d = dst + (size_t(ty) * tiles_x + tx) * tile_size;
+
+		const unsigned int w = std::min(TILE_SIZE, width - tx * TILE_SIZE);
+		const unsigned int h = std::min(TILE_SIZE, height - ty * TILE_SIZE);
+
+		if (w == TILE_SIZE && h == TILE_SIZE && bytes_per_pixel == 4)
+			tile_block_32(s, row_size, d);
+		else
+		{
+			// clear padding texels of border tiles
+			if (w != TILE_SIZE || h != TILE_SIZE)
+				std::memset(d, 0, tile_size);
+
+			tile_block(s, row_size, d, w, h, bytes_per_pixel);
+		}
+	}
+}
+
+void untile_data(const unsigned char* src, unsigned char* dst, unsigned int width, unsigned int height, unsigned int bytes_per_pixel)
+{
+	const unsigned int tiles_x = tile_count(width);
+	const unsigned int tiles_y = tile_count(height);
+	const size_t row_size = size_t(width) * bytes_per_pixel;
+	const size_t tile_size = TILE_TEXELS * bytes_per_pixel;
+
+	for (unsigned int ty = 0; ty < tiles_y; ++ty)
+	for (unsigned int tx = 0; tx < tiles_x; ++tx)
+	{
+		const unsigned char* s = src + (size_t(ty) * tiles_x + tx) * tile_size;
+		unsigned char* d = dst + size_t(ty * TILE_SIZE) * row_size + size_t(tx * TILE_SIZE) * bytes_per_pixel;
+
+		const unsigned int w = std::min(TILE_SIZE, width - tx * TILE_SIZE);
+		const unsigned int h = std::min(TILE_SIZE, height - ty * TILE_SIZE);
+
+		if (w == TILE_SIZE && h == TILE_SIZE && bytes_per_pixel == 4)
+			untile_block_32(s, d, row_size);
+		else
+			untile_block(s, d, row_size, w, h, bytes_per_pixel);
+	}
+}
+
+} // namespace image
+} // namespace deimos
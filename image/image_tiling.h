@@ -0,0 +1,67 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2001
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Tiled texel layout: the image is cut into TILE_SIZE x TILE_SIZE tiles which
+ * are stored one after another (row-major order of tiles). Inside a tile the
+ * texels follow the Z-order (Morton) curve, so every 2x2, 4x4 and 8x8 block
+ * of a tile is contiguous in memory. Images whose size is not a multiple of
+ * TILE_SIZE are padded with zero texels.
+ */
+
+#if !defined(DEIMOS_IMAGE_TILING__)
+#define DEIMOS_IMAGE_TILING__
+
+#include <cstddef>
+
+namespace deimos {
+namespace image {
+
+	const unsigned int TILE_SIZE		= 8;
+	const unsigned int TILE_SHIFT		= 3;
+	const unsigned int TILE_MASK		= TILE_SIZE - 1;
+	const unsigned int TILE_TEXELS		= TILE_SIZE * TILE_SIZE;
+
+	// spread the lower three bits of op to every other bit (abc -> a0b0c)
+	inline unsigned int morton_part(unsigned int op)
+	{
+		op = (op | (op << 2)) & 0x33;
+		op = (op | (op << 1)) & 0x55;
+		return op;
+	}
+
+	// Z-order index of a texel inside a tile, x and y must be < TILE_SIZE
+	inline unsigned int morton_index(unsigned int x, unsigned int y)
+	{
+		return morton_part(x) | (morton_part(y) << 1);
+	}
+
+	inline unsigned int tile_count(unsigned int texels)
+	{
+		return (texels + TILE_MASK) >> TILE_SHIFT;
+	}
+
+	// byte size of a tiled buffer including the padding of the border tiles
+	inline size_t tiled_data_size(unsigned int width, unsigned int height, unsigned int bytes_per_pixel)
+	{
+		return size_t(tile_count(width)) * tile_count(height) * TILE_TEXELS * bytes_per_pixel;
+	}
+
+	// byte offset of texel (x, y) in a tiled buffer with tiles_x tiles per row
+	inline size_t tiled_offset(unsigned int x, unsigned int y, unsigned int tiles_x, unsigned int bytes_per_pixel)
+	{
+		const size_t tile = size_t(y >> TILE_SHIFT) * tiles_x + (x >> TILE_SHIFT);
+		return (tile * TILE_TEXELS + morton_index(x & TILE_MASK, y & TILE_MASK)) * bytes_per_pixel;
+	}
+
+	// converts a row-major buffer into a tiled one, dst must hold tiled_data_size() bytes
+	void tile_data(const unsigned char* src, unsigned char* dst, unsigned int width, unsigned int height, unsigned int bytes_per_pixel);
+
+	// converts a tiled buffer back into a row-major one, dst must hold width*height*bytes_per_pixel bytes
+	void untile_data(const unsigned char* src, unsigned char* dst, unsigned int width, unsigned int height, unsigned int bytes_per_pixel);
+
+} // namespace image
+} // namespace deimos
+
+#endif // DEIMOS_IMAGE_TILING__
@@ -0,0 +1,361 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#if !defined(DEIMOS_MATH_AABB__)
+#define DEIMOS_MATH_AABB__
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+
+#include "../memory/aligned_array.h"
+
+#include "vector.h"
+#include "packet.h"
+#include "ray.h"
+#include "triangle.h"
+#include "sphere.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+/*
+ * Axis aligned box from min_ to max_. The empty box has min_ > max_ in every
+ * component, so extending it by anything gives that thing's bounds.
+ */
+template<typename T, int S>
+class AABB
+{
+public:
+	typedef Vector<T, S> Vec;
+	Vec min_, max_;
+
+	static AABB empty()
+	{
+		AABB res;
+		res.min_.clear(std::numeric_limits<T>::max());
+		res.max_.clear(-std::numeric_limits<T>::max());
+		return res;
+	};
+
+	static AABB from_points(const Vec& op1, const Vec& op2)
+	{
+		AABB res = empty();
+		res.extend(op1);
+		res.extend(op2);
+		return res;
+	};
+
+	bool is_empty() const
+	{
+		for (int i=0; i < S; ++i)
+			if (min_[i] > max_[i])
+				return true;
+
+		return false;
+	};
+
+	void extend(const Vec& op)
+	{
+		for (int i=0; i < S; ++i)
+		{
+			if (op[i] < min_[i]) min_[i] = op[i];
+			if (op[i] > max_[i]) max_[i] = op[i];
+		}
+	};
+
+	void extend(const AABB& op)
+	{
+		for (int i=0; i < S; ++i)
+		{
+			if (op.min_[i] < min_[i]) min_[i] = op.min_[i];
+			if (op.max_[i] > max_[i]) max_[i] = op.max_[i];
+		}
+	};
+
+	// union
+	AABB merge(const AABB& op) const
+	{
+		AABB res(*this);
+		res.extend(op);
+		return res;
+	};
+
+	Vec center() const
+	{
+		return (min_ + max_) * T(0.5);
+	};
+
+	Vec extent() const
+	{
+		return max_ - min_;
+	};
+
+	// sum of the areas of all faces, 0 for the empty box
+	T surface_area() const
+	{
+		if (is_empty())
+			return 0;
+
+		const Vec e = extent();
+		T res = 0;
+
+		for (int i=0; i < S; ++i)
+			for (int j=i+1; j < S; ++j)
+				res += e[i]*e[j];
+
+		return 2*res;
+	};
+
+	int longest_axis() const
+	{
+		const Vec e = extent();
+		int res = 0;
+
+		for (int i=1; i < S; ++i)
+			if (e[i] > e[res])
+				res = i;
+
+		return res;
+	};
+
+	bool contains(const Vec& op) const
+	{
+		for (int i=0; i < S; ++i)
+			if (op[i] < min_[i] || op[i] > max_[i])
+				return false;
+
+		return true;
+	};
+
+	bool overlaps(const AABB& op) const
+	{
+		for (int i=0; i < S; ++i)
+			if (op.max_[i] < min_[i] || op.min_[i] > max_[i])
+				return false;
+
+		return true;
+	};
+};
+
+// spatial bounds of primitives, the homogeneous component of Vector<T, 4> is ignored
+template<typename T, int S>
+AABB<T, 3> bounds(const Triangle<T, S>& op)
+{
+	AABB<T, 3> res = AABB<T, 3>::empty();
+
+	for (int v=0; v < 3; ++v)
+		for (int i=0; i < 3; ++i)
+		{
+			if (op.vertex_[v][i] < res.min_[i]) res.min_[i] = op.vertex_[v][i];
+			if (op.vertex_[v][i] > res.max_[i]) res.max_[i] = op.vertex_[v][i];
+		}
+
+	return res;
+}
+
+template<typename T, int S>
+AABB<T, 3> bounds(const Sphere<T, S>& op)
+{
+	AABB<T, 3> res;
+
+	for (int i=0; i < 3; ++i)
+	{
+		res.min_[i] = op.center_[i] - op.radius_;
+		res.max_[i] = op.center_[i] + op.radius_;
+	}
+
+	return res;
+}
+
+//-------------------------------------//
+
+/*
+ * Ray prepared for slab tests, the reciprocal direction is infinite along
+ * axes the ray is parallel to. The exit distance is scaled by 1 + 2 gamma(3)
+ * as in Ize, "Robust BVH Ray Traversal" (JCGT 2013), so rounding never
+ * misses a box the ray touches, e.g. on the shared edge of two boxes.
+ */
+template<typename T>
+struct BoxRay
+{
+	static inline T robust_scale()
+	{
+		const T e = std::numeric_limits<T>::epsilon() / 2;
+		return 1 + 2 * (3*e / (1 - 3*e));
+	};
+
+	T origin_[3];
+	T inv_direction_[3];
+	int negative_[3];
+
+	explicit BoxRay(const Ray<T, 4>& ray)
+	{
+		for (int i=0; i < 3; ++i)
+		{
+			origin_[i] = ray.origin_[i];
+			inv_direction_[i] = 1 / ray.direction_[i];
+			negative_[i] = (inv_direction_[i] < 0) ? 1 : 0;
+		}
+	};
+};
+
+/*
+ * Slab test, true if the ray runs through the box between 0 and t_max.
+ * tnear and tfar are the entry and exit distances clipped to that range.
+ */
+template<typename T>
+bool intersect(const AABB<T, 3>& box, const BoxRay<T>& ray, T t_max, T& tnear, T& tfar)
+{
+	T t0 = 0, t1 = t_max;
+
+	for (int i=0; i < 3; ++i)
+	{
+		const T near_plane = ray.negative_[i] ? box.max_[i] : box.min_[i];
+		const T far_plane = ray.negative_[i] ? box.min_[i] : box.max_[i];
+
+		const T tn = (near_plane - ray.origin_[i]) * ray.inv_direction_[i];
+		const T tf = (far_plane - ray.origin_[i]) * ray.inv_direction_[i];
+
+		// NaN from a parallel ray on a slab plane keeps the old values
+		if (tn > t0) t0 = tn;
+		if (tf < t1) t1 = tf;
+	}
+
+	tnear = t0;
+	tfar = t1;
+
+	return t0 <= t1 * BoxRay<T>::robust_scale();
+}
+
+//-------------------------------------//
+
+// N boxes as structure of arrays, component c of lane i is min_.component_[c][i]
+template<typename T, int N>
+struct AABBBlock
+{
+	VectorPacket<T, 3, N> min_, max_;
+
+	void set(int lane, const AABB<T, 3>& op)
+	{
+		assert(lane >= 0 && lane < N);
+
+		for (int c=0; c < 3; ++c)
+		{
+			min_.component_[c].element_[lane] = op.min_[c];
+			max_.component_[c].element_[lane] = op.max_[c];
+		}
+	};
+
+	AABB<T, 3> get(int lane) const
+	{
+		assert(lane >= 0 && lane < N);
+
+		AABB<T, 3> res;
+
+		for (int c=0; c < 3; ++c)
+		{
+			res.min_[c] = min_.component_[c].element_[lane];
+			res.max_[c] = max_.component_[c].element_[lane];
+		}
+
+		return res;
+	};
+};
+
+/*
+ * One ray against the boxes of a block, the slab test of intersect() in
+ * every lane. Returns the lanes of mask hit between 0 and t_max, tnear
+ * has their entry distances.
+ */
+template<typename T, int N>
+unsigned int intersect(const AABBBlock<T, N>& block, const BoxRay<T>& ray, unsigned int mask, T t_max, ScalarPacket<T, N>& tnear)
+{
+	typedef ScalarPacket<T, N> Scalar;
+
+	Scalar t0 = Scalar::broadcast(0), t1 = Scalar::broadcast(t_max);
+
+	for (int i=0; i < 3; ++i)
+	{
+		const Scalar& lo = ray.negative_[i] ? block.max_.component_[i] : block.min_.component_[i];
+		const Scalar& hi = ray.negative_[i] ? block.min_.component_[i] : block.max_.component_[i];
+
+		const Scalar o = Scalar::broadcast(ray.origin_[i]);
+		const Scalar inv = Scalar::broadcast(ray.inv_direction_[i]);
+
+		const Scalar tn = (lo - o) * inv;
+		const Scalar tf = (hi - o) * inv;
+
+		t0 = select(t0.less(tn), tn, t0);
+		t1 = select(tf.less(t1), tf, t1);
+	}
+
+	tnear = t0;
+	return mask & t0.less_equal(t1 * BoxRay<T>::robust_scale());
+}
+
+/*
+ * Boxes in blocks of N, box i in lane i%N of block i/N; lanes past the
+ * last box are empty and never hit.
+ */
+template<typename T, int N>
+class AABBBlocks
+{
+protected:
+	memory::AlignedArray< AABBBlock<T, N> > blocks_;
+	size_t size_;
+
+public:
+	AABBBlocks() : size_(0) {};
+
+	void build(const AABB<T, 3>* boxes, size_t n)
+	{
+		size_ = n;
+		blocks_.resize((n + N - 1) / N);
+
+		for (size_t b=0; b < blocks_.size(); ++b)
+			for (int i=0; i < N; ++i)
+				blocks_[b].set(i, (b*N + i < n) ? boxes[b*N + i] : AABB<T, 3>::empty());
+	};
+
+	inline size_t size() const								{ return size_; };
+	inline size_t num_blocks() const							{ return blocks_.size(); };
+	inline const AABBBlock<T, N>& get_block(size_t n) const	{ return blocks_[n]; };
+
+	/*
+	 * Writes the indices of all boxes the ray hits between 0 and t_max to
+	 * hits, in order, and their entry distances to tnear unless it is 0.
+	 * Both must have room for size() entries; returns the number of hits.
+	 */
+	size_t intersect(const BoxRay<T>& ray, T t_max, unsigned int* hits, T* tnear = 0) const
+	{
+		size_t res = 0;
+		ScalarPacket<T, N> t;
+
+		for (size_t b=0; b < blocks_.size(); ++b)
+		{
+			const unsigned int mask = geometry::intersect(blocks_[b], ray, full_mask<N>(), t_max, t);
+
+			for (int i=0; i < N; ++i)
+				if (mask & (1u << i))
+				{
+					if (tnear)
+						tnear[res] = t[i];
+
+					hits[res++] = static_cast<unsigned int>(b*N + i);
+				}
+		}
+
+		return res;
+	};
+};
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_AABB__
@@ -0,0 +1,323 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * All overlapping pairs of a set of spheres with a spatial hash: the
+ * centers are put into a grid of cells as wide as the largest sphere, so
+ * overlapping spheres are at most one cell apart. The spheres are sorted by
+ * the hash of their cell, which makes the spheres of a cell consecutive.
+ * Cells next to each other along x hash to consecutive buckets, so each
+ * sphere is tested against the 27 cells around it as 9 runs of SphereBlocks
+ * in sorted order, N at a time:
+ *
+ *   SphereBroadphase<float, 8> broadphase;
+ *   std::vector<SpherePair> pairs;
+ *
+ *   for (;;)
+ *   {
+ *       step(particles);
+ *       broadphase.find_pairs(pool, particles, count, pairs);
+ *   }
+ *
+ * The order of the last call is kept and sorted again by insertion, which
+ * is close to linear while few spheres change their cell; after too many
+ * moves it falls back to std::sort. A few large spheres among many small
+ * ones make the cells large and the search slow.
+ */
+
+#if !defined(DEIMOS_MATH_BROADPHASE__)
+#define DEIMOS_MATH_BROADPHASE__
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "../memory/aligned_array.h"
+#include "../thread/task_pool.h"
+#include "packet.h"
+#include "sphere.h"
+#include "sphere_block.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+// two overlapping spheres, first_ < second_
+struct SpherePair
+{
+	unsigned int first_, second_;
+};
+
+namespace detail {
+
+	// spheres per task of the broadphase
+	const size_t BROADPHASE_GRAIN = 4096;
+
+	// cell coordinates are kept within this, far beyond any sensible grid
+	const double BROADPHASE_MAX_CELL = 1 << 30;
+
+	struct GridCell
+	{
+		int x_, y_, z_;
+
+		inline bool operator==(const GridCell& op) const
+		{
+			return x_ == op.x_ && y_ == op.y_ && z_ == op.z_;
+		};
+	};
+
+	// bucket of a cell in a table of mask+1 entries, neighbours along x go to consecutive buckets
+	inline unsigned int grid_hash(int x, int y, int z, unsigned int mask)
+	{
+		return (static_cast<unsigned int>(x) + (static_cast<unsigned int>(y)*73856093u ^ static_cast<unsigned int>(z)*19349663u)) & mask;
+	}
+
+	// bucket of a sphere, the index keeps the order within a bucket fixed
+	struct GridKey
+	{
+		unsigned int bucket_, index_;
+
+		inline bool operator<(const GridKey& op) const
+		{
+			return bucket_ < op.bucket_ || (bucket_ == op.bucket_ && index_ < op.index_);
+		};
+	};
+
+	// sorts keys that barely moved, false if it gave up after max_moves
+	template<class K>
+	bool insertion_sort(K* keys, size_t n, size_t max_moves)
+	{
+		size_t moves = 0;
+
+		for (size_t i=1; i < n; ++i)
+		{
+			const K key = keys[i];
+			size_t j = i;
+
+			for (; j > 0 && key < keys[j-1]; --j)
+				keys[j] = keys[j-1];
+
+			keys[j] = key;
+			moves += i - j;
+
+			if (moves > max_moves)
+				return false;
+		}
+
+		return true;
+	}
+
+} // namespace detail
+
+template<typename T, int N>
+class SphereBroadphase
+{
+protected:
+	memory::AlignedArray<detail::GridKey> keys_;
+	memory::AlignedArray<unsigned int> order_;
+	memory::AlignedArray<detail::GridCell> cells_;		// cell of each sphere
+	memory::AlignedArray<unsigned int> bucket_start_;		// first sorted entry of each bucket
+	SphereBlocks<T, N> blocks_;
+	std::vector<T> max_radius_;
+	std::vector< std::vector<SpherePair> > chunk_pairs_;
+	double inv_cell_;
+	unsigned int mask_;
+
+	SphereBroadphase(const SphereBroadphase&);
+	SphereBroadphase& operator=(const SphereBroadphase&);
+
+	void radius_chunk(const Sphere<T, 4>* spheres, size_t first, size_t last)
+	{
+		T& r = max_radius_[first / detail::BROADPHASE_GRAIN];
+		r = 0;
+
+		for (size_t i=first; i < last; ++i)
+			r = std::max(r, spheres[i].radius_);
+	}
+
+	int cell_coordinate(T x) const
+	{
+		const double c = std::floor(x * inv_cell_);
+		return static_cast<int>(std::max(-detail::BROADPHASE_MAX_CELL, std::min(c, detail::BROADPHASE_MAX_CELL)));
+	}
+
+	void cell_chunk(const Sphere<T, 4>* spheres, size_t first, size_t last)
+	{
+		for (size_t i=first; i < last; ++i)
+		{
+			detail::GridCell& c = cells_[i];
+
+			c.x_ = cell_coordinate(spheres[i].center_[0]);
+			c.y_ = cell_coordinate(spheres[i].center_[1]);
+			c.z_ = cell_coordinate(spheres[i].center_[2]);
+		}
+	}
+
+	// keys in the order of the last call
+	void key_chunk(size_t first, size_t last)
+	{
+		for (size_t i=first; i < last; ++i)
+		{
+			const detail::GridCell& c = cells_[order_[i]];
+
+			keys_[i].bucket_ = detail::grid_hash(c.x_, c.y_, c.z_, mask_);
+			keys_[i].index_ = order_[i];
+		}
+	}
+
+	// sorted order and where each bucket starts in it
+	void bucket_chunk(size_t first, size_t last)
+	{
+		const size_t n = order_.size();
+
+		for (size_t i=first; i < last; ++i)
+		{
+			order_[i] = keys_[i].index_;
+
+			const unsigned int lo = (i == 0) ? 0 : keys_[i-1].bucket_ + 1;
+			const unsigned int hi = keys_[i].bucket_;
+
+			for (unsigned int b=lo; b <= hi; ++b)
+				bucket_start_[b] = static_cast<unsigned int>(i);
+
+			if (i == n-1)
+				for (size_t b=hi+1; b < bucket_start_.size(); ++b)
+					bucket_start_[b] = static_cast<unsigned int>(n);
+		}
+	}
+
+	// pairs of sorted entry i with the entries after it in buckets lo to hi, which are in the row of cells around row
+	void pair_buckets(size_t i, const Sphere<T, 4>& s, const detail::GridCell& row, unsigned int lo, unsigned int hi, std::vector<SpherePair>& pairs) const
+	{
+		const unsigned int a = order_[i];
+		const size_t begin = std::max<size_t>(bucket_start_[lo], i+1);
+		const size_t end = bucket_start_[hi+1];
+
+		if (begin >= end)
+			return;
+
+		for (size_t b=begin/N; b*N < end; ++b)
+		{
+			const unsigned int mask = overlaps(blocks_.get_block(b), s, SphereBlocks<T, N>::lane_mask(b, begin, end));
+
+			// buckets are shared by cells, a sphere only counts when found through its own row
+			for (int k=0; k < N; ++k)
+				if (mask & (1u << k))
+				{
+					const unsigned int o = order_[b*N + k];
+					const detail::GridCell& c = cells_[o];
+
+					if (c.y_ == row.y_ && c.z_ == row.z_ && c.x_ >= row.x_ - 1 && c.x_ <= row.x_ + 1)
+					{
+						const SpherePair p = { std::min(a, o), std::max(a, o) };
+						pairs.push_back(p);
+					}
+				}
+		}
+	}
+
+	// pairs of the sorted entries first to last-1 with the entries after them
+	void pair_chunk(const Sphere<T, 4>* spheres, size_t first, size_t last)
+	{
+		std::vector<SpherePair>& pairs = chunk_pairs_[first / detail::BROADPHASE_GRAIN];
+		pairs.clear();
+
+		for (size_t i=first; i < last; ++i)
+		{
+			const Sphere<T, 4>& s = spheres[order_[i]];
+			const detail::GridCell& c = cells_[order_[i]];
+
+			// the three cells of a row are three consecutive buckets, unless they wrap around
+			for (int z=-1; z <= 1; ++z)
+				for (int y=-1; y <= 1; ++y)
+				{
+					const detail::GridCell row = { c.x_, c.y_ + y, c.z_ + z };
+					const unsigned int bucket = detail::grid_hash(row.x_, row.y_, row.z_, mask_);
+					const unsigned int lo = (bucket - 1) & mask_;
+					const unsigned int hi = (bucket + 1) & mask_;
+
+					if (lo < hi)
+						pair_buckets(i, s, row, lo, hi, pairs);
+					else
+					{
+						pair_buckets(i, s, row, lo, mask_, pairs);
+						pair_buckets(i, s, row, 0, hi, pairs);
+					}
+				}
+		}
+	}
+
+public:
+	SphereBroadphase() : inv_cell_(0), mask_(0) {};
+
+	// replaces pairs by every pair of overlapping spheres, as overlaps() of the two
+	void find_pairs(thread::TaskPool& pool, const Sphere<T, 4>* spheres, size_t n, std::vector<SpherePair>& pairs)
+	{
+		using namespace boost::placeholders;
+
+		pairs.clear();
+
+		if (n < 2)
+			return;
+
+		max_radius_.resize((n + detail::BROADPHASE_GRAIN - 1) / detail::BROADPHASE_GRAIN);
+		thread::parallel_for(pool, 0, n, detail::BROADPHASE_GRAIN, boost::bind(&SphereBroadphase::radius_chunk, this, spheres, _1, _2));
+
+		const T max_radius = *std::max_element(max_radius_.begin(), max_radius_.end());
+
+		if (!(max_radius > 0))
+			return;
+
+		// a little wider than two radii, so rounding never puts overlapping spheres two cells apart
+		inv_cell_ = 1 / (2.00001 * max_radius);
+
+		// a new set starts over from the identity, with about two buckets per sphere
+		if (order_.size() != n)
+		{
+			order_.resize(n);
+
+			for (size_t i=0; i < n; ++i)
+				order_[i] = static_cast<unsigned int>(i);
+
+			size_t buckets = 1;
+			while (buckets < 2*n)
+				buckets *= 2;
+
+			mask_ = static_cast<unsigned int>(buckets - 1);
+			bucket_start_.resize(buckets + 1);
+		}
+
+		keys_.resize(n);
+		cells_.resize(n);
+		thread::parallel_for(pool, 0, n, detail::BROADPHASE_GRAIN, boost::bind(&SphereBroadphase::cell_chunk, this, spheres, _1, _2));
+		thread::parallel_for(pool, 0, n, detail::BROADPHASE_GRAIN, boost::bind(&SphereBroadphase::key_chunk, this, _1, _2));
+
+		if (!detail::insertion_sort(keys_.data(), n, 8*n))
+			std::sort(keys_.data(), keys_.data() + n);
+
+		thread::parallel_for(pool, 0, n, detail::BROADPHASE_GRAIN, boost::bind(&SphereBroadphase::bucket_chunk, this, _1, _2));
+
+		blocks_.build(pool, spheres, n, order_.data());
+
+		chunk_pairs_.resize((n + detail::BROADPHASE_GRAIN - 1) / detail::BROADPHASE_GRAIN);
+		thread::parallel_for(pool, 0, n, detail::BROADPHASE_GRAIN, boost::bind(&SphereBroadphase::pair_chunk, this, spheres, _1, _2));
+
+		size_t count = 0;
+
+		for (size_t k=0; k < chunk_pairs_.size(); ++k)
+			count += chunk_pairs_[k].size();
+
+		pairs.reserve(count);
+
+		for (size_t k=0; k < chunk_pairs_.size(); ++k)
+			pairs.insert(pairs.end(), chunk_pairs_[k].begin(), chunk_pairs_[k].end());
+	};
+};
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_BROADPHASE__
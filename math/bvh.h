@@ -0,0 +1,1917 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Bounding volume hierarchy over anything with an AABB. A node holds the
+ * boxes of both of its children side by side, so one node fetch (64 bytes
+ * for float, one cache line) is enough to test and order both children:
+ *
+ *   Bvh<float> bvh;
+ *   bvh.build(boxes, count);							// surface area heuristic
+ *   bvh.build_binned(pool, boxes, count);			// the same, parallel and binned
+ *   bvh.build_morton(pool, boxes, count);			// parallel LBVH for previews
+ *   bvh.refit(pool, boxes);							// moved boxes, same tree
+ *   bvh.traverse(ray, t_max, leaf);					// leaf(primitive, t_max)
+ *   bvh.traverse(rays, mask, t_max, leaf);			// leaf(primitive, mask, t_max)
+ *   bvh.traverse_leaves(ray, t_max, leaf);			// leaf(first, count, t_max)
+ *   bvh.traverse_any(ray, t_max, leaf);				// stops at the first hit
+ *   bvh.query(box, leaf);							// leaf(first, count) overlapping box
+ *
+ *   BvhScene< float, Triangle<float, 4> > scene(triangles, count);
+ *   scene.closest_hit(ray, hit, primitive);			// same hit as PrimitiveList
+ *   scene.closest_hit(rays, mask, hits);				// for a RayPacket
+ *   scene.occluded(ray, t_max);						// any hit closer than t_max
+ *
+ * Primitive indices refer to the order of the boxes given to build().
+ * refit() keeps the tree and only updates the node boxes, bottom up; the
+ * tree gets worse the farther the primitives move, get_degradation() tells
+ * by how much. See dynamic_scene.h for scenes that rebuild when it's due.
+ */
+
+#if !defined(DEIMOS_MATH_BVH__)
+#define DEIMOS_MATH_BVH__
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "../memory/aligned_array.h"
+#include "../thread/task_pool.h"
+#include "aabb.h"
+#include "intersect.h"
+#include "ray.h"
+#include "ray_caster.h"
+#include "ray_packet.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+// count_ of inner children
+const unsigned int BVH_INNER = static_cast<unsigned int>(-1);
+
+// leaves above this size are split even if the SAH disagrees
+const size_t BVH_MAX_LEAF = 8;
+
+// deeper ranges become leaves, which bounds the traversal stack
+const size_t BVH_MAX_DEPTH = 64;
+
+// SAH costs of one node visit and one primitive test
+const double BVH_TRAVERSAL_COST = 1.0;
+const double BVH_INTERSECT_COST = 1.0;
+
+template<typename T>
+struct BvhNode
+{
+	// boxes of both children, [axis][child]
+	T min_[3][2];
+	T max_[3][2];
+
+	// node index of an inner child, first entry of the primitive indices of a leaf
+	unsigned int child_[2];
+
+	// number of primitives of a leaf or BVH_INNER, empty children are leaves of size 0
+	unsigned int count_[2];
+
+	inline bool is_inner(int c) const { return count_[c] == BVH_INNER; };
+
+	// two empty children
+	static BvhNode empty()
+	{
+		BvhNode res;
+		res.set_leaf(0, AABB<T, 3>::empty(), 0, 0);
+		res.set_leaf(1, AABB<T, 3>::empty(), 0, 0);
+		return res;
+	};
+
+	void set_bounds(int c, const AABB<T, 3>& op)
+	{
+		for (int i=0; i < 3; ++i)
+		{
+			min_[i][c] = op.min_[i];
+			max_[i][c] = op.max_[i];
+		}
+	};
+
+	AABB<T, 3> get_bounds(int c) const
+	{
+		AABB<T, 3> res;
+
+		for (int i=0; i < 3; ++i)
+		{
+			res.min_[i] = min_[i][c];
+			res.max_[i] = max_[i][c];
+		}
+
+		return res;
+	};
+
+	void set_leaf(int c, const AABB<T, 3>& op, unsigned int first, unsigned int count)
+	{
+		set_bounds(c, op);
+		child_[c] = first;
+		count_[c] = count;
+	};
+
+	void set_inner(int c, const AABB<T, 3>& op, unsigned int node)
+	{
+		set_bounds(c, op);
+		child_[c] = node;
+		count_[c] = BVH_INNER;
+	};
+};
+
+struct BvhBuildStats
+{
+	double build_time_;		// seconds
+	size_t nodes_;
+	size_t leaves_;
+	size_t max_depth_;
+	size_t max_leaf_size_;
+	double sah_cost_;		// expected cost of a random ray hitting the root box
+	double build_sah_cost_;	// sah_cost_ right after the build, refit() only updates sah_cost_
+
+	BvhBuildStats() : build_time_(0), nodes_(0), leaves_(0), max_depth_(0), max_leaf_size_(0), sah_cost_(0), build_sah_cost_(0) {};
+};
+
+// counters of traverse(), per thread; add them up afterwards. A packet counts all its rays but visits nodes once
+struct BvhTraversalStats
+{
+	size_t rays_;
+	size_t nodes_;			// inner nodes visited
+	size_t leaves_;			// leaves visited
+	size_t primitives_;		// primitives tested
+
+	BvhTraversalStats() : rays_(0), nodes_(0), leaves_(0), primitives_(0) {};
+
+	void operator+=(const BvhTraversalStats& op)
+	{
+		rays_ += op.rays_;
+		nodes_ += op.nodes_;
+		leaves_ += op.leaves_;
+		primitives_ += op.primitives_;
+	};
+};
+
+//-------------------------------------//
+
+// BoxRay with the slab test against the children of a node
+template<typename T>
+struct BvhRay : public BoxRay<T>
+{
+	using BoxRay<T>::origin_;
+	using BoxRay<T>::inv_direction_;
+	using BoxRay<T>::negative_;
+
+	explicit BvhRay(const Ray<T, 4>& ray) : BoxRay<T>(ray) {};
+
+	// slab test against child c, tnear is the entry distance
+	inline bool intersect(const BvhNode<T>& node, int c, T t_max, T& tnear) const
+	{
+		T t0 = 0, t1 = t_max;
+
+		for (int i=0; i < 3; ++i)
+		{
+			const T near_plane = negative_[i] ? node.max_[i][c] : node.min_[i][c];
+			const T far_plane = negative_[i] ? node.min_[i][c] : node.max_[i][c];
+
+			const T tn = (near_plane - origin_[i]) * inv_direction_[i];
+			const T tf = (far_plane - origin_[i]) * inv_direction_[i];
+
+			// NaN from a parallel ray on a slab plane keeps the old values
+			if (tn > t0) t0 = tn;
+			if (tf < t1) t1 = tf;
+		}
+
+		tnear = t0;
+		return t0 <= t1 * BoxRay<T>::robust_scale();
+	};
+};
+
+// BvhRay for the lanes of a RayPacket
+template<typename T, int N>
+struct BvhRayPacket
+{
+	typedef ScalarPacket<T, N> Scalar;
+
+	const RayPacket<T, N>& rays_;
+	unsigned int negative_[3];		// lanes with negative direction per axis
+
+	explicit BvhRayPacket(const RayPacket<T, N>& rays) : rays_(rays)
+	{
+		for (int i=0; i < 3; ++i)
+			negative_[i] = rays.inv_direction_.component_[i].less(Scalar::broadcast(0));
+	};
+
+	// lanes of mask that hit child c, the same slab test as BvhRay
+	inline unsigned int intersect(const BvhNode<T>& node, int c, const Scalar& t_max, unsigned int mask, Scalar& tnear) const
+	{
+		Scalar t0 = Scalar::broadcast(0), t1 = t_max;
+
+		for (int i=0; i < 3; ++i)
+		{
+			const Scalar lo = Scalar::broadcast(node.min_[i][c]);
+			const Scalar hi = Scalar::broadcast(node.max_[i][c]);
+
+			const Scalar tn = (select(negative_[i], hi, lo) - rays_.origin_.component_[i]) * rays_.inv_direction_.component_[i];
+			const Scalar tf = (select(negative_[i], lo, hi) - rays_.origin_.component_[i]) * rays_.inv_direction_.component_[i];
+
+			t0 = select(t0.less(tn), tn, t0);
+			t1 = select(tf.less(t1), tf, t1);
+		}
+
+		tnear = t0;
+		return mask & t0.less_equal(t1 * BvhRay<T>::robust_scale());
+	};
+};
+
+//-------------------------------------//
+
+namespace detail {
+
+	// primitives per task of the parallel loops
+	const size_t BVH_GRAIN = 16384;
+
+	// larger ranges are binned and partitioned in parallel
+	const size_t BVH_PARALLEL_RANGE = 65536;
+
+	// larger subtrees are built as tasks of their own
+	const size_t BVH_TASK_RANGE = 2048;
+
+	const int BVH_BINS = 32;
+
+	// leaf size of the Morton code build
+	const size_t BVH_MORTON_LEAF = 4;
+
+	// nodes per task of Bvh::refit()
+	const size_t BVH_REFIT_GRAIN = 2048;
+
+	// per primitive leaf calls of Bvh::traverse() on top of traverse_leaves(), ANY_HIT returns at the first hit
+	template<class F, bool ANY_HIT = false>
+	struct BvhPrimitiveLeaf
+	{
+		const unsigned int* indices_;
+		F* leaf_;
+
+		template<typename T>
+		inline bool operator()(unsigned int first, unsigned int count, T& t_max)
+		{
+			bool res = false;
+
+			for (unsigned int i=first; i < first + count; ++i)
+				if ((*leaf_)(indices_[i], t_max))
+				{
+					if (ANY_HIT)
+						return true;
+
+					res = true;
+				}
+
+			return res;
+		};
+	};
+
+	template<typename T>
+	struct BvhRange
+	{
+		size_t begin_, end_;
+		AABB<T, 3> box_, centroid_box_;
+
+		inline size_t size() const { return end_ - begin_; };
+	};
+
+	// node storage of the parallel builds; holds enough nodes for any tree
+	template<typename T>
+	class BvhNodePool
+	{
+	protected:
+		BvhNode<T>* nodes_;
+		size_t size_, capacity_;
+		boost::mutex mutex_;
+
+	public:
+		BvhNodePool(BvhNode<T>* nodes, size_t capacity) : nodes_(nodes), size_(0), capacity_(capacity) {};
+
+		inline size_t size() const { return size_; };
+		inline BvhNode<T>& operator[](size_t n) { return nodes_[n]; };
+
+		unsigned int allocate()
+		{
+			size_t n;
+
+			{
+				boost::lock_guard<boost::mutex> lock(mutex_);
+				assert(size_ < capacity_);
+				n = size_++;
+			}
+
+			nodes_[n] = BvhNode<T>::empty();
+			return static_cast<unsigned int>(n);
+		};
+	};
+
+	// parts shared by the binned and the Morton build
+	template<typename T>
+	class BvhParallelBuild
+	{
+	protected:
+		thread::TaskPool& pool_;
+		const AABB<T, 3>* boxes_;
+		unsigned int* indices_;
+		BvhNodePool<T>& nodes_;
+
+		void bounds_chunk(std::vector< BvhRange<T> >* chunks, size_t first, size_t last) const
+		{
+			BvhRange<T>& r = (*chunks)[first / BVH_GRAIN];
+			r.box_ = r.centroid_box_ = AABB<T, 3>::empty();
+
+			for (size_t i=first; i < last; ++i)
+			{
+				r.box_.extend(boxes_[i]);
+				r.centroid_box_.extend(boxes_[i].center());
+			}
+		}
+
+		BvhParallelBuild(thread::TaskPool& pool, const AABB<T, 3>* boxes, unsigned int* indices, BvhNodePool<T>& nodes) :
+			pool_(pool), boxes_(boxes), indices_(indices), nodes_(nodes) {};
+
+	public:
+		// bounds of all boxes and of their centers
+		BvhRange<T> init(size_t n)
+		{
+			using namespace boost::placeholders;
+
+			std::vector< BvhRange<T> > chunks((n + BVH_GRAIN - 1) / BVH_GRAIN);
+			thread::parallel_for(pool_, 0, n, BVH_GRAIN, boost::bind(&BvhParallelBuild::bounds_chunk, this, &chunks, _1, _2));
+
+			BvhRange<T> res;
+			res.begin_ = 0;
+			res.end_ = n;
+			res.box_ = res.centroid_box_ = AABB<T, 3>::empty();
+
+			for (size_t i=0; i < chunks.size(); ++i)
+			{
+				res.box_.extend(chunks[i].box_);
+				res.centroid_box_.extend(chunks[i].centroid_box_);
+			}
+
+			return res;
+		}
+	};
+
+	/*
+	 * Binned SAH: centroids are sorted into BVH_BINS bins per axis, the best
+	 * of the bin borders is the split. Boxes are copied next to their index
+	 * and move with it, so every pass over a range reads memory in order.
+	 * Large ranges are binned and partitioned in chunks on the pool, subtrees
+	 * are built as tasks.
+	 */
+	template<typename T>
+	class BvhBinnedBuild : public BvhParallelBuild<T>
+	{
+	protected:
+		typedef BvhParallelBuild<T> Base;
+		using Base::pool_;
+		using Base::boxes_;
+		using Base::indices_;
+		using Base::nodes_;
+
+		// plain box, cheaper to extend and measure than AABB in the inner loops
+		struct Box
+		{
+			T min_[3], max_[3];
+
+			inline void clear()
+			{
+				for (int i=0; i < 3; ++i)
+				{
+					min_[i] = std::numeric_limits<T>::max();
+					max_[i] = -std::numeric_limits<T>::max();
+				}
+			};
+
+			inline void extend(const Box& op)
+			{
+				for (int i=0; i < 3; ++i)
+				{
+					min_[i] = std::min(min_[i], op.min_[i]);
+					max_[i] = std::max(max_[i], op.max_[i]);
+				}
+			};
+
+			inline void extend_point(const T* op)
+			{
+				for (int i=0; i < 3; ++i)
+				{
+					min_[i] = std::min(min_[i], op[i]);
+					max_[i] = std::max(max_[i], op[i]);
+				}
+			};
+
+			// only for boxes that are not empty
+			inline double half_area() const
+			{
+				const double x = max_[0] - min_[0], y = max_[1] - min_[1], z = max_[2] - min_[2];
+				return x*y + y*z + z*x;
+			};
+
+			AABB<T, 3> aabb() const
+			{
+				AABB<T, 3> res;
+
+				for (int i=0; i < 3; ++i)
+				{
+					res.min_[i] = min_[i];
+					res.max_[i] = max_[i];
+				}
+
+				return res;
+			};
+		};
+
+		// a primitive during the build
+		struct Ref
+		{
+			Box box_;
+			T centroid_[3];
+			unsigned int index_;
+		};
+
+		// the first size_ of BVH_BINS bins are used
+		struct Bins
+		{
+			int size_;
+			size_t count_[3][BVH_BINS];
+			Box box_[3][BVH_BINS];
+
+			void clear(int size)
+			{
+				size_ = size;
+
+				for (int axis=0; axis < 3; ++axis)
+					for (int b=0; b < size_; ++b)
+					{
+						count_[axis][b] = 0;
+						box_[axis][b].clear();
+					}
+			};
+
+			void merge(const Bins& op)
+			{
+				for (int axis=0; axis < 3; ++axis)
+					for (int b=0; b < size_; ++b)
+					{
+						count_[axis][b] += op.count_[axis][b];
+						box_[axis][b].extend(op.box_[axis][b]);
+					}
+			};
+		};
+
+		// axis_ < 0 halves the range by count
+		struct Split
+		{
+			int axis_;
+			int bin_;
+			double cost_;
+			T offset_, scale_;
+
+			inline bool left(const Ref& op) const
+			{
+				return std::min(static_cast<int>((op.centroid_[axis_] - offset_) * scale_), BVH_BINS-1) < bin_;
+			};
+
+			inline bool operator()(const Ref& op) const { return left(op); };
+		};
+
+		struct Partition
+		{
+			size_t left_, right_;
+			Box box_[2], centroid_box_[2];
+		};
+
+		std::vector<Ref> refs_, temp_;
+
+		void init_chunk(size_t first, size_t last)
+		{
+			for (size_t i=first; i < last; ++i)
+			{
+				Ref& r = refs_[i];
+
+				for (int axis=0; axis < 3; ++axis)
+				{
+					r.box_.min_[axis] = boxes_[i].min_[axis];
+					r.box_.max_[axis] = boxes_[i].max_[axis];
+					r.centroid_[axis] = (r.box_.min_[axis] + r.box_.max_[axis]) * T(0.5);
+				}
+
+				r.index_ = static_cast<unsigned int>(i);
+			}
+		}
+
+		void finish_chunk(size_t first, size_t last)
+		{
+			for (size_t i=first; i < last; ++i)
+				indices_[i] = refs_[i].index_;
+		}
+
+		// small ranges use fewer bins
+		static int num_bins(size_t n)
+		{
+			return (n < size_t(BVH_BINS)) ? std::max(static_cast<int>(n), 4) : BVH_BINS;
+		}
+
+		T bin_scale(const BvhRange<T>& r, int axis) const
+		{
+			const T extent = r.centroid_box_.max_[axis] - r.centroid_box_.min_[axis];
+			return (extent > 0) ? T(num_bins(r.size())) * T(0.999) / extent : T(0);
+		}
+
+		void bin(const BvhRange<T>* r, Bins* bins, size_t first, size_t last) const
+		{
+			T scale[3], offset[3];
+			for (int axis=0; axis < 3; ++axis)
+			{
+				scale[axis] = bin_scale(*r, axis);
+				offset[axis] = r->centroid_box_.min_[axis];
+			}
+
+			bins->clear(num_bins(r->size()));
+
+			for (size_t i=first; i < last; ++i)
+			{
+				const Ref& ref = refs_[i];
+
+				for (int axis=0; axis < 3; ++axis)
+				{
+					const int b = std::min(static_cast<int>((ref.centroid_[axis] - offset[axis]) * scale[axis]), BVH_BINS-1);
+					bins->count_[axis][b]++;
+					bins->box_[axis][b].extend(ref.box_);
+				}
+			}
+		}
+
+		void bin_chunk(const BvhRange<T>* r, std::vector<Bins>* bins, size_t first, size_t last) const
+		{
+			bin(r, &(*bins)[(first - r->begin_) / BVH_GRAIN], first, last);
+		}
+
+		Split find_split(const BvhRange<T>& r)
+		{
+			using namespace boost::placeholders;
+
+			Bins bins;
+
+			if (r.size() > BVH_PARALLEL_RANGE)
+			{
+				std::vector<Bins> chunks((r.size() + BVH_GRAIN - 1) / BVH_GRAIN);
+				thread::parallel_for(pool_, r.begin_, r.end_, BVH_GRAIN, boost::bind(&BvhBinnedBuild::bin_chunk, this, &r, &chunks, _1, _2));
+
+				bins.clear(num_bins(r.size()));
+				for (size_t i=0; i < chunks.size(); ++i)
+					bins.merge(chunks[i]);
+			}
+			else
+				bin(&r, &bins, r.begin_, r.end_);
+
+			Split res;
+			res.axis_ = -1;
+			res.bin_ = 0;
+			res.cost_ = std::numeric_limits<double>::max();
+			res.offset_ = res.scale_ = 0;
+
+			const double area = r.box_.surface_area() / 2;
+
+			for (int axis=0; axis < 3 && area > 0; ++axis)
+			{
+				const T scale = bin_scale(r, axis);
+
+				if (scale == 0)
+					continue;
+
+				// only borders between non-empty bins are candidates
+				int used[BVH_BINS];
+				int num_used = 0;
+
+				for (int b=0; b < bins.size_; ++b)
+					if (bins.count_[axis][b])
+						used[num_used++] = b;
+
+				// area times count of everything from used bin k on
+				double right_cost[BVH_BINS];
+				Box right = bins.box_[axis][used[num_used-1]];
+				size_t right_count = bins.count_[axis][used[num_used-1]];
+
+				for (int k=num_used-1; k > 0; --k)
+				{
+					if (k < num_used-1)
+					{
+						right.extend(bins.box_[axis][used[k]]);
+						right_count += bins.count_[axis][used[k]];
+					}
+
+					right_cost[k] = right.half_area() * right_count;
+				}
+
+				Box left;
+				left.clear();
+				size_t left_count = 0;
+
+				for (int k=1; k < num_used; ++k)
+				{
+					left.extend(bins.box_[axis][used[k-1]]);
+					left_count += bins.count_[axis][used[k-1]];
+
+					const double cost = BVH_TRAVERSAL_COST + BVH_INTERSECT_COST *
+						(left.half_area() * left_count + right_cost[k]) / area;
+
+					if (cost < res.cost_)
+					{
+						res.cost_ = cost;
+						res.axis_ = axis;
+						res.bin_ = used[k];
+						res.offset_ = r.centroid_box_.min_[axis];
+						res.scale_ = scale;
+					}
+				}
+			}
+
+			if (res.axis_ < 0)
+				res.cost_ = BVH_INTERSECT_COST * r.size();
+
+			return res;
+		}
+
+		void count_chunk(const BvhRange<T>* r, const Split* split, std::vector<Partition>* parts, size_t first, size_t last) const
+		{
+			Partition& part = (*parts)[(first - r->begin_) / BVH_GRAIN];
+			part.left_ = 0;
+
+			for (size_t i=first; i < last; ++i)
+				if (split->left(refs_[i]))
+					part.left_++;
+		}
+
+		// entries of a chunk go to their offsets in temp_, left_ and right_ are the offsets of the chunk
+		void scatter_chunk(const BvhRange<T>* r, const Split* split, std::vector<Partition>* parts, size_t first, size_t last)
+		{
+			Partition& part = (*parts)[(first - r->begin_) / BVH_GRAIN];
+			size_t offset[2] = { part.left_, part.right_ };
+
+			for (int c=0; c < 2; ++c)
+			{
+				part.box_[c].clear();
+				part.centroid_box_[c].clear();
+			}
+
+			for (size_t i=first; i < last; ++i)
+			{
+				const Ref& ref = refs_[i];
+				const int side = split->left(ref) ? 0 : 1;
+
+				temp_[offset[side]++] = ref;
+				part.box_[side].extend(ref.box_);
+				part.centroid_box_[side].extend_point(ref.centroid_);
+			}
+		}
+
+		void copy_back(size_t first, size_t last)
+		{
+			std::copy(temp_.begin() + first, temp_.begin() + last, refs_.begin() + first);
+		}
+
+		static void set_range(BvhRange<T>& r, size_t begin, size_t end, const Box& box, const Box& centroid_box)
+		{
+			r.begin_ = begin;
+			r.end_ = end;
+			r.box_ = box.aabb();
+			r.centroid_box_ = centroid_box.aabb();
+		}
+
+		// the two children of r as given by split, with their bounds
+		void partition(const BvhRange<T>& r, const Split& split, BvhRange<T>& left, BvhRange<T>& right)
+		{
+			using namespace boost::placeholders;
+
+			if (split.axis_ >= 0 && r.size() > BVH_PARALLEL_RANGE)
+			{
+				const size_t chunks = (r.size() + BVH_GRAIN - 1) / BVH_GRAIN;
+				std::vector<Partition> parts(chunks);
+
+				thread::parallel_for(pool_, r.begin_, r.end_, BVH_GRAIN, boost::bind(&BvhBinnedBuild::count_chunk, this, &r, &split, &parts, _1, _2));
+
+				size_t mid = r.begin_;
+				for (size_t c=0; c < chunks; ++c)
+					mid += parts[c].left_;
+
+				// prefix sums: left entries from r.begin_, right entries from mid
+				size_t l = r.begin_, rr = mid;
+				for (size_t c=0; c < chunks; ++c)
+				{
+					const size_t count = std::min(BVH_GRAIN, r.end_ - (r.begin_ + c*BVH_GRAIN));
+					const size_t nl = parts[c].left_;
+
+					parts[c].left_ = l;
+					parts[c].right_ = rr;
+
+					l += nl;
+					rr += count - nl;
+				}
+
+				thread::parallel_for(pool_, r.begin_, r.end_, BVH_GRAIN, boost::bind(&BvhBinnedBuild::scatter_chunk, this, &r, &split, &parts, _1, _2));
+				thread::parallel_for(pool_, r.begin_, r.end_, BVH_GRAIN, boost::bind(&BvhBinnedBuild::copy_back, this, _1, _2));
+
+				Box box[2], centroid_box[2];
+
+				for (int c=0; c < 2; ++c)
+				{
+					box[c].clear();
+					centroid_box[c].clear();
+
+					for (size_t i=0; i < chunks; ++i)
+					{
+						box[c].extend(parts[i].box_[c]);
+						centroid_box[c].extend(parts[i].centroid_box_[c]);
+					}
+				}
+
+				set_range(left, r.begin_, mid, box[0], centroid_box[0]);
+				set_range(right, mid, r.end_, box[1], centroid_box[1]);
+				return;
+			}
+
+			const size_t mid = (split.axis_ < 0) ?
+				r.begin_ + r.size()/2 : std::partition(refs_.begin() + r.begin_, refs_.begin() + r.end_, split) - refs_.begin();
+
+			const size_t first[2] = { r.begin_, mid };
+			const size_t last[2] = { mid, r.end_ };
+			BvhRange<T>* side[2] = { &left, &right };
+
+			for (int c=0; c < 2; ++c)
+			{
+				Box box, centroid_box;
+				box.clear();
+				centroid_box.clear();
+
+				for (size_t i=first[c]; i < last[c]; ++i)
+				{
+					box.extend(refs_[i].box_);
+					centroid_box.extend_point(refs_[i].centroid_);
+				}
+
+				set_range(*side[c], first[c], last[c], box, centroid_box);
+			}
+		}
+
+		bool make_leaf(const BvhRange<T>& r, const Split& split, size_t depth) const
+		{
+			const size_t n = r.size();
+
+			if (n <= 1 || depth >= BVH_MAX_DEPTH)
+				return true;
+
+			return n <= BVH_MAX_LEAF && split.cost_ >= BVH_INTERSECT_COST * n;
+		}
+
+		// splits an inner node's range into its two children
+		void build_children(unsigned int node, const BvhRange<T>& r, const Split& split, size_t depth)
+		{
+			BvhRange<T> children[2];
+			partition(r, split, children[0], children[1]);
+
+			if (r.size() > BVH_TASK_RANGE)
+			{
+				thread::TaskGroup group(pool_);
+				group.run(boost::bind(&BvhBinnedBuild::build, this, node, 0, children[0], depth));
+				build(node, 1, children[1], depth);
+				group.wait();
+			}
+			else
+			{
+				build(node, 0, children[0], depth);
+				build(node, 1, children[1], depth);
+			}
+		}
+
+		// subtree of r in child c of parent
+		void build(unsigned int parent, int c, BvhRange<T> r, size_t depth)
+		{
+			const Split split = (r.size() > 1 && depth < BVH_MAX_DEPTH) ? find_split(r) : Split();
+
+			if (make_leaf(r, split, depth))
+			{
+				nodes_[parent].set_leaf(c, r.box_, static_cast<unsigned int>(r.begin_), static_cast<unsigned int>(r.size()));
+				return;
+			}
+
+			const unsigned int node = nodes_.allocate();
+			nodes_[parent].set_inner(c, r.box_, node);
+
+			build_children(node, r, split, depth+1);
+		}
+
+	public:
+		BvhBinnedBuild(thread::TaskPool& pool, const AABB<T, 3>* boxes, unsigned int* indices, BvhNodePool<T>& nodes) :
+			Base(pool, boxes, indices, nodes) {};
+
+		void run(const BvhRange<T>& r)
+		{
+			using namespace boost::placeholders;
+
+			const size_t n = r.size();
+
+			refs_.resize(n);
+			temp_.resize(n);
+			thread::parallel_for(pool_, 0, n, BVH_GRAIN, boost::bind(&BvhBinnedBuild::init_chunk, this, _1, _2));
+
+			const unsigned int root = nodes_.allocate();
+			const Split split = (n > 1) ? find_split(r) : Split();
+
+			if (make_leaf(r, split, 0))
+				nodes_[root].set_leaf(0, r.box_, 0, static_cast<unsigned int>(n));
+			else
+				build_children(root, r, split, 1);
+
+			thread::parallel_for(pool_, 0, n, BVH_GRAIN, boost::bind(&BvhBinnedBuild::finish_chunk, this, _1, _2));
+		}
+	};
+
+	// spreads the lower ten bits of op to every third bit
+	inline unsigned int morton_spread(unsigned int op)
+	{
+		op &= 0x3ff;
+		op = (op | (op << 16)) & 0x030000ff;
+		op = (op | (op << 8)) & 0x0300f00f;
+		op = (op | (op << 4)) & 0x030c30c3;
+		op = (op | (op << 2)) & 0x09249249;
+		return op;
+	}
+
+	/*
+	 * Linear BVH: primitives are sorted along a 30 bit Morton curve of their
+	 * centroids, every range is split where its highest differing code bit
+	 * changes. Much faster than binning and good enough for previews.
+	 */
+	template<typename T>
+	class BvhMortonBuild : public BvhParallelBuild<T>
+	{
+	protected:
+		typedef BvhParallelBuild<T> Base;
+		using Base::pool_;
+		using Base::boxes_;
+		using Base::indices_;
+		using Base::nodes_;
+
+		std::vector<unsigned int> code_, temp_code_, temp_index_;
+		std::vector<size_t> histogram_;
+		size_t chunks_;
+
+		void encode_chunk(const BvhRange<T>* r, size_t first, size_t last)
+		{
+			T scale[3];
+			for (int axis=0; axis < 3; ++axis)
+			{
+				const T extent = r->centroid_box_.max_[axis] - r->centroid_box_.min_[axis];
+				scale[axis] = (extent > 0) ? T(1023.99) / extent : T(0);
+			}
+
+			for (size_t i=first; i < last; ++i)
+			{
+				unsigned int code = 0;
+
+				for (int axis=0; axis < 3; ++axis)
+				{
+					const T centroid = (boxes_[i].min_[axis] + boxes_[i].max_[axis]) * T(0.5);
+					const unsigned int q = static_cast<unsigned int>((centroid - r->centroid_box_.min_[axis]) * scale[axis]);
+					code |= morton_spread(q) << (2 - axis);
+				}
+
+				code_[i] = code;
+				indices_[i] = static_cast<unsigned int>(i);
+			}
+		}
+
+		// one pass of a stable radix sort by 8 bits of the codes
+		void count_chunk(int shift, size_t first, size_t last)
+		{
+			size_t* h = &histogram_[(first / BVH_GRAIN) * 256];
+			std::fill(h, h + 256, size_t(0));
+
+			for (size_t i=first; i < last; ++i)
+				h[(code_[i] >> shift) & 0xff]++;
+		}
+
+		void scatter_chunk(int shift, size_t first, size_t last)
+		{
+			size_t* h = &histogram_[(first / BVH_GRAIN) * 256];
+
+			for (size_t i=first; i < last; ++i)
+			{
+				const size_t dst = h[(code_[i] >> shift) & 0xff]++;
+				temp_code_[dst] = code_[i];
+				temp_index_[dst] = indices_[i];
+			}
+		}
+
+		void copy_back(size_t first, size_t last)
+		{
+			std::copy(&temp_code_[0] + first, &temp_code_[0] + last, &code_[0] + first);
+			std::copy(&temp_index_[0] + first, &temp_index_[0] + last, indices_ + first);
+		}
+
+		void sort(size_t n)
+		{
+			using namespace boost::placeholders;
+
+			chunks_ = (n + BVH_GRAIN - 1) / BVH_GRAIN;
+			histogram_.resize(chunks_ * 256);
+			temp_code_.resize(n);
+			temp_index_.resize(n);
+
+			for (int shift=0; shift < 32; shift += 8)
+			{
+				thread::parallel_for(pool_, 0, n, BVH_GRAIN, boost::bind(&BvhMortonBuild::count_chunk, this, shift, _1, _2));
+
+				// bucket by bucket, chunk by chunk keeps the sort stable
+				size_t offset = 0;
+				for (size_t b=0; b < 256; ++b)
+					for (size_t c=0; c < chunks_; ++c)
+					{
+						const size_t count = histogram_[c*256 + b];
+						histogram_[c*256 + b] = offset;
+						offset += count;
+					}
+
+				thread::parallel_for(pool_, 0, n, BVH_GRAIN, boost::bind(&BvhMortonBuild::scatter_chunk, this, shift, _1, _2));
+				thread::parallel_for(pool_, 0, n, BVH_GRAIN, boost::bind(&BvhMortonBuild::copy_back, this, _1, _2));
+			}
+		}
+
+		// first entry of [begin, end) whose code differs from code_[begin] in the highest bit
+		size_t find_split(size_t begin, size_t end) const
+		{
+			const unsigned int first = code_[begin];
+			const unsigned int last = code_[end-1];
+
+			if (first == last)
+				return begin + (end - begin)/2;
+
+			unsigned int bit = 0x80000000u;
+			while (!((first ^ last) & bit))
+				bit >>= 1;
+
+			size_t lo = begin, hi = end-1;
+
+			while (lo + 1 < hi)
+			{
+				const size_t mid = lo + (hi - lo)/2;
+
+				if (code_[mid] & bit)
+					hi = mid;
+				else
+					lo = mid;
+			}
+
+			return hi;
+		}
+
+		void build_children(unsigned int node, size_t begin, size_t end, size_t depth)
+		{
+			const size_t mid = find_split(begin, end);
+
+			if (end - begin > BVH_TASK_RANGE)
+			{
+				thread::TaskGroup group(pool_);
+				group.run(boost::bind(&BvhMortonBuild::build, this, node, 0, begin, mid, depth));
+				build(node, 1, mid, end, depth);
+				group.wait();
+			}
+			else
+			{
+				build(node, 0, begin, mid, depth);
+				build(node, 1, mid, end, depth);
+			}
+		}
+
+		// subtree of [begin, end) in child c of parent, boxes are merged on the way up
+		void build(unsigned int parent, int c, size_t begin, size_t end, size_t depth)
+		{
+			if (end - begin <= BVH_MORTON_LEAF || depth >= BVH_MAX_DEPTH)
+			{
+				AABB<T, 3> box = AABB<T, 3>::empty();
+
+				for (size_t i=begin; i < end; ++i)
+					box.extend(boxes_[indices_[i]]);
+
+				nodes_[parent].set_leaf(c, box, static_cast<unsigned int>(begin), static_cast<unsigned int>(end - begin));
+				return;
+			}
+
+			const unsigned int node = nodes_.allocate();
+			build_children(node, begin, end, depth+1);
+
+			const AABB<T, 3> box = nodes_[node].get_bounds(0).merge(nodes_[node].get_bounds(1));
+			nodes_[parent].set_inner(c, box, node);
+		}
+
+	public:
+		BvhMortonBuild(thread::TaskPool& pool, const AABB<T, 3>* boxes, unsigned int* indices, BvhNodePool<T>& nodes) :
+			Base(pool, boxes, indices, nodes) {};
+
+		void run(const BvhRange<T>& r)
+		{
+			using namespace boost::placeholders;
+
+			const size_t n = r.size();
+
+			code_.resize(n);
+			thread::parallel_for(pool_, 0, n, BVH_GRAIN, boost::bind(&BvhMortonBuild::encode_chunk, this, &r, _1, _2));
+
+			sort(n);
+
+			const unsigned int root = nodes_.allocate();
+
+			if (n <= BVH_MORTON_LEAF)
+				nodes_[root].set_leaf(0, r.box_, 0, static_cast<unsigned int>(n));
+			else
+				build_children(root, 0, n, 1);
+		}
+	};
+
+} // namespace detail
+
+template<typename T>
+class Bvh
+{
+public:
+	typedef BvhNode<T> Node;
+
+protected:
+	memory::AlignedArray<Node> nodes_;
+	memory::AlignedArray<unsigned int> indices_;
+	AABB<T, 3> bounds_;
+	BvhBuildStats stats_;
+
+	// nodes in breadth first order for refit(), level l starts at refit_levels_[l]
+	memory::AlignedArray<unsigned int> refit_order_;
+	std::vector<size_t> refit_levels_;
+
+	struct Split
+	{
+		size_t mid_;
+		double cost_;
+		AABB<T, 3> left_, right_;
+	};
+
+	struct CentroidLess
+	{
+		const T* centroid_;
+
+		inline bool operator()(unsigned int op1, unsigned int op2) const
+		{
+			return centroid_[op1] < centroid_[op2] || (centroid_[op1] == centroid_[op2] && op1 < op2);
+		};
+	};
+
+	// state of a build, shared by the recursion
+	struct SweepBuild
+	{
+		const AABB<T, 3>* bounds_;
+		std::vector<T> centroid_[3];
+		std::vector< AABB<T, 3> > right_;
+	};
+
+	static double leaf_cost(size_t n)
+	{
+		return BVH_INTERSECT_COST * n;
+	}
+
+	// sorts [begin, end) of indices_ along the best axis and splits it there
+	Split find_split(SweepBuild& build, size_t begin, size_t end)
+	{
+		const size_t n = end - begin;
+		unsigned int* idx = indices_.data();
+
+		Split res;
+		res.mid_ = begin + n/2;
+		res.cost_ = std::numeric_limits<double>::max();
+
+		AABB<T, 3> parent = AABB<T, 3>::empty();
+		for (size_t i=begin; i < end; ++i)
+			parent.extend(build.bounds_[idx[i]]);
+
+		double area = parent.surface_area();
+		int best_axis = -1;
+
+		for (int axis=0; axis < 3 && area > 0; ++axis)
+		{
+			CentroidLess less = { &build.centroid_[axis][0] };
+			std::sort(idx + begin, idx + end, less);
+
+			// boxes of all suffixes, then sweep the prefixes
+			AABB<T, 3> right = AABB<T, 3>::empty();
+			for (size_t i=end; i-- > begin+1;)
+			{
+				right.extend(build.bounds_[idx[i]]);
+				build.right_[i] = right;
+			}
+
+			AABB<T, 3> left = AABB<T, 3>::empty();
+			for (size_t i=begin+1; i < end; ++i)
+			{
+				left.extend(build.bounds_[idx[i-1]]);
+
+				const double cost = BVH_TRAVERSAL_COST + BVH_INTERSECT_COST *
+					(left.surface_area() * (i - begin) + build.right_[i].surface_area() * (end - i)) / area;
+
+				if (cost < res.cost_)
+				{
+					res.cost_ = cost;
+					res.mid_ = i;
+					best_axis = axis;
+				}
+			}
+		}
+
+		// no useful split (e.g. all centroids at the same spot), only the count can be halved
+		if (best_axis < 0 || (res.cost_ >= leaf_cost(n) && n > BVH_MAX_LEAF))
+		{
+			res.cost_ = std::min(res.cost_, leaf_cost(n));
+			res.mid_ = begin + n/2;
+			best_axis = parent.longest_axis();
+			area = 0;
+		}
+
+		if (best_axis != 2 || area <= 0)
+		{
+			CentroidLess less = { &build.centroid_[best_axis][0] };
+			std::sort(idx + begin, idx + end, less);
+		}
+
+		res.left_ = res.right_ = AABB<T, 3>::empty();
+
+		for (size_t i=begin; i < res.mid_; ++i)
+			res.left_.extend(build.bounds_[idx[i]]);
+
+		for (size_t i=res.mid_; i < end; ++i)
+			res.right_.extend(build.bounds_[idx[i]]);
+
+		return res;
+	}
+
+	bool make_leaf(const Split& split, size_t n, size_t depth) const
+	{
+		if (n <= 1 || depth >= BVH_MAX_DEPTH)
+			return true;
+
+		return n <= BVH_MAX_LEAF && split.cost_ >= leaf_cost(n);
+	}
+
+	void add_leaf(unsigned int node, int c, const AABB<T, 3>& box, size_t first, size_t n)
+	{
+		nodes_[node].set_leaf(c, box, static_cast<unsigned int>(first), static_cast<unsigned int>(n));
+	}
+
+	unsigned int add_node()
+	{
+		nodes_.push_back(Node::empty());
+		return static_cast<unsigned int>(nodes_.size() - 1);
+	}
+
+	// the children of node are [begin, split) and [split, end)
+	void build_children(SweepBuild& build, unsigned int node, size_t begin, size_t end, const Split& split, size_t depth)
+	{
+		const size_t first[2] = { begin, split.mid_ };
+		const size_t last[2] = { split.mid_, end };
+		const AABB<T, 3> box[2] = { split.left_, split.right_ };
+
+		for (int c=0; c < 2; ++c)
+		{
+			const size_t n = last[c] - first[c];
+
+			Split child;
+			child.cost_ = 0;
+
+			if (n > 1 && depth < BVH_MAX_DEPTH)
+				child = find_split(build, first[c], last[c]);
+
+			if (make_leaf(child, n, depth))
+			{
+				add_leaf(node, c, box[c], first[c], n);
+				continue;
+			}
+
+			const unsigned int inner = add_node();
+			nodes_[node].set_inner(c, box[c], inner);
+
+			build_children(build, inner, first[c], last[c], child, depth+1);
+		}
+	}
+
+public:
+	Bvh() : bounds_(AABB<T, 3>::empty()) {};
+
+	// full sweep SAH build over n boxes; slow but gives the best trees
+	void build(const AABB<T, 3>* boxes, size_t n)
+	{
+		const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+		clear();
+
+		if (!n)
+			return;
+
+		SweepBuild build;
+		build.bounds_ = boxes;
+		build.right_.resize(n);
+
+		for (int axis=0; axis < 3; ++axis)
+			build.centroid_[axis].resize(n);
+
+		indices_.resize(n);
+
+		for (size_t i=0; i < n; ++i)
+		{
+			indices_[i] = static_cast<unsigned int>(i);
+			bounds_.extend(boxes[i]);
+
+			for (int axis=0; axis < 3; ++axis)
+				build.centroid_[axis][i] = (boxes[i].min_[axis] + boxes[i].max_[axis]) * T(0.5);
+		}
+
+		const unsigned int root = add_node();
+		const Split split = find_split(build, 0, n);
+
+		if (make_leaf(split, n, 0))
+			add_leaf(root, 0, bounds_, 0, n);
+		else
+			build_children(build, root, 0, n, split, 1);
+
+		finish_stats(start);
+	};
+
+	// binned SAH on the pool, close to build() in quality and much faster
+	void build_binned(thread::TaskPool& pool, const AABB<T, 3>* boxes, size_t n)
+	{
+		build_parallel< detail::BvhBinnedBuild<T> >(pool, boxes, n);
+	};
+
+	// Morton code order on the pool, the fastest build with the slowest tree
+	void build_morton(thread::TaskPool& pool, const AABB<T, 3>* boxes, size_t n)
+	{
+		build_parallel< detail::BvhMortonBuild<T> >(pool, boxes, n);
+	};
+
+	/*
+	 * Fits the node boxes to new boxes of the same primitives, given in the
+	 * same order as to the build. The tree itself stays as it is.
+	 */
+	void refit(const AABB<T, 3>* boxes)
+	{
+		if (nodes_.empty())
+			return;
+
+		prepare_refit();
+
+		// children are one level further down, so the deepest level goes first
+		for (size_t l=refit_levels_.size()-1; l-- > 0;)
+			refit_chunk(boxes, refit_levels_[l], refit_levels_[l+1]);
+
+		finish_refit();
+	};
+
+	// the same on the pool, the nodes of a level are independent of each other
+	void refit(thread::TaskPool& pool, const AABB<T, 3>* boxes)
+	{
+		using namespace boost::placeholders;
+
+		if (nodes_.empty())
+			return;
+
+		prepare_refit();
+
+		for (size_t l=refit_levels_.size()-1; l-- > 0;)
+			thread::parallel_for(pool, refit_levels_[l], refit_levels_[l+1], detail::BVH_REFIT_GRAIN,
+								 boost::bind(&Bvh::refit_chunk, this, boxes, _1, _2));
+
+		finish_refit();
+	};
+
+	// SAH cost of the refit tree relative to the build, 1 right after it
+	inline double get_degradation() const
+	{
+		return (stats_.build_sah_cost_ > 0) ? stats_.sah_cost_ / stats_.build_sah_cost_ : 1;
+	};
+
+	void clear()
+	{
+		nodes_.clear();
+		indices_.clear();
+		bounds_ = AABB<T, 3>::empty();
+		stats_ = BvhBuildStats();
+		refit_order_.clear();
+		refit_levels_.clear();
+	};
+
+	void swap(Bvh& op)
+	{
+		nodes_.swap(op.nodes_);
+		indices_.swap(op.indices_);
+		std::swap(bounds_, op.bounds_);
+		std::swap(stats_, op.stats_);
+		refit_order_.swap(op.refit_order_);
+		refit_levels_.swap(op.refit_levels_);
+	};
+
+	inline bool empty() const							{ return nodes_.empty(); };
+	inline const AABB<T, 3>& get_bounds() const		{ return bounds_; };
+	inline const BvhBuildStats& get_stats() const		{ return stats_; };
+
+	inline size_t num_nodes() const						{ return nodes_.size(); };
+	inline const Node& get_node(size_t n) const			{ return nodes_[n]; };
+
+	// primitive of leaf entry n
+	inline unsigned int get_index(size_t n) const		{ return indices_[n]; };
+	inline const unsigned int* get_indices() const		{ return indices_.data(); };
+
+	/*
+	 * Visits the leaves hit by ray closer than t_max, nearest child first.
+	 * leaf(primitive, t_max) returns true if it found a hit and lowered
+	 * t_max to it; true if any call did.
+	 */
+	template<class F>
+	bool traverse(const Ray<T, 4>& ray, T t_max, F& leaf, BvhTraversalStats* stats = 0) const
+	{
+		detail::BvhPrimitiveLeaf<F> range = { indices_.data(), &leaf };
+		return traverse_leaves(ray, t_max, range, stats);
+	};
+
+	// the same with one call leaf(first, count, t_max) per leaf, for entries first to first+count-1
+	template<class F>
+	bool traverse_leaves(const Ray<T, 4>& ray, T t_max, F& leaf, BvhTraversalStats* stats = 0) const
+	{
+		return visit_leaves<false>(ray, t_max, leaf, stats);
+	};
+
+	/*
+	 * Occlusion traversal: returns true at the first call of leaf(primitive,
+	 * t_max) that does, which should mean primitive is hit closer than t_max.
+	 * The children are still visited nearest first.
+	 */
+	template<class F>
+	bool traverse_any(const Ray<T, 4>& ray, T t_max, F& leaf, BvhTraversalStats* stats = 0) const
+	{
+		detail::BvhPrimitiveLeaf<F, true> range = { indices_.data(), &leaf };
+		return visit_leaves<true>(ray, t_max, range, stats);
+	};
+
+	// the same with one call leaf(first, count, t_max) per leaf
+	template<class F>
+	bool traverse_any_leaves(const Ray<T, 4>& ray, T t_max, F& leaf, BvhTraversalStats* stats = 0) const
+	{
+		return visit_leaves<true>(ray, t_max, leaf, stats);
+	};
+
+	// calls leaf(first, count) for every leaf whose box overlaps box, e.g. to find the neighbours of a primitive
+	template<class F>
+	void query(const AABB<T, 3>& box, F& leaf) const
+	{
+		if (nodes_.empty())
+			return;
+
+		unsigned int stack[BVH_MAX_DEPTH + 2];
+		int top = 0;
+
+		stack[top++] = 0;
+
+		while (top)
+		{
+			const Node& node = nodes_[stack[--top]];
+
+			for (int c=0; c < 2; ++c)
+			{
+				if (!node.count_[c] || !box.overlaps(node.get_bounds(c)))
+					continue;
+
+				if (node.is_inner(c))
+					stack[top++] = node.child_[c];
+				else
+					leaf(node.child_[c], node.count_[c]);
+			}
+		}
+	};
+
+	/*
+	 * Packet version, a node is visited if any lane of mask hits it closer
+	 * than its t_max. leaf(primitive, mask, t_max) gets the lanes that hit
+	 * the leaf box and returns the lanes whose t_max it lowered; returns all
+	 * lanes any call returned.
+	 */
+	template<int N, class F>
+	unsigned int traverse(const RayPacket<T, N>& rays, unsigned int mask, ScalarPacket<T, N>& t_max, F& leaf, BvhTraversalStats* stats = 0) const
+	{
+		typedef ScalarPacket<T, N> Scalar;
+
+		struct Entry
+		{
+			unsigned int child_, count_, mask_;
+			Scalar tnear_;
+		};
+
+		if (nodes_.empty() || !mask)
+			return 0;
+
+		const BvhRayPacket<T, N> r(rays);
+		unsigned int res = 0;
+
+		Entry stack[BVH_MAX_DEPTH + 2];
+		int top = 0;
+
+		Entry root = { 0, BVH_INNER, mask, Scalar::broadcast(0) };
+		stack[top++] = root;
+
+		if (stats)
+			for (int i=0; i < N; ++i)
+				if (mask & (1u << i))
+					stats->rays_++;
+
+		while (top)
+		{
+			const Entry e = stack[--top];
+
+			// lanes that have found something closer since the push
+			const unsigned int m = e.mask_ & ~(t_max * BvhRay<T>::robust_scale()).less(e.tnear_);
+			if (!m)
+				continue;
+
+			if (e.count_ != BVH_INNER)
+			{
+				if (stats)
+				{
+					stats->leaves_++;
+					stats->primitives_ += e.count_;
+				}
+
+				for (unsigned int i=e.child_; i < e.child_ + e.count_; ++i)
+					res |= leaf(indices_[i], m, t_max);
+
+				continue;
+			}
+
+			if (stats)
+				stats->nodes_++;
+
+			const Node& node = nodes_[e.child_];
+
+			Scalar tnear[2];
+			const unsigned int hit[2] = {
+				r.intersect(node, 0, t_max, m, tnear[0]),
+				r.intersect(node, 1, t_max, m, tnear[1])
+			};
+
+			// the child nearer for most lanes that hit both is visited first
+			const unsigned int closer1 = tnear[1].less(tnear[0]);
+			int votes = 0;
+
+			for (int i=0; i < N; ++i)
+				if (hit[0] & hit[1] & (1u << i))
+					votes += (closer1 & (1u << i)) ? 1 : -1;
+
+			const int near = (!hit[0] || (hit[1] && votes > 0)) ? 1 : 0;
+			const int far = 1 - near;
+
+			if (hit[far])
+			{
+				Entry f = { node.child_[far], node.count_[far], hit[far], tnear[far] };
+				stack[top++] = f;
+			}
+
+			if (hit[near])
+			{
+				Entry c = { node.child_[near], node.count_[near], hit[near], tnear[near] };
+				stack[top++] = c;
+			}
+		}
+
+		return res;
+	};
+
+protected:
+	// traverse_leaves(), ANY_HIT stops at the first leaf that returns true
+	template<bool ANY_HIT, class F>
+	bool visit_leaves(const Ray<T, 4>& ray, T t_max, F& leaf, BvhTraversalStats* stats) const
+	{
+		struct Entry
+		{
+			unsigned int child_, count_;
+			T tnear_;
+		};
+
+		if (nodes_.empty())
+			return false;
+
+		const BvhRay<T> r(ray);
+		bool res = false;
+
+		Entry stack[BVH_MAX_DEPTH + 2];
+		int top = 0;
+
+		Entry root = { 0, BVH_INNER, 0 };
+		stack[top++] = root;
+
+		if (stats)
+			stats->rays_++;
+
+		while (top)
+		{
+			const Entry e = stack[--top];
+
+			if (e.tnear_ > t_max * BvhRay<T>::robust_scale())
+				continue;
+
+			if (e.count_ != BVH_INNER)
+			{
+				if (stats)
+				{
+					stats->leaves_++;
+					stats->primitives_ += e.count_;
+				}
+
+				if (leaf(e.child_, e.count_, t_max))
+				{
+					if (ANY_HIT)
+						return true;
+
+					res = true;
+				}
+
+				continue;
+			}
+
+			if (stats)
+				stats->nodes_++;
+
+			const Node& node = nodes_[e.child_];
+
+			T tnear[2];
+			const bool hit0 = r.intersect(node, 0, t_max, tnear[0]);
+			const bool hit1 = r.intersect(node, 1, t_max, tnear[1]);
+
+			// the nearer child is pushed last and visited first
+			const int near = (hit1 && (!hit0 || tnear[1] < tnear[0])) ? 1 : 0;
+			const int far = 1 - near;
+			const bool hit[2] = { hit0, hit1 };
+
+			if (hit[far])
+			{
+				Entry f = { node.child_[far], node.count_[far], tnear[far] };
+				stack[top++] = f;
+			}
+
+			if (hit[near])
+			{
+				Entry c = { node.child_[near], node.count_[near], tnear[near] };
+				stack[top++] = c;
+			}
+		}
+
+		return res;
+	};
+
+	template<class B>
+	void build_parallel(thread::TaskPool& pool, const AABB<T, 3>* boxes, size_t n)
+	{
+		const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+		clear();
+
+		if (!n)
+			return;
+
+		// every inner node has two non-empty children, so there are at most n-1 of them
+		nodes_.resize(n);
+		indices_.resize(n);
+
+		detail::BvhNodePool<T> nodes(nodes_.data(), n);
+		B build(pool, boxes, indices_.data(), nodes);
+
+		const detail::BvhRange<T> r = build.init(n);
+		bounds_ = r.box_;
+
+		build.run(r);
+
+		nodes_.resize(nodes.size());
+		finish_stats(start);
+	}
+
+	// the level order is the same for every refit() of a tree
+	void prepare_refit()
+	{
+		if (refit_order_.size() == nodes_.size())
+			return;
+
+		refit_order_.resize(nodes_.size());
+		refit_levels_.clear();
+
+		size_t end = 0;
+		refit_order_[end++] = 0;
+
+		for (size_t begin=0; begin < end;)
+		{
+			const size_t level_end = end;
+			refit_levels_.push_back(begin);
+
+			for (size_t i=begin; i < level_end; ++i)
+			{
+				const Node& n = nodes_[refit_order_[i]];
+
+				for (int c=0; c < 2; ++c)
+					if (n.is_inner(c))
+						refit_order_[end++] = n.child_[c];
+			}
+
+			begin = level_end;
+		}
+
+		refit_levels_.push_back(end);
+		assert(end == nodes_.size());
+	}
+
+	void refit_chunk(const AABB<T, 3>* boxes, size_t first, size_t last)
+	{
+		for (size_t i=first; i < last; ++i)
+		{
+			Node& n = nodes_[refit_order_[i]];
+
+			for (int c=0; c < 2; ++c)
+			{
+				AABB<T, 3> box = AABB<T, 3>::empty();
+
+				if (n.is_inner(c))
+				{
+					const Node& child = nodes_[n.child_[c]];
+					box.extend(child.get_bounds(0));
+					box.extend(child.get_bounds(1));
+				}
+				else
+				{
+					for (unsigned int k=0; k < n.count_[c]; ++k)
+						box.extend(boxes[indices_[n.child_[c] + k]]);
+				}
+
+				n.set_bounds(c, box);
+			}
+		}
+	}
+
+	// new root box and SAH cost, the same sum as collect_stats() in node order
+	void finish_refit()
+	{
+		bounds_ = nodes_[0].get_bounds(0).merge(nodes_[0].get_bounds(1));
+
+		double cost = 0;
+
+		for (size_t i=0; i < nodes_.size(); ++i)
+		{
+			const Node& n = nodes_[i];
+
+			for (int c=0; c < 2; ++c)
+			{
+				if (n.is_inner(c))
+					cost += BVH_TRAVERSAL_COST * n.get_bounds(c).surface_area();
+				else if (n.count_[c])
+					cost += leaf_cost(n.count_[c]) * n.get_bounds(c).surface_area();
+			}
+		}
+
+		const double area = bounds_.surface_area();
+		stats_.sah_cost_ = (area > 0) ? BVH_TRAVERSAL_COST + cost / area : leaf_cost(indices_.size());
+	}
+
+	void collect_stats(unsigned int node, size_t depth)
+	{
+		const Node& n = nodes_[node];
+
+		for (int c=0; c < 2; ++c)
+		{
+			const double area = n.get_bounds(c).surface_area();
+
+			if (n.is_inner(c))
+			{
+				stats_.sah_cost_ += BVH_TRAVERSAL_COST * area;
+				collect_stats(n.child_[c], depth+1);
+			}
+			else if (n.count_[c])
+			{
+				stats_.leaves_++;
+				stats_.max_leaf_size_ = std::max<size_t>(stats_.max_leaf_size_, n.count_[c]);
+				stats_.max_depth_ = std::max(stats_.max_depth_, depth);
+				stats_.sah_cost_ += leaf_cost(n.count_[c]) * area;
+			}
+		}
+	}
+
+	void finish_stats(const boost::posix_time::ptime& start)
+	{
+		stats_ = BvhBuildStats();
+
+		if (!nodes_.empty())
+			collect_stats(0, 1);
+
+		const double area = bounds_.surface_area();
+
+		stats_.nodes_ = nodes_.size();
+		stats_.sah_cost_ = (area > 0) ? BVH_TRAVERSAL_COST + stats_.sah_cost_ / area : leaf_cost(indices_.size());
+		stats_.build_sah_cost_ = stats_.sah_cost_;
+		stats_.build_time_ = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1e-6;
+	}
+};
+
+//-------------------------------------//
+
+namespace detail {
+
+	template<typename T, class P>
+	struct ClosestHit
+	{
+		const P* primitives_;
+		const Ray<T, 4>* ray_;
+		intersection_point<T>* hit_;
+		size_t primitive_;
+
+		inline bool operator()(unsigned int primitive, T& t_max)
+		{
+			const intersection_point<T> p = intersect(primitives_[primitive], *ray_);
+
+			if (!p.valid_ || p.distance_ >= t_max)
+				return false;
+
+			*hit_ = p;
+			primitive_ = primitive;
+			t_max = p.distance_;
+
+			return true;
+		};
+	};
+
+	template<typename T, class P>
+	struct AnyHit
+	{
+		const P* primitives_;
+		const Ray<T, 4>* ray_;
+
+		inline bool operator()(unsigned int primitive, T& t_max) const
+		{
+			return occluded(primitives_[primitive], *ray_, t_max);
+		};
+	};
+
+	// closest hits of a RayPacket, t_max is hits_->distance_
+	template<typename T, class P, int N>
+	struct PacketClosestHit
+	{
+		const P* primitives_;
+		const RayPacket<T, N>* rays_;
+		PacketHit<T, N>* hits_;
+
+		inline unsigned int operator()(unsigned int primitive, unsigned int mask, ScalarPacket<T, N>& t_max)
+		{
+			assert(&t_max == &hits_->distance_);
+			return intersect(primitives_[primitive], *rays_, mask, *hits_, primitive);
+		};
+	};
+
+} // namespace detail
+
+enum BvhBuildMethod
+{
+	BVH_BUILD_SWEEP,	// Bvh::build()
+	BVH_BUILD_BINNED,	// Bvh::build_binned()
+	BVH_BUILD_MORTON	// Bvh::build_morton()
+};
+
+// triangles or spheres in a Bvh, a scene for RayCaster; the primitives must outlive it
+template<typename T, class P>
+class BvhScene
+{
+public:
+	typedef T value_type;
+
+protected:
+	const P* primitives_;
+	size_t size_;
+	Bvh<T> bvh_;
+
+	void bounds_chunk(AABB<T, 3>* boxes, size_t first, size_t last) const
+	{
+		for (size_t i=first; i < last; ++i)
+			boxes[i] = bounds(primitives_[i]);
+	}
+
+public:
+	BvhScene(const P* primitives, size_t size) : primitives_(primitives), size_(size)
+	{
+		memory::AlignedArray< AABB<T, 3> > boxes(size);
+		bounds_chunk(boxes.data(), 0, size);
+
+		bvh_.build(boxes.data(), size);
+	};
+
+	BvhScene(const P* primitives, size_t size, thread::TaskPool& pool, BvhBuildMethod method = BVH_BUILD_BINNED) : primitives_(primitives), size_(size)
+	{
+		using namespace boost::placeholders;
+
+		memory::AlignedArray< AABB<T, 3> > boxes(size);
+		thread::parallel_for(pool, 0, size, detail::BVH_GRAIN, boost::bind(&BvhScene::bounds_chunk, this, boxes.data(), _1, _2));
+
+		if (method == BVH_BUILD_SWEEP)
+			bvh_.build(boxes.data(), size);
+		else if (method == BVH_BUILD_BINNED)
+			bvh_.build_binned(pool, boxes.data(), size);
+		else
+			bvh_.build_morton(pool, boxes.data(), size);
+	};
+
+	inline const Bvh<T>& get_bvh() const { return bvh_; };
+
+	// boxes of the primitives as they are now
+	void get_boxes(thread::TaskPool& pool, memory::AlignedArray< AABB<T, 3> >& boxes) const
+	{
+		using namespace boost::placeholders;
+
+		boxes.resize(size_);
+		thread::parallel_for(pool, 0, size_, detail::BVH_GRAIN, boost::bind(&BvhScene::bounds_chunk, this, boxes.data(), _1, _2));
+	};
+
+	// after the primitives moved, boxes from get_boxes()
+	void refit(thread::TaskPool& pool, const AABB<T, 3>* boxes)
+	{
+		bvh_.refit(pool, boxes);
+	};
+
+	// swaps in bvh, built over older boxes of the same primitives, and refits it
+	void swap_bvh(thread::TaskPool& pool, const AABB<T, 3>* boxes, Bvh<T>& bvh)
+	{
+		bvh_.swap(bvh);
+		refit(pool, boxes);
+	};
+
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive, BvhTraversalStats* stats) const
+	{
+		detail::ClosestHit<T, P> leaf = { primitives_, &ray, &hit, NO_HIT };
+
+		hit.valid_ = false;
+		hit.distance_ = std::numeric_limits<T>::infinity();
+
+		bvh_.traverse(ray, std::numeric_limits<T>::max(), leaf, stats);
+
+		primitive = leaf.primitive_;
+		return hit.valid_;
+	};
+
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive) const
+	{
+		return closest_hit(ray, hit, primitive, 0);
+	};
+
+	// true if any primitive is hit closer than t_max, e.g. for shadow rays
+	bool occluded(const Ray<T, 4>& ray, T t_max, BvhTraversalStats* stats) const
+	{
+		detail::AnyHit<T, P> leaf = { primitives_, &ray };
+		return bvh_.traverse_any(ray, t_max, leaf, stats);
+	};
+
+	bool occluded(const Ray<T, 4>& ray, T t_max) const
+	{
+		return occluded(ray, t_max, 0);
+	};
+
+	// closest hits of the lanes in mask, the same as closest_hit() per lane; returns the lanes that hit
+	template<int N>
+	unsigned int closest_hit(const RayPacket<T, N>& rays, unsigned int mask, PacketHit<T, N>& hits, BvhTraversalStats* stats) const
+	{
+		detail::PacketClosestHit<T, P, N> leaf = { primitives_, &rays, &hits };
+
+		hits.clear();
+		bvh_.traverse(rays, mask, hits.distance_, leaf, stats);
+		hits.finish(primitives_, rays);
+
+		return hits.valid_;
+	};
+
+	template<int N>
+	unsigned int closest_hit(const RayPacket<T, N>& rays, unsigned int mask, PacketHit<T, N>& hits) const
+	{
+		return closest_hit(rays, mask, hits, 0);
+	};
+};
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_BVH__
@@ -0,0 +1,613 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Compact storage for Vector<float, S>, to keep large data sets small in
+ * memory and decode them on the fly:
+ *
+ *   HalfVector<S>			16 bit IEEE half floats, relative error <= 2^-11 for
+ *							|x| in [6.1e-5, 65504], absolute <= 2^-25 below
+ *   SnormVector<Q, S>		signed char/short in [-1, 1], absolute error <= 0.5/127 or 0.5/32767
+ *   UnormVector<Q, S>		unsigned char/short in [0, 1], absolute error <= 0.5/255 or 0.5/65535
+ *   OctahedralNormal		unit vectors in 32 bit, two snorm16 of the octahedral
+ *							projection, angular error <= 6.4e-5 rad (0.0037 degrees)
+ *
+ * Every type has encode() and decode() for a single vector, the free encode()
+ * and decode() overloads convert arrays. Half floats use F16C if available,
+ * the arrays of the other types SSE2.
+ */
+
+#if !defined(DEIMOS_MATH_COMPACT__)
+#define DEIMOS_MATH_COMPACT__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include "simd.h"
+#include "vector.h"
+
+namespace deimos {
+namespace math {
+
+namespace detail {
+
+	// IEEE 754 binary16, round to nearest even, NaN becomes a quiet NaN without payload
+	inline unsigned short float_to_half(float op)
+	{
+		unsigned int f;
+		std::memcpy(&f, &op, sizeof(f));
+
+		const unsigned int sign = (f >> 16) & 0x8000u;
+		f &= 0x7fffffffu;
+
+		unsigned int h;
+
+		// overflow to infinity, 65536 and above
+		if (f >= (143u << 23))
+			h = (f > 0x7f800000u) ? 0x7e00u : 0x7c00u;
+		// denormal half, let the float addition round the mantissa
+		else if (f < (113u << 23))
+		{
+			const unsigned int magic_bits = 126u << 23;
+			float magic, g;
+
+			std::memcpy(&magic, &magic_bits, sizeof(magic));
+			std::memcpy(&g, &f, sizeof(g));
+			g += magic;
+			std::memcpy(&h, &g, sizeof(h));
+
+			h -= magic_bits;
+		}
+		else
+		{
+			const unsigned int odd = (f >> 13) & 1;
+			h = (f + (static_cast<unsigned int>(15 - 127) << 23) + 0xfffu + odd) >> 13;
+		}
+
+		return static_cast<unsigned short>(h | sign);
+	}
+
+	inline float half_to_float(unsigned short op)
+	{
+		const unsigned int shifted_exp = 0x7c00u << 13;
+
+		unsigned int f = (op & 0x7fffu) << 13;
+		const unsigned int exp = f & shifted_exp;
+		f += (127u - 15u) << 23;
+
+		float res;
+
+		// infinity and NaN
+		if (exp == shifted_exp)
+			f += (128u - 16u) << 23;
+		// zero and denormals
+		else if (exp == 0)
+		{
+			const unsigned int magic_bits = 113u << 23;
+			float magic;
+
+			f += 1u << 23;
+			std::memcpy(&res, &f, sizeof(res));
+			std::memcpy(&magic, &magic_bits, sizeof(magic));
+			res -= magic;
+			std::memcpy(&f, &res, sizeof(f));
+		}
+
+		f |= static_cast<unsigned int>(op & 0x8000u) << 16;
+		std::memcpy(&res, &f, sizeof(res));
+		return res;
+	}
+
+	template<typename Q>
+	struct quantize_range;
+
+	template<> struct quantize_range<signed char>		{ static float max() { return 127.f; }		static float min() { return -1.f; } };
+	template<> struct quantize_range<short>				{ static float max() { return 32767.f; }	static float min() { return -1.f; } };
+	template<> struct quantize_range<unsigned char>		{ static float max() { return 255.f; }		static float min() { return 0.f; } };
+	template<> struct quantize_range<unsigned short>	{ static float max() { return 65535.f; }	static float min() { return 0.f; } };
+
+	template<typename Q>
+	inline Q quantize(float op)
+	{
+		typedef quantize_range<Q> R;
+
+		const float c = (op < R::min()) ? R::min() : (op > 1.f) ? 1.f : op;
+		return static_cast<Q>(std::floor(c * static_cast<double>(R::max()) + 0.5));
+	}
+
+	template<typename Q>
+	inline float dequantize(Q op)
+	{
+		typedef quantize_range<Q> R;
+
+		// -128 and -32768 map to -1 as well
+		const float f = op * (1.f / R::max());
+		return (f < R::min()) ? R::min() : f;
+	}
+
+	// x += (x >= 0) ? -t : t with t = max(-z, 0), folds the lower half of the octahedron
+	inline float octahedral_fold(float op, float t)
+	{
+		return (op >= 0) ? op - t : op + t;
+	}
+
+	template<typename Q, int S>
+	inline void quantize_vector(const Vector<float, S>& op, Q* res)
+	{
+		for (int i=0; i < S; ++i)
+			res[i] = quantize<Q>(op[i]);
+	}
+
+	template<typename Q, int S>
+	inline void dequantize_vector(const Q* op, Vector<float, S>& res)
+	{
+		for (int i=0; i < S; ++i)
+			res[i] = dequantize(op[i]);
+	}
+
+	template<int S>
+	inline void half_vector(const Vector<float, S>& op, unsigned short* res)
+	{
+		for (int i=0; i < S; ++i)
+			res[i] = float_to_half(op[i]);
+	}
+
+	template<int S>
+	inline void unhalf_vector(const unsigned short* op, Vector<float, S>& res)
+	{
+		for (int i=0; i < S; ++i)
+			res[i] = half_to_float(op[i]);
+	}
+
+#if defined(DEIMOS_SSE2)
+
+	// packing of four int lanes into Q and back, only the bytes of S components are touched
+	template<typename Q>
+	struct quantize_io;
+
+	template<>
+	struct quantize_io<short>
+	{
+		template<int S>
+		static inline void store(short* res, __m128i op)
+		{
+			const __m128i p = _mm_packs_epi32(op, op);
+			std::memcpy(res, &p, S * sizeof(short));
+		}
+
+		template<int S>
+		static inline __m128i load(const short* op)
+		{
+			__m128i p = _mm_setzero_si128();
+			std::memcpy(&p, op, S * sizeof(short));
+			return _mm_srai_epi32(_mm_unpacklo_epi16(p, p), 16);
+		}
+	};
+
+	template<>
+	struct quantize_io<unsigned short>
+	{
+		// biased into the signed range, SSE2 has no unsigned 32 bit pack
+		template<int S>
+		static inline void store(unsigned short* res, __m128i op)
+		{
+			const __m128i b = _mm_sub_epi32(op, _mm_set1_epi32(32768));
+			const __m128i p = _mm_xor_si128(_mm_packs_epi32(b, b), _mm_set1_epi16(-32768));
+			std::memcpy(res, &p, S * sizeof(unsigned short));
+		}
+
+		template<int S>
+		static inline __m128i load(const unsigned short* op)
+		{
+			__m128i p = _mm_setzero_si128();
+			std::memcpy(&p, op, S * sizeof(unsigned short));
+			return _mm_unpacklo_epi16(p, _mm_setzero_si128());
+		}
+	};
+
+	template<>
+	struct quantize_io<signed char>
+	{
+		template<int S>
+		static inline void store(signed char* res, __m128i op)
+		{
+			const __m128i p16 = _mm_packs_epi32(op, op);
+			const __m128i p = _mm_packs_epi16(p16, p16);
+			std::memcpy(res, &p, S * sizeof(signed char));
+		}
+
+		template<int S>
+		static inline __m128i load(const signed char* op)
+		{
+			__m128i p = _mm_setzero_si128();
+			std::memcpy(&p, op, S * sizeof(signed char));
+			p = _mm_unpacklo_epi8(p, p);
+			return _mm_srai_epi32(_mm_unpacklo_epi16(p, p), 24);
+		}
+	};
+
+	template<>
+	struct quantize_io<unsigned char>
+	{
+		template<int S>
+		static inline void store(unsigned char* res, __m128i op)
+		{
+			const __m128i p16 = _mm_packs_epi32(op, op);
+			const __m128i p = _mm_packus_epi16(p16, p16);
+			std::memcpy(res, &p, S * sizeof(unsigned char));
+		}
+
+		template<int S>
+		static inline __m128i load(const unsigned char* op)
+		{
+			__m128i p = _mm_setzero_si128();
+			std::memcpy(&p, op, S * sizeof(unsigned char));
+			p = _mm_unpacklo_epi8(p, _mm_setzero_si128());
+			return _mm_unpacklo_epi16(p, _mm_setzero_si128());
+		}
+	};
+
+	// float lanes to rounded integers, may differ by one step from the scalar version close to ties
+	template<typename Q>
+	inline __m128i quantize_lanes(__m128 op)
+	{
+		typedef quantize_range<Q> R;
+
+		const __m128 c = _mm_min_ps(_mm_max_ps(op, _mm_set1_ps(R::min())), _mm_set1_ps(1.f));
+		return _mm_cvtps_epi32(_mm_mul_ps(c, _mm_set1_ps(R::max())));
+	}
+
+	template<typename Q>
+	inline __m128 dequantize_lanes(__m128i op)
+	{
+		typedef quantize_range<Q> R;
+
+		const __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(op), _mm_set1_ps(1.f/R::max()));
+		return _mm_max_ps(f, _mm_set1_ps(R::min()));
+	}
+
+	template<typename Q>
+	inline void quantize_vector(const Vector<float, 3>& op, Q* res)
+	{
+		quantize_io<Q>::template store<3>(res, quantize_lanes<Q>(op.load()));
+	}
+
+	template<typename Q>
+	inline void quantize_vector(const Vector<float, 4>& op, Q* res)
+	{
+		quantize_io<Q>::template store<4>(res, quantize_lanes<Q>(op.load()));
+	}
+
+	template<typename Q>
+	inline void dequantize_vector(const Q* op, Vector<float, 3>& res)
+	{
+		res.store(dequantize_lanes<Q>(quantize_io<Q>::template load<3>(op)));
+	}
+
+	template<typename Q>
+	inline void dequantize_vector(const Q* op, Vector<float, 4>& res)
+	{
+		res.store(dequantize_lanes<Q>(quantize_io<Q>::template load<4>(op)));
+	}
+
+#endif // DEIMOS_SSE2
+
+#if defined(DEIMOS_F16C)
+
+	inline void half_vector(const Vector<float, 3>& op, unsigned short* res)
+	{
+		const __m128i h = _mm_cvtps_ph(op.load(), _MM_FROUND_TO_NEAREST_INT);
+		std::memcpy(res, &h, 3 * sizeof(unsigned short));
+	}
+
+	inline void half_vector(const Vector<float, 4>& op, unsigned short* res)
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(res), _mm_cvtps_ph(op.load(), _MM_FROUND_TO_NEAREST_INT));
+	}
+
+	inline void unhalf_vector(const unsigned short* op, Vector<float, 3>& res)
+	{
+		__m128i h = _mm_setzero_si128();
+		std::memcpy(&h, op, 3 * sizeof(unsigned short));
+		res.store(_mm_cvtph_ps(h));
+	}
+
+	inline void unhalf_vector(const unsigned short* op, Vector<float, 4>& res)
+	{
+		res.store(_mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(op))));
+	}
+
+#endif // DEIMOS_F16C
+
+} // namespace detail
+
+//-------------------------------------//
+
+template<int S>
+struct HalfVector
+{
+	typedef Vector<float, S> Vec;
+
+	unsigned short element_[S];
+
+	static inline HalfVector encode(const Vec& op)
+	{
+		HalfVector res;
+		detail::half_vector(op, res.element_);
+		return res;
+	};
+
+	inline Vec decode() const
+	{
+		Vec res = Vec();
+		detail::unhalf_vector(element_, res);
+		return res;
+	};
+};
+
+// Q is signed char or short
+template<typename Q, int S>
+struct SnormVector
+{
+	typedef Vector<float, S> Vec;
+
+	Q element_[S];
+
+	static inline SnormVector encode(const Vec& op)
+	{
+		SnormVector res;
+		detail::quantize_vector(op, res.element_);
+		return res;
+	};
+
+	inline Vec decode() const
+	{
+		Vec res = Vec();
+		detail::dequantize_vector(element_, res);
+		return res;
+	};
+};
+
+// Q is unsigned char or unsigned short
+template<typename Q, int S>
+struct UnormVector
+{
+	typedef Vector<float, S> Vec;
+
+	Q element_[S];
+
+	static inline UnormVector encode(const Vec& op)
+	{
+		UnormVector res;
+		detail::quantize_vector(op, res.element_);
+		return res;
+	};
+
+	inline Vec decode() const
+	{
+		Vec res = Vec();
+		detail::dequantize_vector(element_, res);
+		return res;
+	};
+};
+
+/*
+ * Unit vector projected onto the octahedron |x|+|y|+|z| = 1, the lower half
+ * folded over the upper one and the remaining square stored as two snorm16.
+ * Only the first three components of a vector are used, decode() gives a
+ * normalized vector with any further components zero.
+ */
+struct OctahedralNormal
+{
+	short element_[2];
+
+	template<int S>
+	static inline OctahedralNormal encode(const Vector<float, S>& op)
+	{
+		const float l1 = std::fabs(op[0]) + std::fabs(op[1]) + std::fabs(op[2]);
+		assert(l1 > 0);
+
+		float x = op[0] / l1;
+		float y = op[1] / l1;
+
+		if (op[2] < 0)
+		{
+			const float fx = (1.f - std::fabs(y)) * ((x >= 0) ? 1.f : -1.f);
+			const float fy = (1.f - std::fabs(x)) * ((y >= 0) ? 1.f : -1.f);
+			x = fx;
+			y = fy;
+		}
+
+		OctahedralNormal res;
+		res.element_[0] = detail::quantize<short>(x);
+		res.element_[1] = detail::quantize<short>(y);
+		return res;
+	};
+
+	template<int S>
+	inline void decode(Vector<float, S>& res) const
+	{
+		float x = detail::dequantize(element_[0]);
+		float y = detail::dequantize(element_[1]);
+		const float z = 1.f - std::fabs(x) - std::fabs(y);
+		const float t = (z < 0) ? -z : 0.f;
+
+		x = detail::octahedral_fold(x, t);
+		y = detail::octahedral_fold(y, t);
+
+		const float inv = 1.f / std::sqrt(x*x + y*y + z*z);
+
+		res.clear();
+		res[0] = x * inv;
+		res[1] = y * inv;
+		res[2] = z * inv;
+	};
+
+	inline Vector<float, 3> decode() const
+	{
+		Vector<float, 3> res;
+		decode(res);
+		return res;
+	};
+};
+
+//-------------------------------------//
+
+template<int S>
+void encode(const Vector<float, S>* src, HalfVector<S>* dst, std::size_t n)
+{
+	for (std::size_t i=0; i < n; ++i)
+		dst[i] = HalfVector<S>::encode(src[i]);
+}
+
+template<int S>
+void decode(const HalfVector<S>* src, Vector<float, S>* dst, std::size_t n)
+{
+	for (std::size_t i=0; i < n; ++i)
+		dst[i] = src[i].decode();
+}
+
+template<typename Q, int S>
+void encode(const Vector<float, S>* src, SnormVector<Q, S>* dst, std::size_t n)
+{
+	for (std::size_t i=0; i < n; ++i)
+		dst[i] = SnormVector<Q, S>::encode(src[i]);
+}
+
+template<typename Q, int S>
+void decode(const SnormVector<Q, S>* src, Vector<float, S>* dst, std::size_t n)
+{
+	for (std::size_t i=0; i < n; ++i)
+		dst[i] = src[i].decode();
+}
+
+template<typename Q, int S>
+void encode(const Vector<float, S>* src, UnormVector<Q, S>* dst, std::size_t n)
+{
+	for (std::size_t i=0; i < n; ++i)
+		dst[i] = UnormVector<Q, S>::encode(src[i]);
+}
+
+template<typename Q, int S>
+void decode(const UnormVector<Q, S>* src, Vector<float, S>* dst, std::size_t n)
+{
+	for (std::size_t i=0; i < n; ++i)
+		dst[i] = src[i].decode();
+}
+
+template<int S>
+void encode(const Vector<float, S>* src, OctahedralNormal* dst, std::size_t n)
+{
+	for (std::size_t i=0; i < n; ++i)
+		dst[i] = OctahedralNormal::encode(src[i]);
+}
+
+#if defined(DEIMOS_SSE2)
+
+namespace detail {
+
+	// four normals at once, the same arithmetic as OctahedralNormal::decode()
+	template<int S>
+	void decode_octahedral(const OctahedralNormal* src, Vector<float, S>* dst, std::size_t n)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+		std::size_t i = 0;
+
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+			__m128 x = dequantize_lanes<short>(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+			__m128 y = dequantize_lanes<short>(_mm_srai_epi32(v, 16));
+
+			const __m128 z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_and_ps(x, abs_mask)), _mm_and_ps(y, abs_mask));
+			const __m128 t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+
+			// x - t for x >= 0, x + t otherwise
+			x = _mm_add_ps(x, _mm_xor_ps(t, _mm_andnot_ps(_mm_cmplt_ps(x, zero), sign_mask)));
+			y = _mm_add_ps(y, _mm_xor_ps(t, _mm_andnot_ps(_mm_cmplt_ps(y, zero), sign_mask)));
+
+			const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+			const __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), len);
+
+			__m128 r0 = _mm_mul_ps(x, inv);
+			__m128 r1 = _mm_mul_ps(y, inv);
+			__m128 r2 = _mm_mul_ps(z, inv);
+			__m128 r3 = zero;
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			dst[i+0].store(r0);
+			dst[i+1].store(r1);
+			dst[i+2].store(r2);
+			dst[i+3].store(r3);
+		}
+
+		for (; i < n; ++i)
+			src[i].decode(dst[i]);
+	}
+
+} // namespace detail
+
+inline void decode(const OctahedralNormal* src, Vector<float, 3>* dst, std::size_t n)
+{
+	detail::decode_octahedral(src, dst, n);
+}
+
+inline void decode(const OctahedralNormal* src, Vector<float, 4>* dst, std::size_t n)
+{
+	detail::decode_octahedral(src, dst, n);
+}
+
+#endif // DEIMOS_SSE2
+
+template<int S>
+void decode(const OctahedralNormal* src, Vector<float, S>* dst, std::size_t n)
+{
+	for (std::size_t i=0; i < n; ++i)
+		src[i].decode(dst[i]);
+}
+
+#if defined(DEIMOS_F16C)
+
+// two vectors per conversion
+inline void encode(const Vector<float, 4>* src, HalfVector<4>* dst, std::size_t n)
+{
+	std::size_t i = 0;
+
+	for (; i + 2 <= n; i += 2)
+	{
+		const __m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(src[i].load()), src[i+1].load(), 1);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+	}
+
+	for (; i < n; ++i)
+		dst[i] = HalfVector<4>::encode(src[i]);
+}
+
+inline void decode(const HalfVector<4>* src, Vector<float, 4>* dst, std::size_t n)
+{
+	std::size_t i = 0;
+
+	for (; i + 2 <= n; i += 2)
+	{
+		const __m256 v = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+		dst[i].store(_mm256_castps256_ps128(v));
+		dst[i+1].store(_mm256_extractf128_ps(v, 1));
+	}
+
+	for (; i < n; ++i)
+		dst[i] = src[i].decode();
+}
+
+#endif // DEIMOS_F16C
+
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_COMPACT__
@@ -0,0 +1,51 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Language feature switches. The math headers still build as C++03, newer
+ * standards make them usable in constant expressions:
+ *
+ *   DEIMOS_CONSTEXPR         constexpr with C++14 (loops in constexpr functions)
+ *   DEIMOS_CONSTEXPR_DATA    constexpr tables with C++11, plain const before
+ *   DEIMOS_CONSTEXPR_BRANCH  constexpr for functions that take a SIMD or libm
+ *                            path at runtime, needs DEIMOS_IS_CONSTANT_EVALUATED
+ */
+
+#if !defined(DEIMOS_MATH_CONFIG__)
+#define DEIMOS_MATH_CONFIG__
+
+#if defined(_MSVC_LANG)
+	#define DEIMOS_CPLUSPLUS _MSVC_LANG
+#else
+	#define DEIMOS_CPLUSPLUS __cplusplus
+#endif
+
+#if DEIMOS_CPLUSPLUS >= 201103L
+	#define DEIMOS_CONSTEXPR_DATA constexpr
+#else
+	#define DEIMOS_CONSTEXPR_DATA const
+#endif
+
+#if DEIMOS_CPLUSPLUS >= 201402L
+	#define DEIMOS_HAS_CONSTEXPR
+	#define DEIMOS_CONSTEXPR constexpr
+#else
+	#define DEIMOS_CONSTEXPR
+#endif
+
+#if defined(DEIMOS_HAS_CONSTEXPR)
+	#if (defined(__GNUC__) && __GNUC__ >= 9) || (defined(__clang__) && __clang_major__ >= 9) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+		#define DEIMOS_HAS_CONSTEXPR_BRANCH
+	#endif
+#endif
+
+#if defined(DEIMOS_HAS_CONSTEXPR_BRANCH)
+	#define DEIMOS_CONSTEXPR_BRANCH constexpr
+	#define DEIMOS_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+	#define DEIMOS_CONSTEXPR_BRANCH
+	#define DEIMOS_IS_CONSTANT_EVALUATED() false
+#endif
+
+#endif // DEIMOS_MATH_CONFIG__
@@ -0,0 +1,379 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Piecewise cubic curves over scalar, Vector or Quaternion keys. Every
+ * segment between two keys is stored as the polynomial
+ *
+ *   p(u) = ((a u + b) u + c) u + d,  u = (t - t_i) / (t_i+1 - t_i)
+ *
+ * so evaluation is a key lookup and three multiply-adds, whatever the spline
+ * type was. Quaternion curves are normalized after evaluation, their keys are
+ * flipped onto one hemisphere first.
+ *
+ *   Curve<float> c = Curve<float>::catmull_rom(times, values, n);
+ *   Curve<float>::Cursor cursor;
+ *   for (float t = 0; t < end; t += dt)
+ *       v = c.evaluate(t, cursor);		// next segment found in O(1)
+ */
+
+#if !defined(DEIMOS_MATH_CURVE__)
+#define DEIMOS_MATH_CURVE__
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+#include "../memory/aligned_array.h"
+#include "packet.h"
+#include "quaternion.h"
+#include "vector.h"
+
+namespace deimos {
+namespace math {
+
+namespace detail {
+
+	template<typename K>
+	struct CurveSegment
+	{
+		K a_, b_, c_, d_;
+		float start_;
+		float inv_length_;
+
+		inline K evaluate(float t) const
+		{
+			const float u = (t - start_) * inv_length_;
+			return ((a_*u + b_)*u + c_)*u + d_;
+		};
+	};
+
+	// key types that need fixing before and after interpolation
+	template<typename K>
+	struct curve_key
+	{
+		static inline void prepare(const K* src, K* dst, std::size_t n)
+		{
+			std::copy(src, src + n, dst);
+		};
+
+		static inline void finish(K&) {};
+	};
+
+	template<typename T>
+	struct curve_key< Quaternion<T> >
+	{
+		// neighbouring keys on the same hemisphere, so the curve takes the shorter arc
+		static void prepare(const Quaternion<T>* src, Quaternion<T>* dst, std::size_t n)
+		{
+			for (std::size_t i=0; i < n; ++i)
+				dst[i] = (i && dst[i-1].dot(src[i]) < 0) ? -src[i] : src[i];
+		};
+
+		static inline void finish(Quaternion<T>& op)
+		{
+			op.normalize();
+		};
+	};
+
+	// many segments at once, lane i evaluates segs[i] at times[i]
+	template<typename K>
+	void evaluate_segments(const CurveSegment<K>* const* segs, const float* times, K* res, std::size_t n)
+	{
+		for (std::size_t i=0; i < n; ++i)
+		{
+			res[i] = segs[i]->evaluate(times[i]);
+			curve_key<K>::finish(res[i]);
+		}
+	}
+
+	// scalar curves eight lanes at a time
+	inline void evaluate_segments(const CurveSegment<float>* const* segs, const float* times, float* res, std::size_t n)
+	{
+		typedef ScalarPacket<float, 8> Scalar;
+
+		std::size_t i = 0;
+
+		for (; i + 8 <= n; i += 8)
+		{
+			Scalar a, b, c, d, u;
+
+			for (int l=0; l < 8; ++l)
+			{
+				const CurveSegment<float>& s = *segs[i+l];
+				a[l] = s.a_;
+				b[l] = s.b_;
+				c[l] = s.c_;
+				d[l] = s.d_;
+				u[l] = (times[i+l] - s.start_) * s.inv_length_;
+			}
+
+			const Scalar v = ((a*u + b)*u + c)*u + d;
+			std::copy(v.element_, v.element_ + 8, res + i);
+		}
+
+		for (; i < n; ++i)
+			res[i] = segs[i]->evaluate(times[i]);
+	}
+
+} // namespace detail
+
+//-------------------------------------//
+
+template<typename K>
+class Curve
+{
+public:
+	typedef K key_type;
+	typedef detail::CurveSegment<K> Segment;
+
+	// remembers the last segment, for lookups with slowly changing times
+	struct Cursor
+	{
+		std::size_t segment_;
+
+		Cursor() : segment_(0) {};
+	};
+
+protected:
+	memory::AlignedArray<float> times_;
+	memory::AlignedArray<Segment> segments_;
+
+	// cubic Hermite segment with tangents m0, m1 already scaled to the segment length
+	void add_hermite(float t0, float t1, const K& p0, const K& p1, const K& m0, const K& m1)
+	{
+		Segment s;
+		s.a_ = p0*2 - p1*2 + m0 + m1;
+		s.b_ = p1*3 - p0*3 - m0*2 - m1;
+		s.c_ = m0;
+		s.d_ = p0;
+		s.start_ = t0;
+		s.inv_length_ = 1.f/(t1 - t0);
+
+		segments_.push_back(s);
+	};
+
+	// a single key is a constant curve
+	void add_constant(float t, const K& p)
+	{
+		Segment s;
+		s.a_ = s.b_ = s.c_ = K();
+		s.d_ = p;
+		s.start_ = t;
+		s.inv_length_ = 0;
+
+		segments_.push_back(s);
+	};
+
+	void set_times(const float* times, std::size_t n)
+	{
+		assert(n > 0);
+
+		times_.resize(n);
+
+		for (std::size_t i=0; i < n; ++i)
+		{
+			assert(i == 0 || times[i] > times[i-1]);
+			times_[i] = times[i];
+		}
+
+		segments_.clear();
+		segments_.reserve(n > 1 ? n-1 : 1);
+	};
+
+public:
+	// n keys with tangents in key units per time unit
+	static Curve hermite(const float* times, const K* keys, const K* tangents, std::size_t n)
+	{
+		memory::AlignedArray<K> p(n);
+		detail::curve_key<K>::prepare(keys, p.data(), n);
+
+		Curve res;
+		res.set_times(times, n);
+
+		if (n == 1)
+			res.add_constant(times[0], p[0]);
+
+		for (std::size_t i=0; i+1 < n; ++i)
+		{
+			const float h = times[i+1] - times[i];
+			res.add_hermite(times[i], times[i+1], p[i], p[i+1], tangents[i]*h, tangents[i+1]*h);
+		}
+
+		return res;
+	};
+
+	// tangents from the neighbouring keys, one-sided at both ends
+	static Curve catmull_rom(const float* times, const K* keys, std::size_t n)
+	{
+		memory::AlignedArray<K> p(n);
+		detail::curve_key<K>::prepare(keys, p.data(), n);
+
+		memory::AlignedArray<K> tangents(n);
+
+		for (std::size_t i=0; i < n && n > 1; ++i)
+		{
+			const std::size_t prev = (i > 0) ? i-1 : i;
+			const std::size_t next = (i+1 < n) ? i+1 : i;
+			tangents[i] = (p[next] - p[prev]) * (1.f/(times[next] - times[prev]));
+		}
+
+		return hermite(times, p.data(), tangents.data(), n);
+	};
+
+	// n keys and 3(n-1)+1 control points, key i is points[3i]
+	static Curve bezier(const float* times, const K* points, std::size_t n)
+	{
+		const std::size_t m = (n > 1) ? 3*(n-1)+1 : 1;
+
+		memory::AlignedArray<K> p(m);
+		detail::curve_key<K>::prepare(points, p.data(), m);
+
+		Curve res;
+		res.set_times(times, n);
+
+		if (n == 1)
+			res.add_constant(times[0], p[0]);
+
+		for (std::size_t i=0; i+1 < n; ++i)
+		{
+			const K& p0 = p[3*i];
+			const K& c0 = p[3*i+1];
+			const K& c1 = p[3*i+2];
+			const K& p1 = p[3*i+3];
+
+			Segment s;
+			s.a_ = p1 - p0 + (c0 - c1)*3;
+			s.b_ = (p0 + c1)*3 - c0*6;
+			s.c_ = (c0 - p0)*3;
+			s.d_ = p0;
+			s.start_ = times[i];
+			s.inv_length_ = 1.f/(times[i+1] - times[i]);
+
+			res.segments_.push_back(s);
+		}
+
+		return res;
+	};
+
+	inline std::size_t num_segments() const	{ return segments_.size(); };
+	inline float start_time() const				{ return times_[0]; };
+	inline float end_time() const				{ return times_.back(); };
+
+	inline const Segment& segment(std::size_t n) const
+	{
+		return segments_[n];
+	};
+
+	// binary search, times outside the curve give the first or last segment
+	std::size_t find_segment(float t) const
+	{
+		const float* begin = times_.begin() + 1;
+		const float* end = times_.end() - 1;
+
+		if (begin >= end)
+			return 0;
+
+		return std::upper_bound(begin, end, t) - begin;
+	};
+
+	// the cursor's segment or one of its neighbours before falling back to the binary search
+	std::size_t find_segment(float t, Cursor& cursor) const
+	{
+		const std::size_t last = segments_.size() - 1;
+		std::size_t s = (cursor.segment_ > last) ? last : cursor.segment_;
+
+		const bool after_start = (s == 0 || t >= times_[s]);
+		const bool before_end = (s == last || t < times_[s+1]);
+
+		if (!(after_start && before_end))
+		{
+			if (after_start && s+1 <= last && (s+1 == last || t < times_[s+2]))
+				++s;
+			else
+				s = find_segment(t);
+		}
+
+		cursor.segment_ = s;
+		return s;
+	};
+
+	// times outside the curve are clamped
+	inline float clamp_time(float t) const
+	{
+		return (t < times_[0]) ? times_[0] : (t > times_.back()) ? times_.back() : t;
+	};
+
+	K evaluate(float t) const
+	{
+		t = clamp_time(t);
+
+		K res = segments_[find_segment(t)].evaluate(t);
+		detail::curve_key<K>::finish(res);
+		return res;
+	};
+
+	K evaluate(float t, Cursor& cursor) const
+	{
+		t = clamp_time(t);
+
+		K res = segments_[find_segment(t, cursor)].evaluate(t);
+		detail::curve_key<K>::finish(res);
+		return res;
+	};
+
+	// the curve at n times, ideally sorted
+	void evaluate(const float* times, K* res, std::size_t n) const
+	{
+		const std::size_t BLOCK = 64;
+
+		const Segment* segs[BLOCK];
+		float clamped[BLOCK];
+		Cursor cursor;
+
+		for (std::size_t i=0; i < n; i += BLOCK)
+		{
+			const std::size_t count = std::min(BLOCK, n - i);
+
+			for (std::size_t j=0; j < count; ++j)
+			{
+				clamped[j] = clamp_time(times[i+j]);
+				segs[j] = &segments_[find_segment(clamped[j], cursor)];
+			}
+
+			detail::evaluate_segments(segs, clamped, res + i, count);
+		}
+	};
+};
+
+// n curves at time t, cursors may be null
+template<typename K>
+void evaluate(const Curve<K>* curves, std::size_t n, float t, K* res, typename Curve<K>::Cursor* cursors = 0)
+{
+	const std::size_t BLOCK = 64;
+
+	const detail::CurveSegment<K>* segs[BLOCK];
+	float clamped[BLOCK];
+
+	for (std::size_t i=0; i < n; i += BLOCK)
+	{
+		const std::size_t count = std::min(BLOCK, n - i);
+
+		for (std::size_t j=0; j < count; ++j)
+		{
+			const Curve<K>& c = curves[i+j];
+			clamped[j] = c.clamp_time(t);
+
+			const std::size_t s = cursors ? c.find_segment(clamped[j], cursors[i+j]) : c.find_segment(clamped[j]);
+			segs[j] = &c.segment(s);
+		}
+
+		detail::evaluate_segments(segs, clamped, res + i, count);
+	}
+}
+
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_CURVE__
@@ -0,0 +1,778 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Dense matrices of run time size and the usual factorizations for solving
+ * linear systems and least squares problems:
+ *
+ *   gemm(alpha, a, b, beta, c)			c = alpha a b + beta c
+ *   lu_decompose(a, pivots)				PA = LU with partial pivoting
+ *   cholesky_decompose(a)				A = LL^T for symmetric positive definite A
+ *   qr_decompose(a, tau)					A = QR by Householder reflections
+ *   least_squares(a, b, x)				x minimizing |Ax - b|
+ *
+ * Rows are stored contiguously and padded to a cache line. The products run
+ * in cache blocks with a register blocked SIMD kernel, LU and Cholesky are
+ * blocked so that most of their work is such a product. The overloads taking
+ * a thread::TaskPool split the products and the trailing updates into row
+ * ranges that run in parallel.
+ *
+ * Factorizations overwrite their input and return false if the matrix is
+ * singular (LU, QR solve) or not positive definite (Cholesky).
+ */
+
+#if !defined(DEIMOS_MATH_DENSE_MATRIX__)
+#define DEIMOS_MATH_DENSE_MATRIX__
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include "../memory/aligned_array.h"
+#include "../thread/task_pool.h"
+#include "packet.h"
+
+namespace deimos {
+namespace math {
+
+// block size of the factorizations and the product
+const size_t DENSE_BLOCK = 64;
+const size_t GEMM_BLOCK_K = 256;
+const size_t GEMM_BLOCK_N = 512;
+
+// rows per task of the parallel overloads
+const size_t DENSE_GRAIN = 32;
+
+template<typename T>
+class DenseMatrix
+{
+protected:
+	size_t rows_, cols_, stride_;
+	memory::AlignedArray<T> element_;
+
+public:
+	typedef T value_type;
+
+	DenseMatrix() : rows_(0), cols_(0), stride_(0) {};
+
+	DenseMatrix(size_t rows, size_t cols, T op = T()) : rows_(0), cols_(0), stride_(0)
+	{
+		resize(rows, cols, op);
+	};
+
+	// the content is not kept
+	void resize(size_t rows, size_t cols, T op = T())
+	{
+		const size_t line = memory::CACHE_LINE / sizeof(T);
+
+		rows_ = rows;
+		cols_ = cols;
+		stride_ = ((cols + line - 1) / line) * line;
+
+		element_.clear();
+		element_.resize(rows_ * stride_, op);
+	};
+
+	inline size_t rows() const		{ return rows_; };
+	inline size_t cols() const		{ return cols_; };
+
+	// distance between two rows in elements
+	inline size_t stride() const	{ return stride_; };
+
+	inline T* row(size_t n)
+	{
+		assert(n < rows_);
+		return element_.data() + n * stride_;
+	};
+
+	inline const T* row(size_t n) const
+	{
+		assert(n < rows_);
+		return element_.data() + n * stride_;
+	};
+
+	inline T& operator()(size_t r, size_t c)
+	{
+		assert(r < rows_ && c < cols_);
+		return element_[r * stride_ + c];
+	};
+
+	inline const T& operator()(size_t r, size_t c) const
+	{
+		assert(r < rows_ && c < cols_);
+		return element_[r * stride_ + c];
+	};
+
+	void clear(T op = 0)
+	{
+		for (size_t r=0; r < rows_; ++r)
+			std::fill(row(r), row(r) + cols_, op);
+	};
+
+	static DenseMatrix identity(size_t n)
+	{
+		DenseMatrix res(n, n);
+
+		for (size_t i=0; i < n; ++i)
+			res(i, i) = 1;
+
+		return res;
+	};
+
+	DenseMatrix transpose() const
+	{
+		DenseMatrix res(cols_, rows_);
+
+		// in tiles, so both sides are read and written a few cache lines at a time
+		for (size_t r0=0; r0 < rows_; r0 += DENSE_BLOCK)
+			for (size_t c0=0; c0 < cols_; c0 += DENSE_BLOCK)
+				for (size_t r=r0; r < std::min(r0 + DENSE_BLOCK, rows_); ++r)
+					for (size_t c=c0; c < std::min(c0 + DENSE_BLOCK, cols_); ++c)
+						res(c, r) = (*this)(r, c);
+
+		return res;
+	};
+
+	DenseMatrix operator+(const DenseMatrix& op) const
+	{
+		assert(rows_ == op.rows_ && cols_ == op.cols_);
+
+		DenseMatrix res(*this);
+
+		for (size_t r=0; r < rows_; ++r)
+			for (size_t c=0; c < cols_; ++c)
+				res(r, c) += op(r, c);
+
+		return res;
+	};
+
+	DenseMatrix operator-(const DenseMatrix& op) const
+	{
+		assert(rows_ == op.rows_ && cols_ == op.cols_);
+
+		DenseMatrix res(*this);
+
+		for (size_t r=0; r < rows_; ++r)
+			for (size_t c=0; c < cols_; ++c)
+				res(r, c) -= op(r, c);
+
+		return res;
+	};
+
+	DenseMatrix operator*(T op) const
+	{
+		DenseMatrix res(*this);
+		res *= op;
+		return res;
+	};
+
+	void operator*=(T op)
+	{
+		for (size_t r=0; r < rows_; ++r)
+			for (size_t c=0; c < cols_; ++c)
+				(*this)(r, c) *= op;
+	};
+
+	DenseMatrix operator*(const DenseMatrix& op) const;
+};
+
+//-------------------------------------//
+
+namespace detail {
+
+	template<typename T>
+	struct dense_lanes
+	{
+		enum { width = packet_width<T, 8>::value };
+		typedef lanes<T, width> L;
+	};
+
+	// y += a x
+	template<typename T>
+	void axpy(T a, const T* x, T* y, size_t n)
+	{
+		typedef typename dense_lanes<T>::L L;
+		const size_t W = dense_lanes<T>::width;
+
+		const typename L::reg va = L::set1(a);
+		size_t i = 0;
+
+		for (; i + W <= n; i += W)
+			L::store(y + i, L::add(L::load(y + i), L::mul(va, L::load(x + i))));
+
+		for (; i < n; ++i)
+			y[i] += a * x[i];
+	}
+
+	/*
+	 * c[0..R) += alpha a b for R rows of c with nc columns and a depth of kc.
+	 * R rows of c are held in registers while a column block of b streams by.
+	 */
+	template<typename T, int R>
+	void gemm_kernel(T alpha, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc, size_t nc, size_t kc)
+	{
+		typedef typename dense_lanes<T>::L L;
+		typedef typename L::reg reg;
+		const size_t W = dense_lanes<T>::width;
+
+		size_t j = 0;
+
+		for (; j + W <= nc; j += W)
+		{
+			reg acc[R];
+
+			for (int r=0; r < R; ++r)
+				acc[r] = L::load(c + r*ldc + j);
+
+			for (size_t p=0; p < kc; ++p)
+			{
+				const reg bp = L::load(b + p*ldb + j);
+
+				for (int r=0; r < R; ++r)
+					acc[r] = L::add(acc[r], L::mul(L::set1(alpha * a[r*lda + p]), bp));
+			}
+
+			for (int r=0; r < R; ++r)
+				L::store(c + r*ldc + j, acc[r]);
+		}
+
+		for (; j < nc; ++j)
+			for (int r=0; r < R; ++r)
+			{
+				T sum = 0;
+
+				for (size_t p=0; p < kc; ++p)
+					sum += a[r*lda + p] * b[p*ldb + j];
+
+				c[r*ldc + j] += alpha * sum;
+			}
+	}
+
+	// c += alpha a b on raw row-major blocks, rows [first, last) of c
+	template<typename T>
+	void gemm_rows(T alpha, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+				   size_t n, size_t k, size_t first, size_t last)
+	{
+		for (size_t kk=0; kk < k; kk += GEMM_BLOCK_K)
+		{
+			const size_t kc = std::min(GEMM_BLOCK_K, k - kk);
+
+			for (size_t jj=0; jj < n; jj += GEMM_BLOCK_N)
+			{
+				const size_t nc = std::min(GEMM_BLOCK_N, n - jj);
+				const T* bb = b + kk*ldb + jj;
+
+				size_t i = first;
+
+				for (; i + 4 <= last; i += 4)
+					gemm_kernel<T, 4>(alpha, a + i*lda + kk, lda, bb, ldb, c + i*ldc + jj, ldc, nc, kc);
+
+				for (; i < last; ++i)
+					gemm_kernel<T, 1>(alpha, a + i*lda + kk, lda, bb, ldb, c + i*ldc + jj, ldc, nc, kc);
+			}
+		}
+	}
+
+	template<typename T>
+	struct GemmTask
+	{
+		T alpha_;
+		const T* a_; size_t lda_;
+		const T* b_; size_t ldb_;
+		T* c_; size_t ldc_;
+		size_t n_, k_;
+
+		void operator()(size_t first, size_t last) const
+		{
+			gemm_rows(alpha_, a_, lda_, b_, ldb_, c_, ldc_, n_, k_, first, last);
+		};
+	};
+
+	// m x n block of c += alpha a b, in parallel if a pool is given
+	template<typename T>
+	void gemm_block(thread::TaskPool* pool, T alpha, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+					size_t m, size_t n, size_t k)
+	{
+		if (!m || !n || !k)
+			return;
+
+		GemmTask<T> task = { alpha, a, lda, b, ldb, c, ldc, n, k };
+
+		if (pool)
+			thread::parallel_for(*pool, 0, m, DENSE_GRAIN, task);
+		else
+			task(0, m);
+	}
+
+	template<typename T>
+	void gemm(thread::TaskPool* pool, T alpha, const DenseMatrix<T>& a, const DenseMatrix<T>& b, T beta, DenseMatrix<T>& c)
+	{
+		assert(a.cols() == b.rows() && c.rows() == a.rows() && c.cols() == b.cols());
+		assert(&c != &a && &c != &b);
+
+		// as in BLAS, c is not read for beta 0, so NaN or garbage in it doesn't reach the result
+		if (beta == 0)
+			c.clear();
+		else if (beta != 1)
+			c *= beta;
+
+		if (!a.rows())
+			return;
+
+		gemm_block(pool, alpha, a.row(0), a.stride(), b.row(0), b.stride(), c.row(0), c.stride(), c.rows(), c.cols(), a.cols());
+	}
+
+	//-------------------------------------//
+
+	template<typename T>
+	bool lu_decompose(thread::TaskPool* pool, DenseMatrix<T>& a, std::vector<size_t>& pivots)
+	{
+		assert(a.rows() == a.cols());
+
+		const size_t n = a.rows();
+		const size_t ld = a.stride();
+		bool regular = true;
+
+		pivots.resize(n);
+
+		for (size_t k0=0; k0 < n; k0 += DENSE_BLOCK)
+		{
+			const size_t k1 = std::min(k0 + DENSE_BLOCK, n);
+
+			// factorize the panel of columns [k0, k1), swapping whole rows
+			for (size_t k=k0; k < k1; ++k)
+			{
+				size_t p = k;
+
+				for (size_t i=k+1; i < n; ++i)
+					if (std::abs(a(i, k)) > std::abs(a(p, k)))
+						p = i;
+
+				pivots[k] = p;
+
+				if (p != k)
+					std::swap_ranges(a.row(k), a.row(k) + n, a.row(p));
+
+				if (a(k, k) == 0)
+				{
+					regular = false;
+					continue;
+				}
+
+				const T inv = 1 / a(k, k);
+
+				for (size_t i=k+1; i < n; ++i)
+				{
+					T& l = a(i, k);
+					l *= inv;
+					axpy(-l, a.row(k) + k+1, a.row(i) + k+1, k1 - (k+1));
+				}
+			}
+
+			if (k1 == n)
+				break;
+
+			// U12 = L11^-1 A12
+			for (size_t k=k0; k < k1; ++k)
+				for (size_t i=k+1; i < k1; ++i)
+					axpy(-a(i, k), a.row(k) + k1, a.row(i) + k1, n - k1);
+
+			// A22 -= L21 U12
+			gemm_block(pool, T(-1), a.row(k1) + k0, ld, a.row(k0) + k1, ld, a.row(k1) + k1, ld, n - k1, n - k1, k1 - k0);
+		}
+
+		return regular;
+	}
+
+	// row i of the trailing block, L21 = A21 L11^-T
+	template<typename T>
+	struct CholeskyPanelTask
+	{
+		DenseMatrix<T>* a_;
+		size_t k0_, k1_;
+
+		void operator()(size_t first, size_t last) const
+		{
+			DenseMatrix<T>& a = *a_;
+
+			for (size_t i=first; i < last; ++i)
+				for (size_t j=k0_; j < k1_; ++j)
+				{
+					T sum = a(i, j);
+
+					for (size_t p=k0_; p < j; ++p)
+						sum -= a(i, p) * a(j, p);
+
+					a(i, j) = sum / a(j, j);
+				}
+		};
+	};
+
+	// A22 -= L21 L21^T on and below the diagonal; the transposed panel is in lt
+	template<typename T>
+	struct CholeskyUpdateTask
+	{
+		DenseMatrix<T>* a_;
+		const DenseMatrix<T>* lt_;
+		size_t k0_, k1_;
+
+		void operator()(size_t first, size_t last) const
+		{
+			DenseMatrix<T>& a = *a_;
+			const size_t k1 = k1_;
+
+			// rows [first, last) need the columns up to last
+			gemm_rows(T(-1), a.row(k1) + k0_, a.stride(), lt_->row(0), lt_->stride(), a.row(k1) + k1, a.stride(),
+					  last, k1 - k0_, first, last);
+		};
+	};
+
+	template<typename T>
+	bool cholesky_decompose(thread::TaskPool* pool, DenseMatrix<T>& a)
+	{
+		assert(a.rows() == a.cols());
+
+		const size_t n = a.rows();
+
+		for (size_t k0=0; k0 < n; k0 += DENSE_BLOCK)
+		{
+			const size_t k1 = std::min(k0 + DENSE_BLOCK, n);
+
+			// diagonal block
+			for (size_t j=k0; j < k1; ++j)
+			{
+				T d = a(j, j);
+
+				for (size_t p=k0; p < j; ++p)
+					d -= a(j, p) * a(j, p);
+
+				if (!(d > 0))
+					return false;
+
+				a(j, j) = std::sqrt(d);
+
+				for (size_t i=j+1; i < k1; ++i)
+				{
+					T sum = a(i, j);
+
+					for (size_t p=k0; p < j; ++p)
+						sum -= a(i, p) * a(j, p);
+
+					a(i, j) = sum / a(j, j);
+				}
+			}
+
+			if (k1 == n)
+				break;
+
+			CholeskyPanelTask<T> panel = { &a, k0, k1 };
+
+			if (pool)
+				thread::parallel_for(*pool, k1, n, DENSE_GRAIN, panel);
+			else
+				panel(k1, n);
+
+			DenseMatrix<T> lt(k1 - k0, n - k1);
+
+			for (size_t i=k1; i < n; ++i)
+				for (size_t p=k0; p < k1; ++p)
+					lt(p - k0, i - k1) = a(i, p);
+
+			CholeskyUpdateTask<T> update = { &a, &lt, k0, k1 };
+
+			if (pool)
+				thread::parallel_for(*pool, 0, n - k1, DENSE_GRAIN, update);
+			else
+				update(0, n - k1);
+		}
+
+		// only L is kept
+		for (size_t i=0; i < n; ++i)
+			std::fill(a.row(i) + i+1, a.row(i) + n, T(0));
+
+		return true;
+	}
+
+	// H = I - tau v v^T applied to columns [first, last) of rows [k, m) of b, v in column k of qr
+	template<typename T>
+	void apply_householder(const DenseMatrix<T>& qr, size_t k, T tau, DenseMatrix<T>& b, size_t first, size_t last)
+	{
+		if (tau == 0 || first >= last)
+			return;
+
+		const size_t m = qr.rows();
+		const size_t n = last - first;
+
+		std::vector<T> w(b.row(k) + first, b.row(k) + last);
+
+		for (size_t i=k+1; i < m; ++i)
+			axpy(qr(i, k), b.row(i) + first, &w[0], n);
+
+		axpy(-tau, &w[0], b.row(k) + first, n);
+
+		for (size_t i=k+1; i < m; ++i)
+			axpy(-tau * qr(i, k), &w[0], b.row(i) + first, n);
+	}
+
+	template<typename T>
+	struct HouseholderTask
+	{
+		const DenseMatrix<T>* qr_;
+		DenseMatrix<T>* b_;
+		size_t k_;
+		T tau_;
+
+		void operator()(size_t first, size_t last) const
+		{
+			apply_householder(*qr_, k_, tau_, *b_, first, last);
+		};
+	};
+
+	template<typename T>
+	void qr_decompose(thread::TaskPool* pool, DenseMatrix<T>& a, std::vector<T>& tau)
+	{
+		const size_t m = a.rows();
+		const size_t n = a.cols();
+		const size_t steps = std::min(m, n);
+
+		assert(m >= n);
+
+		tau.assign(steps, T(0));
+
+		for (size_t k=0; k < steps; ++k)
+		{
+			T norm = 0;
+
+			for (size_t i=k; i < m; ++i)
+				norm += a(i, k) * a(i, k);
+
+			norm = std::sqrt(norm);
+
+			if (norm == 0)
+				continue;
+
+			const T x0 = a(k, k);
+			const T beta = (x0 >= 0) ? -norm : norm;
+			const T scale = 1 / (x0 - beta);
+
+			for (size_t i=k+1; i < m; ++i)
+				a(i, k) *= scale;
+
+			tau[k] = (beta - x0) / beta;
+			a(k, k) = beta;
+
+			HouseholderTask<T> task = { &a, &a, k, tau[k] };
+
+			// columns are independent, split them into cache line sized groups
+			if (pool && n - (k+1) > DENSE_BLOCK)
+				thread::parallel_for(*pool, k+1, n, DENSE_BLOCK, task);
+			else
+				task(k+1, n);
+		}
+	}
+
+} // namespace detail
+
+//-------------------------------------//
+
+// c = alpha a b + beta c, c is only read if beta is not 0
+template<typename T>
+void gemm(T alpha, const DenseMatrix<T>& a, const DenseMatrix<T>& b, T beta, DenseMatrix<T>& c)
+{
+	detail::gemm<T>(0, alpha, a, b, beta, c);
+}
+
+template<typename T>
+void gemm(thread::TaskPool& pool, T alpha, const DenseMatrix<T>& a, const DenseMatrix<T>& b, T beta, DenseMatrix<T>& c)
+{
+	detail::gemm<T>(&pool, alpha, a, b, beta, c);
+}
+
+template<typename T>
+DenseMatrix<T> DenseMatrix<T>::operator*(const DenseMatrix<T>& op) const
+{
+	DenseMatrix<T> res(rows_, op.cols_);
+	gemm(T(1), *this, op, T(0), res);
+	return res;
+}
+
+// in place, L below the diagonal with an implicit unit diagonal, U on and above it
+template<typename T>
+bool lu_decompose(DenseMatrix<T>& a, std::vector<size_t>& pivots)
+{
+	return detail::lu_decompose<T>(0, a, pivots);
+}
+
+template<typename T>
+bool lu_decompose(thread::TaskPool& pool, DenseMatrix<T>& a, std::vector<size_t>& pivots)
+{
+	return detail::lu_decompose<T>(&pool, a, pivots);
+}
+
+// b is overwritten by the solution of A x = b for all columns of b
+template<typename T>
+void lu_solve(const DenseMatrix<T>& lu, const std::vector<size_t>& pivots, DenseMatrix<T>& b)
+{
+	const size_t n = lu.rows();
+	const size_t nrhs = b.cols();
+
+	assert(b.rows() == n && pivots.size() == n);
+
+	for (size_t k=0; k < n; ++k)
+		if (pivots[k] != k)
+			std::swap_ranges(b.row(k), b.row(k) + nrhs, b.row(pivots[k]));
+
+	for (size_t i=1; i < n; ++i)
+		for (size_t k=0; k < i; ++k)
+			detail::axpy(-lu(i, k), b.row(k), b.row(i), nrhs);
+
+	for (size_t i=n; i-- > 0;)
+	{
+		for (size_t k=i+1; k < n; ++k)
+			detail::axpy(-lu(i, k), b.row(k), b.row(i), nrhs);
+
+		const T inv = 1 / lu(i, i);
+
+		for (size_t c=0; c < nrhs; ++c)
+			b(i, c) *= inv;
+	}
+}
+
+// in place, L on and below the diagonal, zeros above
+template<typename T>
+bool cholesky_decompose(DenseMatrix<T>& a)
+{
+	return detail::cholesky_decompose<T>(0, a);
+}
+
+template<typename T>
+bool cholesky_decompose(thread::TaskPool& pool, DenseMatrix<T>& a)
+{
+	return detail::cholesky_decompose<T>(&pool, a);
+}
+
+template<typename T>
+void cholesky_solve(const DenseMatrix<T>& l, DenseMatrix<T>& b)
+{
+	const size_t n = l.rows();
+	const size_t nrhs = b.cols();
+
+	assert(b.rows() == n);
+
+	// L y = b
+	for (size_t i=0; i < n; ++i)
+	{
+		for (size_t k=0; k < i; ++k)
+			detail::axpy(-l(i, k), b.row(k), b.row(i), nrhs);
+
+		const T inv = 1 / l(i, i);
+
+		for (size_t c=0; c < nrhs; ++c)
+			b(i, c) *= inv;
+	}
+
+	// L^T x = y, row i of L^T is column i of L
+	for (size_t i=n; i-- > 0;)
+	{
+		const T inv = 1 / l(i, i);
+
+		for (size_t c=0; c < nrhs; ++c)
+			b(i, c) *= inv;
+
+		for (size_t k=0; k < i; ++k)
+			detail::axpy(-l(i, k), b.row(i), b.row(k), nrhs);
+	}
+}
+
+// in place for rows >= cols, R on and above the diagonal, the Householder vectors below it
+template<typename T>
+void qr_decompose(DenseMatrix<T>& a, std::vector<T>& tau)
+{
+	detail::qr_decompose<T>(0, a, tau);
+}
+
+template<typename T>
+void qr_decompose(thread::TaskPool& pool, DenseMatrix<T>& a, std::vector<T>& tau)
+{
+	detail::qr_decompose<T>(&pool, a, tau);
+}
+
+// least squares solution of A x = b, the first cols(A) rows of b hold x afterwards
+template<typename T>
+bool qr_solve(const DenseMatrix<T>& qr, const std::vector<T>& tau, DenseMatrix<T>& b)
+{
+	const size_t n = qr.cols();
+	const size_t nrhs = b.cols();
+
+	assert(b.rows() == qr.rows());
+
+	// Q^T b
+	for (size_t k=0; k < tau.size(); ++k)
+		detail::apply_householder(qr, k, tau[k], b, 0, nrhs);
+
+	// R x = Q^T b
+	for (size_t i=n; i-- > 0;)
+	{
+		for (size_t k=i+1; k < n; ++k)
+			detail::axpy(-qr(i, k), b.row(k), b.row(i), nrhs);
+
+		if (qr(i, i) == 0)
+			return false;
+
+		const T inv = 1 / qr(i, i);
+
+		for (size_t c=0; c < nrhs; ++c)
+			b(i, c) *= inv;
+	}
+
+	return true;
+}
+
+// x minimizing |A x - b| for every column of b, A has at least as many rows as columns
+template<typename T>
+bool least_squares(const DenseMatrix<T>& a, const DenseMatrix<T>& b, DenseMatrix<T>& x)
+{
+	DenseMatrix<T> qr(a), y(b);
+	std::vector<T> tau;
+
+	qr_decompose(qr, tau);
+
+	if (!qr_solve(qr, tau, y))
+		return false;
+
+	x.resize(a.cols(), b.cols());
+
+	for (size_t i=0; i < a.cols(); ++i)
+		std::copy(y.row(i), y.row(i) + b.cols(), x.row(i));
+
+	return true;
+}
+
+template<typename T>
+bool least_squares(thread::TaskPool& pool, const DenseMatrix<T>& a, const DenseMatrix<T>& b, DenseMatrix<T>& x)
+{
+	DenseMatrix<T> qr(a), y(b);
+	std::vector<T> tau;
+
+	qr_decompose(pool, qr, tau);
+
+	if (!qr_solve(qr, tau, y))
+		return false;
+
+	x.resize(a.cols(), b.cols());
+
+	for (size_t i=0; i < a.cols(); ++i)
+		std::copy(y.row(i), y.row(i) + b.cols(), x.row(i));
+
+	return true;
+}
+
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_DENSE_MATRIX__
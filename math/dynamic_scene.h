@@ -0,0 +1,179 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Scenes of moving primitives. update() after every step of a simulation
+ * refits the tree to the new boxes, which is much cheaper than a build but
+ * makes the tree worse the farther the primitives get from where it was
+ * built. Once its SAH cost has grown by the threshold, a new tree is built
+ * on a thread of its own from a copy of the boxes; queries keep using the
+ * refit tree until a later update() swaps in the new one:
+ *
+ *   DynamicScene< BvhScene< float, Sphere<float, 4> > > scene(spheres, count, pool);
+ *
+ *   for (;;)
+ *   {
+ *       step(spheres);
+ *       scene.update();
+ *       caster.cast(scene, camera, 640, 480, hits);
+ *   }
+ *
+ * S is a BvhScene, TriangleBlockScene, MeshScene or SphereBlockScene. Like
+ * moving the primitives, update() must not run while queries do.
+ */
+
+#if !defined(DEIMOS_MATH_DYNAMIC_SCENE__)
+#define DEIMOS_MATH_DYNAMIC_SCENE__
+
+#include <algorithm>
+#include <cstddef>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "../memory/aligned_array.h"
+#include "../thread/task_pool.h"
+#include "aabb.h"
+#include "bvh.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+// update() starts a new build once get_degradation() of the tree exceeds this
+const double BVH_REBUILD_THRESHOLD = 1.5;
+
+/*
+ * Builds a Bvh in the background. The build is binned and serial, it
+ * never takes tasks of the pool from the queries.
+ */
+template<typename T>
+class BvhRebuild
+{
+protected:
+	memory::AlignedArray< AABB<T, 3> > boxes_;
+	Bvh<T> bvh_;
+
+	boost::scoped_ptr<boost::thread> thread_;
+	boost::mutex mutex_;
+	bool done_;
+
+	BvhRebuild(const BvhRebuild&);
+	BvhRebuild& operator=(const BvhRebuild&);
+
+	void run()
+	{
+		thread::TaskPool pool(0);
+		bvh_.build_binned(pool, boxes_.data(), boxes_.size());
+
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		done_ = true;
+	}
+
+public:
+	BvhRebuild() : done_(false) {};
+
+	~BvhRebuild()
+	{
+		if (thread_)
+			thread_->join();
+	};
+
+	inline bool is_running() const { return thread_.get() != 0; };
+
+	// builds over a copy of the n boxes, false if a build is still running
+	bool start(const AABB<T, 3>* boxes, size_t n)
+	{
+		if (thread_)
+			return false;
+
+		boxes_.resize(n);
+		std::copy(boxes, boxes + n, boxes_.data());
+
+		done_ = false;
+		thread_.reset(new boost::thread(boost::bind(&BvhRebuild::run, this)));
+
+		return true;
+	};
+
+	// swaps the new tree into bvh once it is done, false until then
+	bool finish(Bvh<T>& bvh)
+	{
+		if (!thread_)
+			return false;
+
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+
+			if (!done_)
+				return false;
+		}
+
+		thread_->join();
+		thread_.reset();
+
+		bvh.swap(bvh_);
+		bvh_.clear();
+
+		return true;
+	};
+};
+
+template<class S>
+class DynamicScene : public S
+{
+public:
+	typedef typename S::value_type value_type;
+
+protected:
+	thread::TaskPool& pool_;
+	memory::AlignedArray< AABB<value_type, 3> > boxes_;
+	BvhRebuild<value_type> rebuild_;
+	double threshold_;
+
+	DynamicScene(const DynamicScene&);
+	DynamicScene& operator=(const DynamicScene&);
+
+public:
+	// triangles or spheres, as for S
+	template<class P>
+	DynamicScene(const P* primitives, size_t size, thread::TaskPool& pool, double threshold = BVH_REBUILD_THRESHOLD) :
+		S(primitives, size, pool), pool_(pool), threshold_(threshold)
+	{};
+
+	// an IndexedMesh for MeshScene
+	template<class M>
+	DynamicScene(const M& mesh, thread::TaskPool& pool, double threshold = BVH_REBUILD_THRESHOLD) :
+		S(mesh, pool), pool_(pool), threshold_(threshold)
+	{};
+
+	inline bool is_rebuilding() const		{ return rebuild_.is_running(); };
+	inline double get_threshold() const		{ return threshold_; };
+	inline void set_threshold(double op)	{ threshold_ = op; };
+
+	// after the primitives moved, true if a new tree took over
+	bool update()
+	{
+		S::get_boxes(pool_, boxes_);
+
+		Bvh<value_type> bvh;
+		const bool rebuilt = rebuild_.finish(bvh);
+
+		if (rebuilt)
+			S::swap_bvh(pool_, boxes_.data(), bvh);
+		else
+			S::refit(pool_, boxes_.data());
+
+		if (!rebuild_.is_running() && S::get_bvh().get_degradation() > threshold_)
+			rebuild_.start(boxes_.data(), boxes_.size());
+
+		return rebuilt;
+	};
+};
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_DYNAMIC_SCENE__
@@ -0,0 +1,365 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Lazy evaluation of Vector and Matrix arithmetic. Wrapping an operand with
+ * lazy() turns +, -, scalar * and scalar / into expression templates that
+ * are evaluated element by element in one loop once they are assigned:
+ *
+ *   Vector<float, 4> r = lazy(a)*s + lazy(b)*t - c;
+ *   assign(r, lazy(a)*s + b);	// writes r directly, r may appear on the right
+ *
+ * Every element goes through the same operations as with the eager
+ * operators (x / s is x * (1/s) in both cases), so results are bit-identical.
+ * Expressions hold references to their operands and must not outlive them.
+ */
+
+#if !defined(DEIMOS_MATH_EXPRESSION__)
+#define DEIMOS_MATH_EXPRESSION__
+
+#include "vector.h"
+#include "matrix.h"
+
+namespace deimos {
+namespace math {
+
+namespace detail {
+
+	// keeps scalars out of template argument deduction, so s may be a double literal
+	template<typename T>
+	struct identity
+	{
+		typedef T type;
+	};
+
+} // namespace detail
+
+//-------------------------------------//
+
+// base of all vector expressions, E provides element access with operator[]
+template<class E, typename T, int S>
+struct vec_expr
+{
+	typedef Vector<T, S> Vec;
+
+	const E& self() const
+	{
+		return static_cast<const E&>(*this);
+	};
+
+	Vec eval() const
+	{
+		Vec res;
+
+		for (int i=0; i < S; ++i)
+			res.element_[i] = self()[i];
+
+		return res;
+	};
+
+	operator Vec() const
+	{
+		return eval();
+	};
+};
+
+template<typename T, int S>
+struct vec_ref : public vec_expr<vec_ref<T, S>, T, S>
+{
+	const Vector<T, S>& op_;
+
+	explicit vec_ref(const Vector<T, S>& op) : op_(op) {};
+
+	T operator[](int i) const
+	{
+		return op_.element_[i];
+	};
+};
+
+template<class L, class R, typename T, int S>
+struct vec_add : public vec_expr<vec_add<L, R, T, S>, T, S>
+{
+	L op1_;
+	R op2_;
+
+	vec_add(const L& op1, const R& op2) : op1_(op1), op2_(op2) {};
+
+	T operator[](int i) const
+	{
+		return op1_[i] + op2_[i];
+	};
+};
+
+template<class L, class R, typename T, int S>
+struct vec_sub : public vec_expr<vec_sub<L, R, T, S>, T, S>
+{
+	L op1_;
+	R op2_;
+
+	vec_sub(const L& op1, const R& op2) : op1_(op1), op2_(op2) {};
+
+	T operator[](int i) const
+	{
+		return op1_[i] - op2_[i];
+	};
+};
+
+template<class E, typename T, int S>
+struct vec_scale : public vec_expr<vec_scale<E, T, S>, T, S>
+{
+	E op_;
+	T scale_;
+
+	vec_scale(const E& op, T scale) : op_(op), scale_(scale) {};
+
+	T operator[](int i) const
+	{
+		return op_[i] * scale_;
+	};
+};
+
+template<typename T, int S>
+vec_ref<T, S> lazy(const Vector<T, S>& op)
+{
+	return vec_ref<T, S>(op);
+}
+
+// expression + expression, expression + vector, vector + expression
+template<class L, class R, typename T, int S>
+vec_add<L, R, T, S> operator+(const vec_expr<L, T, S>& op1, const vec_expr<R, T, S>& op2)
+{
+	return vec_add<L, R, T, S>(op1.self(), op2.self());
+}
+
+template<class L, typename T, int S>
+vec_add<L, vec_ref<T, S>, T, S> operator+(const vec_expr<L, T, S>& op1, const Vector<T, S>& op2)
+{
+	return vec_add<L, vec_ref<T, S>, T, S>(op1.self(), vec_ref<T, S>(op2));
+}
+
+template<class R, typename T, int S>
+vec_add<vec_ref<T, S>, R, T, S> operator+(const Vector<T, S>& op1, const vec_expr<R, T, S>& op2)
+{
+	return vec_add<vec_ref<T, S>, R, T, S>(vec_ref<T, S>(op1), op2.self());
+}
+
+template<class L, class R, typename T, int S>
+vec_sub<L, R, T, S> operator-(const vec_expr<L, T, S>& op1, const vec_expr<R, T, S>& op2)
+{
+	return vec_sub<L, R, T, S>(op1.self(), op2.self());
+}
+
+template<class L, typename T, int S>
+vec_sub<L, vec_ref<T, S>, T, S> operator-(const vec_expr<L, T, S>& op1, const Vector<T, S>& op2)
+{
+	return vec_sub<L, vec_ref<T, S>, T, S>(op1.self(), vec_ref<T, S>(op2));
+}
+
+template<class R, typename T, int S>
+vec_sub<vec_ref<T, S>, R, T, S> operator-(const Vector<T, S>& op1, const vec_expr<R, T, S>& op2)
+{
+	return vec_sub<vec_ref<T, S>, R, T, S>(vec_ref<T, S>(op1), op2.self());
+}
+
+template<class E, typename T, int S>
+vec_scale<E, T, S> operator*(const vec_expr<E, T, S>& op, typename detail::identity<T>::type scale)
+{
+	return vec_scale<E, T, S>(op.self(), scale);
+}
+
+template<class E, typename T, int S>
+vec_scale<E, T, S> operator*(typename detail::identity<T>::type scale, const vec_expr<E, T, S>& op)
+{
+	return vec_scale<E, T, S>(op.self(), scale);
+}
+
+template<class E, typename T, int S>
+vec_scale<E, T, S> operator/(const vec_expr<E, T, S>& op, typename detail::identity<T>::type scale)
+{
+	return vec_scale<E, T, S>(op.self(), 1/scale);
+}
+
+// evaluates into dst without a temporary, dst may be used inside the expression
+template<class E, typename T, int S>
+Vector<T, S>& assign(Vector<T, S>& dst, const vec_expr<E, T, S>& op)
+{
+	for (int i=0; i < S; ++i)
+		dst.element_[i] = op.self()[i];
+
+	return dst;
+}
+
+// inner product, evaluated with the eager operator so the summation order matches
+template<class L, class R, typename T, int S>
+T dot(const vec_expr<L, T, S>& op1, const vec_expr<R, T, S>& op2)
+{
+	return op1.eval() * op2.eval();
+}
+
+//-------------------------------------//
+
+// base of all matrix expressions, E provides element access with operator()(row, column)
+template<class E, typename T, int S>
+struct mat_expr
+{
+	typedef Matrix<T, S> Mat;
+
+	const E& self() const
+	{
+		return static_cast<const E&>(*this);
+	};
+
+	Mat eval() const
+	{
+		Mat res;
+
+		for (int i=0; i < S; ++i)
+			for (int j=0; j < S; ++j)
+				res.row_[i].element_[j] = self()(i, j);
+
+		return res;
+	};
+
+	operator Mat() const
+	{
+		return eval();
+	};
+};
+
+template<typename T, int S>
+struct mat_ref : public mat_expr<mat_ref<T, S>, T, S>
+{
+	const Matrix<T, S>& op_;
+
+	explicit mat_ref(const Matrix<T, S>& op) : op_(op) {};
+
+	T operator()(int i, int j) const
+	{
+		return op_.row_[i].element_[j];
+	};
+};
+
+template<class L, class R, typename T, int S>
+struct mat_add : public mat_expr<mat_add<L, R, T, S>, T, S>
+{
+	L op1_;
+	R op2_;
+
+	mat_add(const L& op1, const R& op2) : op1_(op1), op2_(op2) {};
+
+	T operator()(int i, int j) const
+	{
+		return op1_(i, j) + op2_(i, j);
+	};
+};
+
+template<class L, class R, typename T, int S>
+struct mat_sub : public mat_expr<mat_sub<L, R, T, S>, T, S>
+{
+	L op1_;
+	R op2_;
+
+	mat_sub(const L& op1, const R& op2) : op1_(op1), op2_(op2) {};
+
+	T operator()(int i, int j) const
+	{
+		return op1_(i, j) - op2_(i, j);
+	};
+};
+
+template<class E, typename T, int S>
+struct mat_scale : public mat_expr<mat_scale<E, T, S>, T, S>
+{
+	E op_;
+	T scale_;
+
+	mat_scale(const E& op, T scale) : op_(op), scale_(scale) {};
+
+	T operator()(int i, int j) const
+	{
+		return op_(i, j) * scale_;
+	};
+};
+
+template<typename T, int S>
+mat_ref<T, S> lazy(const Matrix<T, S>& op)
+{
+	return mat_ref<T, S>(op);
+}
+
+template<class L, class R, typename T, int S>
+mat_add<L, R, T, S> operator+(const mat_expr<L, T, S>& op1, const mat_expr<R, T, S>& op2)
+{
+	return mat_add<L, R, T, S>(op1.self(), op2.self());
+}
+
+template<class L, typename T, int S>
+mat_add<L, mat_ref<T, S>, T, S> operator+(const mat_expr<L, T, S>& op1, const Matrix<T, S>& op2)
+{
+	return mat_add<L, mat_ref<T, S>, T, S>(op1.self(), mat_ref<T, S>(op2));
+}
+
+template<class R, typename T, int S>
+mat_add<mat_ref<T, S>, R, T, S> operator+(const Matrix<T, S>& op1, const mat_expr<R, T, S>& op2)
+{
+	return mat_add<mat_ref<T, S>, R, T, S>(mat_ref<T, S>(op1), op2.self());
+}
+
+template<class L, class R, typename T, int S>
+mat_sub<L, R, T, S> operator-(const mat_expr<L, T, S>& op1, const mat_expr<R, T, S>& op2)
+{
+	return mat_sub<L, R, T, S>(op1.self(), op2.self());
+}
+
+template<class L, typename T, int S>
+mat_sub<L, mat_ref<T, S>, T, S> operator-(const mat_expr<L, T, S>& op1, const Matrix<T, S>& op2)
+{
+	return mat_sub<L, mat_ref<T, S>, T, S>(op1.self(), mat_ref<T, S>(op2));
+}
+
+template<class R, typename T, int S>
+mat_sub<mat_ref<T, S>, R, T, S> operator-(const Matrix<T, S>& op1, const mat_expr<R, T, S>& op2)
+{
+	return mat_sub<mat_ref<T, S>, R, T, S>(mat_ref<T, S>(op1), op2.self());
+}
+
+template<class E, typename T, int S>
+mat_scale<E, T, S> operator*(const mat_expr<E, T, S>& op, typename detail::identity<T>::type scale)
+{
+	return mat_scale<E, T, S>(op.self(), scale);
+}
+
+template<class E, typename T, int S>
+mat_scale<E, T, S> operator*(typename detail::identity<T>::type scale, const mat_expr<E, T, S>& op)
+{
+	return mat_scale<E, T, S>(op.self(), scale);
+}
+
+template<class E, typename T, int S>
+mat_scale<E, T, S> operator/(const mat_expr<E, T, S>& op, typename detail::identity<T>::type scale)
+{
+	return mat_scale<E, T, S>(op.self(), 1/scale);
+}
+
+template<class E, typename T, int S>
+Matrix<T, S>& assign(Matrix<T, S>& dst, const mat_expr<E, T, S>& op)
+{
+	for (int i=0; i < S; ++i)
+		for (int j=0; j < S; ++j)
+			dst.row_[i].element_[j] = op.self()(i, j);
+
+	return dst;
+}
+
+// matrix times vector expression, the vector is evaluated once
+template<class E, typename T, int S>
+Vector<T, S> operator*(const Matrix<T, S>& op1, const vec_expr<E, T, S>& op2)
+{
+	return op1 * op2.eval();
+}
+
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_EXPRESSION__
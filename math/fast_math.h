@@ -0,0 +1,493 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Approximations of sqrt, 1/sqrt, sin, cos, acos, atan2, exp2, log2 and pow,
+ * as scalar templates and as SSE versions for four floats. Maximum errors
+ * measured over the given ranges against the double precision libm, float
+ * inputs:
+ *
+ *   rsqrt	x > 0				relative 2.5e-7 (SSE), exact otherwise
+ *   sqrt	x >= 0				relative 2.7e-7 (SSE), exact otherwise
+ *   sin	|x| <= 8192			absolute 7.8e-8
+ *   cos	|x| <= 8192			absolute 7.7e-8
+ *   acos	-1 <= x <= 1		absolute 4.3e-7
+ *   atan2	all finite x, y		absolute 2.7e-7
+ *   exp2	-126 <= x <= 127	relative 9.5e-8
+ *   log2	normalized x > 0	absolute 6.1e-8 for |log2 x| <= 1, relative 7.0e-8 otherwise
+ *   pow	exp2(y log2 x)		relative error grows with |y log2 x|
+ *
+ * For double arguments the same polynomials are evaluated in double precision,
+ * their error stays about that of the float versions (sin 2.7e-9, acos 2.2e-8).
+ * exp2 clamps to the float exponent range for both.
+ *
+ * exact_math and fast_math select the implementation at compile time, code
+ * that can use either takes one of them as a template parameter or a tag:
+ *
+ *   v.normalize(fast_math());
+ *   T a = M::acos(c);
+ */
+
+#if !defined(DEIMOS_MATH_FAST_MATH__)
+#define DEIMOS_MATH_FAST_MATH__
+
+#include <cmath>
+
+#include <boost/math/special_functions/sign.hpp>
+
+#include "simd.h"
+
+namespace deimos {
+namespace math {
+namespace fast {
+
+namespace detail {
+
+	// pi/2 split into parts that are exact in float, for the range reduction of sin and cos
+	const float PIO2_1 = 1.5703125f;
+	const float PIO2_2 = 4.837512969970703125e-4f;
+	const float PIO2_3 = 7.54978995489188216e-8f;
+	const float TWO_OVER_PI = 0.636619772367581343f;
+
+	// minimax polynomials on [-pi/4, pi/4]
+	template<typename T>
+	inline T sin_poly(T x)
+	{
+		const T z = x*x;
+		return ((T(-1.9515295891e-4)*z + T(8.3321608736e-3))*z - T(1.6666654611e-1))*z*x + x;
+	}
+
+	template<typename T>
+	inline T cos_poly(T x)
+	{
+		const T z = x*x;
+		return ((T(2.443315711809948e-5)*z - T(1.388731625493765e-3))*z + T(4.166664568298827e-2))*z*z - T(0.5)*z + T(1);
+	}
+
+	// x = r + q pi/2 with |r| <= pi/4
+	template<typename T>
+	inline T reduce(T x, int& q)
+	{
+		const T k = static_cast<T>(std::floor(x*T(TWO_OVER_PI) + T(0.5)));
+		q = static_cast<int>(k);
+		return ((x - k*T(PIO2_1)) - k*T(PIO2_2)) - k*T(PIO2_3);
+	}
+
+	// atan on the full range, reduced to |x| <= tan(pi/8)
+	template<typename T>
+	inline T atan(T x)
+	{
+		const T a = (x < 0) ? -x : x;
+		T r = a, y = 0;
+
+		if (a > T(2.414213562373095))
+		{
+			r = -1/a;
+			y = T(1.5707963267948966);
+		}
+		else if (a > T(0.4142135623730950))
+		{
+			r = (a-1)/(a+1);
+			y = T(0.7853981633974483);
+		}
+
+		const T z = r*r;
+		y += (((T(8.05374449538e-2)*z - T(1.38776856032e-1))*z + T(1.99777106478e-1))*z - T(3.33329491539e-1))*z*r + r;
+
+		return boost::math::signbit(x) ? -y : y;
+	}
+
+} // namespace detail
+
+template<typename T>
+inline T rsqrt(T op)
+{
+	return static_cast<T>(1/std::sqrt(op));
+}
+
+template<typename T>
+inline T sqrt(T op)
+{
+	return static_cast<T>(std::sqrt(op));
+}
+
+template<typename T>
+inline T sin(T op)
+{
+	int q;
+	const T r = detail::reduce(op, q);
+
+	switch (q & 3)
+	{
+		case 0:		return detail::sin_poly(r);
+		case 1:		return detail::cos_poly(r);
+		case 2:		return -detail::sin_poly(r);
+		default:	return -detail::cos_poly(r);
+	}
+}
+
+template<typename T>
+inline T cos(T op)
+{
+	int q;
+	const T r = detail::reduce(op, q);
+
+	switch (q & 3)
+	{
+		case 0:		return detail::cos_poly(r);
+		case 1:		return -detail::sin_poly(r);
+		case 2:		return -detail::cos_poly(r);
+		default:	return detail::sin_poly(r);
+	}
+}
+
+// Abramowitz & Stegun 4.4.46
+template<typename T>
+inline T acos(T op)
+{
+	const T a = (op < 0) ? -op : op;
+
+	T p = T(-0.0012624911);
+	p = p*a + T(0.0066700901);
+	p = p*a - T(0.0170881256);
+	p = p*a + T(0.0308918810);
+	p = p*a - T(0.0501743046);
+	p = p*a + T(0.0889789874);
+	p = p*a - T(0.2145988016);
+	p = p*a + T(1.5707963050);
+	p *= static_cast<T>(std::sqrt(1 - a));
+
+	return (op < 0) ? T(3.14159265358979323846) - p : p;
+}
+
+// signed zeros as std::atan2: -0 for y flips the result to -pi, -0 for x turns 0 into pi
+template<typename T>
+inline T atan2(T y, T x)
+{
+	if (x == 0)
+	{
+		if (y > 0)
+			return T(1.5707963267948966);
+
+		if (y < 0)
+			return T(-1.5707963267948966);
+
+		if (!boost::math::signbit(x))
+			return y;
+
+		return boost::math::signbit(y) ? T(-3.14159265358979323846) : T(3.14159265358979323846);
+	}
+
+	const T a = detail::atan(y/x);
+
+	if (x > 0)
+		return a;
+
+	return boost::math::signbit(y) ? a - T(3.14159265358979323846) : a + T(3.14159265358979323846);
+}
+
+template<typename T>
+inline T exp2(T op)
+{
+	const T x = (op < -126) ? T(-126) : (op > 127) ? T(127) : op;
+
+	const T n = static_cast<T>(std::floor(x + T(0.5)));
+	const T f = x - n;
+
+	const T p = (((((T(1.535336188319500e-4)*f + T(1.339887440266574e-3))*f + T(9.618437357674640e-3))*f +
+					T(5.550332471162809e-2))*f + T(2.402264791363012e-1))*f + T(6.931472028550421e-1))*f + 1;
+
+	return static_cast<T>(std::ldexp(p, static_cast<int>(n)));
+}
+
+template<typename T>
+inline T log2(T op)
+{
+	int e;
+	T m = static_cast<T>(std::frexp(op, &e));
+
+	// m in [sqrt(1/2), sqrt(2)) - 1
+	if (m < T(0.70710678118654752440))
+	{
+		--e;
+		m = m + m - 1;
+	}
+	else
+		m = m - 1;
+
+	const T z = m*m;
+
+	T y = T(7.0376836292e-2);
+	y = y*m - T(1.1514610310e-1);
+	y = y*m + T(1.1676998740e-1);
+	y = y*m - T(1.2420140846e-1);
+	y = y*m + T(1.4249322787e-1);
+	y = y*m - T(1.6668057665e-1);
+	y = y*m + T(2.0000714765e-1);
+	y = y*m - T(2.4999993993e-1);
+	y = y*m + T(3.3333331174e-1);
+	y = y*m*z - T(0.5)*z;
+
+	const T log2ea = T(0.44269504088896340736);
+	return y*log2ea + m*log2ea + y + m + e;
+}
+
+// op > 0
+template<typename T>
+inline T pow(T op, T exponent)
+{
+	return exp2(exponent * log2(op));
+}
+
+#if defined(DEIMOS_SSE2)
+
+// 12 bit hardware estimate and one Newton-Raphson step
+inline __m128 rsqrt(__m128 op)
+{
+	const __m128 r = _mm_rsqrt_ps(op);
+	const __m128 rr_op = _mm_mul_ps(_mm_mul_ps(r, r), op);
+	return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r), _mm_sub_ps(_mm_set1_ps(3.f), rr_op));
+}
+
+inline float rsqrt(float op)
+{
+	return _mm_cvtss_f32(rsqrt(_mm_set_ss(op)));
+}
+
+// op * rsqrt(op), zero stays zero
+inline __m128 sqrt(__m128 op)
+{
+	const __m128 nonzero = _mm_cmpgt_ps(op, _mm_setzero_ps());
+	return _mm_and_ps(_mm_mul_ps(op, rsqrt(op)), nonzero);
+}
+
+inline float sqrt(float op)
+{
+	return _mm_cvtss_f32(sqrt(_mm_set_ss(op)));
+}
+
+namespace detail {
+
+	inline __m128 abs(__m128 op)
+	{
+		return _mm_and_ps(op, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+	}
+
+	inline __m128 sign(__m128 op)
+	{
+		return _mm_and_ps(op, _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+	}
+
+	inline __m128 select(__m128 mask, __m128 op1, __m128 op2)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, op1), _mm_andnot_ps(mask, op2));
+	}
+
+	inline __m128 sin_poly(__m128 x)
+	{
+		const __m128 z = _mm_mul_ps(x, x);
+		__m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), z), _mm_set1_ps(8.3321608736e-3f));
+		p = _mm_sub_ps(_mm_mul_ps(p, z), _mm_set1_ps(1.6666654611e-1f));
+		return _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, z), x), x);
+	}
+
+	inline __m128 cos_poly(__m128 x)
+	{
+		const __m128 z = _mm_mul_ps(x, x);
+		__m128 p = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), z), _mm_set1_ps(1.388731625493765e-3f));
+		p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(4.166664568298827e-2f));
+		p = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(p, z), z), _mm_mul_ps(_mm_set1_ps(0.5f), z));
+		return _mm_add_ps(p, _mm_set1_ps(1.f));
+	}
+
+	// quadrant in q, see reduce() above
+	inline __m128 reduce(__m128 x, __m128i& q)
+	{
+		q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+		const __m128 k = _mm_cvtepi32_ps(q);
+
+		__m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(PIO2_1)));
+		r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(PIO2_2)));
+		return _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(PIO2_3)));
+	}
+
+	// odd quadrants take the cosine polynomial, quadrants 2 and 3 are negated
+	inline __m128 sin_quadrant(__m128 r, __m128i q)
+	{
+		const __m128i one = _mm_set1_epi32(1);
+		const __m128 use_cos = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+		const __m128 negate = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+
+		return _mm_xor_ps(select(use_cos, cos_poly(r), sin_poly(r)), negate);
+	}
+
+	inline __m128 atan(__m128 x)
+	{
+		const __m128 a = abs(x);
+		const __m128 one = _mm_set1_ps(1.f);
+
+		const __m128 big = _mm_cmpgt_ps(a, _mm_set1_ps(2.414213562373095f));
+		const __m128 mid = _mm_andnot_ps(big, _mm_cmpgt_ps(a, _mm_set1_ps(0.4142135623730950f)));
+
+		__m128 r = select(mid, _mm_div_ps(_mm_sub_ps(a, one), _mm_add_ps(a, one)), a);
+		r = select(big, _mm_div_ps(_mm_set1_ps(-1.f), a), r);
+
+		__m128 y = _mm_and_ps(mid, _mm_set1_ps(0.7853981633974483f));
+		y = select(big, _mm_set1_ps(1.5707963267948966f), y);
+
+		const __m128 z = _mm_mul_ps(r, r);
+		__m128 p = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(8.05374449538e-2f), z), _mm_set1_ps(1.38776856032e-1f));
+		p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(1.99777106478e-1f));
+		p = _mm_sub_ps(_mm_mul_ps(p, z), _mm_set1_ps(3.33329491539e-1f));
+		y = _mm_add_ps(y, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, z), r), r));
+
+		return _mm_xor_ps(y, sign(x));
+	}
+
+} // namespace detail
+
+inline __m128 sin(__m128 op)
+{
+	__m128i q;
+	const __m128 r = detail::reduce(op, q);
+	return detail::sin_quadrant(r, q);
+}
+
+inline __m128 cos(__m128 op)
+{
+	__m128i q;
+	const __m128 r = detail::reduce(op, q);
+	return detail::sin_quadrant(r, _mm_add_epi32(q, _mm_set1_epi32(1)));
+}
+
+inline __m128 acos(__m128 op)
+{
+	const __m128 a = detail::abs(op);
+
+	__m128 p = _mm_set1_ps(-0.0012624911f);
+	p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0066700901f));
+	p = _mm_sub_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0170881256f));
+	p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0308918810f));
+	p = _mm_sub_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0501743046f));
+	p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0889789874f));
+	p = _mm_sub_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.2145988016f));
+	p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(1.5707963050f));
+	p = _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.f), a)));
+
+	const __m128 negative = _mm_cmplt_ps(op, _mm_setzero_ps());
+	return detail::select(negative, _mm_sub_ps(_mm_set1_ps(3.14159265358979323846f), p), p);
+}
+
+inline __m128 atan2(__m128 y, __m128 x)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 x_zero = _mm_cmpeq_ps(x, zero);
+
+	// x == +-0 gives atan(+-inf) = +-pi/2 by the sign of y alone
+	__m128 a = detail::atan(_mm_div_ps(y, _mm_andnot_ps(x_zero, x)));
+
+	// x < 0: add pi with the sign of y, other lanes keep the sign of a zero a
+	const __m128 pi = _mm_or_ps(_mm_set1_ps(3.14159265358979323846f), detail::sign(y));
+	a = detail::select(_mm_cmplt_ps(x, zero), _mm_add_ps(a, pi), a);
+
+	// 0/0 is 0 or pi by the sign of x, with the sign of y
+	const __m128 x_negative = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(x), 31));
+	const __m128 z = _mm_or_ps(_mm_and_ps(x_negative, _mm_set1_ps(3.14159265358979323846f)), detail::sign(y));
+
+	return detail::select(_mm_and_ps(x_zero, _mm_cmpeq_ps(y, zero)), z, a);
+}
+
+inline __m128 exp2(__m128 op)
+{
+	const __m128 x = _mm_min_ps(_mm_max_ps(op, _mm_set1_ps(-126.f)), _mm_set1_ps(127.f));
+
+	const __m128i n = _mm_cvtps_epi32(x);
+	const __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(n));
+
+	__m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(1.535336188319500e-4f), f), _mm_set1_ps(1.339887440266574e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.618437357674640e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.550332471162809e-2f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.402264791363012e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.931472028550421e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.f));
+
+	// 2^n built in the exponent bits
+	const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+	return _mm_mul_ps(p, scale);
+}
+
+inline __m128 log2(__m128 op)
+{
+	const __m128i bits = _mm_castps_si128(op);
+
+	// op = m 2^e with m in [0.5, 1)
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f000000)));
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 small = _mm_cmplt_ps(m, _mm_set1_ps(0.70710678118654752440f));
+
+	e = _mm_sub_ps(e, _mm_and_ps(small, one));
+	m = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(small, m)), one);
+
+	const __m128 z = _mm_mul_ps(m, m);
+
+	__m128 y = _mm_set1_ps(7.0376836292e-2f);
+	y = _mm_sub_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.1514610310e-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.1676998740e-1f));
+	y = _mm_sub_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.2420140846e-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.4249322787e-1f));
+	y = _mm_sub_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.6668057665e-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(2.0000714765e-1f));
+	y = _mm_sub_ps(_mm_mul_ps(y, m), _mm_set1_ps(2.4999993993e-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(3.3333331174e-1f));
+	y = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(y, m), z), _mm_mul_ps(_mm_set1_ps(0.5f), z));
+
+	const __m128 log2ea = _mm_set1_ps(0.44269504088896340736f);
+	return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(y, log2ea), _mm_mul_ps(m, log2ea)), y), m), e);
+}
+
+inline __m128 pow(__m128 op, __m128 exponent)
+{
+	return exp2(_mm_mul_ps(exponent, log2(op)));
+}
+
+#endif // DEIMOS_SSE2
+
+} // namespace fast
+
+//-------------------------------------//
+
+// libm, the default everywhere
+struct exact_math
+{
+	template<typename T> static inline T sqrt(T op)				{ return static_cast<T>(std::sqrt(op)); }
+	template<typename T> static inline T rsqrt(T op)			{ return static_cast<T>(1/std::sqrt(op)); }
+	template<typename T> static inline T sin(T op)				{ return static_cast<T>(std::sin(op)); }
+	template<typename T> static inline T cos(T op)				{ return static_cast<T>(std::cos(op)); }
+	template<typename T> static inline T acos(T op)				{ return static_cast<T>(std::acos(op)); }
+	template<typename T> static inline T atan2(T y, T x)		{ return static_cast<T>(std::atan2(y, x)); }
+	template<typename T> static inline T exp2(T op)				{ return static_cast<T>(std::pow(T(2), op)); }
+	template<typename T> static inline T log2(T op)				{ return static_cast<T>(std::log(op) * 1.44269504088896340736); }
+	template<typename T> static inline T pow(T op, T exponent)	{ return static_cast<T>(std::pow(op, exponent)); }
+};
+
+// the approximations above
+struct fast_math
+{
+	template<typename T> static inline T sqrt(T op)				{ return fast::sqrt(op); }
+	template<typename T> static inline T rsqrt(T op)			{ return fast::rsqrt(op); }
+	template<typename T> static inline T sin(T op)				{ return fast::sin(op); }
+	template<typename T> static inline T cos(T op)				{ return fast::cos(op); }
+	template<typename T> static inline T acos(T op)				{ return fast::acos(op); }
+	template<typename T> static inline T atan2(T y, T x)		{ return fast::atan2(y, x); }
+	template<typename T> static inline T exp2(T op)				{ return fast::exp2(op); }
+	template<typename T> static inline T log2(T op)				{ return fast::log2(op); }
+	template<typename T> static inline T pow(T op, T exponent)	{ return fast::pow(op, exponent); }
+};
+
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_FAST_MATH__
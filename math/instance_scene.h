@@ -0,0 +1,283 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Two level scenes: objects with a tree of their own are placed any number
+ * of times with an affine Matrix<T, 4>, and a top level Bvh over the world
+ * boxes of these instances finds the ones a ray passes. Rays are moved into
+ * object space instead of the objects into world space, so rigid motion
+ * only costs a build() of the top level:
+ *
+ *   MeshScene<float, 8> bunny(mesh, pool);
+ *   InstanceScene< float, MeshScene<float, 8> > scene;
+ *   scene.add(bunny, m0);
+ *   scene.add(bunny, m1);
+ *   scene.build();
+ *   scene.closest_hit(ray, hit, instance, face);
+ *
+ *   scene.set_transform(1, m2);
+ *   scene.build();
+ *
+ * S is a BvhScene, TriangleBlockScene, MeshScene or a DynamicScene of them;
+ * after its update() the top level has to be built again as well. The
+ * objects must outlive the scene.
+ */
+
+#if !defined(DEIMOS_MATH_INSTANCE_SCENE__)
+#define DEIMOS_MATH_INSTANCE_SCENE__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "../memory/aligned_array.h"
+#include "../thread/task_pool.h"
+#include "aabb.h"
+#include "bvh.h"
+#include "intersect.h"
+#include "matrix.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "transform.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+template<typename T, class S>
+struct SceneInstance
+{
+	const S* object_;
+	Matrix<T, 4> transform_;		// object to world space
+	Matrix<T, 4> inverse_;			// world to object space
+	Matrix<T, 4> normal_;			// normals from object to world space
+
+	void set_transform(const Matrix<T, 4>& op)
+	{
+		transform_ = op;
+		inverse_ = invert_affine(op);
+		normal_ = normal_matrix(op);
+	};
+
+	// ray in object space with a direction of length 1, distances along it are scale times those in world space
+	Ray<T, 4> object_ray(const Ray<T, 4>& ray, T& scale) const
+	{
+		Ray<T, 4> res;
+		res.origin_ = inverse_ * ray.origin_;
+		res.direction_ = inverse_ * ray.direction_;
+
+		scale = std::sqrt(res.direction_.size_sqr());
+		res.direction_ *= 1/scale;
+
+		return res;
+	};
+
+	// hit p of object_ray() in world space
+	intersection_point<T> world_hit(const Ray<T, 4>& ray, const intersection_point<T>& p, T scale) const
+	{
+		intersection_point<T> res;
+		res.distance_ = p.distance_ / scale;
+		res.pos_ = ray.get_point_on_ray(res.distance_);
+		res.normal_ = normal_ * p.normal_;
+		res.normal_[3] = 0;
+		res.normal_.normalize();
+		res.valid_ = true;
+
+		return res;
+	};
+
+	// the object box in world space, around its transformed corners
+	AABB<T, 3> world_bounds() const
+	{
+		const AABB<T, 3>& box = object_->get_bvh().get_bounds();
+		AABB<T, 3> res = AABB<T, 3>::empty();
+
+		if (box.is_empty())
+			return res;
+
+		for (int k=0; k < 8; ++k)
+		{
+			Vector<T, 4> corner;
+			corner[0] = (k & 1) ? box.max_[0] : box.min_[0];
+			corner[1] = (k & 2) ? box.max_[1] : box.min_[1];
+			corner[2] = (k & 4) ? box.max_[2] : box.min_[2];
+			corner[3] = 1;
+
+			const Vector<T, 4> p = transform_ * corner;
+
+			for (int i=0; i < 3; ++i)
+			{
+				if (p[i] < res.min_[i]) res.min_[i] = p[i];
+				if (p[i] > res.max_[i]) res.max_[i] = p[i];
+			}
+		}
+
+		return res;
+	};
+};
+
+namespace detail {
+
+	// every instance the ray reaches is searched for its own closest hit
+	template<typename T, class S>
+	struct InstanceClosestHit
+	{
+		const SceneInstance<T, S>* instances_;
+		const Ray<T, 4>* ray_;
+		intersection_point<T>* hit_;
+		size_t instance_, primitive_;
+
+		inline bool operator()(unsigned int instance, T& t_max)
+		{
+			const SceneInstance<T, S>& inst = instances_[instance];
+
+			T scale;
+			const Ray<T, 4> r = inst.object_ray(*ray_, scale);
+
+			intersection_point<T> p;
+			size_t primitive;
+
+			if (!inst.object_->closest_hit(r, p, primitive) || p.distance_ / scale >= t_max)
+				return false;
+
+			*hit_ = inst.world_hit(*ray_, p, scale);
+			instance_ = instance;
+			primitive_ = primitive;
+			t_max = hit_->distance_;
+
+			return true;
+		};
+	};
+
+	template<typename T, class S>
+	struct InstanceAnyHit
+	{
+		const SceneInstance<T, S>* instances_;
+		const Ray<T, 4>* ray_;
+
+		inline bool operator()(unsigned int instance, T& t_max) const
+		{
+			const SceneInstance<T, S>& inst = instances_[instance];
+
+			T scale;
+			const Ray<T, 4> r = inst.object_ray(*ray_, scale);
+
+			return inst.object_->occluded(r, t_max * scale);
+		};
+	};
+
+} // namespace detail
+
+template<typename T, class S>
+class InstanceScene
+{
+public:
+	typedef T value_type;
+	typedef SceneInstance<T, S> Instance;
+
+protected:
+	memory::AlignedArray<Instance> instances_;
+	Bvh<T> bvh_;
+
+	void bounds_chunk(AABB<T, 3>* boxes, size_t first, size_t last) const
+	{
+		for (size_t i=first; i < last; ++i)
+			boxes[i] = instances_[i].world_bounds();
+	}
+
+public:
+	// index of the new instance, which is only found after the next build()
+	size_t add(const S& object, const Matrix<T, 4>& transform)
+	{
+		Instance op;
+		op.object_ = &object;
+		op.set_transform(transform);
+
+		instances_.push_back(op);
+		return instances_.size() - 1;
+	};
+
+	void set_transform(size_t instance, const Matrix<T, 4>& transform)
+	{
+		assert(instance < instances_.size());
+		instances_[instance].set_transform(transform);
+	};
+
+	void clear()
+	{
+		instances_.clear();
+		bvh_.clear();
+	};
+
+	inline size_t size() const								{ return instances_.size(); };
+	inline const Instance& get_instance(size_t n) const	{ return instances_[n]; };
+	inline const Bvh<T>& get_bvh() const					{ return bvh_; };
+
+	// top level over the instances as they are now, full sweep SAH
+	void build()
+	{
+		memory::AlignedArray< AABB<T, 3> > boxes(instances_.size());
+		bounds_chunk(boxes.data(), 0, instances_.size());
+
+		bvh_.build(boxes.data(), instances_.size());
+	};
+
+	// the same, binned on the pool for many instances
+	void build(thread::TaskPool& pool)
+	{
+		using namespace boost::placeholders;
+
+		memory::AlignedArray< AABB<T, 3> > boxes(instances_.size());
+		thread::parallel_for(pool, 0, instances_.size(), detail::BVH_GRAIN, boost::bind(&InstanceScene::bounds_chunk, this, boxes.data(), _1, _2));
+
+		bvh_.build_binned(pool, boxes.data(), instances_.size());
+	};
+
+	// primitive is the one the object reported for the hit
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& instance, size_t& primitive, BvhTraversalStats* stats) const
+	{
+		detail::InstanceClosestHit<T, S> leaf = { instances_.data(), &ray, &hit, NO_HIT, NO_HIT };
+
+		hit.valid_ = false;
+		hit.distance_ = std::numeric_limits<T>::infinity();
+
+		bvh_.traverse(ray, std::numeric_limits<T>::max(), leaf, stats);
+
+		instance = leaf.instance_;
+		primitive = leaf.primitive_;
+
+		return hit.valid_;
+	};
+
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& instance, size_t& primitive) const
+	{
+		return closest_hit(ray, hit, instance, primitive, 0);
+	};
+
+	// for RayCaster, primitive is the instance
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive) const
+	{
+		size_t object_primitive;
+		return closest_hit(ray, hit, primitive, object_primitive, 0);
+	};
+
+	// true if any instance is hit closer than t_max, e.g. for shadow rays
+	bool occluded(const Ray<T, 4>& ray, T t_max, BvhTraversalStats* stats) const
+	{
+		detail::InstanceAnyHit<T, S> leaf = { instances_.data(), &ray };
+		return bvh_.traverse_any(ray, t_max, leaf, stats);
+	};
+
+	bool occluded(const Ray<T, 4>& ray, T t_max) const
+	{
+		return occluded(ray, t_max, 0);
+	};
+};
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_INSTANCE_SCENE__
@@ -9,10 +9,13 @@
 
 #include <cmath>
 #include <cassert>
+#include <limits>
 
+#include "aabb.h"
 #include "triangle.h"
 #include "sphere.h"
 #include "plane.h"
+#include "ray.h"
 #include "misc.h"
 
 namespace deimos {
@@ -24,7 +27,10 @@ namespace geometry {
 	}
 
 /*
- * All intersect routines use normalized half-rays and return a positive direction
+ * All intersect routines use normalized half-rays and return a positive direction.
+ * They keep no state and may be called from any number of threads at once.
+ * The overloads taking exact_math or fast_math pick the square roots used for
+ * the hit distance and normal, see fast_math.h.
  */
 
 template<typename T>
@@ -36,90 +42,295 @@ struct intersection_point
     bool			valid_;
 };
 
+namespace detail {
+
+	// Möller-Trumbore, distance t and barycentric coordinates (u, v) of vertex 1 and 2
+	template<typename T>
+	bool moller_trumbore(const Vector<T,4>& v1, const Vector<T,4>& v2, const Vector<T,4>& v3, const Ray<T,4>& ray, T& t, T& u, T& v)
+	{
+		const Vector<T,4> v31 = v3 - v1;
+		const Vector<T,4> v21 = v2 - v1;
+
+		const Vector<T,4> cross2 = cross_product(ray.direction_, v31);
+		const T det = cross2*v21;
+
+		if (is_in_range(det, T(-delta), T(delta)))
+			return false;
+
+		const Vector<T,4> r0v1 = ray.origin_ - v1;
+		const Vector<T,4> cross1 = cross_product(r0v1, v21);
+
+		assert(det!=0);
+		const T invdet = 1/det;
+
+		u = invdet*(cross2*r0v1);
+		if (!is_in_range(u, T(0), T(1)))
+			return false;
+
+		v = invdet*(cross1*ray.direction_);
+		if (u+v > 1 || v < 0)
+			return false;
+
+		t = invdet*(cross1*v31);
+		if (t < 0)
+			return false;
+
+		return true;
+	}
+
+	// hit at distance t with the vertex normals n1, n2, n3 interpolated at (u, v)
+	template<typename T, class M>
+	intersection_point<T> interpolated_hit(const Vector<T,4>& n1, const Vector<T,4>& n2, const Vector<T,4>& n3, const Ray<T,4>& ray, T t, T u, T v, M)
+	{
+		intersection_point<T> result;
+
+		result.normal_ = interpolate_linear(n1, n3, v) +
+						 interpolate_linear(n1, n2, u);
+
+		result.normal_.normalize(M());
+		result.pos_ = ray.origin_ + ray.direction_*t;
+		result.distance_ = t;
+		result.valid_ = true;
+
+		return result;
+	}
+
+	// shared with the packet kernels
+	template<typename T, class M>
+	intersection_point<T> triangle_hit(const Triangle<T,4>& triangle, const Ray<T,4>& ray, T t, T u, T v, M)
+	{
+		return interpolated_hit(triangle.normal_[0], triangle.normal_[1], triangle.normal_[2], ray, t, u, v, M());
+	}
+
+	template<typename T, class M>
+	intersection_point<T> sphere_hit(const Sphere<T,4>& sphere, const Ray<T,4>& ray, T t, M)
+	{
+		intersection_point<T> result;
+
+		result.pos_ = ray.get_point_on_ray(t);
+		result.distance_ = t;
+		result.normal_ = result.pos_ - sphere.center_;
+		result.normal_.normalize(M());
+		result.valid_ = true;
+
+		return result;
+	}
+
+} // namespace detail
+
+template<typename T, class M>
+intersection_point<T> intersect(const Triangle<T,4>& triangle, const Ray<T,4>& ray, M)
+{
+	intersection_point<T> result;
+	result.valid_ = false;
+
+	T t, u, v;
+
+	if (!detail::moller_trumbore(triangle.vertex_[0], triangle.vertex_[1], triangle.vertex_[2], ray, t, u, v))
+		return result;
+
+	return detail::triangle_hit(triangle, ray, t, u, v, M());
+}
+
 template<typename T>
 intersection_point<T> intersect(const Triangle<T,4>& triangle, const Ray<T,4>& ray)
 {
-	static T t, u, v, det, invdet;
-	static Vector<T,4> v31, v21, r0v1, cross1, cross2;
-	static intersection_point<T> result;
-	result.valid_ = false;
+	return intersect(triangle, ray, exact_math());
+}
 
-	v31 = triangle.vertex_[2] - triangle.vertex_[0];
-	v21 = triangle.vertex_[1] - triangle.vertex_[0];
+namespace detail {
 
-	cross2 = cross_product(ray.direction_, v31);
-	det = cross2*v21;
+	// distance t to the sphere, its far side if the ray starts inside
+	template<typename T, class M>
+	bool sphere_distance(const Sphere<T,4>& sphere, const Ray<T,4>& ray, T& t, M)
+	{
+		Vector<T, 4> l = sphere.center_ - ray.origin_;
+		T lsqr(l.size_sqr());
+		T rsqr(sphere.radius_*sphere.radius_);
+		T d = l*ray.direction_;
 
-	if (is_in_range(det, -delta, delta))
-        return result;
+		// sphere behind ray origin and ray direction points into opposite
+		if (d < 0 && lsqr > rsqr)
+			return false;
 
-	r0v1 = ray.origin_ - triangle.vertex_[0];
-	cross1 = cross_product(r0v1, v21);
+		// ray misses sphere (ray is not covered by radius)
+		T msqr(lsqr - d*d);
+		if (msqr > rsqr)
+			return false;
 
-	assert(det!=0);
-	invdet = 1/det;
+		T q(M::sqrt(rsqr - msqr));
+		if (lsqr > rsqr)
+			t = d - q;
+		else
+			t = d + q;
 
-	u = invdet*(cross2*r0v1);
-	if (!is_in_range(u, 0.0f, 1.0f))
-		return result;
+		return true;
+	}
 
-	v = invdet*(cross1*ray.direction_);
-	if (u+v > 1 || v < 0)
-		return result;
+} // namespace detail
+
+template<typename T, class M>
+intersection_point<T> intersect(const Sphere<T,4>& sphere, const Ray<T,4>& ray, M)
+{
+	intersection_point<T> result;
+	result.valid_ = false;
+
+	T t;
 
-	t = invdet*(cross1*v31);
-	if (t < 0)
+	if (!detail::sphere_distance(sphere, ray, t, M()))
 		return result;
 
-	v21 = interpolate_linear(triangle.normal_[0], triangle.normal_[1], u);
+	return detail::sphere_hit(sphere, ray, t, M());
+}
+
+template<typename T>
+intersection_point<T> intersect(const Sphere<T,4>& sphere, const Ray<T,4>& ray)
+{
+	return intersect(sphere, ray, exact_math());
+}
+
+namespace detail {
 
-	v31 = interpolate_linear(triangle.normal_[0], triangle.normal_[2], v);
+	// distance t to the plane, both sides are hit; its normal_ must have w = 0
+	template<typename T>
+	bool plane_distance(const Plane<T,4>& plane, const Ray<T,4>& ray, T& t)
+	{
+		const T d = plane.normal_*ray.direction_;
 
-	result.normal_ = (v31+v21);
+		// ray parallel to the plane
+		if (d == 0)
+			return false;
 
-	result.normal_.normalize();
-	result.pos_ = ray.origin_ + ray.direction_*t;
+		t = (plane.distance_ - plane.normal_*ray.origin_) / d;
+		return t >= 0;
+	}
+
+	// distance t to the box and the axis of the face, its far side if the ray starts inside
+	template<typename T>
+	bool box_distance(const AABB<T,3>& box, const Ray<T,4>& ray, T& t, int& axis, bool& inside)
+	{
+		const BoxRay<T> r(ray);
+
+		T t0 = 0, t1 = std::numeric_limits<T>::max();
+		int axis0 = -1, axis1 = -1;
+
+		for (int i=0; i < 3; ++i)
+		{
+			const T near_plane = r.negative_[i] ? box.max_[i] : box.min_[i];
+			const T far_plane = r.negative_[i] ? box.min_[i] : box.max_[i];
+
+			const T tn = (near_plane - r.origin_[i]) * r.inv_direction_[i];
+			const T tf = (far_plane - r.origin_[i]) * r.inv_direction_[i];
+
+			if (tn > t0) { t0 = tn; axis0 = i; }
+			if (tf < t1) { t1 = tf; axis1 = i; }
+		}
+
+		if (t0 > t1 || axis1 < 0)
+			return false;
+
+		inside = (axis0 < 0);
+		axis = inside ? axis1 : axis0;
+		t = inside ? t1 : t0;
+
+		return true;
+	}
+
+} // namespace detail
+
+template<typename T, class M>
+intersection_point<T> intersect(const Plane<T,4>& plane, const Ray<T,4>& ray, M)
+{
+	intersection_point<T> result;
+	result.valid_ = false;
+
+	T t;
+
+	if (!detail::plane_distance(plane, ray, t))
+		return result;
+
+	result.pos_ = ray.get_point_on_ray(t);
 	result.distance_ = t;
+	result.normal_ = plane.normal_;
+	result.normal_.normalize(M());
 	result.valid_ = true;
 
 	return result;
 }
 
 template<typename T>
-intersection_point<T> intersect(const Sphere<T,4>& sphere, const Ray<T,4>& ray)
+intersection_point<T> intersect(const Plane<T,4>& plane, const Ray<T,4>& ray)
+{
+	return intersect(plane, ray, exact_math());
+}
+
+// hit on the outside of the box with the face normal, as with spheres the far side if the ray starts inside
+template<typename T>
+intersection_point<T> intersect(const AABB<T,3>& box, const Ray<T,4>& ray)
 {
-	static intersection_point<T> result;
+	intersection_point<T> result;
 	result.valid_ = false;
 
-	Vector<T, 4> l = sphere.center_ - ray.origin_;
-	T lsqr(l.size_sqr());
-	T rsqr(std::pow(sphere.radius_, 2));
-	T d = l*ray.direction_;
+	T t;
+	int axis;
+	bool inside;
 
-	// sphere behind ray origin and ray direction points into opposite
-	if (d < 0 && lsqr > rsqr)
+	if (!detail::box_distance(box, ray, t, axis, inside))
 		return result;
 
-	// ray misses sphere (ray is not covered by radius)
-	T msqr(lsqr - std::pow(d,2));
-	if (msqr > rsqr)
-		return result;
-
-	T t = T();
-	T q(sqrt(rsqr - msqr));
-	if (lsqr > rsqr)
-		t = d - q;
-	else
-		t = d + q;
+	// the face the ray enters through looks against it, the one it leaves through along it
+	const bool positive = (ray.direction_[axis] < 0) != inside;
 
 	result.pos_ = ray.get_point_on_ray(t);
 	result.distance_ = t;
-	result.normal_ = result.pos_ - sphere.center_;
-	result.normal_.normalize();
+	result.normal_.clear();
+	result.normal_[axis] = positive ? T(1) : T(-1);
 	result.valid_ = true;
+
 	return result;
 }
 
+/*
+ * Occlusion queries for shadow and ambient occlusion rays: true if intersect()
+ * would find a hit closer than t_max, without computing its normal.
+ */
+template<typename T>
+bool occluded(const Triangle<T,4>& triangle, const Ray<T,4>& ray, T t_max)
+{
+	T t, u, v;
+	return detail::moller_trumbore(triangle.vertex_[0], triangle.vertex_[1], triangle.vertex_[2], ray, t, u, v) && t < t_max;
+}
+
+template<typename T, class M>
+bool occluded(const Sphere<T,4>& sphere, const Ray<T,4>& ray, T t_max, M)
+{
+	T t;
+	return detail::sphere_distance(sphere, ray, t, M()) && t < t_max;
+}
+
+template<typename T>
+bool occluded(const Sphere<T,4>& sphere, const Ray<T,4>& ray, T t_max)
+{
+	return occluded(sphere, ray, t_max, exact_math());
+}
+
+template<typename T>
+bool occluded(const Plane<T,4>& plane, const Ray<T,4>& ray, T t_max)
+{
+	T t;
+	return detail::plane_distance(plane, ray, t) && t < t_max;
+}
+
+template<typename T>
+bool occluded(const AABB<T,3>& box, const Ray<T,4>& ray, T t_max)
+{
+	T t;
+	int axis;
+	bool inside;
+
+	return detail::box_distance(box, ray, t, axis, inside) && t < t_max;
+}
+
 } // namespace geometry
 } // namespace math
 } // namespace deimos
@@ -10,6 +10,8 @@
 #define DEIMOS_MATH_MATRIX__
 
 #include <cassert>
+
+#include "config.h"
 #include "vector.h"
 
 namespace deimos {
@@ -23,31 +25,52 @@ public:
 	typedef Vector<T, S> Vec;
 	Vec row_[S];
 
-	void operator*=(const Mat& op)
+	DEIMOS_CONSTEXPR void operator*=(const Mat& op)
 	{
-		*this = *this * op;
+		// op is read completely for every row
+		if (&op == this)
+		{
+			*this = *this * op;
+			return;
+		}
+
+		// row i of the product only depends on row i of *this
+		for (int i=0; i < S; ++i)
+		{
+			const Vec row = row_[i];
+
+			for (int j=0; j < S; ++j)
+			{
+				T sum = T();
+
+				for (int k=0; k < S; ++k)
+					sum += row[k] * op.row_[k][j];
+
+				row_[i][j] = sum;
+			}
+		}
 	};
 
-	void operator*=(const float op)
+	DEIMOS_CONSTEXPR void operator*=(const float op)
 	{
 		for (int i=0; i < S; ++i)
 			row_[i]*=op;
 	};
 
-	void operator+=(const Mat& op)
+	DEIMOS_CONSTEXPR void operator+=(const Mat& op)
 	{
 		for(int i=0; i < S; ++i)
 			row_[i]+=op[i];
 	};
 
-	void operator/=(const float op)
+	DEIMOS_CONSTEXPR void operator/=(const float op)
 	{
 		operator*=(1/op);
 	};
 
-	Vec operator*(const Vec& op) const
+	DEIMOS_CONSTEXPR Vec operator*(const Vec& op) const
 	{
-		Vec res;
+		Vec res = Vec();
 
 		for (int i=0; i < S; ++i)
 			res[i] = row_[i] * op;
@@ -55,56 +78,65 @@ public:
 		return res;
 	};
 
-	Mat operator*(const Mat& op) const
+	DEIMOS_CONSTEXPR Mat operator*(const Mat& op) const
 	{
-		Mat res;
+		Mat res = Mat();
 
+		// same summation order as row_[i] * op.col(j), without building the columns
 		for (int i=0; i < S; ++i)
 			for (int j=0; j < S; ++j)
-				res.row_[i][j] = row_[i] * op.col(j);
+			{
+				T sum = T();
+
+				for (int k=0; k < S; ++k)
+					sum += row_[i][k] * op.row_[k][j];
+
+				res.row_[i][j] = sum;
+			}
 
 		return res;
 	};
 
-	const Vec& operator[](int i) const
+	DEIMOS_CONSTEXPR const Vec& operator[](int i) const
 	{
 		assert (i >= 0 && i < S);
 		return row_[i];
 	};
 
-	Vec& operator[](int i)
+	DEIMOS_CONSTEXPR Vec& operator[](int i)
 	{
 		assert(i >= 0 && i < S);
 		return row_[i];
 	};
 
-	Vec col(int n) const
+	DEIMOS_CONSTEXPR Vec col(int n) const
 	{
 		assert(n>=0 && n<S);
 
-		Vec res;
+		Vec res = Vec();
 
 		for (int i=0; i < S; ++i)
 			res[i]=row_[i][n];
 		return res;
 	};
 
-	void sqr()
+	DEIMOS_CONSTEXPR void sqr()
 	{
 		*this*=*this;
 	};
 
-	void transpose()
+	DEIMOS_CONSTEXPR void transpose()
 	{
-		Mat res;
-
 		for (int i=0; i < S; ++i)
-			res.row_[i]=col(i);
-
-		*this = res;
+			for (int j=i+1; j < S; ++j)
+			{
+				const T temp = row_[i][j];
+				row_[i][j] = row_[j][i];
+				row_[j][i] = temp;
+			}
 	};
 
-	T trace() const
+	DEIMOS_CONSTEXPR T trace() const
 	{
 		T res = T();
 
@@ -114,7 +146,7 @@ public:
 		return res;
 	};
 
-	void identity()
+	DEIMOS_CONSTEXPR void identity()
 	{
 		for (int i=0; i < S; ++i)
 		{
@@ -123,17 +155,17 @@ public:
 		}
 	};
 
-	T* get_addr()
+	DEIMOS_CONSTEXPR T* get_addr()
 	{
 		return &(row_[0][0]);
 	};
 
-    const T* get_addr() const
+	DEIMOS_CONSTEXPR const T* get_addr() const
 	{
 		return &(row_[0][0]);
 	};
 
-	void clear()
+	DEIMOS_CONSTEXPR void clear()
 	{
 		for(int i=0; i < S; ++i)
 			row_[i].clear();
@@ -143,7 +175,7 @@ public:
 //-------------------------------------//
 
 template<typename T>
-T determinant(const Matrix<T, 3>& op)
+DEIMOS_CONSTEXPR T determinant(const Matrix<T, 3>& op)
 {
 	return	op[0][0]*op[1][1]*op[2][2] +
 			op[0][1]*op[1][2]*op[2][0] +
@@ -156,7 +188,7 @@ T determinant(const Matrix<T, 3>& op)
 
 
 template<typename T>
-T determinant(const Matrix<T, 2>& op)
+DEIMOS_CONSTEXPR T determinant(const Matrix<T, 2>& op)
 {
 	return	op[0][0]*op[1][1] -
 			op[0][1]*op[1][0];
@@ -165,9 +197,32 @@ T determinant(const Matrix<T, 2>& op)
 
 
 template<typename T>
-Matrix<T, 2> invert(const Matrix<T, 2>& op)
+DEIMOS_CONSTEXPR T determinant(const Matrix<T, 4>& op)
 {
-	Matrix<T, 2> ret;
+	// expansion by 2x2 minors of the upper and lower two rows
+	const T s0 = op[0][0]*op[1][1] - op[1][0]*op[0][1];
+	const T s1 = op[0][0]*op[1][2] - op[1][0]*op[0][2];
+	const T s2 = op[0][0]*op[1][3] - op[1][0]*op[0][3];
+	const T s3 = op[0][1]*op[1][2] - op[1][1]*op[0][2];
+	const T s4 = op[0][1]*op[1][3] - op[1][1]*op[0][3];
+	const T s5 = op[0][2]*op[1][3] - op[1][2]*op[0][3];
+
+	const T c5 = op[2][2]*op[3][3] - op[3][2]*op[2][3];
+	const T c4 = op[2][1]*op[3][3] - op[3][1]*op[2][3];
+	const T c3 = op[2][1]*op[3][2] - op[3][1]*op[2][2];
+	const T c2 = op[2][0]*op[3][3] - op[3][0]*op[2][3];
+	const T c1 = op[2][0]*op[3][2] - op[3][0]*op[2][2];
+	const T c0 = op[2][0]*op[3][1] - op[3][0]*op[2][1];
+
+	return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+}
+
+
+
+template<typename T>
+DEIMOS_CONSTEXPR Matrix<T, 2> invert(const Matrix<T, 2>& op)
+{
+	Matrix<T, 2> ret = Matrix<T, 2>();
 
 	ret[0][0]=op[1][1];
 	ret[1][1]=op[0][0];
@@ -183,7 +238,132 @@ Matrix<T, 2> invert(const Matrix<T, 2>& op)
 	return ret;
 }
 
+
+
+template<typename T>
+DEIMOS_CONSTEXPR Matrix<T, 3> invert(const Matrix<T, 3>& op)
+{
+	Matrix<T, 3> ret = Matrix<T, 3>();
+
+	// adjugate
+	ret[0][0] = op[1][1]*op[2][2] - op[1][2]*op[2][1];
+	ret[0][1] = op[0][2]*op[2][1] - op[0][1]*op[2][2];
+	ret[0][2] = op[0][1]*op[1][2] - op[0][2]*op[1][1];
+	ret[1][0] = op[1][2]*op[2][0] - op[1][0]*op[2][2];
+	ret[1][1] = op[0][0]*op[2][2] - op[0][2]*op[2][0];
+	ret[1][2] = op[0][2]*op[1][0] - op[0][0]*op[1][2];
+	ret[2][0] = op[1][0]*op[2][1] - op[1][1]*op[2][0];
+	ret[2][1] = op[0][1]*op[2][0] - op[0][0]*op[2][1];
+	ret[2][2] = op[0][0]*op[1][1] - op[0][1]*op[1][0];
+
+	const T det = op[0][0]*ret[0][0] + op[0][1]*ret[1][0] + op[0][2]*ret[2][0];
+
+	assert(det != 0);
+
+	ret*=1/det;
+
+	return ret;
+}
+
+
+
+template<typename T>
+DEIMOS_CONSTEXPR Matrix<T, 4> invert(const Matrix<T, 4>& op)
+{
+	Matrix<T, 4> ret = Matrix<T, 4>();
+
+	// 2x2 minors of the upper and lower two rows
+	const T s0 = op[0][0]*op[1][1] - op[1][0]*op[0][1];
+	const T s1 = op[0][0]*op[1][2] - op[1][0]*op[0][2];
+	const T s2 = op[0][0]*op[1][3] - op[1][0]*op[0][3];
+	const T s3 = op[0][1]*op[1][2] - op[1][1]*op[0][2];
+	const T s4 = op[0][1]*op[1][3] - op[1][1]*op[0][3];
+	const T s5 = op[0][2]*op[1][3] - op[1][2]*op[0][3];
+
+	const T c5 = op[2][2]*op[3][3] - op[3][2]*op[2][3];
+	const T c4 = op[2][1]*op[3][3] - op[3][1]*op[2][3];
+	const T c3 = op[2][1]*op[3][2] - op[3][1]*op[2][2];
+	const T c2 = op[2][0]*op[3][3] - op[3][0]*op[2][3];
+	const T c1 = op[2][0]*op[3][2] - op[3][0]*op[2][2];
+	const T c0 = op[2][0]*op[3][1] - op[3][0]*op[2][1];
+
+	const T det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+
+	assert(det != 0);
+
+	const T inv_det = 1/det;
+
+	ret[0][0] = ( op[1][1]*c5 - op[1][2]*c4 + op[1][3]*c3) * inv_det;
+	ret[0][1] = (-op[0][1]*c5 + op[0][2]*c4 - op[0][3]*c3) * inv_det;
+	ret[0][2] = ( op[3][1]*s5 - op[3][2]*s4 + op[3][3]*s3) * inv_det;
+	ret[0][3] = (-op[2][1]*s5 + op[2][2]*s4 - op[2][3]*s3) * inv_det;
+
+	ret[1][0] = (-op[1][0]*c5 + op[1][2]*c2 - op[1][3]*c1) * inv_det;
+	ret[1][1] = ( op[0][0]*c5 - op[0][2]*c2 + op[0][3]*c1) * inv_det;
+	ret[1][2] = (-op[3][0]*s5 + op[3][2]*s2 - op[3][3]*s1) * inv_det;
+	ret[1][3] = ( op[2][0]*s5 - op[2][2]*s2 + op[2][3]*s1) * inv_det;
+
+	ret[2][0] = ( op[1][0]*c4 - op[1][1]*c2 + op[1][3]*c0) * inv_det;
+	ret[2][1] = (-op[0][0]*c4 + op[0][1]*c2 - op[0][3]*c0) * inv_det;
+	ret[2][2] = ( op[3][0]*s4 - op[3][1]*s2 + op[3][3]*s0) * inv_det;
+	ret[2][3] = (-op[2][0]*s4 + op[2][1]*s2 - op[2][3]*s0) * inv_det;
+
+	ret[3][0] = (-op[1][0]*c3 + op[1][1]*c1 - op[1][2]*c0) * inv_det;
+	ret[3][1] = ( op[0][0]*c3 - op[0][1]*c1 + op[0][2]*c0) * inv_det;
+	ret[3][2] = (-op[3][0]*s3 + op[3][1]*s1 - op[3][2]*s0) * inv_det;
+	ret[3][3] = ( op[2][0]*s3 - op[2][1]*s1 + op[2][2]*s0) * inv_det;
+
+	return ret;
+}
+
+
+
+/*
+ * Inverse of an affine transformation, i.e. the last row is (0, 0, 0, 1) and
+ * the translation is stored in the last column. Only the upper 3x3 part has
+ * to be inverted, the translation becomes -inv(A) * t.
+ */
+template<typename T>
+DEIMOS_CONSTEXPR Matrix<T, 4> invert_affine(const Matrix<T, 4>& op)
+{
+	assert(op[3][0] == 0 && op[3][1] == 0 && op[3][2] == 0 && op[3][3] == 1);
+
+	Matrix<T, 4> ret = Matrix<T, 4>();
+
+	ret[0][0] = op[1][1]*op[2][2] - op[1][2]*op[2][1];
+	ret[0][1] = op[0][2]*op[2][1] - op[0][1]*op[2][2];
+	ret[0][2] = op[0][1]*op[1][2] - op[0][2]*op[1][1];
+	ret[1][0] = op[1][2]*op[2][0] - op[1][0]*op[2][2];
+	ret[1][1] = op[0][0]*op[2][2] - op[0][2]*op[2][0];
+	ret[1][2] = op[0][2]*op[1][0] - op[0][0]*op[1][2];
+	ret[2][0] = op[1][0]*op[2][1] - op[1][1]*op[2][0];
+	ret[2][1] = op[0][1]*op[2][0] - op[0][0]*op[2][1];
+	ret[2][2] = op[0][0]*op[1][1] - op[0][1]*op[1][0];
+
+	const T det = op[0][0]*ret[0][0] + op[0][1]*ret[1][0] + op[0][2]*ret[2][0];
+
+	assert(det != 0);
+
+	const T inv_det = 1/det;
+
+	for (int i=0; i < 3; ++i)
+	{
+		for (int j=0; j < 3; ++j)
+			ret[i][j] *= inv_det;
+
+		ret[i][3] = -(ret[i][0]*op[0][3] + ret[i][1]*op[1][3] + ret[i][2]*op[2][3]);
+	}
+
+	ret[3].clear();
+	ret[3][3] = 1;
+
+	return ret;
+}
+
 } // namespace math
 } // namespace deimos
 
+// SIMD specializations for 4x4 float matrices
+#include "matrix_simd.h"
+
 #endif // DEIMOS_MATH_MATRIX__
@@ -0,0 +1,307 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * SSE versions of the 4x4 float matrix operations. The layout stays row-major,
+ * each row_[i] is one SSE register (see vector_simd.h).
+ *
+ * With DEIMOS_CONSTEXPR_BRANCH these fall back to the generic algorithms
+ * during constant evaluation.
+ *
+ * Included by matrix.h, don't include directly.
+ */
+
+#if !defined(DEIMOS_MATH_MATRIX_SIMD__)
+#define DEIMOS_MATH_MATRIX_SIMD__
+
+#include "config.h"
+#include "simd.h"
+
+#if defined(DEIMOS_SSE2)
+
+namespace deimos {
+namespace math {
+
+namespace detail {
+
+	template<int x, int y, int z, int w>
+	inline __m128 swizzle(__m128 op)
+	{
+		return _mm_shuffle_ps(op, op, _MM_SHUFFLE(w, z, y, x));
+	}
+
+	// (op1[x], op1[y], op2[z], op2[w])
+	template<int x, int y, int z, int w>
+	inline __m128 shuffle(__m128 op1, __m128 op2)
+	{
+		return _mm_shuffle_ps(op1, op2, _MM_SHUFFLE(w, z, y, x));
+	}
+
+	// linear combination of the rows of op with the weights in row
+	inline __m128 mul_row(__m128 row, const Matrix<float, 4>& op)
+	{
+		__m128 res = _mm_mul_ps(swizzle<0, 0, 0, 0>(row), op.row_[0].load());
+		res = _mm_add_ps(res, _mm_mul_ps(swizzle<1, 1, 1, 1>(row), op.row_[1].load()));
+		res = _mm_add_ps(res, _mm_mul_ps(swizzle<2, 2, 2, 2>(row), op.row_[2].load()));
+		res = _mm_add_ps(res, _mm_mul_ps(swizzle<3, 3, 3, 3>(row), op.row_[3].load()));
+		return res;
+	}
+
+	/*
+	 * 2x2 blocks stored as (m00, m01, m10, m11), used by the blockwise inverse:
+	 * op1 * op2, adj(op1) * op2 and op1 * adj(op2)
+	 */
+	inline __m128 mat2_mul(__m128 op1, __m128 op2)
+	{
+		return _mm_add_ps(_mm_mul_ps(op1, swizzle<0, 3, 0, 3>(op2)),
+						  _mm_mul_ps(swizzle<1, 0, 3, 2>(op1), swizzle<2, 1, 2, 1>(op2)));
+	}
+
+	inline __m128 mat2_adj_mul(__m128 op1, __m128 op2)
+	{
+		return _mm_sub_ps(_mm_mul_ps(swizzle<3, 3, 0, 0>(op1), op2),
+						  _mm_mul_ps(swizzle<1, 1, 2, 2>(op1), swizzle<2, 3, 0, 1>(op2)));
+	}
+
+	inline __m128 mat2_mul_adj(__m128 op1, __m128 op2)
+	{
+		return _mm_sub_ps(_mm_mul_ps(op1, swizzle<3, 0, 3, 0>(op2)),
+						  _mm_mul_ps(swizzle<1, 0, 3, 2>(op1), swizzle<2, 1, 2, 1>(op2)));
+	}
+
+	// scalar products for constant evaluation, same summation order as the generic operators
+	template<typename T, int S>
+	DEIMOS_CONSTEXPR Matrix<T, S> constant_mul(const Matrix<T, S>& op1, const Matrix<T, S>& op2)
+	{
+		Matrix<T, S> res = Matrix<T, S>();
+
+		for (int i=0; i < S; ++i)
+			for (int j=0; j < S; ++j)
+			{
+				T sum = T();
+
+				for (int k=0; k < S; ++k)
+					sum += op1.row_[i].element_[k] * op2.row_[k].element_[j];
+
+				res.row_[i].element_[j] = sum;
+			}
+
+		return res;
+	}
+
+	template<typename T, int S>
+	DEIMOS_CONSTEXPR Vector<T, S> constant_mul(const Matrix<T, S>& op1, const Vector<T, S>& op2)
+	{
+		Vector<T, S> res = Vector<T, S>();
+
+		for (int i=0; i < S; ++i)
+			for (int k=0; k < S; ++k)
+				res.element_[i] += op1.row_[i].element_[k] * op2.element_[k];
+
+		return res;
+	}
+
+} // namespace detail
+
+//-------------------------------------//
+
+template<>
+inline DEIMOS_CONSTEXPR_BRANCH Matrix<float, 4> Matrix<float, 4>::operator*(const Mat& op) const
+{
+	if (DEIMOS_IS_CONSTANT_EVALUATED())
+		return detail::constant_mul(*this, op);
+
+	Mat res = Mat();
+
+	// res.row_[i] = sum_k row_[i][k] * op.row_[k], same summation order as the generic version
+	for (int i=0; i < 4; ++i)
+		res.row_[i].store(detail::mul_row(row_[i].load(), op));
+
+	return res;
+}
+
+template<>
+inline DEIMOS_CONSTEXPR_BRANCH void Matrix<float, 4>::operator*=(const Mat& op)
+{
+	if (DEIMOS_IS_CONSTANT_EVALUATED() || &op == this)
+	{
+		*this = *this * op;
+		return;
+	}
+
+	for (int i=0; i < 4; ++i)
+		row_[i].store(detail::mul_row(row_[i].load(), op));
+}
+
+template<>
+inline DEIMOS_CONSTEXPR_BRANCH Vector<float, 4> Matrix<float, 4>::operator*(const Vec& op) const
+{
+	if (DEIMOS_IS_CONSTANT_EVALUATED())
+		return detail::constant_mul(*this, op);
+
+	const __m128 v = op.load();
+
+	__m128 r0 = _mm_mul_ps(row_[0].load(), v);
+	__m128 r1 = _mm_mul_ps(row_[1].load(), v);
+	__m128 r2 = _mm_mul_ps(row_[2].load(), v);
+	__m128 r3 = _mm_mul_ps(row_[3].load(), v);
+
+	// the columns of the transposed products hold the partial sums of each row
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	return Vec::make(_mm_add_ps(_mm_add_ps(_mm_add_ps(r0, r1), r2), r3));
+}
+
+template<>
+inline DEIMOS_CONSTEXPR_BRANCH void Matrix<float, 4>::transpose()
+{
+	if (DEIMOS_IS_CONSTANT_EVALUATED())
+	{
+		for (int i=0; i < 4; ++i)
+			for (int j=i+1; j < 4; ++j)
+			{
+				const float temp = row_[i].element_[j];
+				row_[i].element_[j] = row_[j].element_[i];
+				row_[j].element_[i] = temp;
+			}
+
+		return;
+	}
+
+	__m128 r0 = row_[0].load();
+	__m128 r1 = row_[1].load();
+	__m128 r2 = row_[2].load();
+	__m128 r3 = row_[3].load();
+
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	row_[0].store(r0);
+	row_[1].store(r1);
+	row_[2].store(r2);
+	row_[3].store(r3);
+}
+
+//-------------------------------------//
+
+// blockwise inverse with 2x2 sub matrices
+inline DEIMOS_CONSTEXPR_BRANCH Matrix<float, 4> invert(const Matrix<float, 4>& op)
+{
+	using namespace detail;
+
+	if (DEIMOS_IS_CONSTANT_EVALUATED())
+		return invert<float>(op);
+
+	const __m128 r0 = op.row_[0].load();
+	const __m128 r1 = op.row_[1].load();
+	const __m128 r2 = op.row_[2].load();
+	const __m128 r3 = op.row_[3].load();
+
+	// | A B |
+	// | C D |
+	const __m128 a = _mm_movelh_ps(r0, r1);
+	const __m128 b = _mm_movehl_ps(r1, r0);
+	const __m128 c = _mm_movelh_ps(r2, r3);
+	const __m128 d = _mm_movehl_ps(r3, r2);
+
+	// (|A|, |B|, |C|, |D|)
+	const __m128 det_sub = _mm_sub_ps(
+		_mm_mul_ps(shuffle<0, 2, 0, 2>(r0, r2), shuffle<1, 3, 1, 3>(r1, r3)),
+		_mm_mul_ps(shuffle<1, 3, 1, 3>(r0, r2), shuffle<0, 2, 0, 2>(r1, r3)));
+
+	const __m128 det_a = swizzle<0, 0, 0, 0>(det_sub);
+	const __m128 det_b = swizzle<1, 1, 1, 1>(det_sub);
+	const __m128 det_c = swizzle<2, 2, 2, 2>(det_sub);
+	const __m128 det_d = swizzle<3, 3, 3, 3>(det_sub);
+
+	const __m128 d_c = mat2_adj_mul(d, c);
+	const __m128 a_b = mat2_adj_mul(a, b);
+
+	// adjugates of the blocks of the inverse
+	__m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), mat2_mul(b, d_c));
+	__m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), mat2_mul(c, a_b));
+	__m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), mat2_mul_adj(d, a_b));
+	__m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), mat2_mul_adj(a, d_c));
+
+	// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+	__m128 tr = _mm_mul_ps(a_b, swizzle<0, 2, 1, 3>(d_c));
+	tr = _mm_add_ps(tr, swizzle<1, 0, 3, 2>(tr));
+	tr = _mm_add_ps(tr, swizzle<2, 3, 0, 1>(tr));
+
+	const __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), tr);
+
+	assert(_mm_cvtss_f32(det) != 0);
+
+	const __m128 inv_det = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), det);
+
+	x = _mm_mul_ps(x, inv_det);
+	y = _mm_mul_ps(y, inv_det);
+	z = _mm_mul_ps(z, inv_det);
+	w = _mm_mul_ps(w, inv_det);
+
+	// undo the adjugate while storing the blocks as rows
+	Matrix<float, 4> ret = Matrix<float, 4>();
+	ret.row_[0].store(shuffle<3, 1, 3, 1>(x, y));
+	ret.row_[1].store(shuffle<2, 0, 2, 0>(x, y));
+	ret.row_[2].store(shuffle<3, 1, 3, 1>(z, w));
+	ret.row_[3].store(shuffle<2, 0, 2, 0>(z, w));
+
+	return ret;
+}
+
+// see the generic invert_affine(), the adjugate of the 3x3 part is built from cross products
+inline DEIMOS_CONSTEXPR_BRANCH Matrix<float, 4> invert_affine(const Matrix<float, 4>& op)
+{
+	using namespace detail;
+
+	if (DEIMOS_IS_CONSTANT_EVALUATED())
+		return invert_affine<float>(op);
+
+	assert(op[3][0] == 0 && op[3][1] == 0 && op[3][2] == 0 && op[3][3] == 1);
+
+	const __m128 r0 = op.row_[0].load();
+	const __m128 r1 = op.row_[1].load();
+	const __m128 r2 = op.row_[2].load();
+
+	// translation in the w lanes
+	const __m128 t = shuffle<2, 3, 3, 3>(_mm_unpackhi_ps(r0, r1), r2);
+
+	// columns of adj(A), cross_product() ignores and clears w
+	__m128 c0 = cross_product(r1, r2);
+	__m128 c1 = cross_product(r2, r0);
+	__m128 c2 = cross_product(r0, r1);
+
+	const __m128 det = _mm_mul_ps(_mm_and_ps(r0, mask_xyz()), c0);
+	const __m128 det_sum = _mm_add_ss(_mm_add_ss(det, swizzle<1, 1, 1, 1>(det)), _mm_movehl_ps(det, det));
+
+	assert(_mm_cvtss_f32(det_sum) != 0);
+
+	const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.f), swizzle<0, 0, 0, 0>(det_sum));
+
+	c0 = _mm_mul_ps(c0, inv_det);
+	c1 = _mm_mul_ps(c1, inv_det);
+	c2 = _mm_mul_ps(c2, inv_det);
+
+	// -inv(A) * t as a column
+	__m128 tr = _mm_mul_ps(c0, swizzle<0, 0, 0, 0>(t));
+	tr = _mm_add_ps(tr, _mm_mul_ps(c1, swizzle<1, 1, 1, 1>(t)));
+	tr = _mm_add_ps(tr, _mm_mul_ps(c2, swizzle<2, 2, 2, 2>(t)));
+	tr = _mm_sub_ps(_mm_setzero_ps(), tr);
+
+	_MM_TRANSPOSE4_PS(c0, c1, c2, tr);
+
+	Matrix<float, 4> ret = Matrix<float, 4>();
+	ret.row_[0].store(c0);
+	ret.row_[1].store(c1);
+	ret.row_[2].store(c2);
+	ret.row_[3].store(_mm_setr_ps(0.f, 0.f, 0.f, 1.f));
+
+	return ret;
+}
+
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_SSE2
+
+#endif // DEIMOS_MATH_MATRIX_SIMD__
@@ -0,0 +1,201 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Indexed triangle mesh: vertices are stored once and faces refer to them by
+ * 32 bit indices, so a closed mesh needs about a third of the memory of an
+ * array of Triangle<T, 4> and shared vertices stay bitwise identical. Every
+ * vertex has a position and optionally a normal, a texture coordinate and a
+ * color; an attribute array is either empty or as long as position_.
+ *
+ *   IndexedMesh<float> mesh;
+ *   mesh::load_mesh(pool, "bunny.ply", mesh);
+ *   MeshScene<float, 8> scene(mesh, pool);		// see triangle_block.h
+ */
+
+#if !defined(DEIMOS_MATH_MESH__)
+#define DEIMOS_MATH_MESH__
+
+#include <cassert>
+#include <cstddef>
+
+#include "../memory/aligned_array.h"
+#include "aabb.h"
+#include "intersect.h"
+#include "ray.h"
+#include "triangle.h"
+#include "vector.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+// one triangle of an IndexedMesh, counter-clockwise
+struct MeshFace
+{
+	unsigned int vertex_[3];
+};
+
+template<typename T>
+class IndexedMesh
+{
+public:
+	typedef Vector<T, 4> Vec;
+
+	// positions have w = 1, normals w = 0
+	memory::AlignedArray<Vec> position_, normal_;
+	memory::AlignedArray< Vector<T, 2> > texcoord_;
+	memory::AlignedArray<Vec> color_;
+	memory::AlignedArray<MeshFace> face_;
+
+	inline size_t num_vertices() const	{ return position_.size(); };
+	inline size_t num_faces() const		{ return face_.size(); };
+
+	inline bool has_normals() const		{ return !normal_.empty(); };
+	inline bool has_texcoords() const	{ return !texcoord_.empty(); };
+	inline bool has_colors() const		{ return !color_.empty(); };
+
+	void clear()
+	{
+		position_.clear();
+		normal_.clear();
+		texcoord_.clear();
+		color_.clear();
+		face_.clear();
+	};
+
+	inline const Vec& get_vertex(size_t face, int k) const
+	{
+		assert(face < face_.size() && k >= 0 && k < 3);
+		return position_[face_[face].vertex_[k]];
+	};
+
+	// face as a standalone triangle, flat shaded without vertex normals
+	Triangle<T, 4> get_triangle(size_t face) const
+	{
+		Triangle<T, 4> res;
+
+		for (int k=0; k < 3; ++k)
+			res.vertex_[k] = get_vertex(face, k);
+
+		if (has_normals())
+			for (int k=0; k < 3; ++k)
+				res.normal_[k] = normal_[face_[face].vertex_[k]];
+		else
+			res.calc_normal();
+
+		return res;
+	};
+
+	// vertex normals as the area weighted sum of the adjacent face normals
+	void calc_normals()
+	{
+		Vec zero;
+		zero.clear(0);
+
+		normal_.clear();
+		normal_.resize(position_.size(), zero);
+
+		for (size_t f=0; f < face_.size(); ++f)
+		{
+			const Vec n = cross_product(get_vertex(f, 1) - get_vertex(f, 0), get_vertex(f, 2) - get_vertex(f, 0));
+
+			for (int k=0; k < 3; ++k)
+				normal_[face_[f].vertex_[k]] += n;
+		}
+
+		for (size_t i=0; i < normal_.size(); ++i)
+			if (normal_[i].size_sqr() > 0)
+				normal_[i].normalize();
+	};
+
+	// false if a face refers to a vertex that doesn't exist or an attribute is incomplete
+	bool is_valid() const
+	{
+		const size_t n = position_.size();
+
+		if ((has_normals() && normal_.size() != n) ||
+			(has_texcoords() && texcoord_.size() != n) ||
+			(has_colors() && color_.size() != n))
+			return false;
+
+		for (size_t f=0; f < face_.size(); ++f)
+			for (int k=0; k < 3; ++k)
+				if (face_[f].vertex_[k] >= n)
+					return false;
+
+		return true;
+	};
+};
+
+template<typename T>
+AABB<T, 3> bounds(const IndexedMesh<T>& mesh, size_t face)
+{
+	AABB<T, 3> res = AABB<T, 3>::empty();
+
+	for (int k=0; k < 3; ++k)
+		for (int i=0; i < 3; ++i)
+		{
+			const T& p = mesh.get_vertex(face, k)[i];
+
+			if (p < res.min_[i]) res.min_[i] = p;
+			if (p > res.max_[i]) res.max_[i] = p;
+		}
+
+	return res;
+}
+
+namespace detail {
+
+	// hit on a face at distance t and barycentric coordinates (u, v) of its vertex 1 and 2
+	template<typename T, class M>
+	intersection_point<T> mesh_hit(const IndexedMesh<T>& mesh, size_t face, const Ray<T, 4>& ray, T t, T u, T v, M)
+	{
+		const MeshFace& f = mesh.face_[face];
+
+		if (mesh.has_normals())
+			return interpolated_hit(mesh.normal_[f.vertex_[0]], mesh.normal_[f.vertex_[1]], mesh.normal_[f.vertex_[2]], ray, t, u, v, M());
+
+		const Vector<T, 4> n = cross_product(mesh.get_vertex(face, 1) - mesh.get_vertex(face, 0),
+											 mesh.get_vertex(face, 2) - mesh.get_vertex(face, 0));
+
+		return interpolated_hit(n, n, n, ray, t, u, v, M());
+	}
+
+} // namespace detail
+
+// the same as intersect(mesh.get_triangle(face), ray) without building the triangle
+template<typename T, class M>
+intersection_point<T> intersect(const IndexedMesh<T>& mesh, size_t face, const Ray<T, 4>& ray, M)
+{
+	intersection_point<T> result;
+	result.valid_ = false;
+
+	T t, u, v;
+
+	if (!detail::moller_trumbore(mesh.get_vertex(face, 0), mesh.get_vertex(face, 1), mesh.get_vertex(face, 2), ray, t, u, v))
+		return result;
+
+	return detail::mesh_hit(mesh, face, ray, t, u, v, M());
+}
+
+template<typename T>
+intersection_point<T> intersect(const IndexedMesh<T>& mesh, size_t face, const Ray<T, 4>& ray)
+{
+	return intersect(mesh, face, ray, exact_math());
+}
+
+// true if intersect(mesh, face, ray) would find a hit closer than t_max
+template<typename T>
+bool occluded(const IndexedMesh<T>& mesh, size_t face, const Ray<T, 4>& ray, T t_max)
+{
+	T t, u, v;
+	return detail::moller_trumbore(mesh.get_vertex(face, 0), mesh.get_vertex(face, 1), mesh.get_vertex(face, 2), ray, t, u, v) && t < t_max;
+}
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_MESH__
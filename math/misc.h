@@ -9,6 +9,7 @@
 
 #include <iostream>
 
+#include "config.h"
 #include "matrix.h"
 #include "vector.h"
 
@@ -18,18 +19,18 @@ namespace math {
 	// constants
 	namespace constants
 	{
-		const double PI			= 3.1415926535897932384626433832795;
-		const double HALF_PI	= 1.5707963267948966192313216916395;
-		const double DOUBLE_PI	= 6.283185307179586476925286766558;
-		const double DEG_TO_RAD = 0.0174532925199432957692369076848861;
+		DEIMOS_CONSTEXPR_DATA double PI			= 3.1415926535897932384626433832795;
+		DEIMOS_CONSTEXPR_DATA double HALF_PI	= 1.5707963267948966192313216916395;
+		DEIMOS_CONSTEXPR_DATA double DOUBLE_PI	= 6.283185307179586476925286766558;
+		DEIMOS_CONSTEXPR_DATA double DEG_TO_RAD = 0.0174532925199432957692369076848861;
 	};
 
 	// converters
 	template<typename T>
-	T deg_to_rad(T x) { return static_cast<T>(x*constants::DEG_TO_RAD); };
+	DEIMOS_CONSTEXPR T deg_to_rad(T x) { return static_cast<T>(x*constants::DEG_TO_RAD); };
 
 	template<typename T>
-	T rad_to_deg(T x) { return static_cast<T>(x/constants::DEG_TO_RAD); };
+	DEIMOS_CONSTEXPR T rad_to_deg(T x) { return static_cast<T>(x/constants::DEG_TO_RAD); };
 
 	// specialized functions for templates
 	template<typename T, int S>
@@ -54,14 +55,14 @@ namespace math {
 
 	// generic distance functions
 	template<typename T, int S>
-	T distance(const Vector<T, S>& op1, const Vector<T, S>& op2)
+	DEIMOS_CONSTEXPR_BRANCH T distance(const Vector<T, S>& op1, const Vector<T, S>& op2)
 	{
-		return (op2 - op1).Size();
+		return (op2 - op1).size();
 	};
 
 	// generic 3dim distance function
 	template<typename T, int S>
-	T distance_sqr_3(const Vector<T, S>& op1, const Vector<T, S>& op2)
+	DEIMOS_CONSTEXPR T distance_sqr_3(const Vector<T, S>& op1, const Vector<T, S>& op2)
 	{
 		assert(S >= 3);
 
@@ -71,16 +72,16 @@ namespace math {
 	};
 
 	template<typename T, int S>
-	T distance_3(const Vector<T, S>& op1, const Vector<T, S>& op2)
+	DEIMOS_CONSTEXPR_BRANCH T distance_3(const Vector<T, S>& op1, const Vector<T, S>& op2)
 	{
 		assert(S >= 3);
 
-		return std::sqrt(distance_sqr_3(op1, op2));
+		return detail::sqrt(distance_sqr_3(op1, op2));
 	};
 
 	// interpolation
 	template<typename T>
-	T interpolate_linear(const T& a, const T& b, float x)
+	DEIMOS_CONSTEXPR T interpolate_linear(const T& a, const T& b, float x)
 	{
 		assert(x >= 0.f && x <= 1.f);
 		return a*(1-x) + b*x;
@@ -94,29 +95,30 @@ namespace math {
 		return a*(1-f) + b*f;
 	};
 
+	// cubic through v1 and v2 at x = 0 and 1, see curve.h for whole splines
 	template<typename T>
-	T interpolate_cubic(const T& v0, const T& v1, const T& v2, const T& v3, float x)
+	DEIMOS_CONSTEXPR T interpolate_cubic(const T& v0, const T& v1, const T& v2, const T& v3, float x)
 	{
-		double P = (v3 - v2) - (v0 - v1);
-		double Q = (v0 - v1) - P;
-		double R = v2 - v0;
-		double S = v1;
+		const T P = (v3 - v2) - (v0 - v1);
+		const T Q = (v0 - v1) - P;
+		const T R = v2 - v0;
+		const T S = v1;
 
-		return std::pow(P*x, 3) + std::pow(Q*x, 2) + R*x + S;
+		return ((P*x + Q)*x + R)*x + S;
 	};
 
 	// boolean functions
 	template<typename T>
-	bool is_in_range(const T& val, const T& min, const T& max)
+	DEIMOS_CONSTEXPR bool is_in_range(const T& val, const T& min, const T& max)
 	{
 		return (val >= min && val <= max);
 	};
 
 	// other functions
 	template<typename T>
-	int round(T val)
+	DEIMOS_CONSTEXPR int round(T val)
 	{
-		static int r = static_cast<int>(val);
+		const int r = static_cast<int>(val);
 
 		if (val - static_cast<int>(val) >= 0.5)
 			return r+1;
@@ -124,8 +126,8 @@ namespace math {
 			return r;
 	};
 
-    template<typename T>
-	T clamp(T value, T min, T max)
+	template<typename T>
+	DEIMOS_CONSTEXPR T clamp(T value, T min, T max)
 	{
 		if (value < min)
 			return min;
@@ -134,58 +136,181 @@ namespace math {
 		return value;
 	};
 
-	static const double factorial_cache[99] = {
-	1, 			  1, 			2,
-	6, 			  24, 			120,
-	720, 		  5040, 		40320,
-	362880, 	  3.6288e+006, 	3.99168e+007,
-	4.79002e+008, 6.22702e+009, 8.71783e+010,
-	1.30767e+012, 2.09228e+013, 3.55687e+014,
-	6.40237e+015, 1.21645e+017, 2.4329e+018,
-	5.10909e+019, 1.124e+021, 	2.5852e+022,
-	6.20448e+023, 1.55112e+025, 4.03291e+026,
-	1.08889e+028, 3.04888e+029, 8.84176e+030,
-	2.65253e+032, 8.22284e+033, 2.63131e+035,
-	8.68332e+036, 2.95233e+038, 1.03331e+040,
-	3.71993e+041, 1.37638e+043, 5.23023e+044,
-	2.03979e+046, 8.15915e+047, 3.34525e+049,
-	1.40501e+051, 6.04153e+052, 2.65827e+054,
-	1.19622e+056, 5.50262e+057, 2.58623e+059,
-	1.24139e+061, 6.08282e+062, 3.04141e+064,
-	1.55112e+066, 8.06582e+067, 4.27488e+069,
-	2.30844e+071, 1.26964e+073, 7.10999e+074,
-	4.05269e+076, 2.35056e+078, 1.38683e+080,
-	8.32099e+081, 5.0758e+083, 	3.147e+085,
-	1.98261e+087, 1.26887e+089, 8.24765e+090,
-	5.44345e+092, 3.64711e+094, 2.48004e+096,
-	1.71122e+098, 1.19786e+100, 8.50479e+101,
-	6.12345e+103, 4.47012e+105, 3.30789e+107,
-	2.48091e+109, 1.88549e+111, 1.45183e+113,
-	1.13243e+115, 8.94618e+116, 7.15695e+118,
-	5.79713e+120, 4.75364e+122, 3.94552e+124,
-	3.31424e+126, 2.8171e+128, 	2.42271e+130,
-	2.10776e+132, 1.85483e+134, 1.6508e+136,
-	1.48572e+138, 1.352e+140, 	1.24384e+142,
-	1.15677e+144, 1.08737e+146, 1.033e+148,
-	9.91678e+149, 9.61928e+151, 9.42689e+153
+	/*
+	 * n! and n!! for every n whose value is finite in double precision. The
+	 * entries are the correctly rounded values of the exact integers, computed
+	 * with arbitrary precision arithmetic rather than by repeated multiplication.
+	 */
+	const int FACTORIAL_CACHE_SIZE = 171;
+	const int DOUBLE_FACTORIAL_CACHE_SIZE = 301;
+
+	static DEIMOS_CONSTEXPR_DATA double factorial_cache[FACTORIAL_CACHE_SIZE] = {
+	1.0, 1.0, 2.0, 6.0,
+	24.0, 120.0, 720.0, 5040.0,
+	40320.0, 362880.0, 3628800.0, 39916800.0,
+	479001600.0, 6227020800.0, 87178291200.0, 1307674368000.0,
+	20922789888000.0, 355687428096000.0, 6402373705728000.0, 1.21645100408832e+17,
+	2.43290200817664e+18, 5.109094217170944e+19, 1.1240007277776077e+21, 2.585201673888498e+22,
+	6.204484017332394e+23, 1.5511210043330986e+25, 4.0329146112660565e+26, 1.0888869450418352e+28,
+	3.0488834461171387e+29, 8.841761993739702e+30, 2.6525285981219107e+32, 8.222838654177922e+33,
+	2.631308369336935e+35, 8.683317618811886e+36, 2.9523279903960416e+38, 1.0333147966386145e+40,
+	3.7199332678990125e+41, 1.3763753091226346e+43, 5.230226174666011e+44, 2.0397882081197444e+46,
+	8.159152832478977e+47, 3.345252661316381e+49, 1.40500611775288e+51, 6.041526306337383e+52,
+	2.658271574788449e+54, 1.1962222086548019e+56, 5.502622159812089e+57, 2.5862324151116818e+59,
+	1.2413915592536073e+61, 6.082818640342675e+62, 3.0414093201713376e+64, 1.5511187532873822e+66,
+	8.065817517094388e+67, 4.2748832840600255e+69, 2.308436973392414e+71, 1.2696403353658276e+73,
+	7.109985878048635e+74, 4.0526919504877214e+76, 2.3505613312828785e+78, 1.3868311854568984e+80,
+	8.32098711274139e+81, 5.075802138772248e+83, 3.146997326038794e+85, 1.98260831540444e+87,
+	1.2688693218588417e+89, 8.247650592082472e+90, 5.443449390774431e+92, 3.647111091818868e+94,
+	2.4800355424368305e+96, 1.711224524281413e+98, 1.1978571669969892e+100, 8.504785885678623e+101,
+	6.1234458376886085e+103, 4.4701154615126844e+105, 3.307885441519386e+107, 2.48091408113954e+109,
+	1.8854947016660504e+111, 1.4518309202828587e+113, 1.1324281178206297e+115, 8.946182130782976e+116,
+	7.156945704626381e+118, 5.797126020747368e+120, 4.753643337012842e+122, 3.945523969720659e+124,
+	3.314240134565353e+126, 2.81710411438055e+128, 2.4227095383672734e+130, 2.107757298379528e+132,
+	1.8548264225739844e+134, 1.650795516090846e+136, 1.4857159644817615e+138, 1.352001527678403e+140,
+	1.2438414054641308e+142, 1.1567725070816416e+144, 1.087366156656743e+146, 1.032997848823906e+148,
+	9.916779348709496e+149, 9.619275968248212e+151, 9.426890448883248e+153, 9.332621544394415e+155,
+	9.332621544394415e+157, 9.42594775983836e+159, 9.614466715035127e+161, 9.90290071648618e+163,
+	1.0299016745145628e+166, 1.081396758240291e+168, 1.1462805637347084e+170, 1.226520203196138e+172,
+	1.324641819451829e+174, 1.4438595832024937e+176, 1.588245541522743e+178, 1.7629525510902446e+180,
+	1.974506857221074e+182, 2.2311927486598138e+184, 2.5435597334721877e+186, 2.925093693493016e+188,
+	3.393108684451898e+190, 3.969937160808721e+192, 4.684525849754291e+194, 5.574585761207606e+196,
+	6.689502913449127e+198, 8.094298525273444e+200, 9.875044200833601e+202, 1.214630436702533e+205,
+	1.506141741511141e+207, 1.882677176888926e+209, 2.372173242880047e+211, 3.0126600184576594e+213,
+	3.856204823625804e+215, 4.974504222477287e+217, 6.466855489220474e+219, 8.47158069087882e+221,
+	1.1182486511960043e+224, 1.4872707060906857e+226, 1.9929427461615188e+228, 2.6904727073180504e+230,
+	3.659042881952549e+232, 5.012888748274992e+234, 6.917786472619489e+236, 9.615723196941089e+238,
+	1.3462012475717526e+241, 1.898143759076171e+243, 2.695364137888163e+245, 3.854370717180073e+247,
+	5.5502938327393044e+249, 8.047926057471992e+251, 1.1749972043909107e+254, 1.727245890454639e+256,
+	2.5563239178728654e+258, 3.80892263763057e+260, 5.713383956445855e+262, 8.62720977423324e+264,
+	1.3113358856834524e+267, 2.0063439050956823e+269, 3.0897696138473508e+271, 4.789142901463394e+273,
+	7.471062926282894e+275, 1.1729568794264145e+278, 1.853271869493735e+280, 2.9467022724950384e+282,
+	4.7147236359920616e+284, 7.590705053947219e+286, 1.2296942187394494e+289, 2.0044015765453026e+291,
+	3.287218585534296e+293, 5.423910666131589e+295, 9.003691705778438e+297, 1.503616514864999e+300,
+	2.5260757449731984e+302, 4.269068009004705e+304, 7.257415615307999e+306
+	};
+
+	static DEIMOS_CONSTEXPR_DATA double double_factorial_cache[DOUBLE_FACTORIAL_CACHE_SIZE] = {
+	1.0, 1.0, 2.0, 3.0,
+	8.0, 15.0, 48.0, 105.0,
+	384.0, 945.0, 3840.0, 10395.0,
+	46080.0, 135135.0, 645120.0, 2027025.0,
+	10321920.0, 34459425.0, 185794560.0, 654729075.0,
+	3715891200.0, 13749310575.0, 81749606400.0, 316234143225.0,
+	1961990553600.0, 7905853580625.0, 51011754393600.0, 213458046676875.0,
+	1428329123020800.0, 6190283353629375.0, 4.2849873690624e+16, 1.9189878396251062e+17,
+	1.371195958099968e+18, 6.33265987076285e+18, 4.662066257539891e+19, 2.2164309547669976e+20,
+	1.6783438527143608e+21, 8.200794532637892e+21, 6.377706640314571e+22, 3.1983098677287775e+23,
+	2.5510826561258285e+24, 1.3113070457687988e+25, 1.071454715572848e+26, 5.638620296805835e+26,
+	4.714400748520531e+27, 2.5373791335626256e+28, 2.1686243443194444e+29, 1.1925681927744342e+30,
+	1.0409396852733332e+31, 5.843584144594727e+31, 5.204698426366666e+32, 2.980227913743311e+33,
+	2.7064431817106665e+34, 1.5795207942839547e+35, 1.4614793181237598e+36, 8.687364368561751e+36,
+	8.184284181493056e+37, 4.951797690080198e+38, 4.746884825265972e+39, 2.921560637147317e+40,
+	2.8481308951595834e+41, 1.7821519886598634e+42, 1.7658411549989415e+43, 1.1227557528557138e+44,
+	1.1301383391993226e+45, 7.29791239356214e+45, 7.458913038715529e+46, 4.889601303686634e+47,
+	5.07206086632656e+48, 3.3738248995437775e+49, 3.550442606428592e+50, 2.395415678676082e+51,
+	2.5563186766285865e+52, 1.7486534454335398e+53, 1.891675820705154e+54, 1.3114900840751548e+55,
+	1.437673623735917e+56, 1.0098473647378693e+57, 1.1213854265140152e+58, 7.977794181429167e+58,
+	8.97108341211212e+59, 6.462013286957625e+60, 7.35628839793194e+61, 5.363471028174829e+62,
+	6.1792822542628295e+63, 4.558950373948605e+64, 5.314182738666033e+65, 3.9662868253352865e+66,
+	4.6764808100261093e+67, 3.529995274548405e+68, 4.208832729023498e+69, 3.212295699839048e+70,
+	3.8721261107016185e+71, 2.987435000850315e+72, 3.639798544059521e+73, 2.838063250807799e+74,
+	3.4942066022971404e+75, 2.7529213532835652e+76, 3.4243224702511974e+77, 2.7253921397507295e+78,
+	3.4243224702511973e+79, 2.7526460611482366e+80, 3.4928089196562214e+81, 2.835225442982684e+82,
+	3.6325212764424704e+83, 2.976986715131818e+84, 3.8504725530290186e+85, 3.185375785191045e+86,
+	4.15851035727134e+87, 3.4720596058582394e+88, 4.5743613929984744e+89, 3.8539861625026457e+90,
+	5.123284760158291e+91, 4.3550043636279895e+92, 5.840544626580451e+93, 5.008255018172188e+94,
+	6.775031766833324e+95, 5.85965837126146e+96, 7.994537484863323e+97, 6.972993461801137e+98,
+	9.593444981835987e+99, 8.437322088779376e+100, 1.1704002877839905e+102, 1.0377906169198634e+103,
+	1.4512963568521482e+104, 1.297238271149829e+105, 1.8286334096337066e+106, 1.647492604360283e+107,
+	2.3406507643311445e+108, 2.1252654596247653e+109, 3.042845993630488e+110, 2.784097752108442e+111,
+	4.016556711592244e+112, 3.7028500103042284e+113, 5.382185993533607e+114, 4.998847513910708e+115,
+	7.319772951205705e+116, 6.84842109405767e+117, 1.0101286672663872e+119, 9.519305320740162e+119,
+	1.4141801341729423e+121, 1.3422220502243628e+122, 2.008135790525578e+123, 1.9193775318208388e+124,
+	2.8917155383568322e+125, 2.783097421140216e+126, 4.2219046860009753e+127, 4.091153209076118e+128,
+	6.248418935281443e+129, 6.095818281523415e+130, 9.372628402922166e+131, 9.204685605100357e+132,
+	1.4246395172441692e+134, 1.4083168975803547e+135, 2.1939448565560204e+136, 2.1828911912495497e+137,
+	3.4225539762273915e+138, 3.4271391702617933e+139, 5.407635282439279e+140, 5.4491512807162513e+141,
+	8.652216451902847e+142, 8.773133561953163e+143, 1.401659065208261e+145, 1.4300207705983658e+146,
+	2.2987208669415484e+147, 2.3595342714873035e+148, 3.81587663912297e+149, 3.940422233383797e+150,
+	6.41067275372659e+151, 6.659313574418617e+152, 1.0898143681335202e+154, 1.1387426212255834e+155,
+	1.874480713189655e+156, 1.9700247347202593e+157, 3.2615964409499996e+158, 3.4475432857604537e+159,
+	5.740409736071999e+160, 6.102151615796004e+161, 1.0217929330208158e+163, 1.0922851392274846e+164,
+	1.8392272794374685e+165, 1.9770361020017472e+166, 3.3473936485761925e+167, 3.617976066663197e+168,
+	6.159204313380195e+169, 6.693255723326915e+170, 1.1456120022887162e+172, 1.2516388202621332e+173,
+	2.1537505643027864e+174, 2.3655973702954314e+175, 4.092126072175294e+176, 4.518290977264274e+177,
+	7.856882058576564e+178, 8.72030158612005e+179, 1.5242351193638536e+181, 1.7004588092934096e+182,
+	2.987500833953153e+183, 3.349903854308017e+184, 5.915251651227243e+185, 6.666308670072953e+186,
+	1.1830503302454486e+188, 1.3399280426846636e+189, 2.3897616670958062e+190, 2.7200539266498673e+191,
+	4.875113800875445e+192, 5.576110549632228e+193, 1.0042734429803416e+195, 1.1542548837738713e+196,
+	2.0888887613991106e+197, 2.412392707087391e+198, 4.386666398938132e+199, 5.090148611954395e+200,
+	9.29973276574884e+201, 1.0842016543462861e+203, 1.9901428118702518e+204, 2.331033556844515e+205,
+	4.298708473639744e+206, 5.0583428183525975e+207, 9.371184472534642e+208, 1.107777077219219e+210,
+	2.0616605839576212e+211, 2.448187340654474e+212, 4.5768864963859186e+213, 5.459457769659476e+214,
+	1.0252225751904458e+216, 1.228377998173382e+217, 2.3170030199304077e+218, 2.7884180558535774e+219,
+	5.282766885441329e+220, 6.3854773479046924e+221, 1.2150363836515058e+223, 1.475045267365984e+224,
+	2.818884410071493e+225, 3.436855472962743e+226, 6.5961895195672945e+227, 8.076610361462445e+228,
+	1.5567007266178815e+230, 1.9141566556665996e+231, 3.704947729350558e+232, 4.574834407043173e+233,
+	8.891874550441339e+234, 1.1025350920974046e+236, 2.151833641206804e+237, 2.6791602737966934e+238,
+	5.2504740845446015e+239, 6.563942670801899e+240, 1.291616624797972e+242, 1.6212938396880689e+243,
+	3.203209229498971e+244, 4.037021660823292e+245, 8.008023073747427e+246, 1.0132924368666462e+248,
+	2.0180218145843514e+249, 2.563629865272615e+250, 5.125775409044253e+251, 6.5372561564451684e+252,
+	1.3121985047153287e+254, 1.6800748322064082e+255, 3.385472142165548e+256, 4.3513938154145973e+257,
+	8.802227569630426e+258, 1.1357137858232099e+260, 2.3061836232431714e+261, 2.986927256715042e+262,
+	6.088324765361972e+263, 7.9153572302948615e+264, 1.6194943875862846e+266, 2.113400380488728e+267,
+	4.340244958731243e+268, 5.685047023514678e+269, 1.1718661388574355e+271, 1.5406477433724777e+272,
+	3.187475897692225e+273, 4.205968339406864e+274, 8.733683959676696e+275, 1.1566412933368878e+277,
+	2.410496772870768e+278, 3.203896382543179e+279, 6.701181028580735e+280, 8.938870907295469e+281,
+	1.876330688002606e+283, 2.5118227249500268e+284, 5.291252540167348e+285, 7.108458311608576e+286,
+	1.502715721407527e+288, 2.025910618808444e+289, 4.2977669632255275e+290, 5.814363475980234e+291,
+	1.2377568854089517e+293, 1.6803510445582878e+294, 3.58949496768596e+295, 4.889821539664618e+296,
+	1.0481325305643003e+298, 1.432717711121733e+299, 3.081509639859043e+300, 4.226517247809112e+301,
+	9.121268533982767e+302, 1.2552756225993064e+304, 2.718138023126865e+305, 3.753274111571926e+306,
+	8.154414069380594e+307
 	};
 
 	template<typename T>
-	T factorial(int number)
+	DEIMOS_CONSTEXPR T factorial(int number)
 	{
-		if (number < 99)
+		assert(number >= 0);
+
+		if (number < FACTORIAL_CACHE_SIZE)
 			return static_cast<T>(factorial_cache[number]);
 
-		T ret = static_cast<T>(factorial_cache[99]);
-		const int stop = number - 99;
-		for (int i = number; i > stop; --i)
+		// only types with a larger range than double get here
+		T ret = static_cast<T>(factorial_cache[FACTORIAL_CACHE_SIZE-1]);
+		for (int i = FACTORIAL_CACHE_SIZE; i <= number; ++i)
+			ret *= i;
+
+		return ret;
+	}
+
+	template<typename T>
+	DEIMOS_CONSTEXPR T double_factorial(int number)
+	{
+		// 0!! = (-1)!! = 1
+		assert(number >= -1);
+
+		if (number < 1)
+			return T(1);
+
+		if (number < DOUBLE_FACTORIAL_CACHE_SIZE)
+			return static_cast<T>(double_factorial_cache[number]);
+
+		// continue from the last cached entry with the same parity
+		int last = DOUBLE_FACTORIAL_CACHE_SIZE-1;
+		if ((number - last) % 2)
+			--last;
+
+		T ret = static_cast<T>(double_factorial_cache[last]);
+		for (int i = last + 2; i <= number; i += 2)
 			ret *= i;
 
 		return ret;
 	}
 
 	template<typename T>
-	T fact_frac(int x, int n)
+	DEIMOS_CONSTEXPR T fact_frac(int x, int n)
 	{
 		// x!
 		//---
@@ -198,7 +323,7 @@ namespace math {
 	}
 
 	// kronecker delta
-	inline unsigned int delta(int a, int b)
+	inline DEIMOS_CONSTEXPR unsigned int delta(int a, int b)
 	{
 		return (a == b) ? 1 : 0;
 	}
@@ -0,0 +1,909 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Structure-of-arrays packets of N scalars or N vectors. VectorPacket<T, S, N>
+ * stores component c of all N vectors in component_[c], so every operation of
+ * Vector is done for all lanes at once without horizontal reductions:
+ *
+ *   VectorPacket<float, 3, 8> p, q;
+ *   p.gather(positions + i);
+ *   ScalarPacket<float, 8> d = p * q;			// 8 dot products
+ *   unsigned int front = d.less(zero);		// bit i set for lane i
+ *   select(front, p, q).scatter(out + i);
+ *
+ * Comparisons return bit masks with bit i for lane i. N is split into SSE/AVX
+ * registers where the width divides it, other sizes use scalar loops.
+ */
+
+#if !defined(DEIMOS_MATH_PACKET__)
+#define DEIMOS_MATH_PACKET__
+
+#include <cassert>
+#include <cmath>
+
+#include "fast_math.h"
+#include "simd.h"
+#include "vector.h"
+
+namespace deimos {
+namespace math {
+
+namespace detail {
+
+	/*
+	 * W lanes of T in one register. lanes<T, 1> is the scalar fallback, the
+	 * SIMD versions exist for the widths the instruction set supports.
+	 * stream() bypasses the cache and needs sizeof(reg) aligned addresses.
+	 */
+	template<typename T, int W>
+	struct lanes;
+
+	template<typename T>
+	struct lanes<T, 1>
+	{
+		typedef T reg;
+
+		static inline reg load(const T* op)					{ return *op; }
+		static inline void store(T* dst, reg op)			{ *dst = op; }
+		static inline void stream(T* dst, reg op)			{ *dst = op; }
+		static inline reg set1(T op)						{ return op; }
+		static inline reg add(reg op1, reg op2)				{ return op1 + op2; }
+		static inline reg sub(reg op1, reg op2)				{ return op1 - op2; }
+		static inline reg mul(reg op1, reg op2)				{ return op1 * op2; }
+		static inline reg div(reg op1, reg op2)				{ return op1 / op2; }
+		static inline reg min(reg op1, reg op2)				{ return (op2 < op1) ? op2 : op1; }
+		static inline reg max(reg op1, reg op2)				{ return (op1 < op2) ? op2 : op1; }
+		static inline reg sqrt(reg op)						{ return static_cast<T>(std::sqrt(op)); }
+		static inline unsigned int less(reg op1, reg op2)		{ return (op1 < op2) ? 1 : 0; }
+		static inline unsigned int less_equal(reg op1, reg op2)	{ return (op1 <= op2) ? 1 : 0; }
+		static inline unsigned int equal(reg op1, reg op2)		{ return (op1 == op2) ? 1 : 0; }
+		static inline reg select(unsigned int mask, reg op1, reg op2) { return (mask & 1) ? op1 : op2; }
+	};
+
+	// widest register that divides N
+	template<typename T, int N>
+	struct packet_width
+	{
+		enum { value = 1 };
+	};
+
+#if defined(DEIMOS_SSE2)
+
+	template<>
+	struct lanes<float, 4>
+	{
+		typedef __m128 reg;
+
+		static inline reg load(const float* op)				{ return _mm_loadu_ps(op); }
+		static inline void store(float* dst, reg op)		{ _mm_storeu_ps(dst, op); }
+		static inline void stream(float* dst, reg op)		{ _mm_stream_ps(dst, op); }
+		static inline reg set1(float op)					{ return _mm_set1_ps(op); }
+		static inline reg add(reg op1, reg op2)				{ return _mm_add_ps(op1, op2); }
+		static inline reg sub(reg op1, reg op2)				{ return _mm_sub_ps(op1, op2); }
+		static inline reg mul(reg op1, reg op2)				{ return _mm_mul_ps(op1, op2); }
+		static inline reg div(reg op1, reg op2)				{ return _mm_div_ps(op1, op2); }
+		static inline reg min(reg op1, reg op2)				{ return _mm_min_ps(op1, op2); }
+		static inline reg max(reg op1, reg op2)				{ return _mm_max_ps(op1, op2); }
+		static inline reg sqrt(reg op)						{ return _mm_sqrt_ps(op); }
+		static inline unsigned int less(reg op1, reg op2)		{ return _mm_movemask_ps(_mm_cmplt_ps(op1, op2)); }
+		static inline unsigned int less_equal(reg op1, reg op2)	{ return _mm_movemask_ps(_mm_cmple_ps(op1, op2)); }
+		static inline unsigned int equal(reg op1, reg op2)		{ return _mm_movemask_ps(_mm_cmpeq_ps(op1, op2)); }
+
+		// all bits of lane i set if bit i of mask is set
+		static inline reg expand(unsigned int mask)
+		{
+			const __m128i bit = _mm_setr_epi32(1, 2, 4, 8);
+			return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask), bit), bit));
+		}
+
+		static inline reg select(unsigned int mask, reg op1, reg op2)
+		{
+			const reg m = expand(mask);
+#if defined(DEIMOS_SSE41)
+			return _mm_blendv_ps(op2, op1, m);
+#else
+			return _mm_or_ps(_mm_and_ps(m, op1), _mm_andnot_ps(m, op2));
+#endif
+		}
+	};
+
+	template<>
+	struct lanes<double, 2>
+	{
+		typedef __m128d reg;
+
+		static inline reg load(const double* op)			{ return _mm_loadu_pd(op); }
+		static inline void store(double* dst, reg op)		{ _mm_storeu_pd(dst, op); }
+		static inline void stream(double* dst, reg op)		{ _mm_stream_pd(dst, op); }
+		static inline reg set1(double op)					{ return _mm_set1_pd(op); }
+		static inline reg add(reg op1, reg op2)				{ return _mm_add_pd(op1, op2); }
+		static inline reg sub(reg op1, reg op2)				{ return _mm_sub_pd(op1, op2); }
+		static inline reg mul(reg op1, reg op2)				{ return _mm_mul_pd(op1, op2); }
+		static inline reg div(reg op1, reg op2)				{ return _mm_div_pd(op1, op2); }
+		static inline reg min(reg op1, reg op2)				{ return _mm_min_pd(op1, op2); }
+		static inline reg max(reg op1, reg op2)				{ return _mm_max_pd(op1, op2); }
+		static inline reg sqrt(reg op)						{ return _mm_sqrt_pd(op); }
+		static inline unsigned int less(reg op1, reg op2)		{ return _mm_movemask_pd(_mm_cmplt_pd(op1, op2)); }
+		static inline unsigned int less_equal(reg op1, reg op2)	{ return _mm_movemask_pd(_mm_cmple_pd(op1, op2)); }
+		static inline unsigned int equal(reg op1, reg op2)		{ return _mm_movemask_pd(_mm_cmpeq_pd(op1, op2)); }
+
+		static inline reg expand(unsigned int mask)
+		{
+			const __m128i bit = _mm_setr_epi32(1, 1, 2, 2);
+			return _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask), bit), bit));
+		}
+
+		static inline reg select(unsigned int mask, reg op1, reg op2)
+		{
+			const reg m = expand(mask);
+#if defined(DEIMOS_SSE41)
+			return _mm_blendv_pd(op2, op1, m);
+#else
+			return _mm_or_pd(_mm_and_pd(m, op1), _mm_andnot_pd(m, op2));
+#endif
+		}
+	};
+
+#if defined(DEIMOS_AVX)
+
+	template<>
+	struct lanes<float, 8>
+	{
+		typedef __m256 reg;
+
+		static inline reg load(const float* op)				{ return _mm256_loadu_ps(op); }
+		static inline void store(float* dst, reg op)		{ _mm256_storeu_ps(dst, op); }
+		static inline void stream(float* dst, reg op)		{ _mm256_stream_ps(dst, op); }
+		static inline reg set1(float op)					{ return _mm256_set1_ps(op); }
+		static inline reg add(reg op1, reg op2)				{ return _mm256_add_ps(op1, op2); }
+		static inline reg sub(reg op1, reg op2)				{ return _mm256_sub_ps(op1, op2); }
+		static inline reg mul(reg op1, reg op2)				{ return _mm256_mul_ps(op1, op2); }
+		static inline reg div(reg op1, reg op2)				{ return _mm256_div_ps(op1, op2); }
+		static inline reg min(reg op1, reg op2)				{ return _mm256_min_ps(op1, op2); }
+		static inline reg max(reg op1, reg op2)				{ return _mm256_max_ps(op1, op2); }
+		static inline reg sqrt(reg op)						{ return _mm256_sqrt_ps(op); }
+		static inline unsigned int less(reg op1, reg op2)		{ return _mm256_movemask_ps(_mm256_cmp_ps(op1, op2, _CMP_LT_OQ)); }
+		static inline unsigned int less_equal(reg op1, reg op2)	{ return _mm256_movemask_ps(_mm256_cmp_ps(op1, op2, _CMP_LE_OQ)); }
+		static inline unsigned int equal(reg op1, reg op2)		{ return _mm256_movemask_ps(_mm256_cmp_ps(op1, op2, _CMP_EQ_OQ)); }
+
+		static inline reg select(unsigned int mask, reg op1, reg op2)
+		{
+			const __m128 lo = lanes<float, 4>::expand(mask);
+			const __m128 hi = lanes<float, 4>::expand(mask >> 4);
+			const reg m = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+			return _mm256_blendv_ps(op2, op1, m);
+		}
+	};
+
+	template<>
+	struct lanes<double, 4>
+	{
+		typedef __m256d reg;
+
+		static inline reg load(const double* op)			{ return _mm256_loadu_pd(op); }
+		static inline void store(double* dst, reg op)		{ _mm256_storeu_pd(dst, op); }
+		static inline void stream(double* dst, reg op)		{ _mm256_stream_pd(dst, op); }
+		static inline reg set1(double op)					{ return _mm256_set1_pd(op); }
+		static inline reg add(reg op1, reg op2)				{ return _mm256_add_pd(op1, op2); }
+		static inline reg sub(reg op1, reg op2)				{ return _mm256_sub_pd(op1, op2); }
+		static inline reg mul(reg op1, reg op2)				{ return _mm256_mul_pd(op1, op2); }
+		static inline reg div(reg op1, reg op2)				{ return _mm256_div_pd(op1, op2); }
+		static inline reg min(reg op1, reg op2)				{ return _mm256_min_pd(op1, op2); }
+		static inline reg max(reg op1, reg op2)				{ return _mm256_max_pd(op1, op2); }
+		static inline reg sqrt(reg op)						{ return _mm256_sqrt_pd(op); }
+		static inline unsigned int less(reg op1, reg op2)		{ return _mm256_movemask_pd(_mm256_cmp_pd(op1, op2, _CMP_LT_OQ)); }
+		static inline unsigned int less_equal(reg op1, reg op2)	{ return _mm256_movemask_pd(_mm256_cmp_pd(op1, op2, _CMP_LE_OQ)); }
+		static inline unsigned int equal(reg op1, reg op2)		{ return _mm256_movemask_pd(_mm256_cmp_pd(op1, op2, _CMP_EQ_OQ)); }
+
+		static inline reg select(unsigned int mask, reg op1, reg op2)
+		{
+			const __m128d lo = lanes<double, 2>::expand(mask);
+			const __m128d hi = lanes<double, 2>::expand(mask >> 2);
+			const reg m = _mm256_insertf128_pd(_mm256_castpd128_pd256(lo), hi, 1);
+			return _mm256_blendv_pd(op2, op1, m);
+		}
+	};
+
+	template<int N>
+	struct packet_width<float, N>
+	{
+		enum { value = (N % 8 == 0) ? 8 : (N % 4 == 0) ? 4 : 1 };
+	};
+
+	template<int N>
+	struct packet_width<double, N>
+	{
+		enum { value = (N % 4 == 0) ? 4 : (N % 2 == 0) ? 2 : 1 };
+	};
+
+#else
+
+	template<int N>
+	struct packet_width<float, N>
+	{
+		enum { value = (N % 4 == 0) ? 4 : 1 };
+	};
+
+	template<int N>
+	struct packet_width<double, N>
+	{
+		enum { value = (N % 2 == 0) ? 2 : 1 };
+	};
+
+#endif // DEIMOS_AVX
+
+#endif // DEIMOS_SSE2
+
+} // namespace detail
+
+//-------------------------------------//
+
+template<typename T, int N>
+class ScalarPacket
+{
+public:
+	typedef ScalarPacket<T, N> Packet;
+	T element_[N];
+
+	enum { width = detail::packet_width<T, N>::value };
+	typedef detail::lanes<T, width> L;
+
+	inline const Packet operator+(const Packet& op) const
+	{
+		Packet res;
+
+		for (int i=0; i < N; i+=width)
+			L::store(res.element_ + i, L::add(L::load(element_ + i), L::load(op.element_ + i)));
+
+		return res;
+	};
+
+	inline const Packet operator-(const Packet& op) const
+	{
+		Packet res;
+
+		for (int i=0; i < N; i+=width)
+			L::store(res.element_ + i, L::sub(L::load(element_ + i), L::load(op.element_ + i)));
+
+		return res;
+	};
+
+	inline const Packet operator*(const Packet& op) const
+	{
+		Packet res;
+
+		for (int i=0; i < N; i+=width)
+			L::store(res.element_ + i, L::mul(L::load(element_ + i), L::load(op.element_ + i)));
+
+		return res;
+	};
+
+	inline const Packet operator/(const Packet& op) const
+	{
+		Packet res;
+
+		for (int i=0; i < N; i+=width)
+			L::store(res.element_ + i, L::div(L::load(element_ + i), L::load(op.element_ + i)));
+
+		return res;
+	};
+
+	inline const Packet operator*(T op) const
+	{
+		Packet res;
+		const typename L::reg s = L::set1(op);
+
+		for (int i=0; i < N; i+=width)
+			L::store(res.element_ + i, L::mul(L::load(element_ + i), s));
+
+		return res;
+	};
+
+	inline const Packet operator/(T op) const
+	{
+		return operator*(1/op);
+	};
+
+	inline void operator+=(const Packet& op)
+	{
+		*this = *this + op;
+	};
+
+	inline void operator-=(const Packet& op)
+	{
+		*this = *this - op;
+	};
+
+	inline void operator*=(const Packet& op)
+	{
+		*this = *this * op;
+	};
+
+	inline void operator*=(T op)
+	{
+		*this = *this * op;
+	};
+
+	inline void operator/=(T op)
+	{
+		*this = *this * (1/op);
+	};
+
+	// lane masks, bit i is set if the comparison holds for lane i
+	inline unsigned int less(const Packet& op) const
+	{
+		unsigned int mask = 0;
+
+		for (int i=0; i < N; i+=width)
+			mask |= L::less(L::load(element_ + i), L::load(op.element_ + i)) << i;
+
+		return mask;
+	};
+
+	inline unsigned int less_equal(const Packet& op) const
+	{
+		unsigned int mask = 0;
+
+		for (int i=0; i < N; i+=width)
+			mask |= L::less_equal(L::load(element_ + i), L::load(op.element_ + i)) << i;
+
+		return mask;
+	};
+
+	inline unsigned int equal(const Packet& op) const
+	{
+		unsigned int mask = 0;
+
+		for (int i=0; i < N; i+=width)
+			mask |= L::equal(L::load(element_ + i), L::load(op.element_ + i)) << i;
+
+		return mask;
+	};
+
+	inline const T& operator[](int n) const
+	{
+		assert(n >= 0 && n < N);
+		return element_[n];
+	};
+
+	inline T& operator[](int n)
+	{
+		assert(n >= 0 && n < N);
+		return element_[n];
+	};
+
+	inline void clear(T op=0)
+	{
+		for (int i=0; i < N; ++i)
+			element_[i] = op;
+	};
+
+	static inline Packet broadcast(T op)
+	{
+		Packet res;
+		res.clear(op);
+		return res;
+	};
+
+	T* get_addr()
+	{
+		return &(element_[0]);
+	};
+
+	const T* get_addr() const
+	{
+		return &(element_[0]);
+	};
+};
+
+// all lanes set in a mask of N lanes
+template<int N>
+inline unsigned int full_mask()
+{
+	return (N == 32) ? ~0u : (1u << N) - 1;
+}
+
+template<typename T, int N>
+ScalarPacket<T, N> sqrt(const ScalarPacket<T, N>& op)
+{
+	typedef typename ScalarPacket<T, N>::L L;
+	ScalarPacket<T, N> res;
+
+	for (int i=0; i < N; i+=ScalarPacket<T, N>::width)
+		L::store(res.element_ + i, L::sqrt(L::load(op.element_ + i)));
+
+	return res;
+}
+
+template<typename T, int N>
+ScalarPacket<T, N> minimum(const ScalarPacket<T, N>& op1, const ScalarPacket<T, N>& op2)
+{
+	typedef typename ScalarPacket<T, N>::L L;
+	ScalarPacket<T, N> res;
+
+	for (int i=0; i < N; i+=ScalarPacket<T, N>::width)
+		L::store(res.element_ + i, L::min(L::load(op1.element_ + i), L::load(op2.element_ + i)));
+
+	return res;
+}
+
+template<typename T, int N>
+ScalarPacket<T, N> maximum(const ScalarPacket<T, N>& op1, const ScalarPacket<T, N>& op2)
+{
+	typedef typename ScalarPacket<T, N>::L L;
+	ScalarPacket<T, N> res;
+
+	for (int i=0; i < N; i+=ScalarPacket<T, N>::width)
+		L::store(res.element_ + i, L::max(L::load(op1.element_ + i), L::load(op2.element_ + i)));
+
+	return res;
+}
+
+// lane i of op1 where bit i of mask is set, else lane i of op2
+template<typename T, int N>
+ScalarPacket<T, N> select(unsigned int mask, const ScalarPacket<T, N>& op1, const ScalarPacket<T, N>& op2)
+{
+	typedef typename ScalarPacket<T, N>::L L;
+	ScalarPacket<T, N> res;
+
+	for (int i=0; i < N; i+=ScalarPacket<T, N>::width)
+		L::store(res.element_ + i, L::select(mask >> i, L::load(op1.element_ + i), L::load(op2.element_ + i)));
+
+	return res;
+}
+
+//-------------------------------------//
+
+namespace detail {
+
+	// fast_math.h has SSE versions for four floats, everything else runs per lane
+	template<typename T, int N>
+	struct fast_width
+	{
+		enum { value = 1 };
+	};
+
+#if defined(DEIMOS_SSE2)
+	template<int N>
+	struct fast_width<float, N>
+	{
+		enum { value = (N % 4 == 0) ? 4 : 1 };
+	};
+#endif
+
+	template<typename T, int N>
+	ScalarPacket<T, N> fast_map(const ScalarPacket<T, N>& op,
+								typename lanes<T, fast_width<T, N>::value>::reg (*func)(typename lanes<T, fast_width<T, N>::value>::reg))
+	{
+		typedef lanes<T, fast_width<T, N>::value> L;
+		ScalarPacket<T, N> res;
+
+		for (int i=0; i < N; i+=fast_width<T, N>::value)
+			L::store(res.element_ + i, func(L::load(op.element_ + i)));
+
+		return res;
+	}
+
+	template<typename T, int N>
+	ScalarPacket<T, N> fast_map(const ScalarPacket<T, N>& op1, const ScalarPacket<T, N>& op2,
+								typename lanes<T, fast_width<T, N>::value>::reg (*func)(typename lanes<T, fast_width<T, N>::value>::reg,
+																						 typename lanes<T, fast_width<T, N>::value>::reg))
+	{
+		typedef lanes<T, fast_width<T, N>::value> L;
+		ScalarPacket<T, N> res;
+
+		for (int i=0; i < N; i+=fast_width<T, N>::value)
+			L::store(res.element_ + i, func(L::load(op1.element_ + i), L::load(op2.element_ + i)));
+
+		return res;
+	}
+
+} // namespace detail
+
+// approximations of fast_math.h for all lanes
+namespace fast {
+
+template<typename T, int N>
+ScalarPacket<T, N> rsqrt(const ScalarPacket<T, N>& op)	{ return math::detail::fast_map(op, &fast::rsqrt); }
+
+template<typename T, int N>
+ScalarPacket<T, N> sqrt(const ScalarPacket<T, N>& op)	{ return math::detail::fast_map(op, &fast::sqrt); }
+
+template<typename T, int N>
+ScalarPacket<T, N> sin(const ScalarPacket<T, N>& op)	{ return math::detail::fast_map(op, &fast::sin); }
+
+template<typename T, int N>
+ScalarPacket<T, N> cos(const ScalarPacket<T, N>& op)	{ return math::detail::fast_map(op, &fast::cos); }
+
+template<typename T, int N>
+ScalarPacket<T, N> acos(const ScalarPacket<T, N>& op)	{ return math::detail::fast_map(op, &fast::acos); }
+
+template<typename T, int N>
+ScalarPacket<T, N> exp2(const ScalarPacket<T, N>& op)	{ return math::detail::fast_map(op, &fast::exp2); }
+
+template<typename T, int N>
+ScalarPacket<T, N> log2(const ScalarPacket<T, N>& op)	{ return math::detail::fast_map(op, &fast::log2); }
+
+template<typename T, int N>
+ScalarPacket<T, N> atan2(const ScalarPacket<T, N>& y, const ScalarPacket<T, N>& x)
+{
+	return math::detail::fast_map(y, x, &fast::atan2);
+}
+
+template<typename T, int N>
+ScalarPacket<T, N> pow(const ScalarPacket<T, N>& op, const ScalarPacket<T, N>& exponent)
+{
+	return math::detail::fast_map(op, exponent, &fast::pow);
+}
+
+} // namespace fast
+
+//-------------------------------------//
+
+template<typename T, int S, int N>
+class VectorPacket;
+
+namespace detail {
+
+	// AoS to SoA, index == 0 reads src[0..N-1]
+	template<typename T, int S, int N>
+	inline void gather(VectorPacket<T, S, N>& dst, const Vector<T, S>* src, const int* index)
+	{
+		for (int i=0; i < N; ++i)
+		{
+			const Vector<T, S>& v = src[index ? index[i] : i];
+
+			for (int c=0; c < S; ++c)
+				dst.component_[c].element_[i] = v.element_[c];
+		}
+	}
+
+	template<typename T, int S, int N>
+	inline void scatter(const VectorPacket<T, S, N>& src, Vector<T, S>* dst, const int* index)
+	{
+		for (int i=0; i < N; ++i)
+		{
+			Vector<T, S>& v = dst[index ? index[i] : i];
+
+			for (int c=0; c < S; ++c)
+				v.element_[c] = src.component_[c].element_[i];
+		}
+	}
+
+#if defined(DEIMOS_SSE2)
+
+	// four vectors at a time are transposed in registers
+	template<int S, int N>
+	inline void gather_transpose(VectorPacket<float, S, N>& dst, const Vector<float, S>* src, const int* index)
+	{
+		for (int i=0; i < N; i+=4)
+		{
+			__m128 r0 = src[index ? index[i+0] : i+0].load();
+			__m128 r1 = src[index ? index[i+1] : i+1].load();
+			__m128 r2 = src[index ? index[i+2] : i+2].load();
+			__m128 r3 = src[index ? index[i+3] : i+3].load();
+
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			_mm_storeu_ps(dst.component_[0].element_ + i, r0);
+			_mm_storeu_ps(dst.component_[1].element_ + i, r1);
+			_mm_storeu_ps(dst.component_[2].element_ + i, r2);
+
+			if (S == 4)
+				_mm_storeu_ps(dst.component_[S-1].element_ + i, r3);
+		}
+	}
+
+	template<int S, int N>
+	inline void scatter_transpose(const VectorPacket<float, S, N>& src, Vector<float, S>* dst, const int* index)
+	{
+		for (int i=0; i < N; i+=4)
+		{
+			__m128 r0 = _mm_loadu_ps(src.component_[0].element_ + i);
+			__m128 r1 = _mm_loadu_ps(src.component_[1].element_ + i);
+			__m128 r2 = _mm_loadu_ps(src.component_[2].element_ + i);
+			__m128 r3 = (S == 4) ? _mm_loadu_ps(src.component_[S-1].element_ + i) : _mm_setzero_ps();
+
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			dst[index ? index[i+0] : i+0].store(r0);
+			dst[index ? index[i+1] : i+1].store(r1);
+			dst[index ? index[i+2] : i+2].store(r2);
+			dst[index ? index[i+3] : i+3].store(r3);
+		}
+	}
+
+	template<int N>
+	inline void gather(VectorPacket<float, 3, N>& dst, const Vector<float, 3>* src, const int* index)
+	{
+		if (N % 4 == 0)
+			gather_transpose(dst, src, index);
+		else
+			gather<float, 3, N>(dst, src, index);
+	}
+
+	template<int N>
+	inline void gather(VectorPacket<float, 4, N>& dst, const Vector<float, 4>* src, const int* index)
+	{
+		if (N % 4 == 0)
+			gather_transpose(dst, src, index);
+		else
+			gather<float, 4, N>(dst, src, index);
+	}
+
+	template<int N>
+	inline void scatter(const VectorPacket<float, 3, N>& src, Vector<float, 3>* dst, const int* index)
+	{
+		if (N % 4 == 0)
+			scatter_transpose(src, dst, index);
+		else
+			scatter<float, 3, N>(src, dst, index);
+	}
+
+	template<int N>
+	inline void scatter(const VectorPacket<float, 4, N>& src, Vector<float, 4>* dst, const int* index)
+	{
+		if (N % 4 == 0)
+			scatter_transpose(src, dst, index);
+		else
+			scatter<float, 4, N>(src, dst, index);
+	}
+
+#endif // DEIMOS_SSE2
+
+} // namespace detail
+
+template<typename T, int S, int N>
+class VectorPacket
+{
+public:
+	typedef VectorPacket<T, S, N> Packet;
+	typedef ScalarPacket<T, N> Scalar;
+	typedef Vector<T, S> Vec;
+	Scalar component_[S];
+
+	// lanes in which all components are equal
+	inline unsigned int equal(const Packet& op) const
+	{
+		unsigned int mask = full_mask<N>();
+
+		for (int c=0; c < S; ++c)
+			mask &= component_[c].equal(op.component_[c]);
+
+		return mask;
+	};
+
+	inline const Packet operator+(const Packet& op) const
+	{
+		Packet res;
+
+		for (int c=0; c < S; ++c)
+			res.component_[c] = component_[c] + op.component_[c];
+
+		return res;
+	};
+
+	inline const Packet operator-(const Packet& op) const
+	{
+		Packet res;
+
+		for (int c=0; c < S; ++c)
+			res.component_[c] = component_[c] - op.component_[c];
+
+		return res;
+	};
+
+	// inner products, summed in component order like the generic Vector
+	inline const Scalar operator*(const Packet& op) const
+	{
+		Scalar res = component_[0] * op.component_[0];
+
+		for (int c=1; c < S; ++c)
+			res += component_[c] * op.component_[c];
+
+		return res;
+	};
+
+	inline const Packet operator*(const Scalar& op) const
+	{
+		Packet res;
+
+		for (int c=0; c < S; ++c)
+			res.component_[c] = component_[c] * op;
+
+		return res;
+	};
+
+	inline const Packet operator*(T op) const
+	{
+		Packet res;
+
+		for (int c=0; c < S; ++c)
+			res.component_[c] = component_[c] * op;
+
+		return res;
+	};
+
+	inline const Packet operator/(T op) const
+	{
+		return operator*(1/op);
+	};
+
+	inline void operator+=(const Packet& op)
+	{
+		for (int c=0; c < S; ++c)
+			component_[c] += op.component_[c];
+	};
+
+	inline void operator-=(const Packet& op)
+	{
+		for (int c=0; c < S; ++c)
+			component_[c] -= op.component_[c];
+	};
+
+	inline void operator*=(const Scalar& op)
+	{
+		for (int c=0; c < S; ++c)
+			component_[c] *= op;
+	};
+
+	inline void operator*=(T op)
+	{
+		for (int c=0; c < S; ++c)
+			component_[c] *= op;
+	};
+
+	inline void operator/=(T op)
+	{
+		operator*=(1/op);
+	};
+
+	// all lanes of component n
+	inline const Scalar& operator[](int n) const
+	{
+		assert(n >= 0 && n < S);
+		return component_[n];
+	};
+
+	inline Scalar& operator[](int n)
+	{
+		assert(n >= 0 && n < S);
+		return component_[n];
+	};
+
+	inline Scalar size_sqr() const
+	{
+		return (*this * *this);
+	};
+
+	inline Scalar size() const
+	{
+		return sqrt(size_sqr());
+	};
+
+	// lanes with zero length become NaN
+	inline void normalize()
+	{
+		*this *= Scalar::broadcast(1) / size();
+	};
+
+	inline void normalize(exact_math)
+	{
+		normalize();
+	};
+
+	inline void normalize(fast_math)
+	{
+		*this *= fast::rsqrt(size_sqr());
+	};
+
+	inline Packet project_to(const Packet& op) const
+	{
+		return op * ((*this * op) / op.size_sqr());
+	};
+
+	inline unsigned int is_parallel_to(const Packet& op) const
+	{
+		return op.project_to(*this).equal(op);
+	};
+
+	inline void clear(T op=0)
+	{
+		for (int c=0; c < S; ++c)
+			component_[c].clear(op);
+	};
+
+	// lane access
+	inline Vec get(int lane) const
+	{
+		assert(lane >= 0 && lane < N);
+
+		Vec res;
+
+		for (int c=0; c < S; ++c)
+			res.element_[c] = component_[c].element_[lane];
+
+		return res;
+	};
+
+	inline void set(int lane, const Vec& op)
+	{
+		assert(lane >= 0 && lane < N);
+
+		for (int c=0; c < S; ++c)
+			component_[c].element_[lane] = op.element_[c];
+	};
+
+	static inline Packet broadcast(const Vec& op)
+	{
+		Packet res;
+
+		for (int c=0; c < S; ++c)
+			res.component_[c].clear(op.element_[c]);
+
+		return res;
+	};
+
+	// loads src[0] .. src[N-1], or src[index[0]] .. src[index[N-1]]
+	inline void gather(const Vec* src, const int* index = 0)
+	{
+		detail::gather(*this, src, index);
+	};
+
+	// stores into dst[0] .. dst[N-1], or dst[index[0]] .. dst[index[N-1]]
+	inline void scatter(Vec* dst, const int* index = 0) const
+	{
+		detail::scatter(*this, dst, index);
+	};
+
+	// only stores the lanes set in mask
+	inline void scatter(Vec* dst, unsigned int mask, const int* index = 0) const
+	{
+		for (int i=0; i < N; ++i)
+			if (mask & (1u << i))
+				dst[index ? index[i] : i] = get(i);
+	};
+};
+
+template<typename T, int S, int N>
+VectorPacket<T, S, N> select(unsigned int mask, const VectorPacket<T, S, N>& op1, const VectorPacket<T, S, N>& op2)
+{
+	VectorPacket<T, S, N> res;
+
+	for (int c=0; c < S; ++c)
+		res.component_[c] = select(mask, op1.component_[c], op2.component_[c]);
+
+	return res;
+}
+
+template<typename T, int N>
+VectorPacket<T, 3, N> cross_product(const VectorPacket<T, 3, N>& op1, const VectorPacket<T, 3, N>& op2)
+{
+	VectorPacket<T, 3, N> res;
+
+	res.component_[0] = op1.component_[1]*op2.component_[2] - op1.component_[2]*op2.component_[1];
+	res.component_[1] = op1.component_[2]*op2.component_[0] - op1.component_[0]*op2.component_[2];
+	res.component_[2] = op1.component_[0]*op2.component_[1] - op1.component_[1]*op2.component_[0];
+
+	return res;
+}
+
+template<typename T, int N>
+VectorPacket<T, 4, N> cross_product(const VectorPacket<T, 4, N>& op1, const VectorPacket<T, 4, N>& op2)
+{
+	VectorPacket<T, 4, N> res;
+
+	res.component_[0] = op1.component_[1]*op2.component_[2] - op1.component_[2]*op2.component_[1];
+	res.component_[1] = op1.component_[2]*op2.component_[0] - op1.component_[0]*op2.component_[2];
+	res.component_[2] = op1.component_[0]*op2.component_[1] - op1.component_[1]*op2.component_[0];
+	res.component_[3].clear();
+
+	return res;
+}
+
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_PACKET__
@@ -2,6 +2,10 @@
  * Deimos tool library - Tobias Alexander Franke 2003
  * For copyright and license see LICENSE
  * http://www.tobias-franke.eu
+ *
+ * Quaternions are PODs with the components in the order x, y, z, w, so arrays
+ * of them can be copied and stored as raw memory. The batch functions at the
+ * end work on such arrays through VectorPacket lanes.
  */
 
 #if !defined(DEIMOS_MATH_QUAT__)
@@ -9,8 +13,12 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+
+#include "config.h"
 #include "vector.h"
 #include "matrix.h"
+#include "packet.h"
 
 namespace deimos {
 namespace math {
@@ -18,36 +26,76 @@ namespace math {
 template<typename T>
 class Quaternion
 {
+public:
 	typedef Quaternion<T> Quat;
 	typedef Matrix<T, 3> Mat3;
 	typedef Matrix<T, 4> Mat4;
 	typedef Vector<T, 3> Vec3;
 
-protected:
-	T x, y, z, w;
+	T x_, y_, z_, w_;
 
-public:
-	virtual ~Quaternion() {};
+	DEIMOS_CONSTEXPR bool operator==(const Quat& op) const
+	{
+		return x_ == op.x_ && y_ == op.y_ && z_ == op.z_ && w_ == op.w_;
+	};
 
-	Quat operator*(const Quat& op) const
+	DEIMOS_CONSTEXPR const Quat operator+(const Quat& op) const
 	{
-		Quat res;
+		Quat res = { x_ + op.x_, y_ + op.y_, z_ + op.z_, w_ + op.w_ };
+		return res;
+	};
 
-		res.x = y*op.z - z*op.y + w*op.x + x*op.w;
-		res.y = z*op.x - x*op.z + w*op.y + y*op.w;
-		res.z = x*op.y - y*op.x + w*op.z + z*op.w;
-		res.w = w*op.w - x*op.x - y*op.y - z*op.z;
+	DEIMOS_CONSTEXPR const Quat operator-(const Quat& op) const
+	{
+		Quat res = { x_ - op.x_, y_ - op.y_, z_ - op.z_, w_ - op.w_ };
+		return res;
+	};
 
+	DEIMOS_CONSTEXPR const Quat operator-() const
+	{
+		Quat res = { -x_, -y_, -z_, -w_ };
+		return res;
+	};
+
+	DEIMOS_CONSTEXPR const Quat operator*(T op) const
+	{
+		Quat res = { x_*op, y_*op, z_*op, w_*op };
 		return res;
 	};
 
+	DEIMOS_CONSTEXPR const Quat operator*(const Quat& op) const
+	{
+		Quat res = Quat();
+
+		res.x_ = y_*op.z_ - z_*op.y_ + w_*op.x_ + x_*op.w_;
+		res.y_ = z_*op.x_ - x_*op.z_ + w_*op.y_ + y_*op.w_;
+		res.z_ = x_*op.y_ - y_*op.x_ + w_*op.z_ + z_*op.w_;
+		res.w_ = w_*op.w_ - x_*op.x_ - y_*op.y_ - z_*op.z_;
+
+		return res;
+	};
+
+	DEIMOS_CONSTEXPR void operator*=(T op)
+	{
+		x_*=op;
+		y_*=op;
+		z_*=op;
+		w_*=op;
+	};
+
+	// 4D inner product
+	DEIMOS_CONSTEXPR T dot(const Quat& op) const
+	{
+		return x_*op.x_ + y_*op.y_ + z_*op.z_ + w_*op.w_;
+	};
+
 	Mat3 unit_to_matrix() const
 	{
 		Mat3 res;
 
-		res(0,0)=1-2*(y*y + z*z);	res(0,1)=2*(x*y - w*z);		res(0,2)=2*(w*y + x*z);
-		res(1,0)=2*(x*y + w*z);		res(1,1)=1-2*(x*x + z*z);	res(1,2)=2*(y*z - w*x);
-		res(2,0)=2*(x*z - w*y);		res(2,1)=2*(y*z + w*x);		res(2,2)=1-2*(x*x+y*y);
+		res[0][0]=1-2*(y_*y_ + z_*z_);	res[0][1]=2*(x_*y_ - w_*z_);	res[0][2]=2*(w_*y_ + x_*z_);
+		res[1][0]=2*(x_*y_ + w_*z_);	res[1][1]=1-2*(x_*x_ + z_*z_);	res[1][2]=2*(y_*z_ - w_*x_);
+		res[2][0]=2*(x_*z_ - w_*y_);	res[2][1]=2*(y_*z_ + w_*x_);	res[2][2]=1-2*(x_*x_ + y_*y_);
 
 		return res;
 	};
@@ -56,56 +104,123 @@ public:
 	{
 		Mat3 res;
 
-		res(0,0)=w*w+x*x-y*y-z*z;	res(0,1)=2*(x*y - w*z);		res(0,2)=2*(w*y + x*z);
-		res(1,0)=2*(x*y + w*z);		res(1,1)=w*w-x*x+y*y-z*z;	res(1,2)=2*(y*z - w*x);
-		res(2,0)=2*(x*z - w*y);		res(2,1)=2*(y*z + w*x);		res(2,2)=w*w-x*x-y*y+z*z;
+		res[0][0]=w_*w_+x_*x_-y_*y_-z_*z_;	res[0][1]=2*(x_*y_ - w_*z_);		res[0][2]=2*(w_*y_ + x_*z_);
+		res[1][0]=2*(x_*y_ + w_*z_);		res[1][1]=w_*w_-x_*x_+y_*y_-z_*z_;	res[1][2]=2*(y_*z_ - w_*x_);
+		res[2][0]=2*(x_*z_ - w_*y_);		res[2][1]=2*(y_*z_ + w_*x_);		res[2][2]=w_*w_-x_*x_-y_*y_+z_*z_;
+
+		return res;
+	};
+
+	// rotation in the upper 3x3 part, no translation
+	Mat4 unit_to_matrix4() const
+	{
+		const Mat3 rot = unit_to_matrix();
+
+		Mat4 res;
+		res.identity();
+
+		for (int i=0; i < 3; ++i)
+			for (int j=0; j < 3; ++j)
+				res[i][j] = rot[i][j];
 
 		return res;
 	};
 
-	void from_matrix(Mat3 op)
+	/*
+	 * Unit quaternion of a rotation matrix. The largest of w, x, y, z is
+	 * computed from the diagonal first and the others are divided by it, which
+	 * keeps the result accurate for rotations close to 180 degrees.
+	 */
+	void from_matrix(const Mat3& op)
 	{
-		assert(op.Trace() > 0);
+		const T trace = op.trace();
 
-		// TODO
+		if (trace > 0)
+		{
+			const T s = static_cast<T>(std::sqrt(trace + 1) * 2);
+			w_ = s / 4;
+			x_ = (op[2][1] - op[1][2]) / s;
+			y_ = (op[0][2] - op[2][0]) / s;
+			z_ = (op[1][0] - op[0][1]) / s;
+		}
+		else if (op[0][0] > op[1][1] && op[0][0] > op[2][2])
+		{
+			const T s = static_cast<T>(std::sqrt(1 + op[0][0] - op[1][1] - op[2][2]) * 2);
+			w_ = (op[2][1] - op[1][2]) / s;
+			x_ = s / 4;
+			y_ = (op[0][1] + op[1][0]) / s;
+			z_ = (op[0][2] + op[2][0]) / s;
+		}
+		else if (op[1][1] > op[2][2])
+		{
+			const T s = static_cast<T>(std::sqrt(1 + op[1][1] - op[0][0] - op[2][2]) * 2);
+			w_ = (op[0][2] - op[2][0]) / s;
+			x_ = (op[0][1] + op[1][0]) / s;
+			y_ = s / 4;
+			z_ = (op[1][2] + op[2][1]) / s;
+		}
+		else
+		{
+			const T s = static_cast<T>(std::sqrt(1 + op[2][2] - op[0][0] - op[1][1]) * 2);
+			w_ = (op[1][0] - op[0][1]) / s;
+			x_ = (op[0][2] + op[2][0]) / s;
+			y_ = (op[1][2] + op[2][1]) / s;
+			z_ = s / 4;
+		}
 	};
 
-	void set(Vec3 axis, T angle)
+	// axis must be normalized
+	void set(const Vec3& axis, T angle)
 	{
 		T sinus = std::sin(angle/2);
 		T cosinus = std::cos(angle/2);
 
-		x = axis[0] * sinus;
-		y = axis[1] * sinus;
-		z = axis[2] * sinus;
+		x_ = axis[0] * sinus;
+		y_ = axis[1] * sinus;
+		z_ = axis[2] * sinus;
+
+		w_ = cosinus;
+	};
 
-		w = cosinus;
+	DEIMOS_CONSTEXPR void identity()
+	{
+		x_ = y_ = z_ = 0;
+		w_ = 1;
 	};
 
-	T length() const
+	// squared length
+	DEIMOS_CONSTEXPR T length() const
 	{
-		return w*w+x*x+y*y+z*z;
+		return dot(*this);
 	};
 
-	void unit_invert()
+	void normalize()
 	{
-		x=-x;
-		y=-y;
-		z=-z;
+		assert(length());
+		*this *= static_cast<T>(1/std::sqrt(length()));
 	};
 
-	void invert()
+	// conjugate, the inverse of a unit quaternion
+	DEIMOS_CONSTEXPR void unit_invert()
+	{
+		x_=-x_;
+		y_=-y_;
+		z_=-z_;
+	};
+
+	DEIMOS_CONSTEXPR void invert()
 	{
 		const T l = length();
 
 		unit_invert();
 
-		x/=l;
-		y/=l;
-		z/=l;
+		x_/=l;
+		y_/=l;
+		z_/=l;
+		w_/=l;
 	};
 
-	Quat inverse() const
+	DEIMOS_CONSTEXPR Quat inverse() const
 	{
 		Quat res = *this;
 		res.invert();
@@ -113,8 +228,240 @@ public:
 		return res;
 	};
 
+	/*
+	 * Rotates op by this unit quaternion without building a matrix:
+	 * t = 2 (q.xyz x op), op' = op + w t + q.xyz x t
+	 */
+	DEIMOS_CONSTEXPR Vec3 rotate(const Vec3& op) const
+	{
+		const Vec3 u = {{ x_, y_, z_ }};
+		const Vec3 t = cross_product(u, op) * T(2);
+
+		return op + t * w_ + cross_product(u, t);
+	};
 };
 
+//-------------------------------------//
+
+// normalized linear interpolation along the shorter arc
+template<typename T>
+Quaternion<T> nlerp(const Quaternion<T>& op1, const Quaternion<T>& op2, T t)
+{
+	const Quaternion<T> b = (op1.dot(op2) < 0) ? -op2 : op2;
+
+	Quaternion<T> res = op1*(1-t) + b*t;
+	res.normalize();
+
+	return res;
+}
+
+namespace detail {
+
+	// above this cosine slerp falls back to nlerp, sin(theta) is too small to divide by
+	template<typename T>
+	inline T slerp_threshold()
+	{
+		return T(0.9995);
+	}
+
+	// weights of op1 and op2 for slerp, the cosine between them must be >= 0
+	template<typename T>
+	inline void slerp_weights(T cosine, T t, T& k1, T& k2)
+	{
+		if (cosine > slerp_threshold<T>())
+		{
+			k1 = 1-t;
+			k2 = t;
+			return;
+		}
+
+		const T theta = static_cast<T>(std::acos(cosine));
+		const T inv_sin = static_cast<T>(1/std::sin(theta));
+
+		k1 = static_cast<T>(std::sin((1-t) * theta) * inv_sin);
+		k2 = static_cast<T>(std::sin(t * theta) * inv_sin);
+	}
+
+} // namespace detail
+
+// spherical linear interpolation along the shorter arc, inputs must be unit quaternions
+template<typename T>
+Quaternion<T> slerp(const Quaternion<T>& op1, const Quaternion<T>& op2, T t)
+{
+	T cosine = op1.dot(op2);
+	const Quaternion<T> b = (cosine < 0) ? -op2 : op2;
+
+	if (cosine < 0)
+		cosine = -cosine;
+
+	if (cosine > detail::slerp_threshold<T>())
+		return nlerp(op1, b, t);
+
+	T k1, k2;
+	detail::slerp_weights(cosine, t, k1, k2);
+
+	return op1*k1 + b*k2;
+}
+
+//-------------------------------------//
+
+namespace detail {
+
+	// lanes per packet in the batch functions
+	const int QUATERNION_PACKET = 8;
+
+	template<typename T, int N>
+	inline void gather(VectorPacket<T, 4, N>& dst, const Quaternion<T>* src)
+	{
+		for (int i=0; i < N; ++i)
+		{
+			dst.component_[0].element_[i] = src[i].x_;
+			dst.component_[1].element_[i] = src[i].y_;
+			dst.component_[2].element_[i] = src[i].z_;
+			dst.component_[3].element_[i] = src[i].w_;
+		}
+	}
+
+	template<typename T, int N>
+	inline void scatter(const VectorPacket<T, 4, N>& src, Quaternion<T>* dst)
+	{
+		for (int i=0; i < N; ++i)
+		{
+			dst[i].x_ = src.component_[0].element_[i];
+			dst[i].y_ = src.component_[1].element_[i];
+			dst[i].z_ = src.component_[2].element_[i];
+			dst[i].w_ = src.component_[3].element_[i];
+		}
+	}
+
+	// op2 negated in the lanes where it points away from op1
+	template<typename T, int N>
+	inline ScalarPacket<T, N> align_signs(const VectorPacket<T, 4, N>& op1, VectorPacket<T, 4, N>& op2)
+	{
+		const ScalarPacket<T, N> zero = ScalarPacket<T, N>::broadcast(0);
+
+		ScalarPacket<T, N> cosine = op1 * op2;
+		const unsigned int flip = cosine.less(zero);
+
+		op2 = select(flip, op2 * T(-1), op2);
+		cosine = select(flip, zero - cosine, cosine);
+
+		return cosine;
+	}
+
+} // namespace detail
+
+// dst[i] = nlerp(op1[i], op2[i], t)
+template<typename T>
+void nlerp(const Quaternion<T>* op1, const Quaternion<T>* op2, T t, Quaternion<T>* dst, size_t count)
+{
+	enum { N = detail::QUATERNION_PACKET };
+
+	size_t i = 0;
+
+	for (; i + N <= count; i += N)
+	{
+		VectorPacket<T, 4, N> a, b;
+		detail::gather(a, op1 + i);
+		detail::gather(b, op2 + i);
+
+		detail::align_signs(a, b);
+
+		VectorPacket<T, 4, N> res = a*(1-t) + b*t;
+		res.normalize();
+
+		detail::scatter(res, dst + i);
+	}
+
+	for (; i < count; ++i)
+		dst[i] = nlerp(op1[i], op2[i], t);
+}
+
+// dst[i] = slerp(op1[i], op2[i], t), the trigonometric weights are computed per lane
+template<typename T>
+void slerp(const Quaternion<T>* op1, const Quaternion<T>* op2, T t, Quaternion<T>* dst, size_t count)
+{
+	enum { N = detail::QUATERNION_PACKET };
+
+	size_t i = 0;
+
+	for (; i + N <= count; i += N)
+	{
+		VectorPacket<T, 4, N> a, b;
+		detail::gather(a, op1 + i);
+		detail::gather(b, op2 + i);
+
+		const ScalarPacket<T, N> cosine = detail::align_signs(a, b);
+
+		ScalarPacket<T, N> k1, k2;
+		unsigned int linear = 0;
+
+		for (int j=0; j < N; ++j)
+		{
+			detail::slerp_weights(cosine[j], t, k1[j], k2[j]);
+
+			if (cosine[j] > detail::slerp_threshold<T>())
+				linear |= 1u << j;
+		}
+
+		VectorPacket<T, 4, N> res = a*k1 + b*k2;
+
+		// nearly identical rotations are interpolated linearly and renormalized like nlerp
+		if (linear)
+		{
+			VectorPacket<T, 4, N> normalized = res;
+			normalized.normalize();
+			res = select(linear, normalized, res);
+		}
+
+		detail::scatter(res, dst + i);
+	}
+
+	for (; i < count; ++i)
+		dst[i] = slerp(op1[i], op2[i], t);
+}
+
+// dst[i] = op.rotate(src[i]), src and dst may be the same array
+template<typename T>
+void rotate(const Quaternion<T>& op, const Vector<T, 3>* src, Vector<T, 3>* dst, size_t count)
+{
+	// the matrix needs 9 multiplications per vector, the quaternion 18
+	const Matrix<T, 3> m = op.unit_to_matrix();
+
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = m * src[i];
+}
+
+// dst[i] = op[i].rotate(src[i])
+template<typename T>
+void rotate(const Quaternion<T>* op, const Vector<T, 3>* src, Vector<T, 3>* dst, size_t count)
+{
+	enum { N = detail::QUATERNION_PACKET };
+
+	size_t i = 0;
+
+	for (; i + N <= count; i += N)
+	{
+		VectorPacket<T, 4, N> q;
+		detail::gather(q, op + i);
+
+		VectorPacket<T, 3, N> u, v;
+		u.component_[0] = q.component_[0];
+		u.component_[1] = q.component_[1];
+		u.component_[2] = q.component_[2];
+
+		v.gather(src + i);
+
+		const VectorPacket<T, 3, N> t = cross_product(u, v) * T(2);
+		const VectorPacket<T, 3, N> res = v + t * q.component_[3] + cross_product(u, t);
+
+		res.scatter(dst + i);
+	}
+
+	for (; i < count; ++i)
+		dst[i] = op[i].rotate(src[i]);
+}
+
 } // namespace math
 } // namespace deimos
 
@@ -7,7 +7,7 @@
 #if !defined(DEIMOS_MATH_RAY__)
 #define DEIMOS_MATH_RAY__
 
-#include "Vector.h"
+#include "vector.h"
 
 namespace deimos {
 namespace math {
@@ -0,0 +1,487 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Casts rays of a camera or a batch into a scene on a TaskPool and stores the
+ * closest hit of every ray in a HitBuffer. Camera images are cut into square
+ * screen tiles, one task each, so idle workers steal whole tiles and coherent
+ * rays stay on one core:
+ *
+ *   thread::TaskPool pool;
+ *   RayCaster<float> caster(pool);
+ *   PrimitiveList< float, Triangle<float, 4> > scene(triangles, count);
+ *   HitBuffer<float> hits;
+ *   caster.cast(scene, camera, 640, 480, hits);
+ *   write_depth(hits, 640, 480, 100.f, tga);
+ *
+ * A scene is anything with a const member
+ *
+ *   bool closest_hit(const Ray<T,4>& ray, intersection_point<T>& hit, size_t& primitive) const;
+ *
+ * that may be called from several threads at once. cast_occlusion() needs
+ *
+ *   bool occluded(const Ray<T,4>& ray, T t_max) const;
+ *
+ * instead, true if anything is hit closer than t_max.
+ */
+
+#if !defined(DEIMOS_MATH_RAY_CASTER__)
+#define DEIMOS_MATH_RAY_CASTER__
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "../memory/aligned_array.h"
+#include "../thread/task_pool.h"
+#include "intersect.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "vector.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+template<typename T>
+class PinholeCamera
+{
+public:
+	typedef Vector<T, 4> Vec;
+
+	// right_ and up_ span half the image plane at distance 1 in front of position_
+	Vec position_, forward_, right_, up_;
+
+	// fov_y in radians, aspect is width/height
+	static PinholeCamera look_at(const Vec& position, const Vec& target, const Vec& up, T fov_y, T aspect)
+	{
+		PinholeCamera res;
+
+		const T h = std::tan(fov_y/2);
+
+		res.position_ = position;
+		res.forward_ = target - position;
+		res.forward_.normalize();
+
+		res.right_ = cross_product(res.forward_, up);
+		res.right_.normalize();
+		res.up_ = cross_product(res.right_, res.forward_);
+
+		res.right_ *= h*aspect;
+		res.up_ *= h;
+
+		return res;
+	};
+
+	// normalized ray through image coordinates (u, v) in [0, 1], v pointing down
+	Ray<T, 4> generate_ray(T u, T v) const
+	{
+		Ray<T, 4> res;
+		res.origin_ = position_;
+		res.direction_ = forward_ + right_*(2*u - 1) + up_*(1 - 2*v);
+		res.direction_.normalize();
+		return res;
+	};
+};
+
+// closest hit by testing every primitive, for small scenes
+template<typename T, class P>
+class PrimitiveList
+{
+protected:
+	const P* primitives_;
+	size_t size_;
+
+public:
+	PrimitiveList(const P* primitives, size_t size) : primitives_(primitives), size_(size) {};
+
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive) const
+	{
+		hit.valid_ = false;
+		hit.distance_ = std::numeric_limits<T>::infinity();
+		primitive = NO_HIT;
+
+		for (size_t i=0; i < size_; ++i)
+		{
+			const intersection_point<T> p = intersect(primitives_[i], ray);
+
+			if (p.valid_ && p.distance_ < hit.distance_)
+			{
+				hit = p;
+				primitive = i;
+			}
+		}
+
+		return hit.valid_;
+	};
+
+	bool occluded(const Ray<T, 4>& ray, T t_max) const
+	{
+		for (size_t i=0; i < size_; ++i)
+			if (geometry::occluded(primitives_[i], ray, t_max))
+				return true;
+
+		return false;
+	};
+
+	// closest hits of the lanes in mask, returns the lanes that hit
+	template<int N>
+	unsigned int closest_hit(const RayPacket<T, N>& rays, unsigned int mask, PacketHit<T, N>& hits) const
+	{
+		hits.clear();
+
+		for (size_t i=0; i < size_; ++i)
+			intersect(primitives_[i], rays, mask, hits, i);
+
+		hits.finish(primitives_, rays);
+
+		return hits.valid_;
+	};
+};
+
+// one entry per ray or pixel (row-major), misses have NO_HIT and an infinite distance
+template<typename T>
+struct HitBuffer
+{
+	memory::AlignedArray<T> distance_;
+	memory::AlignedArray< Vector<T, 4> > normal_;
+	memory::AlignedArray<size_t> primitive_;
+
+	void resize(size_t n)
+	{
+		distance_.resize(n);
+		normal_.resize(n);
+		primitive_.resize(n);
+	};
+
+	inline size_t size() const { return primitive_.size(); };
+
+	inline void set(size_t n, const intersection_point<T>& hit, size_t primitive)
+	{
+		if (hit.valid_)
+		{
+			distance_[n] = hit.distance_;
+			normal_[n] = hit.normal_;
+			primitive_[n] = primitive;
+		}
+		else
+		{
+			distance_[n] = std::numeric_limits<T>::infinity();
+			normal_[n].clear();
+			primitive_[n] = NO_HIT;
+		}
+	};
+
+	// lane of a finished PacketHit
+	template<int N>
+	inline void set(size_t n, const PacketHit<T, N>& hits, int lane)
+	{
+		if (hits.valid_ & (1u << lane))
+		{
+			distance_[n] = hits.distance_[lane];
+			normal_[n] = hits.normal_[lane];
+			primitive_[n] = hits.primitive_[lane];
+		}
+		else
+		{
+			distance_[n] = std::numeric_limits<T>::infinity();
+			normal_[n].clear();
+			primitive_[n] = NO_HIT;
+		}
+	};
+};
+
+//-------------------------------------//
+
+namespace detail {
+
+	template<typename T, class S>
+	struct CameraTileTask
+	{
+		const S* scene_;
+		const PinholeCamera<T>* camera_;
+		HitBuffer<T>* hits_;
+		unsigned int width_, height_, tile_size_, tiles_x_;
+
+		void operator()(size_t first, size_t last) const
+		{
+			const T inv_width = T(1)/width_;
+			const T inv_height = T(1)/height_;
+
+			for (size_t tile=first; tile < last; ++tile)
+			{
+				const unsigned int x0 = static_cast<unsigned int>(tile % tiles_x_) * tile_size_;
+				const unsigned int y0 = static_cast<unsigned int>(tile / tiles_x_) * tile_size_;
+				const unsigned int x1 = std::min(x0 + tile_size_, width_);
+				const unsigned int y1 = std::min(y0 + tile_size_, height_);
+
+				for (unsigned int y=y0; y < y1; ++y)
+					for (unsigned int x=x0; x < x1; ++x)
+					{
+						const Ray<T, 4> ray = camera_->generate_ray((x + T(0.5))*inv_width, (y + T(0.5))*inv_height);
+
+						intersection_point<T> hit;
+						size_t primitive;
+						scene_->closest_hit(ray, hit, primitive);
+
+						hits_->set(size_t(y)*width_ + x, hit, primitive);
+					}
+			}
+		};
+	};
+
+	template<typename T, class S>
+	struct RayBatchTask
+	{
+		const S* scene_;
+		const Ray<T, 4>* rays_;
+		HitBuffer<T>* hits_;
+
+		void operator()(size_t first, size_t last) const
+		{
+			for (size_t i=first; i < last; ++i)
+			{
+				intersection_point<T> hit;
+				size_t primitive;
+				scene_->closest_hit(rays_[i], hit, primitive);
+
+				hits_->set(i, hit, primitive);
+			}
+		};
+	};
+
+	// t_max_[i*t_max_step_] for ray i, 1 in occluded_ if it is occluded
+	template<typename T, class S>
+	struct OcclusionBatchTask
+	{
+		const S* scene_;
+		const Ray<T, 4>* rays_;
+		const T* t_max_;
+		size_t t_max_step_;
+		unsigned char* occluded_;
+
+		void operator()(size_t first, size_t last) const
+		{
+			for (size_t i=first; i < last; ++i)
+				occluded_[i] = scene_->occluded(rays_[i], t_max_[i*t_max_step_]) ? 1 : 0;
+		};
+	};
+
+	// N pixels of a tile row per packet
+	template<typename T, int N, class S>
+	struct CameraPacketTask
+	{
+		const S* scene_;
+		const PinholeCamera<T>* camera_;
+		HitBuffer<T>* hits_;
+		unsigned int width_, height_, tile_size_, tiles_x_;
+
+		void operator()(size_t first, size_t last) const
+		{
+			const T inv_width = T(1)/width_;
+			const T inv_height = T(1)/height_;
+
+			RayPacket<T, N> rays;
+			PacketHit<T, N> hits;
+
+			for (size_t tile=first; tile < last; ++tile)
+			{
+				const unsigned int x0 = static_cast<unsigned int>(tile % tiles_x_) * tile_size_;
+				const unsigned int y0 = static_cast<unsigned int>(tile / tiles_x_) * tile_size_;
+				const unsigned int x1 = std::min(x0 + tile_size_, width_);
+				const unsigned int y1 = std::min(y0 + tile_size_, height_);
+
+				for (unsigned int y=y0; y < y1; ++y)
+					for (unsigned int x=x0; x < x1; x+=N)
+					{
+						const int count = static_cast<int>(std::min<unsigned int>(N, x1 - x));
+
+						for (int i=0; i < N; ++i)
+						{
+							const unsigned int px = x + std::min(i, count-1);
+							rays.set(i, camera_->generate_ray((px + T(0.5))*inv_width, (y + T(0.5))*inv_height));
+						}
+
+						scene_->closest_hit(rays, full_mask<N>() >> (N - count), hits);
+
+						for (int i=0; i < count; ++i)
+							hits_->set(size_t(y)*width_ + x + i, hits, i);
+					}
+			}
+		};
+	};
+
+	template<typename T, int N, class S>
+	struct RayPacketBatchTask
+	{
+		const S* scene_;
+		const Ray<T, 4>* rays_;
+		HitBuffer<T>* hits_;
+
+		void operator()(size_t first, size_t last) const
+		{
+			RayPacket<T, N> rays;
+			PacketHit<T, N> hits;
+
+			for (size_t i=first; i < last; i+=N)
+			{
+				const int count = static_cast<int>(std::min<size_t>(N, last - i));
+
+				scene_->closest_hit(rays, rays.load(rays_ + i, count), hits);
+
+				for (int j=0; j < count; ++j)
+					hits_->set(i + j, hits, j);
+			}
+		};
+	};
+
+} // namespace detail
+
+template<typename T>
+class RayCaster
+{
+protected:
+	thread::TaskPool& pool_;
+	unsigned int tile_size_;
+	size_t batch_grain_;
+
+public:
+	// tile_size x tile_size pixels or batch_grain rays per task
+	explicit RayCaster(thread::TaskPool& pool, unsigned int tile_size = 16, size_t batch_grain = 256) :
+		pool_(pool), tile_size_(tile_size), batch_grain_(batch_grain)
+	{
+		assert(tile_size_ > 0 && batch_grain_ > 0);
+	};
+
+	inline unsigned int get_tile_size() const { return tile_size_; };
+
+	template<class S>
+	void cast(const S& scene, const PinholeCamera<T>& camera, unsigned int width, unsigned int height, HitBuffer<T>& hits) const
+	{
+		hits.resize(size_t(width) * height);
+
+		const unsigned int tiles_x = (width + tile_size_ - 1) / tile_size_;
+		const unsigned int tiles_y = (height + tile_size_ - 1) / tile_size_;
+
+		detail::CameraTileTask<T, S> task = { &scene, &camera, &hits, width, height, tile_size_, tiles_x };
+		thread::parallel_for(pool_, 0, size_t(tiles_x) * tiles_y, 1, task);
+	};
+
+	template<class S>
+	void cast(const S& scene, const Ray<T, 4>* rays, size_t n, HitBuffer<T>& hits) const
+	{
+		hits.resize(n);
+
+		detail::RayBatchTask<T, S> task = { &scene, rays, &hits };
+		thread::parallel_for(pool_, 0, n, batch_grain_, task);
+	};
+
+	/*
+	 * Occlusion of a batch of shadow or ambient occlusion rays, occluded[i]
+	 * is 1 if ray i hits anything closer than t_max[i] and 0 otherwise.
+	 */
+	template<class S>
+	void cast_occlusion(const S& scene, const Ray<T, 4>* rays, const T* t_max, size_t n, memory::AlignedArray<unsigned char>& occluded) const
+	{
+		occluded.resize(n);
+
+		detail::OcclusionBatchTask<T, S> task = { &scene, rays, t_max, 1, occluded.data() };
+		thread::parallel_for(pool_, 0, n, batch_grain_, task);
+	};
+
+	// the same with one t_max for all rays
+	template<class S>
+	void cast_occlusion(const S& scene, const Ray<T, 4>* rays, T t_max, size_t n, memory::AlignedArray<unsigned char>& occluded) const
+	{
+		occluded.resize(n);
+
+		detail::OcclusionBatchTask<T, S> task = { &scene, rays, &t_max, 0, occluded.data() };
+		thread::parallel_for(pool_, 0, n, batch_grain_, task);
+	};
+
+	/*
+	 * The same with packets of N coherent rays, for scenes that also have
+	 *
+	 *   unsigned int closest_hit(const RayPacket<T,N>& rays, unsigned int mask, PacketHit<T,N>& hits) const;
+	 *
+	 * returning finished hits for the lanes in mask. Tile rows are cut into
+	 * packets of N pixels, batches into packets of N consecutive rays.
+	 */
+	template<int N, class S>
+	void cast_packets(const S& scene, const PinholeCamera<T>& camera, unsigned int width, unsigned int height, HitBuffer<T>& hits) const
+	{
+		hits.resize(size_t(width) * height);
+
+		const unsigned int tiles_x = (width + tile_size_ - 1) / tile_size_;
+		const unsigned int tiles_y = (height + tile_size_ - 1) / tile_size_;
+
+		detail::CameraPacketTask<T, N, S> task = { &scene, &camera, &hits, width, height, tile_size_, tiles_x };
+		thread::parallel_for(pool_, 0, size_t(tiles_x) * tiles_y, 1, task);
+	};
+
+	template<int N, class S>
+	void cast_packets(const S& scene, const Ray<T, 4>* rays, size_t n, HitBuffer<T>& hits) const
+	{
+		hits.resize(n);
+
+		// whole packets per task
+		const size_t grain = (batch_grain_ + N - 1) / N * N;
+
+		detail::RayPacketBatchTask<T, N, S> task = { &scene, rays, &hits };
+		thread::parallel_for(pool_, 0, n, grain, task);
+	};
+};
+
+//-------------------------------------//
+
+/*
+ * Hit buffers of width x height pixels as images. I is any Image, which is
+ * resized; depth is 255 at the camera and 0 at max_distance and beyond,
+ * normal component i is mapped from [-1, 1] to [0, 255] in byte i of a texel.
+ */
+template<typename T, class I>
+void write_depth(const HitBuffer<T>& hits, unsigned int width, unsigned int height, T max_distance, I& image)
+{
+	assert(hits.size() == size_t(width) * height);
+
+	image.create(width, height, 1);
+
+	for (unsigned int y=0; y < height; ++y)
+		for (unsigned int x=0; x < width; ++x)
+		{
+			const T d = hits.distance_[size_t(y)*width + x];
+			const T s = (d < max_distance) ? 1 - d/max_distance : 0;
+			const unsigned char c = static_cast<unsigned char>(s*255 + T(0.5));
+
+			image.set_color(x, y, &c);
+		}
+}
+
+template<typename T, class I>
+void write_normals(const HitBuffer<T>& hits, unsigned int width, unsigned int height, I& image)
+{
+	assert(hits.size() == size_t(width) * height);
+
+	image.create(width, height, 3);
+
+	for (unsigned int y=0; y < height; ++y)
+		for (unsigned int x=0; x < width; ++x)
+		{
+			const Vector<T, 4>& n = hits.normal_[size_t(y)*width + x];
+			unsigned char c[3];
+
+			for (int i=0; i < 3; ++i)
+				c[i] = static_cast<unsigned char>((std::max(T(-1), std::min(T(1), n[i]))*T(0.5) + T(0.5))*255 + T(0.5));
+
+			image.set_color(x, y, c);
+		}
+}
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_RAY_CASTER__
@@ -0,0 +1,466 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Packet versions of intersect() for 4 or 8 lanes. Either N rays are tested
+ * against one triangle or sphere, or one ray against N of them:
+ *
+ *   RayPacket<float, 8> rays;
+ *   unsigned int active = rays.load(shadow_rays, count);	// bit i for ray i
+ *   PacketHit<float, 8> hits;
+ *   hits.clear();
+ *   intersect(triangle, rays, active, hits, 0);				// closest hits so far
+ *
+ *   TrianglePacket<float, 8> block;
+ *   block.set(0, triangles[0]); ...
+ *   int lane = intersect(block, ray, block_mask, t_max, u, v);
+ *   unsigned int hit = occluded(spheres, ray, sphere_mask, t_max);
+ *
+ * Both run the same operations and tests as the scalar Möller-Trumbore and
+ * sphere code in intersect.h, so hits, distances and normals are the same as
+ * with intersect() to the bit, as long as the compiler doesn't contract
+ * products and sums into FMAs differently (-ffp-contract=off). Only x, y and
+ * z are used; points are expected to have w = 1 and directions w = 0.
+ */
+
+#if !defined(DEIMOS_MATH_RAY_PACKET__)
+#define DEIMOS_MATH_RAY_PACKET__
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+
+#include "intersect.h"
+#include "packet.h"
+#include "ray.h"
+#include "sphere.h"
+#include "triangle.h"
+#include "vector.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+// primitive index of rays that hit nothing
+const size_t NO_HIT = static_cast<size_t>(-1);
+
+template<typename T, int N>
+class RayPacket
+{
+public:
+	typedef VectorPacket<T, 3, N> Vec;
+	typedef ScalarPacket<T, N> Scalar;
+
+	Vec origin_, direction_;
+
+	// reciprocal direction for box tests, infinite along parallel axes
+	Vec inv_direction_;
+
+	void set(int lane, const Ray<T, 4>& ray)
+	{
+		assert(lane >= 0 && lane < N);
+
+		for (int c=0; c < 3; ++c)
+		{
+			origin_.component_[c].element_[lane] = ray.origin_[c];
+			direction_.component_[c].element_[lane] = ray.direction_[c];
+			inv_direction_.component_[c].element_[lane] = 1 / ray.direction_[c];
+		}
+	};
+
+	Ray<T, 4> get(int lane) const
+	{
+		assert(lane >= 0 && lane < N);
+
+		Ray<T, 4> res;
+
+		for (int c=0; c < 3; ++c)
+		{
+			res.origin_[c] = origin_.component_[c].element_[lane];
+			res.direction_[c] = direction_.component_[c].element_[lane];
+		}
+
+		res.origin_[3] = 1;
+		res.direction_[3] = 0;
+
+		return res;
+	};
+
+	// loads count <= N rays, the remaining lanes repeat the last one; returns the active lanes
+	unsigned int load(const Ray<T, 4>* rays, int count = N)
+	{
+		assert(count > 0 && count <= N);
+
+		for (int i=0; i < N; ++i)
+			set(i, rays[(i < count) ? i : count-1]);
+
+		return full_mask<N>() >> (N - count);
+	};
+};
+
+// closest hit of every lane of a RayPacket
+template<typename T, int N>
+struct PacketHit
+{
+	ScalarPacket<T, N> distance_;
+	ScalarPacket<T, N> u_, v_;		// barycentric coordinates of triangle hits
+	Vector<T, 4> normal_[N];		// set by finish()
+	size_t primitive_[N];
+	unsigned int valid_;
+
+	// no hits closer than t_max
+	void clear(T t_max = std::numeric_limits<T>::infinity())
+	{
+		distance_.clear(t_max);
+		u_.clear();
+		v_.clear();
+
+		for (int i=0; i < N; ++i)
+			primitive_[i] = NO_HIT;
+
+		valid_ = 0;
+	};
+
+	// normals of the valid lanes, primitive_ indexes primitives
+	template<class P, class M>
+	void finish(const P* primitives, const RayPacket<T, N>& rays, M)
+	{
+		for (int i=0; i < N; ++i)
+			if (valid_ & (1u << i))
+				normal_[i] = get(i, primitives, rays, M()).normal_;
+	};
+
+	template<class P>
+	void finish(const P* primitives, const RayPacket<T, N>& rays)
+	{
+		finish(primitives, rays, exact_math());
+	};
+
+	// the scalar intersection_point of a valid lane
+	template<class M>
+	intersection_point<T> get(int lane, const Triangle<T, 4>* primitives, const RayPacket<T, N>& rays, M) const
+	{
+		assert(valid_ & (1u << lane));
+		return detail::triangle_hit(primitives[primitive_[lane]], rays.get(lane), distance_[lane], u_[lane], v_[lane], M());
+	};
+
+	template<class M>
+	intersection_point<T> get(int lane, const Sphere<T, 4>* primitives, const RayPacket<T, N>& rays, M) const
+	{
+		assert(valid_ & (1u << lane));
+		return detail::sphere_hit(primitives[primitive_[lane]], rays.get(lane), distance_[lane], M());
+	};
+};
+
+// N triangles as vertex and edges, for one ray against all of them
+template<typename T, int N>
+class TrianglePacket
+{
+public:
+	typedef VectorPacket<T, 3, N> Vec;
+
+	Vec vertex_;		// vertex_[0]
+	Vec edge1_;			// vertex_[1] - vertex_[0]
+	Vec edge2_;			// vertex_[2] - vertex_[0]
+
+	void set(int lane, const Triangle<T, 4>& op)
+	{
+		assert(lane >= 0 && lane < N);
+
+		// the same subtractions as intersect()
+		const Vector<T, 4> v21 = op.vertex_[1] - op.vertex_[0];
+		const Vector<T, 4> v31 = op.vertex_[2] - op.vertex_[0];
+
+		for (int c=0; c < 3; ++c)
+		{
+			vertex_.component_[c].element_[lane] = op.vertex_[0][c];
+			edge1_.component_[c].element_[lane] = v21[c];
+			edge2_.component_[c].element_[lane] = v31[c];
+		}
+	};
+
+	// loads count <= N triangles, the remaining lanes repeat the last one; returns the active lanes
+	unsigned int load(const Triangle<T, 4>* triangles, int count = N)
+	{
+		assert(count > 0 && count <= N);
+
+		for (int i=0; i < N; ++i)
+			set(i, triangles[(i < count) ? i : count-1]);
+
+		return full_mask<N>() >> (N - count);
+	};
+};
+
+template<typename T, int N>
+class SpherePacket
+{
+public:
+	VectorPacket<T, 3, N> center_;
+	ScalarPacket<T, N> radius_;
+
+	void set(int lane, const Sphere<T, 4>& op)
+	{
+		assert(lane >= 0 && lane < N);
+
+		for (int c=0; c < 3; ++c)
+			center_.component_[c].element_[lane] = op.center_[c];
+
+		radius_.element_[lane] = op.radius_;
+	};
+
+	unsigned int load(const Sphere<T, 4>* spheres, int count = N)
+	{
+		assert(count > 0 && count <= N);
+
+		for (int i=0; i < N; ++i)
+			set(i, spheres[(i < count) ? i : count-1]);
+
+		return full_mask<N>() >> (N - count);
+	};
+};
+
+//-------------------------------------//
+
+namespace detail {
+
+	template<typename T, int N>
+	inline VectorPacket<T, 3, N> broadcast3(const Vector<T, 4>& op)
+	{
+		VectorPacket<T, 3, N> res;
+
+		for (int c=0; c < 3; ++c)
+			res.component_[c].clear(op[c]);
+
+		return res;
+	}
+
+	// square roots of the math policies
+	template<typename T, int N>
+	inline ScalarPacket<T, N> packet_sqrt(const ScalarPacket<T, N>& op, exact_math)
+	{
+		return math::sqrt(op);
+	}
+
+	template<typename T, int N>
+	inline ScalarPacket<T, N> packet_sqrt(const ScalarPacket<T, N>& op, fast_math)
+	{
+		return fast::sqrt(op);
+	}
+
+	/*
+	 * Möller-Trumbore in every lane of mask, the same steps as intersect().
+	 * Returns the lanes that hit, with distance t and barycentrics u and v.
+	 */
+	template<typename T, int N>
+	unsigned int intersect_triangle(const VectorPacket<T, 3, N>& origin, const VectorPacket<T, 3, N>& direction,
+		const VectorPacket<T, 3, N>& vertex, const VectorPacket<T, 3, N>& v21, const VectorPacket<T, 3, N>& v31,
+		unsigned int mask, ScalarPacket<T, N>& t, ScalarPacket<T, N>& u, ScalarPacket<T, N>& v)
+	{
+		typedef ScalarPacket<T, N> Scalar;
+
+		const Scalar zero = Scalar::broadcast(0);
+		const Scalar one = Scalar::broadcast(1);
+
+		const VectorPacket<T, 3, N> cross2 = cross_product(direction, v31);
+		const Scalar det = cross2*v21;
+
+		mask &= ~(Scalar::broadcast(T(-delta)).less_equal(det) & det.less_equal(Scalar::broadcast(T(delta))));
+		if (!mask)
+			return 0;
+
+		const VectorPacket<T, 3, N> r0v1 = origin - vertex;
+		const VectorPacket<T, 3, N> cross1 = cross_product(r0v1, v21);
+
+		const Scalar invdet = one/det;
+
+		u = invdet*(cross2*r0v1);
+		mask &= zero.less_equal(u) & u.less_equal(one);
+		if (!mask)
+			return 0;
+
+		v = invdet*(cross1*direction);
+		mask &= ~(one.less(u + v) | v.less(zero));
+		if (!mask)
+			return 0;
+
+		t = invdet*(cross1*v31);
+		mask &= ~t.less(zero);
+
+		return mask;
+	}
+
+	// sphere test in every lane of mask, the same steps as intersect()
+	template<typename T, int N, class M>
+	unsigned int intersect_sphere(const VectorPacket<T, 3, N>& origin, const VectorPacket<T, 3, N>& direction,
+		const VectorPacket<T, 3, N>& center, const ScalarPacket<T, N>& radius,
+		unsigned int mask, ScalarPacket<T, N>& t, M)
+	{
+		typedef ScalarPacket<T, N> Scalar;
+
+		const VectorPacket<T, 3, N> l = center - origin;
+		const Scalar lsqr = l.size_sqr();
+		const Scalar rsqr = radius*radius;
+		const Scalar d = l*direction;
+
+		const unsigned int outside = rsqr.less(lsqr);
+
+		mask &= ~(d.less(Scalar::broadcast(0)) & outside);
+
+		const Scalar msqr = lsqr - d*d;
+		mask &= ~rsqr.less(msqr);
+
+		if (!mask)
+			return 0;
+
+		const Scalar q = packet_sqrt(rsqr - msqr, M());
+		t = select(outside, d - q, d + q);
+
+		return mask;
+	}
+
+	// lowest lane of mask with the smallest t, mask must not be empty
+	template<typename T, int N>
+	inline int closest_lane(const ScalarPacket<T, N>& t, unsigned int mask)
+	{
+		int res = -1;
+
+		for (int i=0; i < N; ++i)
+			if ((mask & (1u << i)) && (res < 0 || t[i] < t[res]))
+				res = i;
+
+		return res;
+	}
+
+} // namespace detail
+
+//-------------------------------------//
+
+/*
+ * N rays against one primitive: lanes of mask that hit closer than their
+ * current hits.distance_ take the hit and primitive; returns those lanes.
+ * Call finish() on hits for the normals once all primitives are done.
+ */
+template<typename T, int N>
+unsigned int intersect(const Triangle<T, 4>& triangle, const RayPacket<T, N>& rays, unsigned int mask, PacketHit<T, N>& hits, size_t primitive)
+{
+	ScalarPacket<T, N> t, u, v;
+
+	mask = detail::intersect_triangle(rays.origin_, rays.direction_,
+		detail::broadcast3<T, N>(triangle.vertex_[0]),
+		detail::broadcast3<T, N>(triangle.vertex_[1] - triangle.vertex_[0]),
+		detail::broadcast3<T, N>(triangle.vertex_[2] - triangle.vertex_[0]),
+		mask, t, u, v);
+
+	mask &= t.less(hits.distance_);
+	if (!mask)
+		return 0;
+
+	hits.distance_ = select(mask, t, hits.distance_);
+	hits.u_ = select(mask, u, hits.u_);
+	hits.v_ = select(mask, v, hits.v_);
+	hits.valid_ |= mask;
+
+	for (int i=0; i < N; ++i)
+		if (mask & (1u << i))
+			hits.primitive_[i] = primitive;
+
+	return mask;
+}
+
+template<typename T, int N, class M>
+unsigned int intersect(const Sphere<T, 4>& sphere, const RayPacket<T, N>& rays, unsigned int mask, PacketHit<T, N>& hits, size_t primitive, M)
+{
+	ScalarPacket<T, N> t;
+
+	mask = detail::intersect_sphere(rays.origin_, rays.direction_,
+		detail::broadcast3<T, N>(sphere.center_), ScalarPacket<T, N>::broadcast(sphere.radius_),
+		mask, t, M());
+
+	mask &= t.less(hits.distance_);
+	if (!mask)
+		return 0;
+
+	hits.distance_ = select(mask, t, hits.distance_);
+	hits.valid_ |= mask;
+
+	for (int i=0; i < N; ++i)
+		if (mask & (1u << i))
+			hits.primitive_[i] = primitive;
+
+	return mask;
+}
+
+template<typename T, int N>
+unsigned int intersect(const Sphere<T, 4>& sphere, const RayPacket<T, N>& rays, unsigned int mask, PacketHit<T, N>& hits, size_t primitive)
+{
+	return intersect(sphere, rays, mask, hits, primitive, exact_math());
+}
+
+/*
+ * One ray against the lanes of mask: returns the lane of the closest hit
+ * nearer than t_max and lowers t_max to it, or -1. Ties go to the lowest
+ * lane, as if the primitives had been tested one by one in lane order.
+ */
+template<typename T, int N>
+int intersect(const TrianglePacket<T, N>& triangles, const Ray<T, 4>& ray, unsigned int mask, T& t_max, T& u, T& v)
+{
+	ScalarPacket<T, N> pt, pu, pv;
+
+	mask = detail::intersect_triangle(detail::broadcast3<T, N>(ray.origin_), detail::broadcast3<T, N>(ray.direction_),
+		triangles.vertex_, triangles.edge1_, triangles.edge2_, mask, pt, pu, pv);
+
+	mask &= pt.less(ScalarPacket<T, N>::broadcast(t_max));
+	if (!mask)
+		return -1;
+
+	const int res = detail::closest_lane(pt, mask);
+
+	t_max = pt[res];
+	u = pu[res];
+	v = pv[res];
+
+	return res;
+}
+
+template<typename T, int N, class M>
+int intersect(const SpherePacket<T, N>& spheres, const Ray<T, 4>& ray, unsigned int mask, T& t_max, M)
+{
+	ScalarPacket<T, N> pt;
+
+	mask = detail::intersect_sphere(detail::broadcast3<T, N>(ray.origin_), detail::broadcast3<T, N>(ray.direction_),
+		spheres.center_, spheres.radius_, mask, pt, M());
+
+	mask &= pt.less(ScalarPacket<T, N>::broadcast(t_max));
+	if (!mask)
+		return -1;
+
+	const int res = detail::closest_lane(pt, mask);
+	t_max = pt[res];
+
+	return res;
+}
+
+template<typename T, int N>
+int intersect(const SpherePacket<T, N>& spheres, const Ray<T, 4>& ray, unsigned int mask, T& t_max)
+{
+	return intersect(spheres, ray, mask, t_max, exact_math());
+}
+
+// the lanes of mask hit closer than t_max
+template<typename T, int N>
+unsigned int occluded(const SpherePacket<T, N>& spheres, const Ray<T, 4>& ray, unsigned int mask, T t_max)
+{
+	ScalarPacket<T, N> pt;
+
+	mask = detail::intersect_sphere(detail::broadcast3<T, N>(ray.origin_), detail::broadcast3<T, N>(ray.direction_),
+		spheres.center_, spheres.radius_, mask, pt, exact_math());
+
+	return mask & pt.less(ScalarPacket<T, N>::broadcast(t_max));
+}
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_RAY_PACKET__
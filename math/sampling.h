@@ -0,0 +1,287 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Sample generators on the unit square. All of them have the same interface,
+ * next() returns the following point of the sequence in [0,1)^2:
+ *
+ *   sampling::Sobol<float> gen(seed);
+ *   for (int i = 0; i < n; ++i)
+ *   {
+ *       float u, v;
+ *       gen.next(u, v);
+ *   }
+ *
+ * A non-zero seed applies a Cranley-Patterson rotation, i.e. a random toroidal
+ * shift of the whole point set, which keeps its stratification but gives
+ * independent sets for different seeds. square_to_sphere() and
+ * square_to_hemisphere() map the points to uniformly distributed directions.
+ */
+
+#if !defined(DEIMOS_MATH_SAMPLING__)
+#define DEIMOS_MATH_SAMPLING__
+
+#include <cassert>
+#include <cmath>
+
+#include <boost/random.hpp>
+
+#include "misc.h"
+
+namespace deimos {
+namespace math {
+namespace sampling {
+
+namespace detail {
+
+	// largest float below 1, so that points never reach the upper border
+	const float ONE_MINUS_EPSILON = 0.99999994f;
+
+	// reverse the bits of i, the van der Corput sequence in base 2
+	inline unsigned int reverse_bits(unsigned int i)
+	{
+		i = (i << 16) | (i >> 16);
+		i = ((i & 0x00ff00ffu) << 8) | ((i & 0xff00ff00u) >> 8);
+		i = ((i & 0x0f0f0f0fu) << 4) | ((i & 0xf0f0f0f0u) >> 4);
+		i = ((i & 0x33333333u) << 2) | ((i & 0xccccccccu) >> 2);
+		i = ((i & 0x55555555u) << 1) | ((i & 0xaaaaaaaau) >> 1);
+		return i;
+	}
+
+	// second dimension of the Sobol sequence
+	inline unsigned int sobol2(unsigned int i)
+	{
+		unsigned int r = 0;
+
+		for (unsigned int v = 1u << 31; i; i >>= 1, v ^= v >> 1)
+			if (i & 1)
+				r ^= v;
+
+		return r;
+	}
+
+	template<typename T>
+	inline T to_unit(unsigned int bits)
+	{
+		const T r = static_cast<T>(bits * 2.3283064365386963e-10);
+		return (r < T(ONE_MINUS_EPSILON)) ? r : T(ONE_MINUS_EPSILON);
+	}
+
+	template<typename T>
+	T radical_inverse(unsigned int i, unsigned int base)
+	{
+		const double inv_base = 1.0/base;
+		double inv_bi = inv_base;
+		double r = 0;
+
+		for (; i; i /= base, inv_bi *= inv_base)
+			r += (i % base) * inv_bi;
+
+		return (r < ONE_MINUS_EPSILON) ? static_cast<T>(r) : T(ONE_MINUS_EPSILON);
+	}
+
+	// Cranley-Patterson rotation, a random shift modulo 1 drawn from seed
+	template<typename T>
+	class Rotation
+	{
+	protected:
+		T shift_u_, shift_v_;
+
+		explicit Rotation(unsigned int seed) : shift_u_(0), shift_v_(0)
+		{
+			if (seed)
+			{
+				boost::mt19937 rng(seed);
+				boost::uniform_real<T> distribution;
+
+				shift_u_ = distribution(rng);
+				shift_v_ = distribution(rng);
+			}
+		};
+
+		inline void rotate(T& u, T& v) const
+		{
+			u += shift_u_;
+			v += shift_v_;
+
+			if (u >= 1) u -= 1;
+			if (v >= 1) v -= 1;
+
+			u = (u < T(ONE_MINUS_EPSILON)) ? u : T(ONE_MINUS_EPSILON);
+			v = (v < T(ONE_MINUS_EPSILON)) ? v : T(ONE_MINUS_EPSILON);
+		};
+	};
+
+} // namespace detail
+
+// uniform pseudo random numbers, the sequence boost::variate_generator gives for the same engine
+template<typename T>
+class Random
+{
+protected:
+	boost::mt19937 rng_;
+	boost::uniform_real<T> distribution_;
+
+public:
+	typedef T base_type;
+
+	Random() {};
+
+	explicit Random(unsigned int seed) : rng_(seed) {};
+
+	inline void next(T& u, T& v)
+	{
+		u = distribution_(rng_);
+		v = distribution_(rng_);
+	};
+};
+
+// Sobol (0,2)-sequence, any prefix of 2^k points is stratified in all elementary intervals
+template<typename T>
+class Sobol : public detail::Rotation<T>
+{
+protected:
+	unsigned int index_;
+
+public:
+	typedef T base_type;
+
+	explicit Sobol(unsigned int seed = 0) : detail::Rotation<T>(seed), index_(0) {};
+
+	inline void next(T& u, T& v)
+	{
+		u = detail::to_unit<T>(detail::reverse_bits(index_));
+		v = detail::to_unit<T>(detail::sobol2(index_));
+		++index_;
+
+		this->rotate(u, v);
+	};
+};
+
+// Halton sequence in bases 2 and 3
+template<typename T>
+class Halton : public detail::Rotation<T>
+{
+protected:
+	unsigned int index_;
+
+public:
+	typedef T base_type;
+
+	explicit Halton(unsigned int seed = 0) : detail::Rotation<T>(seed), index_(0) {};
+
+	inline void next(T& u, T& v)
+	{
+		u = detail::to_unit<T>(detail::reverse_bits(index_));
+		v = detail::radical_inverse<T>(index_, 3);
+		++index_;
+
+		this->rotate(u, v);
+	};
+};
+
+// Hammersley point set of num_samples points, starts over after the last one
+template<typename T>
+class Hammersley : public detail::Rotation<T>
+{
+protected:
+	unsigned int index_;
+	unsigned int num_samples_;
+
+public:
+	typedef T base_type;
+
+	explicit Hammersley(unsigned int num_samples, unsigned int seed = 0) : detail::Rotation<T>(seed), index_(0), num_samples_(num_samples)
+	{
+		assert(num_samples > 0);
+	};
+
+	inline void next(T& u, T& v)
+	{
+		u = static_cast<T>(static_cast<double>(index_)/num_samples_);
+		v = detail::to_unit<T>(detail::reverse_bits(index_));
+
+		if (++index_ == num_samples_)
+			index_ = 0;
+
+		this->rotate(u, v);
+	};
+};
+
+// one sample in each cell of a cells_u x cells_v grid, at a random position in
+// the cell if jittered and in its center otherwise, starts over after the last cell
+template<typename T>
+class Stratified : public detail::Rotation<T>
+{
+protected:
+	boost::mt19937 rng_;
+	boost::uniform_real<T> distribution_;
+
+	unsigned int cells_u_, cells_v_;
+	unsigned int index_;
+	bool jitter_;
+
+public:
+	typedef T base_type;
+
+	Stratified(unsigned int cells_u, unsigned int cells_v, bool jitter = true, unsigned int seed = 0) :
+		detail::Rotation<T>(seed), cells_u_(cells_u), cells_v_(cells_v), index_(0), jitter_(jitter)
+	{
+		assert(cells_u > 0 && cells_v > 0);
+
+		// the rotation took the first two numbers of this sequence, the jitter goes on after them
+		if (seed)
+		{
+			rng_.seed(seed);
+			distribution_(rng_);
+			distribution_(rng_);
+		}
+	};
+
+	inline void next(T& u, T& v)
+	{
+		const T du = jitter_ ? distribution_(rng_) : T(0.5);
+		const T dv = jitter_ ? distribution_(rng_) : T(0.5);
+
+		u = (index_ % cells_u_ + du) / cells_u_;
+		v = (index_ / cells_u_ + dv) / cells_v_;
+
+		if (++index_ == cells_u_ * cells_v_)
+			index_ = 0;
+
+		this->rotate(u, v);
+	};
+};
+
+//-------------------------------------//
+
+// uniform direction on the unit sphere, 0 <= theta < PI
+template<typename T>
+inline void square_to_sphere(T u, T v, T& theta, T& phi)
+{
+	theta = static_cast<T>(2.0 * std::acos(std::sqrt(1.0 - v)));
+	phi   = static_cast<T>(2.0 * constants::PI * u);
+}
+
+// uniform direction on the upper hemisphere, 0 <= theta < PI/2
+template<typename T>
+inline void square_to_hemisphere(T u, T v, T& theta, T& phi)
+{
+	theta = static_cast<T>(std::acos(1.0 - v));
+	phi   = static_cast<T>(2.0 * constants::PI * u);
+}
+
+template<typename T>
+inline void spherical_to_vector(T theta, T phi, T vec[3])
+{
+	vec[0] = std::sin(theta) * std::cos(phi);
+	vec[1] = std::sin(theta) * std::sin(phi);
+	vec[2] = std::cos(theta);
+}
+
+} // namespace sampling
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_SAMPLING__
@@ -0,0 +1,56 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Instruction set detection for the explicit SIMD code paths. Everything is
+ * derived from the compiler flags (-msse4.1, -mavx2, /arch:AVX2, ...), define
+ * DEIMOS_NO_SIMD to fall back to the generic scalar templates.
+ */
+
+#if !defined(DEIMOS_MATH_SIMD__)
+#define DEIMOS_MATH_SIMD__
+
+#if !defined(DEIMOS_NO_SIMD)
+
+	#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define DEIMOS_SSE2
+	#endif
+
+	#if defined(__SSE4_1__) || defined(__AVX__)
+		#define DEIMOS_SSE41
+	#endif
+
+	#if defined(__AVX__)
+		#define DEIMOS_AVX
+	#endif
+
+	#if defined(__AVX2__)
+		#define DEIMOS_AVX2
+	#endif
+
+	#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+		#define DEIMOS_FMA
+	#endif
+
+	#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+		#define DEIMOS_F16C
+	#endif
+
+#endif // DEIMOS_NO_SIMD
+
+#if defined(DEIMOS_AVX)
+	#include <immintrin.h>
+#elif defined(DEIMOS_SSE41)
+	#include <smmintrin.h>
+#elif defined(DEIMOS_SSE2)
+	#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+	#define DEIMOS_ALIGN(n) __declspec(align(n))
+#else
+	#define DEIMOS_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+#endif // DEIMOS_MATH_SIMD__
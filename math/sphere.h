@@ -8,7 +8,7 @@
 #define DEIMOS_MATH_SPHERE__
 
 #include <cmath>
-#include "Vector.h"
+#include "vector.h"
 
 namespace deimos {
 namespace math {
@@ -24,12 +24,12 @@ public:
 
 	T distance_sqr(const Vec& op) const
 	{
-		return (center_ - op).size_sqr() - std::pow(radius_, 2);
+		return (center_ - op).size_sqr() - radius_*radius_;
 	};
 
 	T distance(const Vec& op) const
 	{
-		std::sqrt(distanceSqr(op));
+		return std::sqrt(distance_sqr(op));
 	};
 
 	bool is_on_sphere(const Vec& op) const
@@ -39,6 +39,14 @@ public:
 
 };
 
+// true if the spheres share more than a point
+template<typename T, int S>
+bool overlaps(const Sphere<T, S>& op1, const Sphere<T, S>& op2)
+{
+	const T r = op1.radius_ + op2.radius_;
+	return (op1.center_ - op2.center_).size_sqr() < r*r;
+}
+
 } // namespace geometry
 } // namespace math
 } // namespace deimos
@@ -0,0 +1,341 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Spheres packed for intersection: SphereBlocks keeps the centers and radii
+ * of N spheres per block as a SpherePacket (16 bytes per float sphere
+ * instead of the 32 of Sphere<float, 4>) and tests one ray or one sphere
+ * against a whole block at once:
+ *
+ *   SphereBlockScene<float, 8> scene(particles, count, pool);
+ *   scene.closest_hit(ray, hit, primitive);
+ *   scene.occluded(ray, t_max);					// first hit closer than t_max
+ *   scene.overlaps(sphere, neighbours);			// indices of overlapping particles
+ *
+ * Ray hits are the same as those of intersect(), see ray_packet.h. Particles
+ * that move every frame go into a DynamicScene< SphereBlockScene<float, 8> >;
+ * SphereBroadphase in broadphase.h finds all overlapping pairs at once.
+ */
+
+#if !defined(DEIMOS_MATH_SPHERE_BLOCK__)
+#define DEIMOS_MATH_SPHERE_BLOCK__
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "../memory/aligned_array.h"
+#include "../thread/task_pool.h"
+#include "aabb.h"
+#include "bvh.h"
+#include "intersect.h"
+#include "packet.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "sphere.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+// the lanes of mask whose spheres overlap op, as overlaps() of two spheres
+template<typename T, int N>
+unsigned int overlaps(const SpherePacket<T, N>& spheres, const Sphere<T, 4>& op, unsigned int mask)
+{
+	typedef ScalarPacket<T, N> Scalar;
+
+	const Scalar r = spheres.radius_ + Scalar::broadcast(op.radius_);
+	const Scalar dsqr = (spheres.center_ - detail::broadcast3<T, N>(op.center_)).size_sqr();
+
+	return mask & dsqr.less(r*r);
+}
+
+/*
+ * Spheres in blocks of N, entry i in lane i%N of block i/N. Lanes past
+ * the last sphere repeat it and are never tested.
+ */
+template<typename T, int N>
+class SphereBlocks
+{
+protected:
+	memory::AlignedArray< SpherePacket<T, N> > blocks_;
+	size_t size_;
+
+	void fill_chunk(const Sphere<T, 4>* spheres, const unsigned int* order, size_t first, size_t last)
+	{
+		for (size_t b=first; b < last; ++b)
+			for (int i=0; i < N; ++i)
+			{
+				const size_t e = std::min(b*N + i, size_ - 1);
+				blocks_[b].set(i, spheres[order ? order[e] : e]);
+			}
+	}
+
+public:
+	SphereBlocks() : size_(0) {};
+
+	// entry i is spheres[order[i]], or spheres[i] without order
+	void build(const Sphere<T, 4>* spheres, size_t n, const unsigned int* order = 0)
+	{
+		size_ = n;
+		blocks_.resize((n + N - 1) / N);
+		fill_chunk(spheres, order, 0, blocks_.size());
+	};
+
+	void build(thread::TaskPool& pool, const Sphere<T, 4>* spheres, size_t n, const unsigned int* order = 0)
+	{
+		using namespace boost::placeholders;
+
+		size_ = n;
+		blocks_.resize((n + N - 1) / N);
+		thread::parallel_for(pool, 0, blocks_.size(), detail::BVH_GRAIN / N,
+			boost::bind(&SphereBlocks::fill_chunk, this, spheres, order, _1, _2));
+	};
+
+	inline size_t size() const									{ return size_; };
+	inline size_t num_blocks() const								{ return blocks_.size(); };
+	inline const SpherePacket<T, N>& get_block(size_t n) const	{ return blocks_[n]; };
+
+	// the lanes of block b with entries from first to last-1
+	static inline unsigned int lane_mask(size_t b, size_t first, size_t last)
+	{
+		const size_t lo = std::max(first, b*N) - b*N;
+		const size_t hi = std::min(last, b*N + N) - b*N;
+
+		return (full_mask<N>() >> (N - (hi - lo))) << lo;
+	};
+
+	// closest hit among entries first to first+count-1 nearer than t_max, sets entry and lowers t_max to it
+	bool intersect(const Ray<T, 4>& ray, size_t first, size_t count, T& t_max, size_t& entry) const
+	{
+		assert(first + count <= size_);
+
+		bool res = false;
+		const size_t last = first + count;
+
+		for (size_t b=first/N; b*N < last; ++b)
+		{
+			const int lane = geometry::intersect(blocks_[b], ray, lane_mask(b, first, last), t_max);
+
+			if (lane >= 0)
+			{
+				entry = b*N + lane;
+				res = true;
+			}
+		}
+
+		return res;
+	};
+
+	// true if any of the entries first to first+count-1 is hit closer than t_max
+	bool occluded(const Ray<T, 4>& ray, size_t first, size_t count, T t_max) const
+	{
+		assert(first + count <= size_);
+
+		const size_t last = first + count;
+
+		for (size_t b=first/N; b*N < last; ++b)
+			if (geometry::occluded(blocks_[b], ray, lane_mask(b, first, last), t_max))
+				return true;
+
+		return false;
+	};
+
+	// appends the entries first to first+count-1 that overlap op
+	void overlaps(const Sphere<T, 4>& op, size_t first, size_t count, std::vector<size_t>& entries) const
+	{
+		assert(first + count <= size_);
+
+		const size_t last = first + count;
+
+		for (size_t b=first/N; b*N < last; ++b)
+		{
+			const unsigned int mask = geometry::overlaps(blocks_[b], op, lane_mask(b, first, last));
+
+			for (int i=0; i < N; ++i)
+				if (mask & (1u << i))
+					entries.push_back(b*N + i);
+		}
+	};
+};
+
+//-------------------------------------//
+
+namespace detail {
+
+	template<typename T, int N>
+	struct SphereBlockAnyHit
+	{
+		const SphereBlocks<T, N>* blocks_;
+		const Ray<T, 4>* ray_;
+
+		inline bool operator()(unsigned int first, unsigned int count, T& t_max) const
+		{
+			return blocks_->occluded(*ray_, first, count, t_max);
+		};
+	};
+
+	template<typename T, int N>
+	struct SphereBlockClosestHit
+	{
+		const SphereBlocks<T, N>* blocks_;
+		const Ray<T, 4>* ray_;
+		T t_;
+		size_t entry_;
+
+		inline bool operator()(unsigned int first, unsigned int count, T& t_max)
+		{
+			if (!blocks_->intersect(*ray_, first, count, t_max, entry_))
+				return false;
+
+			t_ = t_max;
+			return true;
+		};
+	};
+
+	// leaf entries overlapping a sphere, for Bvh::query()
+	template<typename T, int N>
+	struct SphereBlockOverlap
+	{
+		const SphereBlocks<T, N>* blocks_;
+		const Sphere<T, 4>* sphere_;
+		std::vector<size_t>* entries_;
+
+		inline void operator()(unsigned int first, unsigned int count) const
+		{
+			blocks_->overlaps(*sphere_, first, count, *entries_);
+		};
+	};
+
+} // namespace detail
+
+/*
+ * Spheres in a Bvh whose leaves are read from SphereBlocks in leaf order,
+ * a scene for RayCaster. The spheres must outlive it, they are only read
+ * again for the normal of the closest hit.
+ */
+template<typename T, int N>
+class SphereBlockScene
+{
+public:
+	typedef T value_type;
+
+protected:
+	const Sphere<T, 4>* spheres_;
+	Bvh<T> bvh_;
+	SphereBlocks<T, N> blocks_;
+
+	void bounds_chunk(AABB<T, 3>* boxes, size_t first, size_t last) const
+	{
+		for (size_t i=first; i < last; ++i)
+			boxes[i] = bounds(spheres_[i]);
+	}
+
+public:
+	SphereBlockScene(const Sphere<T, 4>* spheres, size_t size) : spheres_(spheres)
+	{
+		memory::AlignedArray< AABB<T, 3> > boxes(size);
+		bounds_chunk(boxes.data(), 0, size);
+
+		bvh_.build(boxes.data(), size);
+		blocks_.build(spheres, size, bvh_.get_indices());
+	};
+
+	SphereBlockScene(const Sphere<T, 4>* spheres, size_t size, thread::TaskPool& pool, BvhBuildMethod method = BVH_BUILD_BINNED) : spheres_(spheres)
+	{
+		using namespace boost::placeholders;
+
+		memory::AlignedArray< AABB<T, 3> > boxes(size);
+		thread::parallel_for(pool, 0, size, detail::BVH_GRAIN, boost::bind(&SphereBlockScene::bounds_chunk, this, boxes.data(), _1, _2));
+
+		if (method == BVH_BUILD_SWEEP)
+			bvh_.build(boxes.data(), size);
+		else if (method == BVH_BUILD_BINNED)
+			bvh_.build_binned(pool, boxes.data(), size);
+		else
+			bvh_.build_morton(pool, boxes.data(), size);
+
+		blocks_.build(pool, spheres, size, bvh_.get_indices());
+	};
+
+	inline const Bvh<T>& get_bvh() const						{ return bvh_; };
+	inline const SphereBlocks<T, N>& get_blocks() const			{ return blocks_; };
+
+	// boxes of the spheres as they are now
+	void get_boxes(thread::TaskPool& pool, memory::AlignedArray< AABB<T, 3> >& boxes) const
+	{
+		using namespace boost::placeholders;
+
+		boxes.resize(blocks_.size());
+		thread::parallel_for(pool, 0, blocks_.size(), detail::BVH_GRAIN, boost::bind(&SphereBlockScene::bounds_chunk, this, boxes.data(), _1, _2));
+	};
+
+	// after the spheres moved, boxes from get_boxes(); the blocks are filled again
+	void refit(thread::TaskPool& pool, const AABB<T, 3>* boxes)
+	{
+		bvh_.refit(pool, boxes);
+		blocks_.build(pool, spheres_, blocks_.size(), bvh_.get_indices());
+	};
+
+	// swaps in bvh, built over older boxes of the same spheres, and refits it
+	void swap_bvh(thread::TaskPool& pool, const AABB<T, 3>* boxes, Bvh<T>& bvh)
+	{
+		bvh_.swap(bvh);
+		refit(pool, boxes);
+	};
+
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive, BvhTraversalStats* stats) const
+	{
+		detail::SphereBlockClosestHit<T, N> leaf = { &blocks_, &ray, 0, 0 };
+
+		hit.valid_ = false;
+		hit.distance_ = std::numeric_limits<T>::infinity();
+		primitive = NO_HIT;
+
+		if (!bvh_.traverse_leaves(ray, std::numeric_limits<T>::max(), leaf, stats))
+			return false;
+
+		primitive = bvh_.get_index(leaf.entry_);
+		hit = detail::sphere_hit(spheres_[primitive], ray, leaf.t_, exact_math());
+
+		return true;
+	};
+
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive) const
+	{
+		return closest_hit(ray, hit, primitive, 0);
+	};
+
+	// true if any sphere is hit closer than t_max, e.g. for shadow rays
+	bool occluded(const Ray<T, 4>& ray, T t_max, BvhTraversalStats* stats) const
+	{
+		detail::SphereBlockAnyHit<T, N> leaf = { &blocks_, &ray };
+		return bvh_.traverse_any_leaves(ray, t_max, leaf, stats);
+	};
+
+	bool occluded(const Ray<T, 4>& ray, T t_max) const
+	{
+		return occluded(ray, t_max, 0);
+	};
+
+	// appends the indices of all spheres overlapping op, in no particular order
+	void overlaps(const Sphere<T, 4>& op, std::vector<size_t>& primitives) const
+	{
+		const size_t first = primitives.size();
+
+		detail::SphereBlockOverlap<T, N> leaf = { &blocks_, &op, &primitives };
+		bvh_.query(bounds(op), leaf);
+
+		for (size_t i=first; i < primitives.size(); ++i)
+			primitives[i] = bvh_.get_index(primitives[i]);
+	};
+};
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_SPHERE_BLOCK__
@@ -16,7 +16,10 @@
 #include <boost/numeric/ublas/matrix_sparse.hpp>
 #include <boost/numeric/ublas/io.hpp>
 
+#include "../memory/aligned_array.h"
+#include "fast_math.h"
 #include "misc.h"
+#include "sampling.h"
 
 namespace deimos {
 namespace math {
@@ -73,14 +76,53 @@ T P(int l, int m, T x)
 	return p_ll;
 }
 
-// spherical harmonics
+#if defined(DEIMOS_HAS_CONSTEXPR)
+
+// bands with a precomputed normalization factor
+const int NORMALIZATION_BANDS = 16;
+
+/*
+ * K(l, m) for 0 <= m <= l < NORMALIZATION_BANDS at index l*(l+1)/2 + m,
+ * evaluated at compile time for a sphere or hemisphere of the given area
+ */
 template<typename T>
+struct normalization_table
+{
+	T k_[NORMALIZATION_BANDS*(NORMALIZATION_BANDS+1)/2];
+
+	constexpr explicit normalization_table(double area) : k_()
+	{
+		for (int l = 0; l < NORMALIZATION_BANDS; ++l)
+			for (int m = 0; m <= l; ++m)
+				k_[l*(l+1)/2 + m] = static_cast<T>(detail::constexpr_sqrt(((2.0 * l + 1.0)/area) * fact_frac<double>(l-m, l+m)));
+	}
+
+	constexpr T operator()(int l, int m) const
+	{
+		return k_[l*(l+1)/2 + m];
+	}
+};
+
+#endif
+
+// spherical harmonics, M picks exact_math or fast_math for the trigonometry
+template<typename T, class M = exact_math>
 struct spherical
 {
 	typedef T base_type;
+	typedef M math_policy;
+
+#if defined(DEIMOS_HAS_CONSTEXPR)
+	static constexpr normalization_table<T> table_ = normalization_table<T>(4.0 * constants::PI);
+#endif
 
 	static inline T K(int l, int m)
 	{
+#if defined(DEIMOS_HAS_CONSTEXPR)
+		if (l < NORMALIZATION_BANDS)
+			return table_(l, m);
+#endif
+
 		return static_cast<T>(std::sqrt( ((2.0 * l + 1.0)/(4.0 * constants::PI)) * fact_frac<T>(l-m, l+m)));
 	}
 
@@ -88,34 +130,45 @@ struct spherical
 	{
 		const T sqrt2 = static_cast<T>(std::sqrt(2.0));
 		if (m == 0)
-			return				K(l, m)	*							P<T>(l, m, std::cos(theta));
+			return				K(l, m)	*							P<T>(l, m, M::cos(theta));
 		else if (m > 0)
-			return sqrt2	*	K(l, m)	* std::cos(m * phi)		*	P<T>(l, m, std::cos(theta));
+			return sqrt2	*	K(l, m)	* M::cos(m * phi)		*	P<T>(l, m, M::cos(theta));
 		else
-			return sqrt2	*	K(l, -m) * std::sin(-m * phi)	*	P<T>(l, -m, std::cos(theta));
+			return sqrt2	*	K(l, -m) * M::sin(-m * phi)	*	P<T>(l, -m, M::cos(theta));
 	}
 };
 
 // zonal harmonics
-template<typename T>
+template<typename T, class M = exact_math>
 struct zonal
 {
 	typedef T base_type;
+	typedef M math_policy;
 
 	static inline T evaluate(int l, int m, T theta, T phi)
 	{
-		return spherical<T>::evaluate(l, 0, theta, phi);
+		return spherical<T, M>::evaluate(l, 0, theta, phi);
 	}
 };
 
 // hemispherical harmonics
-template<typename T>
+template<typename T, class M = exact_math>
 struct hemispherical
 {
 	typedef T base_type;
+	typedef M math_policy;
+
+#if defined(DEIMOS_HAS_CONSTEXPR)
+	static constexpr normalization_table<T> table_ = normalization_table<T>(2.0 * constants::PI);
+#endif
 
 	static T K(int l, int m)
 	{
+#if defined(DEIMOS_HAS_CONSTEXPR)
+		if (l < NORMALIZATION_BANDS)
+			return table_(l, m);
+#endif
+
 		return static_cast<T>(std::sqrt( ((2.0 * l + 1.0)/(2.0 * constants::PI)) * fact_frac<T>(l-m, l+m)));
 	}
 
@@ -128,38 +181,43 @@ struct hemispherical
 	{
 		const T sqrt2 = static_cast<T>(std::sqrt(2.0));
 		if (m == 0)
-			return				K(l, m)	*							hsh_P(l, m, std::cos(theta));
+			return				K(l, m)	*							hsh_P(l, m, M::cos(theta));
 		else if (m > 0)
-			return sqrt2	*	K(l, m)	* std::cos(m * phi)		*	hsh_P(l, m, std::cos(theta));
+			return sqrt2	*	K(l, m)	* M::cos(m * phi)		*	hsh_P(l, m, M::cos(theta));
 		else
-			return sqrt2	*	K(l, -m) * std::sin(-m * phi)	*	hsh_P(l, -m, std::cos(theta));
+			return sqrt2	*	K(l, -m) * M::sin(-m * phi)	*	hsh_P(l, -m, M::cos(theta));
 	}
 };
 
+#if defined(DEIMOS_HAS_CONSTEXPR)
+template<typename T, class M>
+constexpr normalization_table<T> spherical<T, M>::table_;
+
+template<typename T, class M>
+constexpr normalization_table<T> hemispherical<T, M>::table_;
+#endif
+
 template<typename T>
 struct sample
 {
 	T sph[2];
 	T vec[3];
-	std::vector<T> coefficents;
+	memory::AlignedArray<T> coefficents;
 };
 
-template<class B>
-void create_spherical_samples(std::list< sample<typename B::base_type> >& samples, int num_samples, int num_bands)
+// samples drawn from generator, see sampling.h
+template<class B, class G>
+void create_spherical_samples(std::list< sample<typename B::base_type> >& samples, G& generator, int num_samples, int num_bands)
 {
 	typedef typename B::base_type T;
-
-	boost::mt19937 rng;
-
-	boost::uniform_real<T> distribution;
-	boost::variate_generator<boost::mt19937&, boost::uniform_real<T> > rand(rng, distribution);
+	typedef typename B::math_policy M;
 
 	for (int s = 0; s < num_samples; ++s)
 	{
-		T x = rand();
-		T y = rand();
+		T x, y;
+		generator.next(x, y);
 
-		T theta = static_cast<T>(2.0 * std::acos(std::sqrt(1.0 - y)));
+		T theta = static_cast<T>(2 * M::acos(M::sqrt(1 - y)));
 		T phi	= static_cast<T>(2.0 * constants::PI * x);
 
 		sample<T> sample;
@@ -167,9 +225,9 @@ void create_spherical_samples(std::list< sample<typename B::base_type> >& sample
 		sample.sph[0] = theta;
 		sample.sph[1] = phi;
 
-		sample.vec[0] = std::sin(theta) * std::cos(phi);
-		sample.vec[1] = std::sin(theta) * std::sin(phi);
-		sample.vec[2] = std::cos(theta);
+		sample.vec[0] = M::sin(theta) * M::cos(phi);
+		sample.vec[1] = M::sin(theta) * M::sin(phi);
+		sample.vec[2] = M::cos(theta);
 
 		for (int l = 0; l < num_bands; ++l)
 			for(int m = -l; m <= l; ++m)
@@ -179,6 +237,13 @@ void create_spherical_samples(std::list< sample<typename B::base_type> >& sample
 	}
 }
 
+template<class B>
+void create_spherical_samples(std::list< sample<typename B::base_type> >& samples, int num_samples, int num_bands)
+{
+	sampling::Random<typename B::base_type> generator;
+	create_spherical_samples<B>(samples, generator, num_samples, num_bands);
+}
+
 // project polar function with a pregenerated list of samples using spherical parameterization
 template<typename RetT, typename T>
 void project_polar_function_sph(boost::function<RetT(T, T)> func, std::list< sample<T> >& samples, std::vector<RetT>& result)
@@ -189,12 +254,12 @@ void project_polar_function_sph(boost::function<RetT(T, T)> func, std::list< sam
 	const int num_coeff = static_cast<int>((*samples.begin()).coefficents.size());
 
 	const T weight = T(4.0 * constants::PI)/T(samples.size());
-	sample_list::const_iterator end = samples.end();
+	typename sample_list::const_iterator end = samples.end();
 
 	result.resize(num_coeff);
 
 	// integrate sample values
-	for (sample_list::iterator sample = samples.begin(); sample != end; ++sample)
+	for (typename sample_list::iterator sample = samples.begin(); sample != end; ++sample)
 	{
 		const RetT func_val = func((*sample).sph[0], (*sample).sph[1]);
 		for (int c = 0; c < num_coeff; ++c)
@@ -215,12 +280,12 @@ void project_polar_function_vec(boost::function<RetT(T, T, T)> func, std::list<
 	const int num_coeff = static_cast<int>((*samples.begin()).coefficents.size());
 
 	const T weight = T(4.0 * constants::PI)/T(samples.size());
-	sample_list::const_iterator end = samples.end();
+	typename sample_list::const_iterator end = samples.end();
 
 	result.resize(num_coeff);
 
 	// integrate sample values
-	for (sample_list::iterator sample = samples.begin(); sample != end; ++sample)
+	for (typename sample_list::iterator sample = samples.begin(); sample != end; ++sample)
 	{
 		const RetT func_val = func((*sample).vec[0], (*sample).vec[1], (*sample).vec[2]);
 		for (int c = 0; c < num_coeff; ++c)
@@ -231,17 +296,13 @@ void project_polar_function_vec(boost::function<RetT(T, T, T)> func, std::list<
 		result[i] = result[i] * weight;
 }
 
-// project polar function using vector parameterization
-template<typename RetT, class B>
+// project polar function using vector parameterization and samples drawn from generator
+template<typename RetT, class B, class G>
 void project_polar_function_vec(boost::function<RetT(typename B::base_type, typename B::base_type, typename B::base_type)> func,
-								int num_samples, int num_bands, std::vector<RetT>& result)
+								G& generator, int num_samples, int num_bands, std::vector<RetT>& result)
 {
 	typedef typename B::base_type T;
-
-	boost::mt19937 rng;
-
-	boost::uniform_real<T> distribution;
-	boost::variate_generator<boost::mt19937&, boost::uniform_real<T> > rand(rng, distribution);
+	typedef typename B::math_policy M;
 
 	const T weight = T(4.0 * constants::PI)/T(num_samples);
 	const int num_coeff = num_bands * num_bands;
@@ -251,16 +312,16 @@ void project_polar_function_vec(boost::function<RetT(typename B::base_type, type
 	// integrate sample values
 	for (int s = 0; s < num_samples; ++s)
 	{
-		T x = rand();
-		T y = rand();
+		T x, y;
+		generator.next(x, y);
 
-		T theta = static_cast<T>(2.0 * std::acos(std::sqrt(1.0 - y)));
+		T theta = static_cast<T>(2 * M::acos(M::sqrt(1 - y)));
 		T phi	= static_cast<T>(2.0 * constants::PI * x);
 
 		T vec[3];
-		vec[0] = std::sin(theta) * std::cos(phi);
-		vec[1] = std::sin(theta) * std::sin(phi);
-		vec[2] = std::cos(theta);
+		vec[0] = M::sin(theta) * M::cos(phi);
+		vec[1] = M::sin(theta) * M::sin(phi);
+		vec[2] = M::cos(theta);
 
 		const RetT func_val = func(vec[0], vec[1], vec[2]);
 
@@ -276,17 +337,22 @@ void project_polar_function_vec(boost::function<RetT(typename B::base_type, type
 		result[i] = result[i] * weight;
 }
 
-// project polar function using spherical parameterization
+// project polar function using vector parameterization
 template<typename RetT, class B>
-void project_polar_function_sph(boost::function<RetT(typename B::base_type, typename B::base_type)> func,
+void project_polar_function_vec(boost::function<RetT(typename B::base_type, typename B::base_type, typename B::base_type)> func,
 								int num_samples, int num_bands, std::vector<RetT>& result)
 {
-	typedef typename B::base_type T;
-
-	boost::mt19937 rng;
+	sampling::Random<typename B::base_type> generator;
+	project_polar_function_vec<RetT, B>(func, generator, num_samples, num_bands, result);
+}
 
-	boost::uniform_real<T> distribution;
-	boost::variate_generator<boost::mt19937&, boost::uniform_real<T> > rand(rng, distribution);
+// project polar function using spherical parameterization and samples drawn from generator
+template<typename RetT, class B, class G>
+void project_polar_function_sph(boost::function<RetT(typename B::base_type, typename B::base_type)> func,
+								G& generator, int num_samples, int num_bands, std::vector<RetT>& result)
+{
+	typedef typename B::base_type T;
+	typedef typename B::math_policy M;
 
 	const T weight = T(4.0 * constants::PI)/T(num_samples);
 	const int num_coeff = num_bands * num_bands;
@@ -296,10 +362,10 @@ void project_polar_function_sph(boost::function<RetT(typename B::base_type, type
 	// integrate sample values
 	for (int s = 0; s < num_samples; ++s)
 	{
-		T x = rand();
-		T y = rand();
+		T x, y;
+		generator.next(x, y);
 
-		T theta = static_cast<T>(2.0 * std::acos(std::sqrt(1.0 - y)));
+		T theta = static_cast<T>(2 * M::acos(M::sqrt(1 - y)));
 		T phi	= static_cast<T>(2.0 * constants::PI * x);
 
 		const RetT func_val = func(theta, phi);
@@ -316,6 +382,15 @@ void project_polar_function_sph(boost::function<RetT(typename B::base_type, type
 		result[i] = result[i] * weight;
 }
 
+// project polar function using spherical parameterization
+template<typename RetT, class B>
+void project_polar_function_sph(boost::function<RetT(typename B::base_type, typename B::base_type)> func,
+								int num_samples, int num_bands, std::vector<RetT>& result)
+{
+	sampling::Random<typename B::base_type> generator;
+	project_polar_function_sph<RetT, B>(func, generator, num_samples, num_bands, result);
+}
+
 template<typename RetT, class B>
 RetT reconstruct_function(typename B::base_type theta, typename B::base_type phi, std::vector<RetT>& result)
 {
@@ -0,0 +1,406 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Transformation of whole arrays by a Matrix<T, 4>. The matrix is prepared
+ * once per call instead of once per vector.
+ *
+ *   transform(m, src, dst, n)				Vector<T, 4>, full product
+ *   transform_points(m, src, dst, n)		Vector<T, 3> with w = 1
+ *   transform_directions(m, src, dst, n)	Vector<T, 3> with w = 0
+ *   transform_normals(m, src, dst, n)		Vector<T, 3> by the inverse transpose
+ *
+ * Points, directions and normals can also be given as SoA streams, i.e. three
+ * arrays with the x, y and z components. STORE_STREAM writes the results with
+ * non-temporal stores past the cache, for outputs that aren't read again
+ * soon; it needs 16 byte aligned (AVX: 32 byte for SoA streams) outputs and
+ * falls back to regular stores otherwise. Overloads taking a thread::TaskPool
+ * split the arrays into ranges of grain elements and transform them in
+ * parallel. src and dst may be the same array, but must not overlap otherwise.
+ *
+ * Normals are not renormalized.
+ */
+
+#if !defined(DEIMOS_MATH_TRANSFORM__)
+#define DEIMOS_MATH_TRANSFORM__
+
+#include <cstddef>
+
+#include "../thread/task_pool.h"
+#include "matrix.h"
+#include "packet.h"
+#include "simd.h"
+
+namespace deimos {
+namespace math {
+
+enum StoreHint
+{
+	STORE_CACHED,
+	STORE_STREAM
+};
+
+// default number of vectors per parallel task
+const size_t TRANSFORM_GRAIN = 16384;
+
+// inverse transpose of the upper 3x3 part, without translation
+template<typename T>
+Matrix<T, 4> normal_matrix(const Matrix<T, 4>& op)
+{
+	Matrix<T, 3> a;
+
+	for (int i=0; i < 3; ++i)
+		for (int j=0; j < 3; ++j)
+			a[i][j] = op[i][j];
+
+	a = invert(a);
+	a.transpose();
+
+	Matrix<T, 4> ret;
+	ret.identity();
+
+	for (int i=0; i < 3; ++i)
+		for (int j=0; j < 3; ++j)
+			ret[i][j] = a[i][j];
+
+	return ret;
+}
+
+namespace detail {
+
+	inline bool is_aligned(const void* op, size_t alignment)
+	{
+		return (reinterpret_cast<size_t>(op) & (alignment - 1)) == 0;
+	}
+
+	template<typename T>
+	void transform_vectors(const Matrix<T, 4>& m, const Vector<T, 4>* src, Vector<T, 4>* dst, size_t count, StoreHint)
+	{
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = m * src[i];
+	}
+
+	// w is 1 for points and 0 for directions
+	template<typename T>
+	void transform_affine(const Matrix<T, 4>& m, const Vector<T, 3>* src, Vector<T, 3>* dst, size_t count, bool point, StoreHint)
+	{
+		const T w = point ? T(1) : T(0);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Vector<T, 3> v = src[i];
+
+			for (int j=0; j < 3; ++j)
+				dst[i][j] = m[j][0]*v[0] + m[j][1]*v[1] + m[j][2]*v[2] + m[j][3]*w;
+		}
+	}
+
+	template<typename T>
+	void transform_affine(const Matrix<T, 4>& m, const T* const src[3], T* const dst[3], size_t count, bool point, StoreHint hint)
+	{
+		enum { W = packet_width<T, 8>::value };
+		typedef lanes<T, W> L;
+		typedef typename L::reg reg;
+
+		const T w = point ? T(1) : T(0);
+
+		reg mm[3][4];
+
+		for (int j=0; j < 3; ++j)
+			for (int k=0; k < 4; ++k)
+				mm[j][k] = L::set1(k < 3 ? m[j][k] : m[j][k]*w);
+
+		const bool stream = hint == STORE_STREAM && W > 1 &&
+			is_aligned(dst[0], sizeof(reg)) && is_aligned(dst[1], sizeof(reg)) && is_aligned(dst[2], sizeof(reg));
+
+		size_t i = 0;
+
+		for (; i + W <= count; i += W)
+		{
+			const reg x = L::load(src[0] + i);
+			const reg y = L::load(src[1] + i);
+			const reg z = L::load(src[2] + i);
+
+			reg r[3];
+
+			for (int j=0; j < 3; ++j)
+				r[j] = L::add(L::add(L::add(L::mul(mm[j][0], x), L::mul(mm[j][1], y)), L::mul(mm[j][2], z)), mm[j][3]);
+
+			for (int j=0; j < 3; ++j)
+				if (stream)
+					L::stream(dst[j] + i, r[j]);
+				else
+					L::store(dst[j] + i, r[j]);
+		}
+
+		for (; i < count; ++i)
+		{
+			const T x = src[0][i], y = src[1][i], z = src[2][i];
+
+			for (int j=0; j < 3; ++j)
+				dst[j][i] = m[j][0]*x + m[j][1]*y + m[j][2]*z + m[j][3]*w;
+		}
+
+#if defined(DEIMOS_SSE2)
+		if (stream)
+			_mm_sfence();
+#endif
+	}
+
+#if defined(DEIMOS_SSE2)
+
+	/*
+	 * The columns of m are scaled by the broadcast components and summed in
+	 * the same order as Matrix<float, 4>::operator*(const Vec&), so results are
+	 * identical to transforming one by one.
+	 */
+	inline void transform_vectors(const Matrix<float, 4>& m, const Vector<float, 4>* src, Vector<float, 4>* dst, size_t count, StoreHint hint)
+	{
+		__m128 c0 = m.row_[0].load();
+		__m128 c1 = m.row_[1].load();
+		__m128 c2 = m.row_[2].load();
+		__m128 c3 = m.row_[3].load();
+
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+		const bool stream = hint == STORE_STREAM && is_aligned(dst, 16);
+
+		size_t i = 0;
+
+#if defined(DEIMOS_AVX)
+		const __m256 d0 = _mm256_insertf128_ps(_mm256_castps128_ps256(c0), c0, 1);
+		const __m256 d1 = _mm256_insertf128_ps(_mm256_castps128_ps256(c1), c1, 1);
+		const __m256 d2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c2), c2, 1);
+		const __m256 d3 = _mm256_insertf128_ps(_mm256_castps128_ps256(c3), c3, 1);
+
+		// two vectors per register
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m256 v = _mm256_loadu_ps(src[i].element_);
+
+			__m256 r = _mm256_mul_ps(d0, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+			r = _mm256_add_ps(r, _mm256_mul_ps(d1, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+			r = _mm256_add_ps(r, _mm256_mul_ps(d2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+			r = _mm256_add_ps(r, _mm256_mul_ps(d3, _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3))));
+
+			if (stream)
+			{
+				_mm_stream_ps(dst[i].element_, _mm256_castps256_ps128(r));
+				_mm_stream_ps(dst[i+1].element_, _mm256_extractf128_ps(r, 1));
+			}
+			else
+				_mm256_storeu_ps(dst[i].element_, r);
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			const __m128 v = src[i].load();
+
+			__m128 r = _mm_mul_ps(c0, swizzle<0, 0, 0, 0>(v));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, swizzle<1, 1, 1, 1>(v)));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, swizzle<2, 2, 2, 2>(v)));
+			r = _mm_add_ps(r, _mm_mul_ps(c3, swizzle<3, 3, 3, 3>(v)));
+
+			if (stream)
+				_mm_stream_ps(dst[i].element_, r);
+			else
+				dst[i].store(r);
+		}
+
+		if (stream)
+			_mm_sfence();
+	}
+
+	// Vector<float, 3> is padded to 16 bytes, the padding lane of the results is cleared
+	inline void transform_affine(const Matrix<float, 4>& m, const Vector<float, 3>* src, Vector<float, 3>* dst, size_t count, bool point, StoreHint hint)
+	{
+		__m128 c0 = m.row_[0].load();
+		__m128 c1 = m.row_[1].load();
+		__m128 c2 = m.row_[2].load();
+		__m128 c3 = m.row_[3].load();
+
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+		// translation, or adding zeros for directions
+		c3 = _mm_and_ps(c3, point ? mask_xyz() : _mm_setzero_ps());
+
+		const bool stream = hint == STORE_STREAM && is_aligned(dst, 16);
+
+		size_t i = 0;
+
+#if defined(DEIMOS_AVX)
+		const __m256 d0 = _mm256_insertf128_ps(_mm256_castps128_ps256(c0), c0, 1);
+		const __m256 d1 = _mm256_insertf128_ps(_mm256_castps128_ps256(c1), c1, 1);
+		const __m256 d2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c2), c2, 1);
+		const __m256 d3 = _mm256_insertf128_ps(_mm256_castps128_ps256(c3), c3, 1);
+		const __m256 mask = _mm256_insertf128_ps(_mm256_castps128_ps256(mask_xyz()), mask_xyz(), 1);
+
+		for (; i + 2 <= count; i += 2)
+		{
+			// the padding lanes are loaded but never used
+			const __m256 v = _mm256_loadu_ps(src[i].element_);
+
+			__m256 r = _mm256_mul_ps(d0, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+			r = _mm256_add_ps(r, _mm256_mul_ps(d1, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+			r = _mm256_add_ps(r, _mm256_mul_ps(d2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+			r = _mm256_and_ps(_mm256_add_ps(r, d3), mask);
+
+			if (stream)
+			{
+				_mm_stream_ps(dst[i].element_, _mm256_castps256_ps128(r));
+				_mm_stream_ps(dst[i+1].element_, _mm256_extractf128_ps(r, 1));
+			}
+			else
+				_mm256_storeu_ps(dst[i].element_, r);
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			const __m128 v = src[i].load();
+
+			__m128 r = _mm_mul_ps(c0, swizzle<0, 0, 0, 0>(v));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, swizzle<1, 1, 1, 1>(v)));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, swizzle<2, 2, 2, 2>(v)));
+			r = _mm_and_ps(_mm_add_ps(r, c3), mask_xyz());
+
+			if (stream)
+				_mm_stream_ps(dst[i].element_, r);
+			else
+				dst[i].store(r);
+		}
+
+		if (stream)
+			_mm_sfence();
+	}
+
+#endif // DEIMOS_SSE2
+
+	// bound by the parallel overloads, [first, last) of the arrays
+	template<typename T>
+	void transform_range(const Matrix<T, 4>* m, const Vector<T, 4>* src, Vector<T, 4>* dst, StoreHint hint, size_t first, size_t last)
+	{
+		transform_vectors(*m, src + first, dst + first, last - first, hint);
+	}
+
+	template<typename T>
+	void transform_affine_range(const Matrix<T, 4>* m, const Vector<T, 3>* src, Vector<T, 3>* dst, bool point, StoreHint hint, size_t first, size_t last)
+	{
+		transform_affine(*m, src + first, dst + first, last - first, point, hint);
+	}
+
+	template<typename T>
+	void transform_affine_stream_range(const Matrix<T, 4>* m, const T* const* src, T* const* dst, bool point, StoreHint hint, size_t first, size_t last)
+	{
+		const T* const s[3] = { src[0] + first, src[1] + first, src[2] + first };
+		T* const d[3] = { dst[0] + first, dst[1] + first, dst[2] + first };
+
+		transform_affine(*m, s, d, last - first, point, hint);
+	}
+
+} // namespace detail
+
+//-------------------------------------//
+
+template<typename T>
+void transform(const Matrix<T, 4>& m, const Vector<T, 4>* src, Vector<T, 4>* dst, size_t count, StoreHint hint = STORE_CACHED)
+{
+	detail::transform_vectors(m, src, dst, count, hint);
+}
+
+template<typename T>
+void transform_points(const Matrix<T, 4>& m, const Vector<T, 3>* src, Vector<T, 3>* dst, size_t count, StoreHint hint = STORE_CACHED)
+{
+	detail::transform_affine(m, src, dst, count, true, hint);
+}
+
+template<typename T>
+void transform_directions(const Matrix<T, 4>& m, const Vector<T, 3>* src, Vector<T, 3>* dst, size_t count, StoreHint hint = STORE_CACHED)
+{
+	detail::transform_affine(m, src, dst, count, false, hint);
+}
+
+template<typename T>
+void transform_normals(const Matrix<T, 4>& m, const Vector<T, 3>* src, Vector<T, 3>* dst, size_t count, StoreHint hint = STORE_CACHED)
+{
+	detail::transform_affine(normal_matrix(m), src, dst, count, false, hint);
+}
+
+// SoA streams, src[c] and dst[c] point to the c-th components of count vectors
+template<typename T>
+void transform_points(const Matrix<T, 4>& m, const T* const src[3], T* const dst[3], size_t count, StoreHint hint = STORE_CACHED)
+{
+	detail::transform_affine(m, src, dst, count, true, hint);
+}
+
+template<typename T>
+void transform_directions(const Matrix<T, 4>& m, const T* const src[3], T* const dst[3], size_t count, StoreHint hint = STORE_CACHED)
+{
+	detail::transform_affine(m, src, dst, count, false, hint);
+}
+
+template<typename T>
+void transform_normals(const Matrix<T, 4>& m, const T* const src[3], T* const dst[3], size_t count, StoreHint hint = STORE_CACHED)
+{
+	detail::transform_affine(normal_matrix(m), src, dst, count, false, hint);
+}
+
+//-------------------------------------//
+
+template<typename T>
+void transform(thread::TaskPool& pool, const Matrix<T, 4>& m, const Vector<T, 4>* src, Vector<T, 4>* dst, size_t count,
+			   StoreHint hint = STORE_CACHED, size_t grain = TRANSFORM_GRAIN)
+{
+	thread::parallel_for(pool, 0, count, grain, boost::bind(&detail::transform_range<T>, &m, src, dst, hint, boost::placeholders::_1, boost::placeholders::_2));
+}
+
+template<typename T>
+void transform_points(thread::TaskPool& pool, const Matrix<T, 4>& m, const Vector<T, 3>* src, Vector<T, 3>* dst, size_t count,
+					  StoreHint hint = STORE_CACHED, size_t grain = TRANSFORM_GRAIN)
+{
+	thread::parallel_for(pool, 0, count, grain, boost::bind(&detail::transform_affine_range<T>, &m, src, dst, true, hint, boost::placeholders::_1, boost::placeholders::_2));
+}
+
+template<typename T>
+void transform_directions(thread::TaskPool& pool, const Matrix<T, 4>& m, const Vector<T, 3>* src, Vector<T, 3>* dst, size_t count,
+						  StoreHint hint = STORE_CACHED, size_t grain = TRANSFORM_GRAIN)
+{
+	thread::parallel_for(pool, 0, count, grain, boost::bind(&detail::transform_affine_range<T>, &m, src, dst, false, hint, boost::placeholders::_1, boost::placeholders::_2));
+}
+
+template<typename T>
+void transform_normals(thread::TaskPool& pool, const Matrix<T, 4>& m, const Vector<T, 3>* src, Vector<T, 3>* dst, size_t count,
+					   StoreHint hint = STORE_CACHED, size_t grain = TRANSFORM_GRAIN)
+{
+	const Matrix<T, 4> n = normal_matrix(m);
+	thread::parallel_for(pool, 0, count, grain, boost::bind(&detail::transform_affine_range<T>, &n, src, dst, false, hint, boost::placeholders::_1, boost::placeholders::_2));
+}
+
+template<typename T>
+void transform_points(thread::TaskPool& pool, const Matrix<T, 4>& m, const T* const src[3], T* const dst[3], size_t count,
+					  StoreHint hint = STORE_CACHED, size_t grain = TRANSFORM_GRAIN)
+{
+	thread::parallel_for(pool, 0, count, grain, boost::bind(&detail::transform_affine_stream_range<T>, &m, src, dst, true, hint, boost::placeholders::_1, boost::placeholders::_2));
+}
+
+template<typename T>
+void transform_directions(thread::TaskPool& pool, const Matrix<T, 4>& m, const T* const src[3], T* const dst[3], size_t count,
+						  StoreHint hint = STORE_CACHED, size_t grain = TRANSFORM_GRAIN)
+{
+	thread::parallel_for(pool, 0, count, grain, boost::bind(&detail::transform_affine_stream_range<T>, &m, src, dst, false, hint, boost::placeholders::_1, boost::placeholders::_2));
+}
+
+template<typename T>
+void transform_normals(thread::TaskPool& pool, const Matrix<T, 4>& m, const T* const src[3], T* const dst[3], size_t count,
+					   StoreHint hint = STORE_CACHED, size_t grain = TRANSFORM_GRAIN)
+{
+	const Matrix<T, 4> n = normal_matrix(m);
+	thread::parallel_for(pool, 0, count, grain, boost::bind(&detail::transform_affine_stream_range<T>, &n, src, dst, false, hint, boost::placeholders::_1, boost::placeholders::_2));
+}
+
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_TRANSFORM__
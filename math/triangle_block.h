@@ -0,0 +1,721 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Triangles packed for intersection: TriangleBlocks keeps only the vertices,
+ * N triangles per block as structure of arrays (36 bytes per float triangle
+ * instead of the 96 of Triangle<float, 4>), and tests one ray against a whole
+ * block at once:
+ *
+ *   TriangleBlockScene<float, 8> scene(triangles, count, pool);
+ *   scene.closest_hit(ray, hit, primitive);
+ *   scene.occluded(ray, t_max);					// first hit closer than t_max
+ *
+ *   MeshScene<float, 8> mesh_scene(mesh, pool);	// faces of an IndexedMesh
+ *
+ * The intersection is the watertight test of Woop, Benthin and Wald (JCGT
+ * 2013): vertices are moved into a space where the ray is the z axis and
+ * the 2D edge functions are evaluated there, in double precision if a float
+ * result is exactly zero. Two triangles sharing an edge compute that edge
+ * function from the same numbers with opposite signs, so rays through
+ * shared edges and vertices hit at least one of them. Backfaces are hits,
+ * as with intersect(). Unlike intersect(), there is no minimum determinant,
+ * so tiny triangles are not lost either.
+ */
+
+#if !defined(DEIMOS_MATH_TRIANGLE_BLOCK__)
+#define DEIMOS_MATH_TRIANGLE_BLOCK__
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "../memory/aligned_array.h"
+#include "../thread/task_pool.h"
+#include "bvh.h"
+#include "intersect.h"
+#include "mesh.h"
+#include "packet.h"
+#include "ray.h"
+#include "triangle.h"
+
+namespace deimos {
+namespace math {
+namespace geometry {
+
+/*
+ * Ray prepared for the watertight test: kz is the axis of the largest
+ * direction component, kx and ky keep the winding and the shear moves the
+ * direction onto the z axis.
+ */
+template<typename T>
+struct WatertightRay
+{
+	T origin_[3];
+	int kx_, ky_, kz_;
+	T sx_, sy_, sz_;
+
+	explicit WatertightRay(const Ray<T, 4>& ray)
+	{
+		kz_ = 0;
+
+		for (int i=1; i < 3; ++i)
+			if (std::abs(ray.direction_[i]) > std::abs(ray.direction_[kz_]))
+				kz_ = i;
+
+		kx_ = (kz_ + 1) % 3;
+		ky_ = (kx_ + 1) % 3;
+
+		if (ray.direction_[kz_] < 0)
+			std::swap(kx_, ky_);
+
+		sx_ = ray.direction_[kx_] / ray.direction_[kz_];
+		sy_ = ray.direction_[ky_] / ray.direction_[kz_];
+		sz_ = 1 / ray.direction_[kz_];
+
+		for (int i=0; i < 3; ++i)
+			origin_[i] = ray.origin_[i];
+	};
+};
+
+namespace detail {
+
+	// precision of the edge function fallback
+	template<typename T> struct watertight_fallback		{ typedef T type; };
+	template<> struct watertight_fallback<float>		{ typedef double type; };
+
+	/*
+	 * 2D edge function px*qy - py*qx of sheared vertices. It is always
+	 * evaluated with the lexicographically smaller vertex first, so the
+	 * triangle on the other side of an edge gets exactly the negated value,
+	 * even if the compiler fuses the products into multiply-adds.
+	 */
+	template<typename T>
+	inline bool edge_swap(T px, T py, T qx, T qy)
+	{
+		return qx < px || (qx == px && qy < py);
+	}
+
+	template<typename T>
+	inline T edge_function(T px, T py, T qx, T qy)
+	{
+		if (edge_swap(px, py, qx, qy))
+			return -(qx*py - qy*px);
+
+		return px*qy - py*qx;
+	}
+
+	// the same in higher precision, exact for floats
+	template<typename T>
+	inline T edge_function_exact(T px, T py, T qx, T qy)
+	{
+		typedef typename watertight_fallback<T>::type W;
+
+		if (edge_swap(px, py, qx, qy))
+			return static_cast<T>(-(W(qx)*W(py) - W(qy)*W(px)));
+
+		return static_cast<T>(W(px)*W(qy) - W(py)*W(qx));
+	}
+
+	template<typename T, int N>
+	inline ScalarPacket<T, N> edge_function(const ScalarPacket<T, N>& px, const ScalarPacket<T, N>& py,
+		const ScalarPacket<T, N>& qx, const ScalarPacket<T, N>& qy)
+	{
+		const unsigned int swap = qx.less(px) | (qx.equal(px) & qy.less(py));
+
+		const ScalarPacket<T, N> ax = select(swap, qx, px);
+		const ScalarPacket<T, N> ay = select(swap, qy, py);
+		const ScalarPacket<T, N> bx = select(swap, px, qx);
+		const ScalarPacket<T, N> by = select(swap, py, qy);
+
+		const ScalarPacket<T, N> e = ax*by - ay*bx;
+		return select(swap, ScalarPacket<T, N>::broadcast(0) - e, e);
+	}
+
+	/*
+	 * Watertight test of the triangle a, b, c against ray, hits at distance
+	 * t in [0, t_max). u and v weigh b and c like the barycentrics of
+	 * intersect().
+	 */
+	template<typename T>
+	bool intersect_watertight(const T* a, const T* b, const T* c, const WatertightRay<T>& ray, T t_max, T& t, T& u, T& v)
+	{
+		const T az = a[ray.kz_] - ray.origin_[ray.kz_];
+		const T bz = b[ray.kz_] - ray.origin_[ray.kz_];
+		const T cz = c[ray.kz_] - ray.origin_[ray.kz_];
+
+		const T ax = (a[ray.kx_] - ray.origin_[ray.kx_]) - ray.sx_*az;
+		const T ay = (a[ray.ky_] - ray.origin_[ray.ky_]) - ray.sy_*az;
+		const T bx = (b[ray.kx_] - ray.origin_[ray.kx_]) - ray.sx_*bz;
+		const T by = (b[ray.ky_] - ray.origin_[ray.ky_]) - ray.sy_*bz;
+		const T cx = (c[ray.kx_] - ray.origin_[ray.kx_]) - ray.sx_*cz;
+		const T cy = (c[ray.ky_] - ray.origin_[ray.ky_]) - ray.sy_*cz;
+
+		T eu = edge_function(cx, cy, bx, by);
+		T ev = edge_function(ax, ay, cx, cy);
+		T ew = edge_function(bx, by, ax, ay);
+
+		if (eu == 0 || ev == 0 || ew == 0)
+		{
+			eu = edge_function_exact(cx, cy, bx, by);
+			ev = edge_function_exact(ax, ay, cx, cy);
+			ew = edge_function_exact(bx, by, ax, ay);
+		}
+
+		if ((eu < 0 || ev < 0 || ew < 0) && (eu > 0 || ev > 0 || ew > 0))
+			return false;
+
+		const T det = eu + ev + ew;
+		if (det == 0)
+			return false;
+
+		const T invdet = 1/det;
+		const T dist = (eu*(ray.sz_*az) + ev*(ray.sz_*bz) + ew*(ray.sz_*cz)) * invdet;
+
+		if (!(dist >= 0 && dist < t_max))
+			return false;
+
+		t = dist;
+		u = ev*invdet;
+		v = ew*invdet;
+
+		return true;
+	}
+
+} // namespace detail
+
+// one triangle, mostly as reference for the blocks
+template<typename T>
+bool intersect_watertight(const Triangle<T, 4>& triangle, const WatertightRay<T>& ray, T t_max, T& t, T& u, T& v)
+{
+	T p[3][3];
+
+	for (int k=0; k < 3; ++k)
+		for (int i=0; i < 3; ++i)
+			p[k][i] = triangle.vertex_[k][i];
+
+	return detail::intersect_watertight(p[0], p[1], p[2], ray, t_max, t, u, v);
+}
+
+//-------------------------------------//
+
+// vertices of N triangles, component c of vertex k of lane i is vertex_[k].component_[c][i]
+template<typename T, int N>
+struct TriangleBlock
+{
+	VectorPacket<T, 3, N> vertex_[3];
+
+	void set(int lane, const Vector<T, 4>& v0, const Vector<T, 4>& v1, const Vector<T, 4>& v2)
+	{
+		assert(lane >= 0 && lane < N);
+
+		for (int c=0; c < 3; ++c)
+		{
+			vertex_[0].component_[c].element_[lane] = v0[c];
+			vertex_[1].component_[c].element_[lane] = v1[c];
+			vertex_[2].component_[c].element_[lane] = v2[c];
+		}
+	};
+
+	inline void set(int lane, const Triangle<T, 4>& op)
+	{
+		set(lane, op.vertex_[0], op.vertex_[1], op.vertex_[2]);
+	};
+};
+
+namespace detail {
+
+	/*
+	 * The watertight test for the lanes of mask, the same steps as the scalar
+	 * version. Returns the lanes hit closer than t_max with the distances in
+	 * t and the barycentric coordinates of vertex 1 and 2 in ev*invdet and
+	 * ew*invdet.
+	 */
+	template<typename T, int N>
+	unsigned int block_hits(const TriangleBlock<T, N>& block, const WatertightRay<T>& ray, unsigned int mask, T t_max,
+		ScalarPacket<T, N>& t, ScalarPacket<T, N>& ev, ScalarPacket<T, N>& ew, ScalarPacket<T, N>& invdet)
+	{
+		typedef ScalarPacket<T, N> Scalar;
+
+		const Scalar zero = Scalar::broadcast(0);
+
+		const Scalar ox = Scalar::broadcast(ray.origin_[ray.kx_]);
+		const Scalar oy = Scalar::broadcast(ray.origin_[ray.ky_]);
+		const Scalar oz = Scalar::broadcast(ray.origin_[ray.kz_]);
+		const Scalar sx = Scalar::broadcast(ray.sx_);
+		const Scalar sy = Scalar::broadcast(ray.sy_);
+		const Scalar sz = Scalar::broadcast(ray.sz_);
+
+		Scalar x[3], y[3], z[3];
+
+		for (int k=0; k < 3; ++k)
+		{
+			z[k] = block.vertex_[k].component_[ray.kz_] - oz;
+			x[k] = (block.vertex_[k].component_[ray.kx_] - ox) - sx*z[k];
+			y[k] = (block.vertex_[k].component_[ray.ky_] - oy) - sy*z[k];
+		}
+
+		Scalar eu = edge_function(x[2], y[2], x[1], y[1]);
+		ev = edge_function(x[0], y[0], x[2], y[2]);
+		ew = edge_function(x[1], y[1], x[0], y[0]);
+
+		// lanes with an edge exactly on the ray are redone in higher precision
+		const unsigned int exact = mask & (eu.equal(zero) | ev.equal(zero) | ew.equal(zero));
+
+		for (int i=0; i < N; ++i)
+			if (exact & (1u << i))
+			{
+				eu[i] = edge_function_exact(x[2][i], y[2][i], x[1][i], y[1][i]);
+				ev[i] = edge_function_exact(x[0][i], y[0][i], x[2][i], y[2][i]);
+				ew[i] = edge_function_exact(x[1][i], y[1][i], x[0][i], y[0][i]);
+			}
+
+		const unsigned int negative = eu.less(zero) | ev.less(zero) | ew.less(zero);
+		const unsigned int positive = zero.less(eu) | zero.less(ev) | zero.less(ew);
+
+		mask &= ~(negative & positive);
+
+		const Scalar det = eu + ev + ew;
+		mask &= ~det.equal(zero);
+
+		if (!mask)
+			return 0;
+
+		invdet = Scalar::broadcast(1) / det;
+		t = (eu*(sz*z[0]) + ev*(sz*z[1]) + ew*(sz*z[2])) * invdet;
+
+		return mask & zero.less_equal(t) & t.less(Scalar::broadcast(t_max));
+	}
+
+} // namespace detail
+
+// lane of the closest hit nearer than t_max, which is lowered to it, or -1; ties go to the lowest lane
+template<typename T, int N>
+int intersect(const TriangleBlock<T, N>& block, const WatertightRay<T>& ray, unsigned int mask, T& t_max, T& u, T& v)
+{
+	ScalarPacket<T, N> t, ev, ew, invdet;
+
+	mask = detail::block_hits(block, ray, mask, t_max, t, ev, ew, invdet);
+	if (!mask)
+		return -1;
+
+	const int res = detail::closest_lane(t, mask);
+
+	t_max = t[res];
+	u = ev[res]*invdet[res];
+	v = ew[res]*invdet[res];
+
+	return res;
+}
+
+// the lanes of mask hit closer than t_max
+template<typename T, int N>
+unsigned int occluded(const TriangleBlock<T, N>& block, const WatertightRay<T>& ray, unsigned int mask, T t_max)
+{
+	ScalarPacket<T, N> t, ev, ew, invdet;
+	return detail::block_hits(block, ray, mask, t_max, t, ev, ew, invdet);
+}
+
+/*
+ * Triangles in blocks of N, entry i in lane i%N of block i/N. Lanes past
+ * the last triangle repeat it and are never tested.
+ */
+template<typename T, int N>
+class TriangleBlocks
+{
+protected:
+	memory::AlignedArray< TriangleBlock<T, N> > blocks_;
+	size_t size_;
+
+	void fill_chunk(const Triangle<T, 4>* triangles, const unsigned int* order, size_t first, size_t last)
+	{
+		for (size_t b=first; b < last; ++b)
+			for (int i=0; i < N; ++i)
+			{
+				const size_t e = std::min(b*N + i, size_ - 1);
+				blocks_[b].set(i, triangles[order ? order[e] : e]);
+			}
+	}
+
+	void fill_mesh_chunk(const IndexedMesh<T>* mesh, const unsigned int* order, size_t first, size_t last)
+	{
+		for (size_t b=first; b < last; ++b)
+			for (int i=0; i < N; ++i)
+			{
+				const size_t e = std::min(b*N + i, size_ - 1);
+				const size_t f = order ? order[e] : e;
+				blocks_[b].set(i, mesh->get_vertex(f, 0), mesh->get_vertex(f, 1), mesh->get_vertex(f, 2));
+			}
+	}
+
+public:
+	TriangleBlocks() : size_(0) {};
+
+	// entry i is triangles[order[i]], or triangles[i] without order
+	void build(const Triangle<T, 4>* triangles, size_t n, const unsigned int* order = 0)
+	{
+		size_ = n;
+		blocks_.resize((n + N - 1) / N);
+		fill_chunk(triangles, order, 0, blocks_.size());
+	};
+
+	void build(thread::TaskPool& pool, const Triangle<T, 4>* triangles, size_t n, const unsigned int* order = 0)
+	{
+		using namespace boost::placeholders;
+
+		size_ = n;
+		blocks_.resize((n + N - 1) / N);
+		thread::parallel_for(pool, 0, blocks_.size(), detail::BVH_GRAIN / N,
+			boost::bind(&TriangleBlocks::fill_chunk, this, triangles, order, _1, _2));
+	};
+
+	// entry i is face order[i] of mesh, or face i without order
+	void build(const IndexedMesh<T>& mesh, const unsigned int* order = 0)
+	{
+		size_ = mesh.num_faces();
+		blocks_.resize((size_ + N - 1) / N);
+		fill_mesh_chunk(&mesh, order, 0, blocks_.size());
+	};
+
+	void build(thread::TaskPool& pool, const IndexedMesh<T>& mesh, const unsigned int* order = 0)
+	{
+		using namespace boost::placeholders;
+
+		size_ = mesh.num_faces();
+		blocks_.resize((size_ + N - 1) / N);
+		thread::parallel_for(pool, 0, blocks_.size(), detail::BVH_GRAIN / N,
+			boost::bind(&TriangleBlocks::fill_mesh_chunk, this, &mesh, order, _1, _2));
+	};
+
+	inline size_t size() const									{ return size_; };
+	inline size_t num_blocks() const								{ return blocks_.size(); };
+	inline const TriangleBlock<T, N>& get_block(size_t n) const	{ return blocks_[n]; };
+
+	// the lanes of block b with entries from first to last-1
+	static inline unsigned int lane_mask(size_t b, size_t first, size_t last)
+	{
+		const size_t lo = std::max(first, b*N) - b*N;
+		const size_t hi = std::min(last, b*N + N) - b*N;
+
+		return (full_mask<N>() >> (N - (hi - lo))) << lo;
+	};
+
+	/*
+	 * Closest hit among entries first to first+count-1 nearer than t_max,
+	 * sets entry and lowers t_max to it. A range touches one block more
+	 * than it fills at most, the lanes outside are masked off.
+	 */
+	bool intersect(const WatertightRay<T>& ray, size_t first, size_t count, T& t_max, T& u, T& v, size_t& entry) const
+	{
+		assert(first + count <= size_);
+
+		bool res = false;
+		const size_t last = first + count;
+
+		for (size_t b=first/N; b*N < last; ++b)
+		{
+			const int lane = geometry::intersect(blocks_[b], ray, lane_mask(b, first, last), t_max, u, v);
+
+			if (lane >= 0)
+			{
+				entry = b*N + lane;
+				res = true;
+			}
+		}
+
+		return res;
+	};
+
+	// true if any of the entries first to first+count-1 is hit closer than t_max
+	bool occluded(const WatertightRay<T>& ray, size_t first, size_t count, T t_max) const
+	{
+		assert(first + count <= size_);
+
+		const size_t last = first + count;
+
+		for (size_t b=first/N; b*N < last; ++b)
+			if (geometry::occluded(blocks_[b], ray, lane_mask(b, first, last), t_max))
+				return true;
+
+		return false;
+	};
+};
+
+//-------------------------------------//
+
+namespace detail {
+
+	template<typename T, int N>
+	struct BlockAnyHit
+	{
+		const TriangleBlocks<T, N>* blocks_;
+		const WatertightRay<T>* ray_;
+
+		inline bool operator()(unsigned int first, unsigned int count, T& t_max) const
+		{
+			return blocks_->occluded(*ray_, first, count, t_max);
+		};
+	};
+
+	template<typename T, int N>
+	struct BlockClosestHit
+	{
+		const TriangleBlocks<T, N>* blocks_;
+		const WatertightRay<T>* ray_;
+		T t_, u_, v_;
+		size_t entry_;
+
+		inline bool operator()(unsigned int first, unsigned int count, T& t_max)
+		{
+			if (!blocks_->intersect(*ray_, first, count, t_max, u_, v_, entry_))
+				return false;
+
+			t_ = t_max;
+			return true;
+		};
+	};
+
+} // namespace detail
+
+/*
+ * Triangles in a Bvh whose leaves are read from TriangleBlocks in leaf
+ * order, a scene for RayCaster. The triangles must outlive it, their
+ * normals are only read for the closest hit.
+ */
+template<typename T, int N>
+class TriangleBlockScene
+{
+public:
+	typedef T value_type;
+
+protected:
+	const Triangle<T, 4>* triangles_;
+	Bvh<T> bvh_;
+	TriangleBlocks<T, N> blocks_;
+
+	void bounds_chunk(AABB<T, 3>* boxes, size_t first, size_t last) const
+	{
+		for (size_t i=first; i < last; ++i)
+			boxes[i] = bounds(triangles_[i]);
+	}
+
+public:
+	TriangleBlockScene(const Triangle<T, 4>* triangles, size_t size) : triangles_(triangles)
+	{
+		memory::AlignedArray< AABB<T, 3> > boxes(size);
+		bounds_chunk(boxes.data(), 0, size);
+
+		bvh_.build(boxes.data(), size);
+		blocks_.build(triangles, size, bvh_.get_indices());
+	};
+
+	TriangleBlockScene(const Triangle<T, 4>* triangles, size_t size, thread::TaskPool& pool, BvhBuildMethod method = BVH_BUILD_BINNED) : triangles_(triangles)
+	{
+		using namespace boost::placeholders;
+
+		memory::AlignedArray< AABB<T, 3> > boxes(size);
+		thread::parallel_for(pool, 0, size, detail::BVH_GRAIN, boost::bind(&TriangleBlockScene::bounds_chunk, this, boxes.data(), _1, _2));
+
+		if (method == BVH_BUILD_SWEEP)
+			bvh_.build(boxes.data(), size);
+		else if (method == BVH_BUILD_BINNED)
+			bvh_.build_binned(pool, boxes.data(), size);
+		else
+			bvh_.build_morton(pool, boxes.data(), size);
+
+		blocks_.build(pool, triangles, size, bvh_.get_indices());
+	};
+
+	inline const Bvh<T>& get_bvh() const						{ return bvh_; };
+	inline const TriangleBlocks<T, N>& get_blocks() const		{ return blocks_; };
+
+	// boxes of the triangles as they are now
+	void get_boxes(thread::TaskPool& pool, memory::AlignedArray< AABB<T, 3> >& boxes) const
+	{
+		using namespace boost::placeholders;
+
+		boxes.resize(blocks_.size());
+		thread::parallel_for(pool, 0, blocks_.size(), detail::BVH_GRAIN, boost::bind(&TriangleBlockScene::bounds_chunk, this, boxes.data(), _1, _2));
+	};
+
+	// after the triangles moved, boxes from get_boxes(); the blocks are filled again
+	void refit(thread::TaskPool& pool, const AABB<T, 3>* boxes)
+	{
+		bvh_.refit(pool, boxes);
+		blocks_.build(pool, triangles_, blocks_.size(), bvh_.get_indices());
+	};
+
+	// swaps in bvh, built over older boxes of the same triangles, and refits it
+	void swap_bvh(thread::TaskPool& pool, const AABB<T, 3>* boxes, Bvh<T>& bvh)
+	{
+		bvh_.swap(bvh);
+		refit(pool, boxes);
+	};
+
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive, BvhTraversalStats* stats) const
+	{
+		const WatertightRay<T> r(ray);
+		detail::BlockClosestHit<T, N> leaf = { &blocks_, &r, 0, 0, 0, 0 };
+
+		hit.valid_ = false;
+		hit.distance_ = std::numeric_limits<T>::infinity();
+		primitive = NO_HIT;
+
+		if (!bvh_.traverse_leaves(ray, std::numeric_limits<T>::max(), leaf, stats))
+			return false;
+
+		primitive = bvh_.get_index(leaf.entry_);
+		hit = detail::triangle_hit(triangles_[primitive], ray, leaf.t_, leaf.u_, leaf.v_, exact_math());
+
+		return true;
+	};
+
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive) const
+	{
+		return closest_hit(ray, hit, primitive, 0);
+	};
+
+	// true if any triangle is hit closer than t_max, e.g. for shadow rays
+	bool occluded(const Ray<T, 4>& ray, T t_max, BvhTraversalStats* stats) const
+	{
+		const WatertightRay<T> r(ray);
+		detail::BlockAnyHit<T, N> leaf = { &blocks_, &r };
+
+		return bvh_.traverse_any_leaves(ray, t_max, leaf, stats);
+	};
+
+	bool occluded(const Ray<T, 4>& ray, T t_max) const
+	{
+		return occluded(ray, t_max, 0);
+	};
+};
+
+/*
+ * The faces of an IndexedMesh in a Bvh with TriangleBlocks leaves, the same
+ * as a TriangleBlockScene of the faces as triangles. The mesh must outlive
+ * it, its normals are only read for the closest hit.
+ */
+template<typename T, int N>
+class MeshScene
+{
+public:
+	typedef T value_type;
+
+protected:
+	const IndexedMesh<T>* mesh_;
+	Bvh<T> bvh_;
+	TriangleBlocks<T, N> blocks_;
+
+	void bounds_chunk(AABB<T, 3>* boxes, size_t first, size_t last) const
+	{
+		for (size_t i=first; i < last; ++i)
+			boxes[i] = bounds(*mesh_, i);
+	}
+
+public:
+	MeshScene(const IndexedMesh<T>& mesh) : mesh_(&mesh)
+	{
+		const size_t size = mesh.num_faces();
+
+		memory::AlignedArray< AABB<T, 3> > boxes(size);
+		bounds_chunk(boxes.data(), 0, size);
+
+		bvh_.build(boxes.data(), size);
+		blocks_.build(mesh, bvh_.get_indices());
+	};
+
+	MeshScene(const IndexedMesh<T>& mesh, thread::TaskPool& pool, BvhBuildMethod method = BVH_BUILD_BINNED) : mesh_(&mesh)
+	{
+		using namespace boost::placeholders;
+
+		const size_t size = mesh.num_faces();
+
+		memory::AlignedArray< AABB<T, 3> > boxes(size);
+		thread::parallel_for(pool, 0, size, detail::BVH_GRAIN, boost::bind(&MeshScene::bounds_chunk, this, boxes.data(), _1, _2));
+
+		if (method == BVH_BUILD_SWEEP)
+			bvh_.build(boxes.data(), size);
+		else if (method == BVH_BUILD_BINNED)
+			bvh_.build_binned(pool, boxes.data(), size);
+		else
+			bvh_.build_morton(pool, boxes.data(), size);
+
+		blocks_.build(pool, mesh, bvh_.get_indices());
+	};
+
+	inline const IndexedMesh<T>& get_mesh() const				{ return *mesh_; };
+	inline const Bvh<T>& get_bvh() const						{ return bvh_; };
+	inline const TriangleBlocks<T, N>& get_blocks() const		{ return blocks_; };
+
+	// boxes of the faces as they are now
+	void get_boxes(thread::TaskPool& pool, memory::AlignedArray< AABB<T, 3> >& boxes) const
+	{
+		using namespace boost::placeholders;
+
+		const size_t size = mesh_->num_faces();
+
+		boxes.resize(size);
+		thread::parallel_for(pool, 0, size, detail::BVH_GRAIN, boost::bind(&MeshScene::bounds_chunk, this, boxes.data(), _1, _2));
+	};
+
+	// after the vertices moved, boxes from get_boxes(); the blocks are filled again
+	void refit(thread::TaskPool& pool, const AABB<T, 3>* boxes)
+	{
+		bvh_.refit(pool, boxes);
+		blocks_.build(pool, *mesh_, bvh_.get_indices());
+	};
+
+	// swaps in bvh, built over older boxes of the same faces, and refits it
+	void swap_bvh(thread::TaskPool& pool, const AABB<T, 3>* boxes, Bvh<T>& bvh)
+	{
+		bvh_.swap(bvh);
+		refit(pool, boxes);
+	};
+
+	// primitive is the face
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive, BvhTraversalStats* stats) const
+	{
+		const WatertightRay<T> r(ray);
+		detail::BlockClosestHit<T, N> leaf = { &blocks_, &r, 0, 0, 0, 0 };
+
+		hit.valid_ = false;
+		hit.distance_ = std::numeric_limits<T>::infinity();
+		primitive = NO_HIT;
+
+		if (!bvh_.traverse_leaves(ray, std::numeric_limits<T>::max(), leaf, stats))
+			return false;
+
+		primitive = bvh_.get_index(leaf.entry_);
+		hit = detail::mesh_hit(*mesh_, primitive, ray, leaf.t_, leaf.u_, leaf.v_, exact_math());
+
+		return true;
+	};
+
+	bool closest_hit(const Ray<T, 4>& ray, intersection_point<T>& hit, size_t& primitive) const
+	{
+		return closest_hit(ray, hit, primitive, 0);
+	};
+
+	// true if any triangle is hit closer than t_max, e.g. for shadow rays
+	bool occluded(const Ray<T, 4>& ray, T t_max, BvhTraversalStats* stats) const
+	{
+		const WatertightRay<T> r(ray);
+		detail::BlockAnyHit<T, N> leaf = { &blocks_, &r };
+
+		return bvh_.traverse_any_leaves(ray, t_max, leaf, stats);
+	};
+
+	bool occluded(const Ray<T, 4>& ray, T t_max) const
+	{
+		return occluded(ray, t_max, 0);
+	};
+};
+
+} // namespace geometry
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_MATH_TRIANGLE_BLOCK__
@@ -10,9 +10,44 @@
 #include <cassert>
 #include <cmath>
 
+#include "config.h"
+#include "fast_math.h"
+
 namespace deimos {
 namespace math {
 
+namespace detail {
+
+	// Newton iteration from above, for square roots in constant expressions
+	template<typename T>
+	DEIMOS_CONSTEXPR T constexpr_sqrt(T op)
+	{
+		assert(op >= 0);
+
+		T res = (op > 1) ? op : T(1);
+
+		for (;;)
+		{
+			const T next = T(0.5) * (res + op / res);
+
+			if (!(next < res))
+				return (op == 0) ? op : res;
+
+			res = next;
+		}
+	}
+
+	template<typename T>
+	DEIMOS_CONSTEXPR_BRANCH T sqrt(T op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return constexpr_sqrt(op);
+
+		return static_cast<T>(std::sqrt(op));
+	}
+
+} // namespace detail
+
 template<typename T, int S>
 class Vector
 {
@@ -20,7 +55,7 @@ public:
 	typedef Vector<T, S> Vec;
 	T element_[S];
 
-	bool operator==(const Vec& op) const
+	DEIMOS_CONSTEXPR bool operator==(const Vec& op) const
 	{
 		for (int i=0; i < S; ++i)
 			if (element_[i] != op.element_[i])
@@ -29,9 +64,9 @@ public:
 		return true;
 	};
 
-	const Vec operator+(const Vec& op) const
+	DEIMOS_CONSTEXPR const Vec operator+(const Vec& op) const
 	{
-		Vec res;
+		Vec res = Vec();
 
 		for (int i=0; i<S; ++i)
 			res.element_[i] = element_[i] + op.element_[i];
@@ -39,9 +74,9 @@ public:
 		return res;
 	};
 
-	const Vec operator-(const Vec& op) const
+	DEIMOS_CONSTEXPR const Vec operator-(const Vec& op) const
 	{
-		Vec res;
+		Vec res = Vec();
 
 		for (int i=0; i<S; ++i)
 			res.element_[i] = element_[i] - op.element_[i];
@@ -50,7 +85,7 @@ public:
 	};
 
 	// Inner product
-	T operator*(const Vec& op) const
+	DEIMOS_CONSTEXPR T operator*(const Vec& op) const
 	{
 		T res = T();
 
@@ -60,9 +95,9 @@ public:
 		return res;
 	};
 
-	const Vec operator*(T op) const
+	DEIMOS_CONSTEXPR const Vec operator*(T op) const
 	{
-		Vec res;
+		Vec res = Vec();
 
 		for (int i=0; i<S; ++i)
 			res.element_[i] = element_[i] * op;
@@ -70,97 +105,105 @@ public:
 		return res;
 	};
 
-	const Vec operator/(T op) const
+	DEIMOS_CONSTEXPR const Vec operator/(T op) const
 	{
 		return operator*(1/op);
 	};
 
-	void operator*=(T op)
+	DEIMOS_CONSTEXPR void operator*=(T op)
 	{
 		for (int i=0; i<S; ++i)
 			element_[i]*=op;
 	};
 
-	void operator/=(T op)
+	DEIMOS_CONSTEXPR void operator/=(T op)
 	{
 		operator*=(1/op);
 	};
 
-	void operator+=(const Vec& op)
+	DEIMOS_CONSTEXPR void operator+=(const Vec& op)
 	{
 		for (int i=0; i<S; ++i)
 			element_[i]+=op.element_[i];
 	};
 
-	void operator-=(const Vec& op)
+	DEIMOS_CONSTEXPR void operator-=(const Vec& op)
 	{
 		for (int i=0; i<S; ++i)
 			element_[i]-=op.element_[i];
 	};
 
-	inline const T& operator[](int n) const
+	DEIMOS_CONSTEXPR inline const T& operator[](int n) const
 	{
 		assert(n >=0 && n < S);
 
 		return element_[n];
 	};
 
-	inline T& operator[](int n)
+	DEIMOS_CONSTEXPR inline T& operator[](int n)
 	{
 		assert(n >=0 && n < S);
 
 		return element_[n];
 	};
 
-	T size_sqr() const
+	DEIMOS_CONSTEXPR T size_sqr() const
 	{
 		return (*this * *this);
 	};
 
-	T size() const
+	DEIMOS_CONSTEXPR_BRANCH T size() const
 	{
-		return static_cast<T>(sqrt(size_sqr()));
+		return detail::sqrt(size_sqr());
 	};
 
-	void clear(T op=0)
+	DEIMOS_CONSTEXPR void clear(T op=0)
 	{
 		for (int i=0; i < S; ++i)
 			element_[i]=op;
 	};
 
-	void normalize()
+	DEIMOS_CONSTEXPR_BRANCH void normalize()
 	{
 		assert(size());
 		*this *= T(1/size());
 	};
 
-	Vec project_to(const Vec& op) const
+	// square root taken from a math policy, e.g. normalize(fast_math())
+	template<class M>
+	void normalize(M)
+	{
+		assert(size_sqr());
+		*this *= M::rsqrt(size_sqr());
+	};
+
+	DEIMOS_CONSTEXPR Vec project_to(const Vec& op) const
 	{
 		return op * ((*this * op)/op.size_sqr());
 	};
 
-	bool is_parallel_to(const Vec& op) const
+	DEIMOS_CONSTEXPR bool is_parallel_to(const Vec& op) const
 	{
 		Vec temp(op.project_to(*this));
 
 		return temp == op;
 	};
 
-	T* get_addr()
+	DEIMOS_CONSTEXPR T* get_addr()
 	{
 		return &(element_[0]);
 	};
 
-    const T* get_addr() const
+	DEIMOS_CONSTEXPR const T* get_addr() const
 	{
 		return &(element_[0]);
 	};
 };
 
 template<typename T>
-Vector<T, 3> cross_product(const Vector<T, 3>& op1, const Vector<T, 3>& op2)
+DEIMOS_CONSTEXPR Vector<T, 3> cross_product(const Vector<T, 3>& op1, const Vector<T, 3>& op2)
 {
-	Vector<T, 3> res;
+	Vector<T, 3> res = Vector<T, 3>();
 
 	res[0]=op1[1]*op2[2] - op1[2]*op2[1];
 	res[1]=op1[2]*op2[0] - op1[0]*op2[2];
@@ -170,9 +213,9 @@ Vector<T, 3> cross_product(const Vector<T, 3>& op1, const Vector<T, 3>& op2)
 };
 
 template<typename T>
-Vector<T, 4> cross_product(const Vector<T, 4>& op1, const Vector<T, 4>& op2)
+DEIMOS_CONSTEXPR Vector<T, 4> cross_product(const Vector<T, 4>& op1, const Vector<T, 4>& op2)
 {
-	Vector<T, 4> res;
+	Vector<T, 4> res = Vector<T, 4>();
 
 	res[0]=op1[1]*op2[2] - op1[2]*op2[1];
 	res[1]=op1[2]*op2[0] - op1[0]*op2[2];
@@ -191,4 +234,7 @@ Vector<T, S> get_normal_angle(const Vector<T, S>& op1, const Vector<T, S>& op2)
 } // namespace math
 } // namespace deimos
 
+// SIMD specializations for float and double vectors
+#include "vector_simd.h"
+
 #endif // DEIMOS_MATH_VECTOR__
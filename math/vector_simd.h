@@ -0,0 +1,775 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2003
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * SSE/AVX specializations of Vector<float, 4>, Vector<float, 3> and
+ * Vector<double, 4> with the same interface as the generic template.
+ * Vector<float, 3> is padded to 16 bytes, the padding lane is kept at zero.
+ * Loads and stores are unaligned so that heap arrays without over-aligned
+ * allocation stay valid, stack and static vectors are aligned anyway.
+ *
+ * With DEIMOS_CONSTEXPR_BRANCH the operators fall back to scalar code during
+ * constant evaluation.
+ *
+ * Included by vector.h, don't include directly.
+ */
+
+#if !defined(DEIMOS_MATH_VECTOR_SIMD__)
+#define DEIMOS_MATH_VECTOR_SIMD__
+
+#include "config.h"
+#include "simd.h"
+
+#if defined(DEIMOS_SSE2)
+
+namespace deimos {
+namespace math {
+
+namespace detail {
+
+	inline float hsum3(__m128 op)
+	{
+		// ((x + y) + z), same order as the generic inner product
+		const __m128 xy = _mm_add_ss(op, _mm_shuffle_ps(op, op, _MM_SHUFFLE(1, 1, 1, 1)));
+		return _mm_cvtss_f32(_mm_add_ss(xy, _mm_movehl_ps(op, op)));
+	}
+
+	inline __m128 hsum4(__m128 op)
+	{
+		// pairwise sum, broadcast to all lanes
+		const __m128 s = _mm_add_ps(op, _mm_shuffle_ps(op, op, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+
+	inline __m128 mask_xyz()
+	{
+		return _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	}
+
+	// (y, z, x, w)
+	inline __m128 shuffle_yzx(__m128 op)
+	{
+		return _mm_shuffle_ps(op, op, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	// same products and order as the generic cross_product, w is zero
+	inline __m128 cross_product(__m128 op1, __m128 op2)
+	{
+		const __m128 c = _mm_sub_ps(_mm_mul_ps(op1, shuffle_yzx(op2)), _mm_mul_ps(shuffle_yzx(op1), op2));
+		return _mm_and_ps(shuffle_yzx(c), mask_xyz());
+	}
+
+	/*
+	 * Scalar versions of the specialized operators, used during constant
+	 * evaluation where intrinsics are not available
+	 */
+	template<class V, int S>
+	DEIMOS_CONSTEXPR V constant_add(const V& op1, const V& op2)
+	{
+		V res = V();
+
+		for (int i=0; i < S; ++i)
+			res.element_[i] = op1.element_[i] + op2.element_[i];
+
+		return res;
+	}
+
+	template<class V, int S>
+	DEIMOS_CONSTEXPR V constant_sub(const V& op1, const V& op2)
+	{
+		V res = V();
+
+		for (int i=0; i < S; ++i)
+			res.element_[i] = op1.element_[i] - op2.element_[i];
+
+		return res;
+	}
+
+	template<class V, int S, typename T>
+	DEIMOS_CONSTEXPR V constant_scale(const V& op1, T op2)
+	{
+		V res = V();
+
+		for (int i=0; i < S; ++i)
+			res.element_[i] = op1.element_[i] * op2;
+
+		return res;
+	}
+
+	template<class V, int S, typename T>
+	DEIMOS_CONSTEXPR T constant_dot(const V& op1, const V& op2)
+	{
+		T res = T();
+
+		for (int i=0; i < S; ++i)
+			res += op1.element_[i] * op2.element_[i];
+
+		return res;
+	}
+
+	template<class V, int S>
+	DEIMOS_CONSTEXPR bool constant_equal(const V& op1, const V& op2)
+	{
+		for (int i=0; i < S; ++i)
+			if (op1.element_[i] != op2.element_[i])
+				return false;
+
+		return true;
+	}
+
+} // namespace detail
+
+//-------------------------------------//
+
+template<>
+class DEIMOS_ALIGN(16) Vector<float, 4>
+{
+public:
+	typedef Vector<float, 4> Vec;
+	float element_[4];
+
+	inline __m128 load() const
+	{
+		return _mm_loadu_ps(element_);
+	};
+
+	inline void store(__m128 op)
+	{
+		_mm_storeu_ps(element_, op);
+	};
+
+	static inline Vec make(__m128 op)
+	{
+		Vec res;
+		res.store(op);
+		return res;
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH bool operator==(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_equal<Vec, 4>(*this, op);
+
+		return _mm_movemask_ps(_mm_cmpeq_ps(load(), op.load())) == 0xf;
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator+(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_add<Vec, 4>(*this, op);
+
+		return make(_mm_add_ps(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator-(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_sub<Vec, 4>(*this, op);
+
+		return make(_mm_sub_ps(load(), op.load()));
+	};
+
+	// Inner product
+	DEIMOS_CONSTEXPR_BRANCH float operator*(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_dot<Vec, 4, float>(*this, op);
+
+		return _mm_cvtss_f32(detail::hsum4(_mm_mul_ps(load(), op.load())));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator*(float op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_scale<Vec, 4>(*this, op);
+
+		return make(_mm_mul_ps(load(), _mm_set1_ps(op)));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator/(float op) const
+	{
+		return operator*(1/op);
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator*=(float op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_scale<Vec, 4>(*this, op);
+			return;
+		}
+
+		store(_mm_mul_ps(load(), _mm_set1_ps(op)));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator/=(float op)
+	{
+		operator*=(1/op);
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator+=(const Vec& op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_add<Vec, 4>(*this, op);
+			return;
+		}
+
+		store(_mm_add_ps(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator-=(const Vec& op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_sub<Vec, 4>(*this, op);
+			return;
+		}
+
+		store(_mm_sub_ps(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR inline const float& operator[](int n) const
+	{
+		assert(n >=0 && n < 4);
+
+		return element_[n];
+	};
+
+	DEIMOS_CONSTEXPR inline float& operator[](int n)
+	{
+		assert(n >=0 && n < 4);
+
+		return element_[n];
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH float size_sqr() const
+	{
+		return (*this * *this);
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH float size() const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constexpr_sqrt(size_sqr());
+
+		return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(size_sqr())));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void clear(float op=0)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			for (int i=0; i < 4; ++i)
+				element_[i]=op;
+			return;
+		}
+
+		store(_mm_set1_ps(op));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void normalize()
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_scale<Vec, 4>(*this, float(1/size()));
+			return;
+		}
+
+		const __m128 v = load();
+		const __m128 len = _mm_sqrt_ps(detail::hsum4(_mm_mul_ps(v, v)));
+
+		assert(_mm_cvtss_f32(len));
+		store(_mm_div_ps(v, len));
+	};
+
+	// square root taken from a math policy, e.g. normalize(fast_math())
+	template<class M>
+	void normalize(M)
+	{
+		assert(size_sqr());
+		*this *= M::rsqrt(size_sqr());
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH Vec project_to(const Vec& op) const
+	{
+		return op * ((*this * op)/op.size_sqr());
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH bool is_parallel_to(const Vec& op) const
+	{
+		Vec temp(op.project_to(*this));
+
+		return temp == op;
+	};
+
+	DEIMOS_CONSTEXPR float* get_addr()
+	{
+		return &(element_[0]);
+	};
+
+	DEIMOS_CONSTEXPR const float* get_addr() const
+	{
+		return &(element_[0]);
+	};
+};
+
+//-------------------------------------//
+
+template<>
+class DEIMOS_ALIGN(16) Vector<float, 3>
+{
+public:
+	typedef Vector<float, 3> Vec;
+	float element_[3];
+
+	// the fourth lane reads the padding and is masked to zero
+	inline __m128 load() const
+	{
+		return _mm_and_ps(_mm_loadu_ps(element_), detail::mask_xyz());
+	};
+
+	inline void store(__m128 op)
+	{
+		_mm_storeu_ps(element_, op);
+	};
+
+	static inline Vec make(__m128 op)
+	{
+		Vec res;
+		res.store(op);
+		return res;
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH bool operator==(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_equal<Vec, 3>(*this, op);
+
+		return (_mm_movemask_ps(_mm_cmpeq_ps(load(), op.load())) & 0x7) == 0x7;
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator+(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_add<Vec, 3>(*this, op);
+
+		return make(_mm_add_ps(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator-(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_sub<Vec, 3>(*this, op);
+
+		return make(_mm_sub_ps(load(), op.load()));
+	};
+
+	// Inner product
+	DEIMOS_CONSTEXPR_BRANCH float operator*(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_dot<Vec, 3, float>(*this, op);
+
+		return detail::hsum3(_mm_mul_ps(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator*(float op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_scale<Vec, 3>(*this, op);
+
+		return make(_mm_mul_ps(load(), _mm_set1_ps(op)));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator/(float op) const
+	{
+		return operator*(1/op);
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator*=(float op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_scale<Vec, 3>(*this, op);
+			return;
+		}
+
+		store(_mm_mul_ps(load(), _mm_set1_ps(op)));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator/=(float op)
+	{
+		operator*=(1/op);
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator+=(const Vec& op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_add<Vec, 3>(*this, op);
+			return;
+		}
+
+		store(_mm_add_ps(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator-=(const Vec& op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_sub<Vec, 3>(*this, op);
+			return;
+		}
+
+		store(_mm_sub_ps(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR inline const float& operator[](int n) const
+	{
+		assert(n >=0 && n < 3);
+
+		return element_[n];
+	};
+
+	DEIMOS_CONSTEXPR inline float& operator[](int n)
+	{
+		assert(n >=0 && n < 3);
+
+		return element_[n];
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH float size_sqr() const
+	{
+		return (*this * *this);
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH float size() const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constexpr_sqrt(size_sqr());
+
+		return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(size_sqr())));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void clear(float op=0)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			for (int i=0; i < 3; ++i)
+				element_[i]=op;
+			return;
+		}
+
+		store(_mm_and_ps(_mm_set1_ps(op), detail::mask_xyz()));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void normalize()
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_scale<Vec, 3>(*this, float(1/size()));
+			return;
+		}
+
+		const __m128 v = load();
+		const __m128 len = _mm_sqrt_ps(_mm_set1_ps(detail::hsum3(_mm_mul_ps(v, v))));
+
+		assert(_mm_cvtss_f32(len));
+		store(_mm_div_ps(v, len));
+	};
+
+	// square root taken from a math policy, e.g. normalize(fast_math())
+	template<class M>
+	void normalize(M)
+	{
+		assert(size_sqr());
+		*this *= M::rsqrt(size_sqr());
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH Vec project_to(const Vec& op) const
+	{
+		return op * ((*this * op)/op.size_sqr());
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH bool is_parallel_to(const Vec& op) const
+	{
+		Vec temp(op.project_to(*this));
+
+		return temp == op;
+	};
+
+	DEIMOS_CONSTEXPR float* get_addr()
+	{
+		return &(element_[0]);
+	};
+
+	DEIMOS_CONSTEXPR const float* get_addr() const
+	{
+		return &(element_[0]);
+	};
+};
+
+//-------------------------------------//
+
+namespace detail {
+
+#if defined(DEIMOS_AVX)
+	typedef __m256d double4;
+
+	inline double4 load_d4(const double* op)			{ return _mm256_loadu_pd(op); }
+	inline void store_d4(double* dst, double4 op)		{ _mm256_storeu_pd(dst, op); }
+	inline double4 set1_d4(double op)					{ return _mm256_set1_pd(op); }
+	inline double4 add_d4(double4 a, double4 b)			{ return _mm256_add_pd(a, b); }
+	inline double4 sub_d4(double4 a, double4 b)			{ return _mm256_sub_pd(a, b); }
+	inline double4 mul_d4(double4 a, double4 b)			{ return _mm256_mul_pd(a, b); }
+	inline double4 div_d4(double4 a, double4 b)			{ return _mm256_div_pd(a, b); }
+	inline bool equal_d4(double4 a, double4 b)			{ return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)) == 0xf; }
+
+	// (x + y) + (z + w), the generic order when w is zero
+	inline double hsum_d4(double4 op)
+	{
+		const __m128d xy = _mm256_castpd256_pd128(op);
+		const __m128d zw = _mm256_extractf128_pd(op, 1);
+		const __m128d s = _mm_add_pd(_mm_unpacklo_pd(xy, zw), _mm_unpackhi_pd(xy, zw));
+		return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+	}
+#else
+	// two SSE2 registers: (x, y) and (z, w)
+	struct double4 { __m128d xy, zw; };
+
+	inline double4 make_d4(__m128d xy, __m128d zw)		{ double4 res; res.xy = xy; res.zw = zw; return res; }
+
+	inline double4 load_d4(const double* op)			{ return make_d4(_mm_loadu_pd(op), _mm_loadu_pd(op + 2)); }
+	inline void store_d4(double* dst, double4 op)		{ _mm_storeu_pd(dst, op.xy); _mm_storeu_pd(dst + 2, op.zw); }
+	inline double4 set1_d4(double op)					{ return make_d4(_mm_set1_pd(op), _mm_set1_pd(op)); }
+	inline double4 add_d4(double4 a, double4 b)			{ return make_d4(_mm_add_pd(a.xy, b.xy), _mm_add_pd(a.zw, b.zw)); }
+	inline double4 sub_d4(double4 a, double4 b)			{ return make_d4(_mm_sub_pd(a.xy, b.xy), _mm_sub_pd(a.zw, b.zw)); }
+	inline double4 mul_d4(double4 a, double4 b)			{ return make_d4(_mm_mul_pd(a.xy, b.xy), _mm_mul_pd(a.zw, b.zw)); }
+	inline double4 div_d4(double4 a, double4 b)			{ return make_d4(_mm_div_pd(a.xy, b.xy), _mm_div_pd(a.zw, b.zw)); }
+
+	inline bool equal_d4(double4 a, double4 b)
+	{
+		return (_mm_movemask_pd(_mm_cmpeq_pd(a.xy, b.xy)) & _mm_movemask_pd(_mm_cmpeq_pd(a.zw, b.zw))) == 0x3;
+	}
+
+	inline double hsum_d4(double4 op)
+	{
+		const __m128d s = _mm_add_pd(_mm_unpacklo_pd(op.xy, op.zw), _mm_unpackhi_pd(op.xy, op.zw));
+		return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+	}
+#endif
+
+} // namespace detail
+
+template<>
+class DEIMOS_ALIGN(32) Vector<double, 4>
+{
+public:
+	typedef Vector<double, 4> Vec;
+	double element_[4];
+
+	inline detail::double4 load() const
+	{
+		return detail::load_d4(element_);
+	};
+
+	inline void store(detail::double4 op)
+	{
+		detail::store_d4(element_, op);
+	};
+
+	static inline Vec make(detail::double4 op)
+	{
+		Vec res;
+		res.store(op);
+		return res;
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH bool operator==(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_equal<Vec, 4>(*this, op);
+
+		return detail::equal_d4(load(), op.load());
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator+(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_add<Vec, 4>(*this, op);
+
+		return make(detail::add_d4(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator-(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_sub<Vec, 4>(*this, op);
+
+		return make(detail::sub_d4(load(), op.load()));
+	};
+
+	// Inner product
+	DEIMOS_CONSTEXPR_BRANCH double operator*(const Vec& op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_dot<Vec, 4, double>(*this, op);
+
+		return detail::hsum_d4(detail::mul_d4(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator*(double op) const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constant_scale<Vec, 4>(*this, op);
+
+		return make(detail::mul_d4(load(), detail::set1_d4(op)));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH const Vec operator/(double op) const
+	{
+		return operator*(1/op);
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator*=(double op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_scale<Vec, 4>(*this, op);
+			return;
+		}
+
+		store(detail::mul_d4(load(), detail::set1_d4(op)));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator/=(double op)
+	{
+		operator*=(1/op);
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator+=(const Vec& op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_add<Vec, 4>(*this, op);
+			return;
+		}
+
+		store(detail::add_d4(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void operator-=(const Vec& op)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_sub<Vec, 4>(*this, op);
+			return;
+		}
+
+		store(detail::sub_d4(load(), op.load()));
+	};
+
+	DEIMOS_CONSTEXPR inline const double& operator[](int n) const
+	{
+		assert(n >=0 && n < 4);
+
+		return element_[n];
+	};
+
+	DEIMOS_CONSTEXPR inline double& operator[](int n)
+	{
+		assert(n >=0 && n < 4);
+
+		return element_[n];
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH double size_sqr() const
+	{
+		return (*this * *this);
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH double size() const
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+			return detail::constexpr_sqrt(size_sqr());
+
+		return std::sqrt(size_sqr());
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void clear(double op=0)
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			for (int i=0; i < 4; ++i)
+				element_[i]=op;
+			return;
+		}
+
+		store(detail::set1_d4(op));
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH void normalize()
+	{
+		if (DEIMOS_IS_CONSTANT_EVALUATED())
+		{
+			*this = detail::constant_scale<Vec, 4>(*this, double(1/size()));
+			return;
+		}
+
+		const double len = size();
+
+		assert(len);
+		store(detail::div_d4(load(), detail::set1_d4(len)));
+	};
+
+	// square root taken from a math policy, e.g. normalize(fast_math())
+	template<class M>
+	void normalize(M)
+	{
+		assert(size_sqr());
+		*this *= M::rsqrt(size_sqr());
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH Vec project_to(const Vec& op) const
+	{
+		return op * ((*this * op)/op.size_sqr());
+	};
+
+	DEIMOS_CONSTEXPR_BRANCH bool is_parallel_to(const Vec& op) const
+	{
+		Vec temp(op.project_to(*this));
+
+		return temp == op;
+	};
+
+	DEIMOS_CONSTEXPR double* get_addr()
+	{
+		return &(element_[0]);
+	};
+
+	DEIMOS_CONSTEXPR const double* get_addr() const
+	{
+		return &(element_[0]);
+	};
+};
+
+//-------------------------------------//
+
+inline Vector<float, 3> cross_product(const Vector<float, 3>& op1, const Vector<float, 3>& op2)
+{
+	return Vector<float, 3>::make(detail::cross_product(op1.load(), op2.load()));
+}
+
+inline Vector<float, 4> cross_product(const Vector<float, 4>& op1, const Vector<float, 4>& op2)
+{
+	return Vector<float, 4>::make(detail::cross_product(op1.load(), op2.load()));
+}
+
+} // namespace math
+} // namespace deimos
+
+#endif // DEIMOS_SSE2
+
+#endif // DEIMOS_MATH_VECTOR_SIMD__
@@ -0,0 +1,162 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Memory aligned to A bytes. Containers with the default allocator only
+ * guarantee the alignment of malloc before C++17, which is not enough for
+ * Vector<double, 4> or cache line aligned data:
+ *
+ *   std::vector< Vector<double, 4>, AlignedAllocator<Vector<double, 4>, 32> > v;
+ *   std::vector< Aligned<Matrix<float, 4>, 64> > m;	// one matrix per cache line, needs an
+ *													// AlignedAllocator as well before C++17
+ */
+
+#if !defined(DEIMOS_MEMORY_ALIGNED_ALLOCATOR__)
+#define DEIMOS_MEMORY_ALIGNED_ALLOCATOR__
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "../math/simd.h"
+
+namespace deimos {
+namespace memory {
+
+// cache line size, the default alignment of the containers
+const std::size_t CACHE_LINE = 64;
+
+// size bytes at a multiple of alignment, which must be a power of two; throws std::bad_alloc
+inline void* aligned_malloc(std::size_t size, std::size_t alignment)
+{
+	assert(alignment && !(alignment & (alignment - 1)));
+
+	if (alignment < sizeof(void*))
+		alignment = sizeof(void*);
+
+	// the pointer returned by malloc is kept right before the aligned block
+	void* raw = std::malloc(size + alignment + sizeof(void*));
+	if (!raw)
+		throw std::bad_alloc();
+
+	const std::size_t base = reinterpret_cast<std::size_t>(raw) + sizeof(void*);
+	void** aligned = reinterpret_cast<void**>((base + alignment - 1) & ~(alignment - 1));
+	aligned[-1] = raw;
+
+	return aligned;
+}
+
+inline void aligned_free(void* op)
+{
+	if (op)
+		std::free(static_cast<void**>(op)[-1]);
+}
+
+template<typename T, std::size_t A = CACHE_LINE>
+class AlignedAllocator
+{
+public:
+	typedef T					value_type;
+	typedef T*					pointer;
+	typedef const T*			const_pointer;
+	typedef T&					reference;
+	typedef const T&			const_reference;
+	typedef std::size_t			size_type;
+	typedef std::ptrdiff_t		difference_type;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, A> other;
+	};
+
+	enum { alignment = A };
+
+	AlignedAllocator() {};
+
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, A>&) {};
+
+	pointer address(reference op) const				{ return &op; };
+	const_pointer address(const_reference op) const	{ return &op; };
+
+	pointer allocate(size_type n, const void* = 0)
+	{
+		if (n > max_size())
+			throw std::bad_alloc();
+
+		return static_cast<pointer>(aligned_malloc(n * sizeof(T), A));
+	};
+
+	void deallocate(pointer p, size_type)
+	{
+		aligned_free(p);
+	};
+
+	size_type max_size() const
+	{
+		return (static_cast<size_type>(-1) - A - sizeof(void*)) / sizeof(T);
+	};
+
+	void construct(pointer p, const T& op)
+	{
+		new (p) T(op);
+	};
+
+	void destroy(pointer p)
+	{
+		p->~T();
+	};
+};
+
+template<typename T, typename U, std::size_t A>
+inline bool operator==(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&)
+{
+	return true;
+}
+
+template<typename T, typename U, std::size_t A>
+inline bool operator!=(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&)
+{
+	return false;
+}
+
+//-------------------------------------//
+
+// V at a multiple of A bytes and padded to a multiple of A, A is 16, 32 or 64
+template<class V, int A>
+struct Aligned;
+
+template<class V>
+struct DEIMOS_ALIGN(16) Aligned<V, 16>
+{
+	V value_;
+
+	operator V&()				{ return value_; };
+	operator const V&() const	{ return value_; };
+};
+
+template<class V>
+struct DEIMOS_ALIGN(32) Aligned<V, 32>
+{
+	V value_;
+
+	operator V&()				{ return value_; };
+	operator const V&() const	{ return value_; };
+};
+
+template<class V>
+struct DEIMOS_ALIGN(64) Aligned<V, 64>
+{
+	V value_;
+
+	operator V&()				{ return value_; };
+	operator const V&() const	{ return value_; };
+};
+
+} // namespace memory
+} // namespace deimos
+
+#endif // DEIMOS_MEMORY_ALIGNED_ALLOCATOR__
@@ -0,0 +1,364 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Contiguous growable arrays in aligned memory. The storage of AlignedArray is
+ * padded to a multiple of A bytes, so SIMD loads of the last partial register
+ * stay inside the allocation; the padding is zeroed.
+ *
+ * SoAArray keeps one AlignedArray per component of Vector<T, S> for packet
+ * code, StridedView looks at one component of an array of Vectors:
+ *
+ *   AlignedArray< Vector<float, 4> > points;			// AoS, 64 byte aligned
+ *   SoAArray<float, 3> soa;
+ *   to_soa(points.data(), points.size(), soa);
+ *   VectorPacket<float, 3, 8> p = soa.packet<8>(i);	// lanes i to i+7
+ */
+
+#if !defined(DEIMOS_MEMORY_ALIGNED_ARRAY__)
+#define DEIMOS_MEMORY_ALIGNED_ARRAY__
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#include "aligned_allocator.h"
+#include "../math/packet.h"
+#include "../math/vector.h"
+
+namespace deimos {
+namespace memory {
+
+template<typename T, std::size_t A = CACHE_LINE>
+class AlignedArray
+{
+public:
+	typedef T				value_type;
+	typedef T*				iterator;
+	typedef const T*		const_iterator;
+	typedef T&				reference;
+	typedef const T&		const_reference;
+	typedef std::size_t		size_type;
+
+	enum { alignment = A };
+
+protected:
+	T* data_;
+	size_type size_;
+	size_type capacity_;
+
+	// capacity for at least n elements, rounded up to whole blocks of A bytes
+	static size_type padded_capacity(size_type n)
+	{
+		const size_type bytes = ((n * sizeof(T) + A - 1) / A) * A;
+		return bytes / sizeof(T);
+	}
+
+	void reallocate(size_type n)
+	{
+		const size_type capacity = padded_capacity(n);
+		const size_type bytes = ((capacity * sizeof(T) + A - 1) / A) * A;
+
+		T* data = static_cast<T*>(aligned_malloc(bytes, A));
+		std::memset(static_cast<void*>(data), 0, bytes);
+
+		for (size_type i=0; i < size_; ++i)
+		{
+			new (data + i) T(data_[i]);
+			data_[i].~T();
+		}
+
+		aligned_free(data_);
+
+		data_ = data;
+		capacity_ = capacity;
+	}
+
+	// elements from n on, the memory is zeroed again
+	void destroy(size_type n)
+	{
+		for (size_type i=n; i < size_; ++i)
+			data_[i].~T();
+
+		if (n < size_)
+			std::memset(static_cast<void*>(data_ + n), 0, (size_ - n) * sizeof(T));
+
+		size_ = n;
+	}
+
+public:
+	AlignedArray() : data_(0), size_(0), capacity_(0) {};
+
+	explicit AlignedArray(size_type n, const T& op = T()) : data_(0), size_(0), capacity_(0)
+	{
+		resize(n, op);
+	};
+
+	AlignedArray(const AlignedArray& op) : data_(0), size_(0), capacity_(0)
+	{
+		reserve(op.size_);
+
+		for (; size_ < op.size_; ++size_)
+			new (data_ + size_) T(op.data_[size_]);
+	};
+
+	~AlignedArray()
+	{
+		clear();
+		aligned_free(data_);
+	};
+
+	AlignedArray& operator=(const AlignedArray& op)
+	{
+		AlignedArray temp(op);
+		swap(temp);
+		return *this;
+	};
+
+	void swap(AlignedArray& op)
+	{
+		std::swap(data_, op.data_);
+		std::swap(size_, op.size_);
+		std::swap(capacity_, op.capacity_);
+	};
+
+	inline size_type size() const		{ return size_; };
+	inline size_type capacity() const	{ return capacity_; };
+	inline bool empty() const			{ return size_ == 0; };
+
+	inline T* data()					{ return data_; };
+	inline const T* data() const		{ return data_; };
+
+	inline iterator begin()				{ return data_; };
+	inline iterator end()				{ return data_ + size_; };
+	inline const_iterator begin() const	{ return data_; };
+	inline const_iterator end() const	{ return data_ + size_; };
+
+	inline T& operator[](size_type n)
+	{
+		assert(n < size_);
+		return data_[n];
+	};
+
+	inline const T& operator[](size_type n) const
+	{
+		assert(n < size_);
+		return data_[n];
+	};
+
+	inline T& back()
+	{
+		assert(size_);
+		return data_[size_-1];
+	};
+
+	inline const T& back() const
+	{
+		assert(size_);
+		return data_[size_-1];
+	};
+
+	void reserve(size_type n)
+	{
+		if (n > capacity_)
+			reallocate(n);
+	};
+
+	void resize(size_type n, const T& op = T())
+	{
+		reserve(n);
+
+		for (; size_ < n; ++size_)
+			new (data_ + size_) T(op);
+
+		if (n < size_)
+			destroy(n);
+	};
+
+	void push_back(const T& op)
+	{
+		// op may live in this array
+		if (size_ == capacity_)
+		{
+			const T copy(op);
+			reallocate(std::max<size_type>(2 * capacity_, 1));
+			new (data_ + size_) T(copy);
+		}
+		else
+			new (data_ + size_) T(op);
+
+		++size_;
+	};
+
+	void pop_back()
+	{
+		assert(size_);
+		destroy(size_ - 1);
+	};
+
+	void clear()
+	{
+		destroy(0);
+	};
+};
+
+//-------------------------------------//
+
+// one component of an array of vectors, or any other strided data
+template<typename T>
+class StridedView
+{
+protected:
+	char* base_;
+	std::size_t stride_;
+	std::size_t size_;
+
+public:
+	StridedView(T* base, std::size_t stride, std::size_t size) :
+		base_(reinterpret_cast<char*>(base)), stride_(stride), size_(size) {};
+
+	inline std::size_t size() const { return size_; };
+
+	inline T& operator[](std::size_t n) const
+	{
+		assert(n < size_);
+		return *reinterpret_cast<T*>(base_ + n * stride_);
+	};
+};
+
+template<typename T, int S>
+inline StridedView<T> component_view(math::Vector<T, S>* op, std::size_t n, int c)
+{
+	assert(c >= 0 && c < S);
+	return StridedView<T>(&(*op)[c], sizeof(math::Vector<T, S>), n);
+}
+
+//-------------------------------------//
+
+template<typename T, int S, std::size_t A = CACHE_LINE>
+class SoAArray
+{
+public:
+	typedef math::Vector<T, S> Vec;
+	typedef std::size_t size_type;
+
+protected:
+	AlignedArray<T, A> component_[S];
+
+public:
+	inline size_type size() const { return component_[0].size(); };
+
+	// stream of component c, aligned to A
+	inline T* component(int c)
+	{
+		assert(c >= 0 && c < S);
+		return component_[c].data();
+	};
+
+	inline const T* component(int c) const
+	{
+		assert(c >= 0 && c < S);
+		return component_[c].data();
+	};
+
+	void reserve(size_type n)
+	{
+		for (int c=0; c < S; ++c)
+			component_[c].reserve(n);
+	};
+
+	void resize(size_type n)
+	{
+		for (int c=0; c < S; ++c)
+			component_[c].resize(n);
+	};
+
+	void clear()
+	{
+		for (int c=0; c < S; ++c)
+			component_[c].clear();
+	};
+
+	void push_back(const Vec& op)
+	{
+		for (int c=0; c < S; ++c)
+			component_[c].push_back(op[c]);
+	};
+
+	inline Vec get(size_type n) const
+	{
+		Vec res = Vec();
+
+		for (int c=0; c < S; ++c)
+			res[c] = component_[c][n];
+
+		return res;
+	};
+
+	inline void set(size_type n, const Vec& op)
+	{
+		for (int c=0; c < S; ++c)
+			component_[c][n] = op[c];
+	};
+
+	// vectors n to n+N-1 as one packet
+	template<int N>
+	math::VectorPacket<T, S, N> packet(size_type n) const
+	{
+		assert(n + N <= size());
+
+		math::VectorPacket<T, S, N> res;
+
+		for (int c=0; c < S; ++c)
+			std::memcpy(res.component_[c].element_, component_[c].data() + n, N * sizeof(T));
+
+		return res;
+	};
+
+	template<int N>
+	void set_packet(size_type n, const math::VectorPacket<T, S, N>& op)
+	{
+		assert(n + N <= size());
+
+		for (int c=0; c < S; ++c)
+			std::memcpy(component_[c].data() + n, op.component_[c].element_, N * sizeof(T));
+	};
+};
+
+// AoS to SoA and back, vectors may have more components than the SoA array
+template<typename T, int S, int SA, std::size_t A>
+void to_soa(const math::Vector<T, SA>* src, std::size_t n, SoAArray<T, S, A>& dst)
+{
+	assert(S <= SA);
+
+	dst.resize(n);
+
+	for (int c=0; c < S; ++c)
+	{
+		T* stream = dst.component(c);
+
+		for (std::size_t i=0; i < n; ++i)
+			stream[i] = src[i][c];
+	}
+}
+
+template<typename T, int S, int SA, std::size_t A>
+void to_aos(const SoAArray<T, S, A>& src, math::Vector<T, SA>* dst)
+{
+	assert(S <= SA);
+
+	for (int c=0; c < S; ++c)
+	{
+		const T* stream = src.component(c);
+
+		for (std::size_t i=0; i < src.size(); ++i)
+			dst[i][c] = stream[i];
+	}
+}
+
+} // namespace memory
+} // namespace deimos
+
+#endif // DEIMOS_MEMORY_ALIGNED_ARRAY__
@@ -0,0 +1,54 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+#include "mesh_loader.h"
+
+namespace deimos {
+namespace mesh {
+
+namespace {
+
+	// case insensitive
+	bool has_extension(const char* filename, const char* extension)
+	{
+		const size_t n = std::strlen(filename), m = std::strlen(extension);
+
+		if (n < m)
+			return false;
+
+		for (size_t i=0; i < m; ++i)
+			if (std::tolower(static_cast<unsigned char>(filename[n - m + i])) != extension[i])
+				return false;
+
+		return true;
+	}
+
+} // namespace
+
+bool load_mesh(const char* filename, math::geometry::IndexedMesh<float>& mesh)
+{
+	thread::TaskPool pool(0);
+	return load_mesh(pool, filename, mesh);
+}
+
+bool load_mesh(thread::TaskPool& pool, const char* filename, math::geometry::IndexedMesh<float>& mesh)
+{
+	if (has_extension(filename, ".obj"))
+		return load_obj(pool, filename, mesh);
+
+	if (has_extension(filename, ".ply"))
+		return load_ply(pool, filename, mesh);
+
+	std::cout << "MeshLoader: error (unknown format) " << filename << std::endl;
+	return false;
+}
+
+} // namespace mesh
+} // namespace deimos
@@ -0,0 +1,25 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Loads an OBJ or a binary PLY file into an IndexedMesh, picked by the
+ * extension of the filename.
+ */
+
+#if !defined(DEIMOS_MESH_LOADER__)
+#define DEIMOS_MESH_LOADER__
+
+#include "mesh_obj.h"
+#include "mesh_ply.h"
+
+namespace deimos {
+namespace mesh {
+
+	bool load_mesh(const char* filename, math::geometry::IndexedMesh<float>& mesh);
+	bool load_mesh(thread::TaskPool& pool, const char* filename, math::geometry::IndexedMesh<float>& mesh);
+
+} // namespace mesh
+} // namespace deimos
+
+#endif // DEIMOS_MESH_LOADER__
@@ -0,0 +1,720 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "../stream/mapped_file.h"
+#include "mesh_obj.h"
+
+namespace deimos {
+namespace mesh {
+
+namespace {
+
+	using math::geometry::IndexedMesh;
+	using math::geometry::MeshFace;
+
+	typedef math::Vector<float, 4> Vec4;
+	typedef math::Vector<float, 2> Vec2;
+
+	// bytes per parse task, cut at the next line break
+	const size_t OBJ_CHUNK = 1 << 20;
+
+	// no texture coordinate or normal at a corner
+	const unsigned int NO_INDEX = ~0u;
+
+	// exactly representable in a double
+	const double POWERS_OF_TEN[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool is_digit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline const char* skip_space(const char* p, const char* end)
+	{
+		while (p < end && is_space(*p))
+			++p;
+
+		return p;
+	}
+
+	// end of the statement in [line, eol), behind it is a comment
+	inline const char* content_end(const char* line, const char* eol)
+	{
+		const char* res = static_cast<const char*>(std::memchr(line, '#', eol - line));
+		return res ? res : eol;
+	}
+
+	// the end of the token at p is the end of the line or a space
+	inline bool is_token_end(const char* p, const char* end)
+	{
+		return p == end || is_space(*p);
+	}
+
+	/*
+	 * [+-]digits[.digits][(e|E)[+-]digits]. The first 15 significant digits
+	 * are summed up exactly in a double and scaled by a power of ten, which
+	 * is exact up to 1e22, so the float is correctly rounded in all but
+	 * pathological cases. Returns the end of the number or 0.
+	 */
+	const char* parse_float(const char* p, const char* end, float& res)
+	{
+		bool negative = false;
+
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = (*p++ == '-');
+
+		double mantissa = 0;
+		int exponent = 0, digits = 0, significant = 0;
+
+		for (; p < end && is_digit(*p); ++p, ++digits)
+		{
+			if (significant < 15)
+			{
+				mantissa = mantissa*10 + (*p - '0');
+				if (mantissa > 0) ++significant;
+			}
+			else
+				++exponent;
+		}
+
+		if (p < end && *p == '.')
+			for (++p; p < end && is_digit(*p); ++p, ++digits)
+				if (significant < 15)
+				{
+					mantissa = mantissa*10 + (*p - '0');
+					if (mantissa > 0) ++significant;
+					--exponent;
+				}
+
+		if (digits == 0)
+			return 0;
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* q = p + 1;
+			bool negative_exponent = false;
+
+			if (q < end && (*q == '-' || *q == '+'))
+				negative_exponent = (*q++ == '-');
+
+			if (q < end && is_digit(*q))
+			{
+				int e = 0;
+
+				for (; q < end && is_digit(*q); ++q)
+					if (e < 10000)
+						e = e*10 + (*q - '0');
+
+				exponent += negative_exponent ? -e : e;
+				p = q;
+			}
+		}
+
+		double value = mantissa;
+
+		if (value != 0 && exponent != 0)
+		{
+			if (exponent < 0 && exponent >= -22)
+				value /= POWERS_OF_TEN[-exponent];
+			else if (exponent > 0 && exponent <= 22)
+				value *= POWERS_OF_TEN[exponent];
+			else
+				value *= std::pow(10., exponent);
+		}
+
+		res = static_cast<float>(negative ? -value : value);
+		return p;
+	}
+
+	// [-]digits, returns the end of the number or 0
+	inline const char* parse_index(const char* p, const char* end, long& res)
+	{
+		bool negative = false;
+
+		if (p < end && *p == '-')
+		{
+			negative = true;
+			++p;
+		}
+
+		if (p == end || !is_digit(*p))
+			return 0;
+
+		res = 0;
+
+		for (; p < end && is_digit(*p); ++p)
+			if (res < 0x7fffffffL)
+				res = res*10 + (*p - '0');
+
+		if (negative)
+			res = -res;
+
+		return p;
+	}
+
+	// 1 based or negative OBJ index to 0 based, NO_INDEX if it doesn't exist
+	inline unsigned int resolve_index(long op, size_t current, size_t total)
+	{
+		const long res = (op > 0) ? op - 1 : long(current) + op;
+
+		if (op == 0 || res < 0 || size_t(res) >= total)
+			return NO_INDEX;
+
+		return static_cast<unsigned int>(res);
+	}
+
+	enum Statement
+	{
+		STATEMENT_OTHER,
+		STATEMENT_POSITION,
+		STATEMENT_TEXCOORD,
+		STATEMENT_NORMAL,
+		STATEMENT_FACE
+	};
+
+	// the type of the line at p, which points behind the keyword afterwards
+	inline Statement statement(const char*& p, const char* end)
+	{
+		if (end - p < 2)
+			return STATEMENT_OTHER;
+
+		if (p[0] == 'f' && is_space(p[1]))
+		{
+			p += 1;
+			return STATEMENT_FACE;
+		}
+
+		if (p[0] != 'v')
+			return STATEMENT_OTHER;
+
+		if (is_space(p[1]))
+		{
+			p += 1;
+			return STATEMENT_POSITION;
+		}
+
+		if (end - p < 3 || !is_space(p[2]))
+			return STATEMENT_OTHER;
+
+		p += 2;
+
+		if (p[-1] == 't')
+			return STATEMENT_TEXCOORD;
+
+		if (p[-1] == 'n')
+			return STATEMENT_NORMAL;
+
+		return STATEMENT_OTHER;
+	}
+
+	struct Chunk
+	{
+		const char* begin_;
+		const char* end_;
+
+		// counts of the first pass, offsets into the arrays after the prefix sum
+		size_t lines_, positions_, texcoords_, normals_, triangles_;
+
+		// corners with texture coordinates and normals, and if any of them differ from the position index
+		size_t corner_texcoords_, corner_normals_;
+		bool mixed_;
+
+		bool colors_;
+
+		// first line (counted from the chunk) that couldn't be parsed
+		bool error_;
+		size_t error_line_;
+	};
+
+	struct Corner
+	{
+		unsigned int position_, texcoord_, normal_;
+
+		inline bool operator==(const Corner& op) const
+		{
+			return position_ == op.position_ && texcoord_ == op.texcoord_ && normal_ == op.normal_;
+		};
+	};
+
+	inline size_t hash_value(const Corner& op)
+	{
+		size_t res = 0;
+		boost::hash_combine(res, op.position_);
+		boost::hash_combine(res, op.texcoord_);
+		boost::hash_combine(res, op.normal_);
+		return res;
+	}
+
+	class ObjParser
+	{
+	private:
+		ObjParser(const ObjParser&);
+		ObjParser& operator=(const ObjParser&);
+
+	protected:
+		std::vector<Chunk> chunks_;
+		IndexedMesh<float>& mesh_;
+
+		// totals of the first pass
+		size_t positions_, texcoords_, normals_;
+
+		// texture coordinate and normal indices of the faces, like mesh_.face_
+		memory::AlignedArray<MeshFace> texcoord_face_, normal_face_;
+
+		void count_chunk(Chunk& chunk) const
+		{
+			for (const char* line = chunk.begin_; line < chunk.end_; ++chunk.lines_)
+			{
+				const char* eol = static_cast<const char*>(std::memchr(line, '\n', chunk.end_ - line));
+				if (!eol) eol = chunk.end_;
+
+				const char* end = content_end(line, eol);
+				const char* p = skip_space(line, end);
+
+				switch (statement(p, end))
+				{
+				case STATEMENT_POSITION:	++chunk.positions_; break;
+				case STATEMENT_TEXCOORD:	++chunk.texcoords_; break;
+				case STATEMENT_NORMAL:		++chunk.normals_; break;
+
+				case STATEMENT_FACE:
+				{
+					size_t corners = 0;
+
+					for (p = skip_space(p, end); p < end; p = skip_space(p, end), ++corners)
+						while (p < end && !is_space(*p))
+							++p;
+
+					if (corners > 2)
+						chunk.triangles_ += corners - 2;
+
+					break;
+				}
+
+				default:
+					break;
+				}
+
+				line = eol + 1;
+			}
+		}
+
+		void count_chunks(size_t first, size_t last)
+		{
+			for (size_t i=first; i < last; ++i)
+				count_chunk(chunks_[i]);
+		}
+
+		// up to n floats of the line at p, returns how many or -1 on garbage
+		static int parse_floats(const char* p, const char* end, float* res, int n)
+		{
+			int count = 0;
+
+			for (p = skip_space(p, end); p < end && count < n; p = skip_space(p, end), ++count)
+			{
+				p = parse_float(p, end, res[count]);
+
+				if (!p || !is_token_end(p, end))
+					return -1;
+			}
+
+			return count;
+		}
+
+		// v[/[t][/n]], false on garbage or indices out of range
+		bool parse_corner(const char*& p, const char* end, size_t position, size_t texcoord, size_t normal, Corner& res) const
+		{
+			long index;
+
+			if (!(p = parse_index(p, end, index)))
+				return false;
+
+			res.position_ = resolve_index(index, position, positions_);
+			res.texcoord_ = res.normal_ = NO_INDEX;
+
+			if (res.position_ == NO_INDEX)
+				return false;
+
+			if (p < end && *p == '/')
+			{
+				++p;
+
+				if (p < end && *p != '/')
+				{
+					if (!(p = parse_index(p, end, index)))
+						return false;
+
+					if ((res.texcoord_ = resolve_index(index, texcoord, texcoords_)) == NO_INDEX)
+						return false;
+				}
+
+				if (p < end && *p == '/')
+				{
+					if (!(p = parse_index(p + 1, end, index)))
+						return false;
+
+					if ((res.normal_ = resolve_index(index, normal, normals_)) == NO_INDEX)
+						return false;
+				}
+			}
+
+			return is_token_end(p, end);
+		}
+
+		void write_triangle(size_t n, const Corner& c0, const Corner& c1, const Corner& c2)
+		{
+			MeshFace& f = mesh_.face_[n];
+			MeshFace& t = texcoord_face_[n];
+			MeshFace& m = normal_face_[n];
+
+			f.vertex_[0] = c0.position_;	f.vertex_[1] = c1.position_;	f.vertex_[2] = c2.position_;
+			t.vertex_[0] = c0.texcoord_;	t.vertex_[1] = c1.texcoord_;	t.vertex_[2] = c2.texcoord_;
+			m.vertex_[0] = c0.normal_;		m.vertex_[1] = c1.normal_;		m.vertex_[2] = c2.normal_;
+		}
+
+		void note_corner(Chunk& chunk, const Corner& c) const
+		{
+			if (c.texcoord_ != NO_INDEX)
+			{
+				++chunk.corner_texcoords_;
+				chunk.mixed_ |= (c.texcoord_ != c.position_);
+			}
+
+			if (c.normal_ != NO_INDEX)
+			{
+				++chunk.corner_normals_;
+				chunk.mixed_ |= (c.normal_ != c.position_);
+			}
+		}
+
+		bool parse_line(Chunk& chunk, const char* p, const char* end, size_t& position, size_t& texcoord, size_t& normal, size_t& triangle)
+		{
+			float v[7];
+
+			switch (statement(p, end))
+			{
+			case STATEMENT_POSITION:
+			{
+				const int n = parse_floats(p, end, v, 7);
+
+				// x y z [w] or x y z r g b [a]
+				if (n < 3)
+					return false;
+
+				Vec4& pos = mesh_.position_[position];
+				pos[0] = v[0]; pos[1] = v[1]; pos[2] = v[2]; pos[3] = 1;
+
+				Vec4& color = mesh_.color_[position];
+
+				if (n >= 6)
+				{
+					color[0] = v[3]; color[1] = v[4]; color[2] = v[5]; color[3] = (n == 7) ? v[6] : 1;
+					chunk.colors_ = true;
+				}
+				else
+					color.clear(1);
+
+				++position;
+				return true;
+			}
+
+			case STATEMENT_TEXCOORD:
+			{
+				const int n = parse_floats(p, end, v, 3);
+
+				if (n < 1)
+					return false;
+
+				Vec2& tex = mesh_.texcoord_[texcoord++];
+				tex[0] = v[0];
+				tex[1] = (n > 1) ? v[1] : 0;
+
+				return true;
+			}
+
+			case STATEMENT_NORMAL:
+			{
+				if (parse_floats(p, end, v, 3) != 3)
+					return false;
+
+				Vec4& nor = mesh_.normal_[normal++];
+				nor[0] = v[0]; nor[1] = v[1]; nor[2] = v[2]; nor[3] = 0;
+
+				return true;
+			}
+
+			case STATEMENT_FACE:
+			{
+				Corner first = { NO_INDEX, NO_INDEX, NO_INDEX };
+				Corner previous = first, current = first;
+				size_t corners = 0;
+
+				for (p = skip_space(p, end); p < end; p = skip_space(p, end), ++corners)
+				{
+					if (!parse_corner(p, end, position, texcoord, normal, current))
+						return false;
+
+					note_corner(chunk, current);
+
+					if (corners == 0)
+						first = current;
+					else if (corners >= 2)
+						write_triangle(triangle++, first, previous, current);
+
+					previous = current;
+				}
+
+				return true;
+			}
+
+			default:
+				return true;
+			}
+		}
+
+		void parse_chunk(Chunk& chunk)
+		{
+			size_t position = chunk.positions_;
+			size_t texcoord = chunk.texcoords_;
+			size_t normal = chunk.normals_;
+			size_t triangle = chunk.triangles_;
+
+			size_t n = 0;
+
+			for (const char* line = chunk.begin_; line < chunk.end_; ++n)
+			{
+				const char* eol = static_cast<const char*>(std::memchr(line, '\n', chunk.end_ - line));
+				if (!eol) eol = chunk.end_;
+
+				const char* end = content_end(line, eol);
+
+				if (!parse_line(chunk, skip_space(line, end), end, position, texcoord, normal, triangle))
+				{
+					chunk.error_ = true;
+					chunk.error_line_ = n;
+					return;
+				}
+
+				line = eol + 1;
+			}
+		}
+
+		void parse_chunks(size_t first, size_t last)
+		{
+			for (size_t i=first; i < last; ++i)
+				parse_chunk(chunks_[i]);
+		}
+
+		// one vertex per distinct corner, in the order of first use
+		void split_vertices(bool texcoords, bool normals)
+		{
+			const size_t triangles = mesh_.face_.size();
+			const bool colors = !mesh_.color_.empty();
+
+			IndexedMesh<float> res;
+			boost::unordered_map<Corner, unsigned int> vertices;
+			vertices.rehash(triangles);
+
+			for (size_t f=0; f < triangles; ++f)
+				for (int k=0; k < 3; ++k)
+				{
+					Corner c;
+					c.position_ = mesh_.face_[f].vertex_[k];
+					c.texcoord_ = texcoord_face_[f].vertex_[k];
+					c.normal_ = normal_face_[f].vertex_[k];
+
+					const std::pair<boost::unordered_map<Corner, unsigned int>::iterator, bool> i =
+						vertices.insert(std::make_pair(c, static_cast<unsigned int>(res.position_.size())));
+
+					if (i.second)
+					{
+						res.position_.push_back(mesh_.position_[c.position_]);
+
+						if (colors)
+							res.color_.push_back(mesh_.color_[c.position_]);
+
+						if (texcoords)
+							res.texcoord_.push_back(mesh_.texcoord_[c.texcoord_]);
+
+						if (normals)
+							res.normal_.push_back(mesh_.normal_[c.normal_]);
+					}
+
+					mesh_.face_[f].vertex_[k] = i.first->second;
+				}
+
+			mesh_.position_.swap(res.position_);
+			mesh_.color_.swap(res.color_);
+			mesh_.texcoord_.swap(res.texcoord_);
+			mesh_.normal_.swap(res.normal_);
+		}
+
+	public:
+		ObjParser(IndexedMesh<float>& mesh) : mesh_(mesh), positions_(0), texcoords_(0), normals_(0) {};
+
+		bool parse(thread::TaskPool& pool, const char* data, size_t size)
+		{
+			using namespace boost::placeholders;
+
+			const char* end = data + size;
+
+			// chunk i starts behind the first line break at or after i*OBJ_CHUNK - 1
+			const size_t num_chunks = (size + OBJ_CHUNK - 1) / OBJ_CHUNK;
+			chunks_.resize(num_chunks);
+
+			for (size_t i=0; i < num_chunks; ++i)
+			{
+				Chunk& c = chunks_[i];
+				std::memset(&c, 0, sizeof(Chunk));
+
+				if (i == 0)
+					c.begin_ = data;
+				else
+				{
+					const char* p = data + i*OBJ_CHUNK - 1;
+					const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+					c.begin_ = eol ? eol + 1 : end;
+				}
+
+				if (i > 0)
+					chunks_[i-1].end_ = c.begin_;
+			}
+
+			if (num_chunks)
+				chunks_.back().end_ = end;
+
+			thread::parallel_for(pool, 0, num_chunks, 1, boost::bind(&ObjParser::count_chunks, this, _1, _2));
+
+			size_t lines = 0, triangles = 0;
+
+			for (size_t i=0; i < num_chunks; ++i)
+			{
+				Chunk& c = chunks_[i];
+				std::swap(lines, c.lines_);				lines += c.lines_;
+				std::swap(positions_, c.positions_);	positions_ += c.positions_;
+				std::swap(texcoords_, c.texcoords_);	texcoords_ += c.texcoords_;
+				std::swap(normals_, c.normals_);		normals_ += c.normals_;
+				std::swap(triangles, c.triangles_);		triangles += c.triangles_;
+			}
+
+			mesh_.clear();
+			mesh_.position_.resize(positions_);
+			mesh_.color_.resize(positions_);
+			mesh_.texcoord_.resize(texcoords_);
+			mesh_.normal_.resize(normals_);
+			mesh_.face_.resize(triangles);
+			texcoord_face_.resize(triangles);
+			normal_face_.resize(triangles);
+
+			thread::parallel_for(pool, 0, num_chunks, 1, boost::bind(&ObjParser::parse_chunks, this, _1, _2));
+
+			bool colors = false, mixed = false;
+			size_t corner_texcoords = 0, corner_normals = 0;
+
+			for (size_t i=0; i < num_chunks; ++i)
+			{
+				const Chunk& c = chunks_[i];
+
+				if (c.error_)
+				{
+					std::cout << "MeshObj: error (line " << c.lines_ + c.error_line_ + 1 << ")" << std::endl;
+					mesh_.clear();
+					return false;
+				}
+
+				colors |= c.colors_;
+				mixed |= c.mixed_;
+				corner_texcoords += c.corner_texcoords_;
+				corner_normals += c.corner_normals_;
+			}
+
+			if (!colors)
+				mesh_.color_.clear();
+
+			const size_t corners = 3*triangles;
+
+			if (mixed || (corner_texcoords && corner_texcoords != corners) || (corner_normals && corner_normals != corners))
+			{
+				// faces without an attribute other faces have get the first one
+				if (corner_texcoords && corner_texcoords != corners)
+					for (size_t f=0; f < triangles; ++f)
+						for (int k=0; k < 3; ++k)
+							if (texcoord_face_[f].vertex_[k] == NO_INDEX)
+								texcoord_face_[f].vertex_[k] = 0;
+
+				if (corner_normals && corner_normals != corners)
+					for (size_t f=0; f < triangles; ++f)
+						for (int k=0; k < 3; ++k)
+							if (normal_face_[f].vertex_[k] == NO_INDEX)
+								normal_face_[f].vertex_[k] = 0;
+
+				split_vertices(corner_texcoords != 0, corner_normals != 0);
+			}
+			else
+			{
+				// the lists are the vertices, attributes no face refers to are dropped
+				Vec2 zero2;
+				zero2.clear(0);
+
+				Vec4 zero4;
+				zero4.clear(0);
+
+				if (corner_texcoords)
+					mesh_.texcoord_.resize(positions_, zero2);
+				else
+					mesh_.texcoord_.clear();
+
+				if (corner_normals)
+					mesh_.normal_.resize(positions_, zero4);
+				else
+					mesh_.normal_.clear();
+			}
+
+			return true;
+		};
+	};
+
+} // namespace
+
+bool load_obj(const char* filename, math::geometry::IndexedMesh<float>& mesh)
+{
+	thread::TaskPool pool(0);
+	return load_obj(pool, filename, mesh);
+}
+
+bool load_obj(thread::TaskPool& pool, const char* filename, math::geometry::IndexedMesh<float>& mesh)
+{
+	MappedFile file(filename);
+
+	if (!file.is_open())
+	{
+		std::cout << "MeshObj: Could not open file " << filename << std::endl;
+		return false;
+	}
+
+	ObjParser parser(mesh);
+	return parser.parse(pool, file.data(), file.size());
+}
+
+} // namespace mesh
+} // namespace deimos
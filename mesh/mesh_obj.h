@@ -0,0 +1,34 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Wavefront OBJ loader for the geometry of a file: v (with an optional
+ * r g b color), vt, vn and f statements, everything else is skipped.
+ * Polygons are split into triangle fans and negative indices are relative
+ * to the end of the list so far. The file is memory mapped and parsed in
+ * chunks cut at line breaks, in parallel on the pool: a first pass counts
+ * the statements of every chunk, so the second one can write them straight
+ * to their final position.
+ *
+ * If every corner uses the same index for its position, texture coordinate
+ * and normal, the lists become the vertices of the mesh as they are.
+ * Otherwise every distinct combination becomes a vertex of its own.
+ */
+
+#if !defined(DEIMOS_MESH_OBJ__)
+#define DEIMOS_MESH_OBJ__
+
+#include "../math/mesh.h"
+#include "../thread/task_pool.h"
+
+namespace deimos {
+namespace mesh {
+
+	bool load_obj(const char* filename, math::geometry::IndexedMesh<float>& mesh);
+	bool load_obj(thread::TaskPool& pool, const char* filename, math::geometry::IndexedMesh<float>& mesh);
+
+} // namespace mesh
+} // namespace deimos
+
+#endif // DEIMOS_MESH_OBJ__
@@ -0,0 +1,711 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/detail/endian.hpp>
+
+#include "../stream/mapped_file.h"
+#include "mesh_ply.h"
+
+namespace deimos {
+namespace mesh {
+
+namespace {
+
+	using math::geometry::IndexedMesh;
+	using math::geometry::MeshFace;
+
+	typedef math::Vector<float, 4> Vec4;
+	typedef math::Vector<float, 2> Vec2;
+
+	// vertices or faces per decode task
+	const size_t PLY_GRAIN = 1 << 16;
+
+	enum PlyType
+	{
+		PLY_NONE,
+		PLY_INT8,
+		PLY_UINT8,
+		PLY_INT16,
+		PLY_UINT16,
+		PLY_INT32,
+		PLY_UINT32,
+		PLY_FLOAT32,
+		PLY_FLOAT64
+	};
+
+	PlyType parse_type(const std::string& op)
+	{
+		if (op == "char" || op == "int8")		return PLY_INT8;
+		if (op == "uchar" || op == "uint8")		return PLY_UINT8;
+		if (op == "short" || op == "int16")		return PLY_INT16;
+		if (op == "ushort" || op == "uint16")	return PLY_UINT16;
+		if (op == "int" || op == "int32")		return PLY_INT32;
+		if (op == "uint" || op == "uint32")		return PLY_UINT32;
+		if (op == "float" || op == "float32")	return PLY_FLOAT32;
+		if (op == "double" || op == "float64")	return PLY_FLOAT64;
+
+		return PLY_NONE;
+	}
+
+	inline size_t type_size(PlyType op)
+	{
+		switch (op)
+		{
+		case PLY_INT8:
+		case PLY_UINT8:		return 1;
+		case PLY_INT16:
+		case PLY_UINT16:	return 2;
+		case PLY_INT32:
+		case PLY_UINT32:
+		case PLY_FLOAT32:	return 4;
+		case PLY_FLOAT64:	return 8;
+		default:			return 0;
+		}
+	}
+
+	// integer colors are scaled to [0, 1]
+	inline float color_scale(PlyType op)
+	{
+		switch (op)
+		{
+		case PLY_INT8:
+		case PLY_UINT8:		return 1.f/255;
+		case PLY_INT16:
+		case PLY_UINT16:	return 1.f/65535;
+		case PLY_INT32:
+		case PLY_UINT32:	return 1.f/4294967295.f;
+		default:			return 1.f;
+		}
+	}
+
+	// unaligned value at p, byte swapped if the file has the other byte order
+	template<typename T>
+	inline T load(const char* p, bool swap)
+	{
+		char bytes[sizeof(T)];
+		std::memcpy(bytes, p, sizeof(T));
+
+		if (swap)
+			std::reverse(bytes, bytes + sizeof(T));
+
+		T res;
+		std::memcpy(&res, bytes, sizeof(T));
+		return res;
+	}
+
+	inline double read_real(const char* p, PlyType type, bool swap)
+	{
+		switch (type)
+		{
+		case PLY_INT8:		return load<signed char>(p, swap);
+		case PLY_UINT8:		return load<unsigned char>(p, swap);
+		case PLY_INT16:		return load<short>(p, swap);
+		case PLY_UINT16:	return load<unsigned short>(p, swap);
+		case PLY_INT32:		return load<int>(p, swap);
+		case PLY_UINT32:	return load<unsigned int>(p, swap);
+		case PLY_FLOAT32:	return load<float>(p, swap);
+		case PLY_FLOAT64:	return load<double>(p, swap);
+		default:			return 0;
+		}
+	}
+
+	// negative indices wrap around and are out of range
+	inline unsigned int read_index(const char* p, PlyType type, bool swap)
+	{
+		switch (type)
+		{
+		case PLY_INT8:		return static_cast<unsigned int>(load<signed char>(p, swap));
+		case PLY_UINT8:		return load<unsigned char>(p, swap);
+		case PLY_INT16:		return static_cast<unsigned int>(load<short>(p, swap));
+		case PLY_UINT16:	return load<unsigned short>(p, swap);
+		case PLY_INT32:		return static_cast<unsigned int>(load<int>(p, swap));
+		case PLY_UINT32:	return load<unsigned int>(p, swap);
+		case PLY_FLOAT32:	return static_cast<unsigned int>(load<float>(p, swap));
+		case PLY_FLOAT64:	return static_cast<unsigned int>(load<double>(p, swap));
+		default:			return ~0u;
+		}
+	}
+
+	struct PlyProperty
+	{
+		std::string name_;
+
+		// a list has count_type_ elements of type_
+		PlyType type_, count_type_;
+		bool list_;
+
+		// from the start of the element, only for elements without lists
+		size_t offset_;
+	};
+
+	struct PlyElement
+	{
+		std::string name_;
+		size_t count_;
+		std::vector<PlyProperty> properties_;
+
+		// bytes per element, 0 if it has lists
+		size_t size_;
+	};
+
+	// a property decoded into the mesh
+	struct Field
+	{
+		size_t offset_;
+		PlyType type_;
+	};
+
+	// faces decoded by one task
+	struct FaceChunk
+	{
+		const char* begin_;
+		size_t faces_;
+
+		// triangles in the chunk, their first one after the prefix sum
+		size_t triangles_;
+
+		bool error_;
+	};
+
+	class PlyParser
+	{
+	private:
+		PlyParser(const PlyParser&);
+		PlyParser& operator=(const PlyParser&);
+
+	protected:
+		IndexedMesh<float>& mesh_;
+
+		const char* end_;
+		bool swap_;
+
+		std::vector<PlyElement> elements_;
+
+		const char* vertices_;
+		const PlyElement* vertex_element_;
+		Field position_[3], normal_[3], texcoord_[2], color_[4];
+
+		const PlyElement* face_element_;
+		size_t index_property_;
+		std::vector<FaceChunk> face_chunks_;
+
+		static bool error(const char* message)
+		{
+			std::cout << "MeshPly: error (" << message << ")" << std::endl;
+			return false;
+		}
+
+		bool parse_header(const char*& p)
+		{
+			bool format = false;
+			std::string line;
+
+			for (size_t n=0; ; ++n)
+			{
+				const char* eol = static_cast<const char*>(std::memchr(p, '\n', end_ - p));
+
+				if (!eol)
+					return error("header");
+
+				line.assign(p, eol);
+				p = eol + 1;
+
+				if (!line.empty() && line[line.size() - 1] == '\r')
+					line.resize(line.size() - 1);
+
+				std::istringstream tokens(line);
+				std::string keyword;
+				tokens >> keyword;
+
+				if (n == 0)
+				{
+					if (keyword != "ply")
+						return error("not a ply file");
+				}
+				else if (keyword == "format")
+				{
+					std::string type;
+					tokens >> type;
+
+					if (type == "ascii")
+						return error("ascii not supported");
+
+					if (type != "binary_little_endian" && type != "binary_big_endian")
+						return error("format");
+
+#ifdef BOOST_BIG_ENDIAN
+					swap_ = (type == "binary_little_endian");
+#else
+					swap_ = (type == "binary_big_endian");
+#endif
+					format = true;
+				}
+				else if (keyword == "element")
+				{
+					PlyElement e;
+					e.size_ = 0;
+
+					if (!(tokens >> e.name_ >> e.count_))
+						return error("element");
+
+					elements_.push_back(e);
+				}
+				else if (keyword == "property")
+				{
+					if (elements_.empty())
+						return error("property without element");
+
+					PlyProperty prop;
+					std::string type;
+					tokens >> type;
+
+					prop.list_ = (type == "list");
+					prop.count_type_ = PLY_NONE;
+
+					if (prop.list_)
+					{
+						std::string count_type;
+						tokens >> count_type >> type;
+						prop.count_type_ = parse_type(count_type);
+					}
+
+					prop.type_ = parse_type(type);
+
+					if (!(tokens >> prop.name_) || prop.type_ == PLY_NONE || (prop.list_ && prop.count_type_ == PLY_NONE))
+						return error("property");
+
+					elements_.back().properties_.push_back(prop);
+				}
+				else if (keyword == "end_header")
+					break;
+				else if (keyword != "comment" && keyword != "obj_info" && !keyword.empty())
+					return error("header");
+			}
+
+			if (!format)
+				return error("format");
+
+			// offsets and sizes of elements without lists
+			for (size_t i=0; i < elements_.size(); ++i)
+			{
+				PlyElement& e = elements_[i];
+				size_t offset = 0;
+
+				for (size_t j=0; j < e.properties_.size() && offset != size_t(-1); ++j)
+				{
+					if (e.properties_[j].list_)
+						offset = size_t(-1);
+					else
+					{
+						e.properties_[j].offset_ = offset;
+						offset += type_size(e.properties_[j].type_);
+					}
+				}
+
+				e.size_ = (offset == size_t(-1)) ? 0 : offset;
+			}
+
+			return true;
+		}
+
+		Field find_field(const PlyElement& element, const char* name) const
+		{
+			Field res = { 0, PLY_NONE };
+
+			for (size_t i=0; i < element.properties_.size(); ++i)
+				if (element.properties_[i].name_ == name)
+				{
+					res.offset_ = element.properties_[i].offset_;
+					res.type_ = element.properties_[i].type_;
+				}
+
+			return res;
+		}
+
+		// the first pair of names that exists
+		void find_fields(const PlyElement& element, const char* const names[][2], size_t n, Field* res) const
+		{
+			for (size_t i=0; i < n; ++i)
+			{
+				res[0] = find_field(element, names[i][0]);
+				res[1] = find_field(element, names[i][1]);
+
+				if (res[0].type_ != PLY_NONE && res[1].type_ != PLY_NONE)
+					return;
+			}
+
+			res[0].type_ = res[1].type_ = PLY_NONE;
+		}
+
+		void decode_vertices(size_t first, size_t last)
+		{
+			const bool normals = mesh_.has_normals();
+			const bool texcoords = mesh_.has_texcoords();
+			const bool colors = mesh_.has_colors();
+
+			float scale[4];
+
+			for (int c=0; c < 4; ++c)
+				scale[c] = color_scale(color_[c].type_);
+
+			for (size_t i=first; i < last; ++i)
+			{
+				const char* v = vertices_ + i*vertex_element_->size_;
+
+				Vec4& pos = mesh_.position_[i];
+
+				for (int c=0; c < 3; ++c)
+					pos[c] = static_cast<float>(read_real(v + position_[c].offset_, position_[c].type_, swap_));
+
+				pos[3] = 1;
+
+				if (normals)
+				{
+					Vec4& nor = mesh_.normal_[i];
+
+					for (int c=0; c < 3; ++c)
+						nor[c] = static_cast<float>(read_real(v + normal_[c].offset_, normal_[c].type_, swap_));
+
+					nor[3] = 0;
+				}
+
+				if (texcoords)
+					for (int c=0; c < 2; ++c)
+						mesh_.texcoord_[i][c] = static_cast<float>(read_real(v + texcoord_[c].offset_, texcoord_[c].type_, swap_));
+
+				if (colors)
+				{
+					Vec4& col = mesh_.color_[i];
+
+					for (int c=0; c < 4; ++c)
+						col[c] = (color_[c].type_ == PLY_NONE) ? 1.f :
+							static_cast<float>(read_real(v + color_[c].offset_, color_[c].type_, swap_)) * scale[c];
+				}
+			}
+		}
+
+		bool setup_vertices(const char* p)
+		{
+			static const char* const POSITION[] = { "x", "y", "z" };
+			static const char* const NORMAL[] = { "nx", "ny", "nz" };
+			static const char* const COLOR[] = { "red", "green", "blue", "alpha" };
+			static const char* const TEXCOORD[][2] = { { "u", "v" }, { "s", "t" }, { "texture_u", "texture_v" }, { "texture_s", "texture_t" } };
+
+			const PlyElement& e = *vertex_element_;
+
+			if (e.size_ == 0 && !e.properties_.empty())
+				return error("vertex lists not supported");
+
+			if (size_t(end_ - p) / std::max<size_t>(e.size_, 1) < e.count_)
+				return error("file too short");
+
+			vertices_ = p;
+
+			bool normals = true, colors = true;
+
+			for (int c=0; c < 3; ++c)
+			{
+				position_[c] = find_field(e, POSITION[c]);
+				normal_[c] = find_field(e, NORMAL[c]);
+				color_[c] = find_field(e, COLOR[c]);
+
+				if (position_[c].type_ == PLY_NONE)
+					return error("vertex without position");
+
+				normals &= (normal_[c].type_ != PLY_NONE);
+				colors &= (color_[c].type_ != PLY_NONE);
+			}
+
+			color_[3] = find_field(e, COLOR[3]);
+			find_fields(e, TEXCOORD, sizeof(TEXCOORD)/sizeof(TEXCOORD[0]), texcoord_);
+
+			mesh_.position_.resize(e.count_);
+
+			if (normals)
+				mesh_.normal_.resize(e.count_);
+
+			if (texcoord_[0].type_ != PLY_NONE)
+				mesh_.texcoord_.resize(e.count_);
+
+			if (colors)
+				mesh_.color_.resize(e.count_);
+
+			return true;
+		}
+
+		// the element at p, the number of vertex indices in corners; 0 if the file ends before it
+		const char* skip_face(const char* p, size_t& corners) const
+		{
+			const std::vector<PlyProperty>& props = face_element_->properties_;
+			corners = 0;
+
+			for (size_t i=0; i < props.size(); ++i)
+			{
+				const PlyProperty& prop = props[i];
+
+				const size_t size = type_size(prop.list_ ? prop.count_type_ : prop.type_);
+
+				if (size_t(end_ - p) < size)
+					return 0;
+
+				if (!prop.list_)
+				{
+					p += size;
+					continue;
+				}
+
+				const size_t count_size = size;
+
+				const size_t n = read_index(p, prop.count_type_, swap_);
+				p += count_size;
+
+				if (n > size_t(end_ - p) / type_size(prop.type_))
+					return 0;
+
+				p += n * type_size(prop.type_);
+
+				if (i == index_property_)
+					corners = n;
+			}
+
+			return p;
+		}
+
+		// finds the start of every chunk of faces and how many triangles it has
+		const char* walk_faces(const char* p)
+		{
+			const size_t count = face_element_->count_;
+			face_chunks_.resize((count + PLY_GRAIN - 1) / PLY_GRAIN);
+
+			for (size_t c=0; c < face_chunks_.size(); ++c)
+			{
+				FaceChunk& chunk = face_chunks_[c];
+
+				chunk.begin_ = p;
+				chunk.faces_ = std::min(PLY_GRAIN, count - c*PLY_GRAIN);
+				chunk.triangles_ = 0;
+				chunk.error_ = false;
+
+				for (size_t f=0; f < chunk.faces_; ++f)
+				{
+					size_t corners;
+
+					if (!(p = skip_face(p, corners)))
+						return 0;
+
+					if (corners > 2)
+						chunk.triangles_ += corners - 2;
+				}
+			}
+
+			return p;
+		}
+
+		void decode_face_chunk(FaceChunk& chunk)
+		{
+			const std::vector<PlyProperty>& props = face_element_->properties_;
+			const unsigned int num_vertices = static_cast<unsigned int>(mesh_.num_vertices());
+
+			const char* p = chunk.begin_;
+			size_t triangle = chunk.triangles_;
+
+			for (size_t f=0; f < chunk.faces_; ++f)
+				for (size_t i=0; i < props.size(); ++i)
+				{
+					const PlyProperty& prop = props[i];
+
+					if (!prop.list_)
+					{
+						p += type_size(prop.type_);
+						continue;
+					}
+
+					const size_t n = read_index(p, prop.count_type_, swap_);
+					const size_t item_size = type_size(prop.type_);
+					p += type_size(prop.count_type_);
+
+					if (i == index_property_ && n > 2)
+					{
+						const unsigned int first = read_index(p, prop.type_, swap_);
+						unsigned int previous = read_index(p + item_size, prop.type_, swap_);
+
+						chunk.error_ |= (first >= num_vertices || previous >= num_vertices);
+
+						for (size_t k=2; k < n; ++k)
+						{
+							const unsigned int current = read_index(p + k*item_size, prop.type_, swap_);
+							chunk.error_ |= (current >= num_vertices);
+
+							MeshFace& face = mesh_.face_[triangle++];
+							face.vertex_[0] = first;
+							face.vertex_[1] = previous;
+							face.vertex_[2] = current;
+
+							previous = current;
+						}
+					}
+
+					p += n * item_size;
+				}
+		}
+
+		void decode_faces(size_t first, size_t last)
+		{
+			for (size_t i=first; i < last; ++i)
+				decode_face_chunk(face_chunks_[i]);
+		}
+
+		bool setup_faces()
+		{
+			const PlyElement& e = *face_element_;
+			index_property_ = e.properties_.size();
+
+			for (size_t i=0; i < e.properties_.size(); ++i)
+				if (e.properties_[i].list_ && (e.properties_[i].name_ == "vertex_indices" || e.properties_[i].name_ == "vertex_index"))
+					index_property_ = i;
+
+			if (index_property_ == e.properties_.size())
+				return error("face without vertex_indices");
+
+			return true;
+		}
+
+		// the element at p, 0 if the file ends before it
+		const char* skip_element(const PlyElement& element, const char* p) const
+		{
+			if (element.size_ || element.properties_.empty())
+				return (size_t(end_ - p) / std::max<size_t>(element.size_, 1) < element.count_) ? 0 : p + element.size_*element.count_;
+
+			for (size_t n=0; n < element.count_ && p; ++n)
+				for (size_t i=0; i < element.properties_.size() && p; ++i)
+				{
+					const PlyProperty& prop = element.properties_[i];
+					const size_t size = type_size(prop.list_ ? prop.count_type_ : prop.type_);
+
+					if (size_t(end_ - p) < size)
+						return 0;
+
+					if (prop.list_)
+					{
+						const size_t count = read_index(p, prop.count_type_, swap_);
+						p += size;
+
+						if (count > size_t(end_ - p) / type_size(prop.type_))
+							return 0;
+
+						p += count * type_size(prop.type_);
+					}
+					else
+						p += size;
+				}
+
+			return p;
+		}
+
+	public:
+		PlyParser(IndexedMesh<float>& mesh) : mesh_(mesh), end_(0), swap_(false), vertices_(0), vertex_element_(0), face_element_(0), index_property_(0) {};
+
+		bool parse(thread::TaskPool& pool, const char* data, size_t size)
+		{
+			using namespace boost::placeholders;
+
+			const char* p = data;
+			end_ = data + size;
+
+			mesh_.clear();
+
+			if (!data)
+				return error("not a ply file");
+
+			if (!parse_header(p))
+				return false;
+
+			for (size_t i=0; i < elements_.size(); ++i)
+			{
+				const PlyElement& e = elements_[i];
+
+				if (e.name_ == "vertex" && !vertex_element_)
+				{
+					vertex_element_ = &e;
+
+					if (!setup_vertices(p))
+						return false;
+
+					p += e.size_ * e.count_;
+				}
+				else if (e.name_ == "face" && !face_element_)
+				{
+					face_element_ = &e;
+
+					if (!setup_faces())
+						return false;
+
+					if (!(p = walk_faces(p)))
+						return error("file too short");
+				}
+				else if (!(p = skip_element(e, p)))
+					return error("file too short");
+			}
+
+			if (vertex_element_)
+				thread::parallel_for(pool, 0, vertex_element_->count_, PLY_GRAIN, boost::bind(&PlyParser::decode_vertices, this, _1, _2));
+
+			if (face_element_)
+			{
+				size_t triangles = 0;
+
+				for (size_t i=0; i < face_chunks_.size(); ++i)
+				{
+					std::swap(triangles, face_chunks_[i].triangles_);
+					triangles += face_chunks_[i].triangles_;
+				}
+
+				mesh_.face_.resize(triangles);
+				thread::parallel_for(pool, 0, face_chunks_.size(), 1, boost::bind(&PlyParser::decode_faces, this, _1, _2));
+
+				for (size_t i=0; i < face_chunks_.size(); ++i)
+					if (face_chunks_[i].error_)
+					{
+						mesh_.clear();
+						return error("vertex index out of range");
+					}
+			}
+
+			return true;
+		};
+	};
+
+} // namespace
+
+bool load_ply(const char* filename, math::geometry::IndexedMesh<float>& mesh)
+{
+	thread::TaskPool pool(0);
+	return load_ply(pool, filename, mesh);
+}
+
+bool load_ply(thread::TaskPool& pool, const char* filename, math::geometry::IndexedMesh<float>& mesh)
+{
+	MappedFile file(filename);
+
+	if (!file.is_open())
+	{
+		std::cout << "MeshPly: Could not open file " << filename << std::endl;
+		return false;
+	}
+
+	PlyParser parser(mesh);
+	return parser.parse(pool, file.data(), file.size());
+}
+
+} // namespace mesh
+} // namespace deimos
@@ -0,0 +1,33 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Binary PLY loader (little or big endian, ascii files are refused) for the
+ * vertex element with position, normal (nx ny nz), texture coordinates
+ * (u v, s t or texture_u texture_v) and color (red green blue [alpha],
+ * integers are scaled to [0, 1]), and the vertex_indices list of the face
+ * element. Polygons are split into triangle fans, other elements and
+ * properties are skipped.
+ *
+ * The file is memory mapped. Vertices have a fixed size and are decoded in
+ * parallel on the pool; faces are walked once to find where every chunk of
+ * them starts and how many triangles it has, then decoded in parallel too.
+ */
+
+#if !defined(DEIMOS_MESH_PLY__)
+#define DEIMOS_MESH_PLY__
+
+#include "../math/mesh.h"
+#include "../thread/task_pool.h"
+
+namespace deimos {
+namespace mesh {
+
+	bool load_ply(const char* filename, math::geometry::IndexedMesh<float>& mesh);
+	bool load_ply(thread::TaskPool& pool, const char* filename, math::geometry::IndexedMesh<float>& mesh);
+
+} // namespace mesh
+} // namespace deimos
+
+#endif // DEIMOS_MESH_PLY__
@@ -0,0 +1,182 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2004
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * Read-only memory mapping of a whole file. The pages are only read from
+ * disk when touched, so parsers can hand disjoint ranges of data() to
+ * several threads without copying the file into a buffer first.
+ */
+
+#if !defined(DEIMOS_MAPPED_FILE__)
+#define DEIMOS_MAPPED_FILE__
+
+#include <cstddef>
+
+#if defined(_WIN32)
+#if !defined(WIN32_LEAN_AND_MEAN)
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace deimos {
+
+class MappedFile
+{
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+protected:
+	const char* data_;
+	size_t size_;
+
+#if defined(_WIN32)
+	HANDLE file_, mapping_;
+#else
+	int file_;
+#endif
+
+public:
+	MappedFile() : data_(0), size_(0)
+	{
+#if defined(_WIN32)
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = 0;
+#else
+		file_ = -1;
+#endif
+	};
+
+	explicit MappedFile(const char* filename) : data_(0), size_(0)
+	{
+#if defined(_WIN32)
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = 0;
+#else
+		file_ = -1;
+#endif
+		open(filename);
+	};
+
+	~MappedFile()
+	{
+		close();
+	};
+
+	// an empty file opens with data() == 0
+	bool open(const char* filename)
+	{
+		close();
+
+#if defined(_WIN32)
+		file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+		if (file_ == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+
+		if (!GetFileSizeEx(file_, &size))
+		{
+			close();
+			return false;
+		}
+
+		size_ = static_cast<size_t>(size.QuadPart);
+
+		if (size_ == 0)
+			return true;
+
+		mapping_ = CreateFileMappingA(file_, 0, PAGE_READONLY, 0, 0, 0);
+
+		if (!mapping_)
+		{
+			close();
+			return false;
+		}
+
+		data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+		file_ = ::open(filename, O_RDONLY);
+
+		if (file_ < 0)
+			return false;
+
+		struct stat info;
+
+		if (fstat(file_, &info) != 0)
+		{
+			close();
+			return false;
+		}
+
+		size_ = static_cast<size_t>(info.st_size);
+
+		if (size_ == 0)
+			return true;
+
+		void* data = mmap(0, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+		data_ = (data == MAP_FAILED) ? 0 : static_cast<const char*>(data);
+
+#if defined(MADV_SEQUENTIAL)
+		if (data_)
+			madvise(data, size_, MADV_SEQUENTIAL);
+#endif
+#endif
+
+		if (!data_)
+		{
+			close();
+			return false;
+		}
+
+		return true;
+	};
+
+	void close()
+	{
+#if defined(_WIN32)
+		if (data_)
+			UnmapViewOfFile(data_);
+
+		if (mapping_)
+			CloseHandle(mapping_);
+
+		if (file_ != INVALID_HANDLE_VALUE)
+			CloseHandle(file_);
+
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = 0;
+#else
+		if (data_)
+			munmap(const_cast<char*>(data_), size_);
+
+		if (file_ >= 0)
+			::close(file_);
+
+		file_ = -1;
+#endif
+		data_ = 0;
+		size_ = 0;
+	};
+
+#if defined(_WIN32)
+	inline bool is_open() const			{ return file_ != INVALID_HANDLE_VALUE; };
+#else
+	inline bool is_open() const			{ return file_ >= 0; };
+#endif
+
+	inline const char* data() const		{ return data_; };
+	inline size_t size() const			{ return size_; };
+};
+
+} // namespace deimos
+
+#endif // DEIMOS_MAPPED_FILE__
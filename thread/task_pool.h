@@ -0,0 +1,288 @@
+/*
+ * Deimos tool library - Tobias Alexander Franke 2006
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ *
+ * A pool of worker threads with one task queue per worker. Workers take new
+ * tasks from the back of their own queue and steal from the front of the
+ * others when it runs empty. Threads waiting on a TaskGroup run queued tasks
+ * instead of blocking, so tasks may start and wait for sub tasks themselves.
+ *
+ *   thread::TaskPool pool;
+ *   using namespace boost::placeholders;
+ *   thread::parallel_for(pool, 0, count, 4096, boost::bind(&work, _1, _2));
+ *
+ * Tasks must not throw.
+ */
+
+#if !defined(DEIMOS_THREAD_TASK_POOL__)
+#define DEIMOS_THREAD_TASK_POOL__
+
+#include <cassert>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <boost/bind/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+namespace deimos {
+namespace thread {
+
+class TaskPool
+{
+public:
+	typedef boost::function<void()> Task;
+
+protected:
+	struct Queue
+	{
+		boost::mutex mutex_;
+		std::deque<Task> tasks_;
+	};
+
+	// queues_[0] takes tasks from threads outside the pool, worker i owns queues_[i+1]
+	std::vector<Queue*> queues_;
+	boost::thread_group threads_;
+	boost::thread_specific_ptr<size_t> index_;
+
+	boost::mutex sleep_mutex_;
+	boost::condition_variable wake_;
+	size_t pending_;
+	size_t next_;
+	bool stop_;
+
+	TaskPool(const TaskPool&);
+	TaskPool& operator=(const TaskPool&);
+
+	static void no_cleanup(size_t*) {};
+
+	size_t own_queue() const
+	{
+		const size_t* index = index_.get();
+		return index ? *index : 0;
+	}
+
+	bool pop(Task& task)
+	{
+		const size_t own = own_queue();
+		const size_t num_queues = queues_.size();
+
+		for (size_t i = 0; i < num_queues; ++i)
+		{
+			Queue& queue = *queues_[(own + i) % num_queues];
+
+			boost::lock_guard<boost::mutex> lock(queue.mutex_);
+
+			if (queue.tasks_.empty())
+				continue;
+
+			// newest own task is still warm in the cache, steal the oldest elsewhere
+			if (i == 0)
+			{
+				task.swap(queue.tasks_.back());
+				queue.tasks_.pop_back();
+			}
+			else
+			{
+				task.swap(queue.tasks_.front());
+				queue.tasks_.pop_front();
+			}
+
+			break;
+		}
+
+		if (task.empty())
+			return false;
+
+		boost::lock_guard<boost::mutex> lock(sleep_mutex_);
+		--pending_;
+
+		return true;
+	}
+
+	void work(size_t index)
+	{
+		index_.reset(&index);
+
+		for (;;)
+		{
+			Task task;
+
+			if (pop(task))
+			{
+				task();
+				continue;
+			}
+
+			boost::unique_lock<boost::mutex> lock(sleep_mutex_);
+
+			while (pending_ == 0 && !stop_)
+				wake_.wait(lock);
+
+			if (pending_ == 0 && stop_)
+				break;
+		}
+
+		index_.release();
+	}
+
+public:
+	// num_threads == 0 runs every task on the threads that wait for it
+	explicit TaskPool(size_t num_threads = boost::thread::hardware_concurrency()) :
+		index_(&TaskPool::no_cleanup), pending_(0), next_(0), stop_(false)
+	{
+		queues_.resize(num_threads + 1);
+
+		for (size_t i = 0; i < queues_.size(); ++i)
+			queues_[i] = new Queue;
+
+		for (size_t i = 0; i < num_threads; ++i)
+			threads_.create_thread(boost::bind(&TaskPool::work, this, i + 1));
+	}
+
+	~TaskPool()
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(sleep_mutex_);
+			stop_ = true;
+		}
+
+		wake_.notify_all();
+		threads_.join_all();
+
+		// without workers, tasks nobody waited for are dropped
+		for (size_t i = 0; i < queues_.size(); ++i)
+			delete queues_[i];
+	}
+
+	size_t get_num_threads() const
+	{
+		return queues_.size() - 1;
+	}
+
+	// workers push to their own queue, other threads spread their tasks over all queues
+	void submit(const Task& task)
+	{
+		size_t target = own_queue();
+
+		{
+			boost::lock_guard<boost::mutex> lock(sleep_mutex_);
+
+			if (target == 0)
+				target = next_++ % queues_.size();
+
+			++pending_;
+		}
+
+		{
+			Queue& queue = *queues_[target];
+			boost::lock_guard<boost::mutex> lock(queue.mutex_);
+			queue.tasks_.push_back(task);
+		}
+
+		wake_.notify_one();
+	}
+
+	// runs one queued task on the calling thread, false if there was none
+	bool run_one()
+	{
+		Task task;
+
+		if (!pop(task))
+			return false;
+
+		task();
+		return true;
+	}
+};
+
+/*
+ * Tasks that are waited for together. The group must outlive its tasks,
+ * wait() returns once all of them have finished.
+ */
+class TaskGroup
+{
+protected:
+	TaskPool& pool_;
+	boost::mutex mutex_;
+	size_t open_;
+
+	TaskGroup(const TaskGroup&);
+	TaskGroup& operator=(const TaskGroup&);
+
+	void execute(const TaskPool::Task& task)
+	{
+		task();
+
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		--open_;
+	}
+
+	bool done()
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		return open_ == 0;
+	}
+
+public:
+	explicit TaskGroup(TaskPool& pool) : pool_(pool), open_(0) {};
+
+	~TaskGroup()
+	{
+		wait();
+	}
+
+	void run(const TaskPool::Task& task)
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			++open_;
+		}
+
+		pool_.submit(boost::bind(&TaskGroup::execute, this, task));
+	}
+
+	// helps with queued tasks of any group until this one is done
+	void wait()
+	{
+		while (!done())
+			if (!pool_.run_one())
+				boost::this_thread::yield();
+	}
+};
+
+/*
+ * Calls func(first, last) for consecutive ranges of at most grain elements
+ * that cover [begin, end) and returns when all calls have finished.
+ */
+inline void parallel_for(TaskPool& pool, size_t begin, size_t end, size_t grain, const boost::function<void(size_t, size_t)>& func)
+{
+	assert(grain > 0);
+
+	if (end <= begin)
+		return;
+
+	// a single range isn't worth the detour through the queues
+	if (end - begin <= grain)
+	{
+		func(begin, end);
+		return;
+	}
+
+	TaskGroup group(pool);
+
+	for (size_t first = begin; first < end; first += grain)
+	{
+		const size_t last = (end - first > grain) ? first + grain : end;
+		group.run(boost::bind(func, first, last));
+	}
+
+	group.wait();
+}
+
+} // namespace thread
+} // namespace deimos
+
+#endif // DEIMOS_THREAD_TASK_POOL__